@@ -98,6 +98,24 @@ function isContourable(ary: any) : ary is ContourableTypedArray {
  */
 type ContourData = Record<number, [number, number][][]>;
 
+/**
+ * Contour data in a compact form for passing between threads. The vertices are quantized to 16 bits within the bounding box 
+ * (`x_min` to `x_max` and `y_min` to `y_max`), and each contour is stored as the zigzag-encoded varint differences from one vertex to the 
+ * next. Contour k has value `values[k]` and `n_points[k]` vertices. Use `decodeContourData()` to turn it back into {@link ContourData}.
+ * If the contours were restricted to a cell box, `cut_flags[k]` has bit 1 set if the start of contour k was cut at the edge of the box and 
+ * bit 2 set if the end was.
+ */
+type EncodedContourData = {
+    x_min: number;
+    y_min: number;
+    x_max: number;
+    y_max: number;
+    values: Float32Array;
+    n_points: Uint32Array;
+    data: Uint8Array;
+    cut_flags?: Uint8Array;
+}
+
 type mat4 = number[] | Float32Array | Float64Array;
 type RenderShaderData = {vertexShaderPrelude: string, define: string, variantName: string};
 
@@ -179,4 +197,4 @@ function getRendererData(arg: RenderMethodArg) : RendererData{
 
 export {isWebGL2Ctx, isContourable, getRendererData, isStormRelativeWindProfile};
 export type {WindProfile, StormRelativeWindProfile, GroundRelativeWindProfile, BillboardSpec, Polyline, LineData, WebGLAnyRenderingContext, 
-             TypedArray, TypedArrayStr, ContourableTypedArray, ContourData, RenderMethodArg, RendererData, RenderShaderData};
\ No newline at end of file
+             TypedArray, TypedArrayStr, ContourableTypedArray, ContourData, EncodedContourData, RenderMethodArg, RendererData, RenderShaderData};
\ No newline at end of file
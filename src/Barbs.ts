@@ -223,7 +223,7 @@ class Barbs<ArrayType extends TypedArray, GridType extends AutoZoomGrid, MapType
     public async updateField(fields: RawVectorField<ArrayType, GridType>) {
         this.fields = fields;
         if (this.gl_elems === null) return;
-        this.gl_elems.barb_billboards.updateField(fields);
+        await this.gl_elems.barb_billboards.updateField(fields);
         this.gl_elems.map.triggerRepaint();
     }
 
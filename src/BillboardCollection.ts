@@ -60,19 +60,19 @@ class BillboardCollection<ArrayType extends TypedArray, GridType extends AutoZoo
         this.wind_textures = null;
     }
 
-    public updateField(field: RawVectorField<ArrayType, GridType>) {
+    public async updateField(field: RawVectorField<ArrayType, GridType>) {
         this.field = field;
 
         if (this.gl_elems === null) return;
 
         const gl = this.gl_elems.gl;
-        const data = this.field.getThinnedField(this.thin_fac, this.max_zoom);
+        const data = await this.field.getThinnedField(this.thin_fac, this.max_zoom);
 
         this.wind_textures = data.updateTexImageData(gl, gl.NEAREST, this.wind_textures);
     }
 
     public async setup(gl: WebGLAnyRenderingContext) {
-        const thinned_grid = this.field.grid.getThinnedGrid(this.thin_fac, this.max_zoom);
+        const thinned_grid = await this.field.grid.getThinnedGrid(this.thin_fac, this.max_zoom);
 
         const geom_verts = new Float32Array([0., 1., 2., 3.]);
         const geom_buffer = new WGLBuffer(gl, geom_verts, 1, gl.TRIANGLE_STRIP);
@@ -1,6 +1,6 @@
 
-import { LineData, RenderMethodArg, TypedArray, WebGLAnyRenderingContext } from './AutumnTypes';
-import { LngLat, MapLikeType } from './Map';
+import { ContourData, LineData, RenderMethodArg, TypedArray, WebGLAnyRenderingContext } from './AutumnTypes';
+import { LngLat, MapLikeType, latFromMercatorY, lngFromMercatorX, mercatorXfromLng, mercatorYfromLat } from './Map';
 import { PlotComponent } from './PlotComponent';
 import { RawScalarField } from './RawField';
 import { LineStyle, PolylineCollection, PolylineCollectionOpts, isLineStyle } from './PolylineCollection';
@@ -11,6 +11,7 @@ import { normalizeOptions } from './utils';
 import { ColorMap } from './Colormap';
 import { StructuredGrid} from './grids/StructuredGrid';
 import { UnstructuredGrid } from './grids/UnstructuredGrid';
+import { GridFilterOpts } from './ContourCreator.worker';
 
 /** Options for {@link Contour} components */
 interface ContourOptions {
@@ -59,6 +60,38 @@ interface ContourOptions {
      * 
      */
     quad_as_tri?: boolean;
+
+    /**
+     * Number of passes of corner cutting to smooth the contours with. Each pass doubles the number of points in the contours.
+     * @default 0
+     */
+    smooth?: number;
+
+    /**
+     * Smooth and/or decimate the grid before contouring it (e.g., `{gaussian_sigma: 2}` or `{decimate: 4}`)
+     * @default null
+     */
+    grid_filter?: GridFilterOpts | null;
+
+    /**
+     * Number of resolutions to contour at for drawing at different map zooms. Each resolution halves the grid, so coarser contours are drawn when 
+     *  zoomed out. The `smooth` and `grid_filter` options are ignored when this is more than 1.
+     * @default 1
+     */
+    lod_levels?: number;
+
+    /**
+     * Map zoom at and above which the full-resolution contours are drawn. Each zoom level below this draws the next coarser resolution.
+     * @default 0
+     */
+    lod_zoom?: number;
+
+    /**
+     * Keep the block minima or maxima instead of the block means when making coarser resolutions, so small highs and lows are still contoured 
+     *  when zoomed out
+     * @default false
+     */
+    lod_preserve_extrema?: boolean;
 }
 
 const contour_opt_defaults: Required<ContourOptions> = {
@@ -68,7 +101,12 @@ const contour_opt_defaults: Required<ContourOptions> = {
     levels: null,
     line_width: 2,
     line_style: '-',
-    quad_as_tri: false
+    quad_as_tri: false,
+    smooth: 0,
+    grid_filter: null,
+    lod_levels: 1,
+    lod_zoom: 0,
+    lod_preserve_extrema: false,
 }
 
 interface ContourGLElems<MapType extends MapLikeType> {
@@ -97,7 +135,8 @@ class Contour<ArrayType extends TypedArray, GridType extends StructuredGrid, Map
     public readonly opts: Required<ContourOptions>;
 
     private gl_elems: ContourGLElems<MapType> | null;
-    private contours: PolylineCollection[] | null;
+    // One list of PolylineCollections per resolution, from finest to coarsest
+    private contours: PolylineCollection[][] | null;
 
     /**
      * Create a contoured field
@@ -124,8 +163,18 @@ class Contour<ArrayType extends TypedArray, GridType extends StructuredGrid, Map
 
         const gl = this.gl_elems.gl;
 
-        const contour_data = await this.getContours();
+        const contour_pyramid = this.opts.lod_levels > 1 ? await this.getContourPyramid() : [await this.getContours()];
+        const promises = contour_pyramid.map(contour_data => this.makePolylineCollections(gl, contour_data));
+
+        Promise.all(promises).then(values => {
+            if (this.gl_elems === null) return;
+
+            this.contours = values;
+            this.gl_elems.map.triggerRepaint();
+        });
+    }
 
+    private async makePolylineCollections(gl: WebGLAnyRenderingContext, contour_data: ContourData) {
         type LineDataStyleWidth = {data: LineData[], line_width: number, line_style: LineStyle};
         const line_data: LineDataStyleWidth[] = [];
 
@@ -169,17 +218,50 @@ class Contour<ArrayType extends TypedArray, GridType extends StructuredGrid, Map
             return await PolylineCollection.make(gl, ld.data, plc_opts);
         });
 
-        Promise.all(promises).then(values => {
-            if (this.gl_elems === null) return;
-
-            this.contours = values;
-            this.gl_elems.map.triggerRepaint();
-        });
+        return await Promise.all(promises);
     }
 
     public async getContours() {
         const levels = this.opts.levels === null ? undefined : this.opts.levels;
-        return await this.field.getContours({interval: this.opts.interval, levels: levels, quad_as_tri: this.opts.quad_as_tri});
+        return await this.field.getContours({interval: this.opts.interval, levels: levels, quad_as_tri: this.opts.quad_as_tri, smooth: this.opts.smooth,
+                                                grid_filter: this.opts.grid_filter === null ? undefined : this.opts.grid_filter});
+    }
+
+    /**
+     * Get an index of the contours for culling the ones that are out of view and finding the contour under the cursor
+     */
+    public async getContourIndex() {
+        const levels = this.opts.levels === null ? undefined : this.opts.levels;
+        return await this.field.getContourIndex({interval: this.opts.interval, levels: levels, quad_as_tri: this.opts.quad_as_tri, smooth: this.opts.smooth,
+                                                    grid_filter: this.opts.grid_filter === null ? undefined : this.opts.grid_filter});
+    }
+
+    /**
+     * Find the contour nearest a point on the map (e.g., the one under the cursor)
+     * @param lon       - Longitude of the point
+     * @param lat       - Latitude of the point
+     * @param radius_px - Only look this many pixels from the point at the current map zoom
+     * @returns the contour level and index into the list of contours at that level from {@link getContours}, plus the nearest point on it, or 
+     *          null if no contour is within radius_px
+     */
+    public async getContourNear(lon: number, lat: number, radius_px?: number) {
+        if (this.gl_elems === null) return null;
+        radius_px = radius_px === undefined ? 5 : radius_px;
+
+        // Mercator coordinates are 0 to 1 across 512 pixels at zoom 0
+        const merc_per_px = 1 / (512 * Math.pow(2, this.gl_elems.map.getZoom()));
+        const lon_radius = lngFromMercatorX(mercatorXfromLng(lon) + radius_px * merc_per_px);
+        const lat_radius = latFromMercatorY(mercatorYfromLat(lat) + radius_px * merc_per_px);
+
+        const index = await this.getContourIndex();
+        const max_dist = Math.max(index.getDistance(lon, lat, lon_radius, lat), index.getDistance(lon, lat, lon, lat_radius));
+        return await index.nearest(lon, lat, max_dist);
+    }
+
+    public async getContourPyramid() {
+        const levels = this.opts.levels === null ? undefined : this.opts.levels;
+        return await this.field.getContourPyramid({interval: this.opts.interval, levels: levels, quad_as_tri: this.opts.quad_as_tri}, 
+                                                  this.opts.lod_levels, this.opts.lod_preserve_extrema);
     }
 
     /**
@@ -210,7 +292,9 @@ class Contour<ArrayType extends TypedArray, GridType extends StructuredGrid, Map
         const pitch = gl_elems.map.getPitch();
 
         // XXX: This will compile another shader each time updateField() is called. Is there a way to not do that?
-        this.contours.forEach(cnt => cnt.render(gl, arg, [map_width, map_height], zoom, bearing, pitch));
+        // Draw one resolution coarser for each zoom level below lod_zoom
+        const lod = Math.max(0, Math.min(this.contours.length - 1, Math.ceil(this.opts.lod_zoom - zoom)));
+        this.contours[lod].forEach(cnt => cnt.render(gl, arg, [map_width, map_height], zoom, bearing, pitch));
     }
 }
 
@@ -385,7 +469,7 @@ class ContourLabels<ArrayType extends TypedArray, GridType extends StructuredGri
         });
 
         const label_grid = new UnstructuredGrid(label_pos.map(lp => lp.coord));
-        const min_zoom = label_grid.getMinVisibleZoom(4);
+        const min_zoom = await label_grid.getMinVisibleZoom(4);
         const text_specs: TextSpec[] = label_pos.map((lp, ilp) => ({...lp.coord, min_zoom: min_zoom[ilp], text: lp.text}));
 
         const tc_opts: TextCollectionOptions = {
@@ -1,8 +1,8 @@
 
 import * as Comlink from 'comlink';
 
-import { GridCoords } from './grids/Grid';
-import { ContourData, ContourableTypedArray } from "./AutumnTypes";
+import { EarthCoords, GridCoords } from './grids/Grid';
+import { ContourData, ContourableTypedArray, EncodedContourData } from "./AutumnTypes";
 import { initMSModule } from "./WasmInterface";
 import { MarchingSquaresModule } from './cpp/marchingsquares';
 
@@ -12,6 +12,38 @@ async function init(wasm_base_url: string | undefined) {
     _msm = await initMSModule({document_script: wasm_base_url});
 }
 
+/** Options for smoothing and decimating a grid before contouring it */
+interface GridFilterOpts {
+    /**
+     * Smooth the grid with a Gaussian filter with this standard deviation (in grid points)
+     */
+    gaussian_sigma?: number;
+
+    /**
+     * Smooth the grid with a box filter with this radius (in grid points). Ignored if gaussian_sigma is given.
+     */
+    box_radius?: number;
+
+    /**
+     * Average blocks of this many grid points on a side after smoothing, which makes contouring much faster for large grids at low zooms
+     */
+    decimate?: number;
+
+    /**
+     * When decimating, keep the block minimum or maximum (whichever is farther from the block mean) instead of the block mean, so small highs
+     * and lows still get contoured
+     */
+    preserve_extrema?: boolean;
+}
+
+/** A box of grid cells, from cell (i_min, j_min) to cell (i_max, j_max), inclusive. Cell (i, j) has grid point (i, j) at its lower-left corner. */
+interface CellBox {
+    i_min: number;
+    j_min: number;
+    i_max: number;
+    j_max: number;
+}
+
 /** Options for contouring data via {@link RawScalarField.getContours | RawScalarField.getContours()} */
 interface FieldContourOpts {
     /**
@@ -28,8 +60,203 @@ interface FieldContourOpts {
      * Add triangles in the contouring, which takes longer and generates more detailed (not necessarily smoother or better) contours
      */
     quad_as_tri?: boolean;
+
+    /**
+     * Number of passes of corner cutting to smooth the contours with. Each pass doubles the number of points in the contours.
+     */
+    smooth?: number;
+
+    /**
+     * Smooth and/or decimate the grid before contouring it. The filtering happens in the contouring worker without copying the filtered grid back.
+     */
+    grid_filter?: GridFilterOpts;
+
+    /**
+     * Only contour the cells in this box (e.g., from {@link RawScalarField.getViewportCellBox | RawScalarField.getViewportCellBox()}), which is much 
+     * faster when zoomed in on a small part of a large grid. Contours that leave the box are cut at its edge.
+     */
+    cell_box?: CellBox;
+
+    /**
+     * Send the contours back from the contouring worker quantized and delta-encoded (see {@link EncodedContourData}), which makes the copy to
+     * the main thread several times smaller. Each vertex moves by up to half a quantization step, which is 1/65535 of the extent of the 
+     * contours, so this is best for fields that cover a small area or are only viewed zoomed out.
+     * @default false
+     */
+    encode?: boolean;
+}
+
+/** 
+ * The parameters for one of the grids that are implemented natively in the contouring workers, so the grid can be set up in a worker 
+ * without sending its coordinates
+ */
+type NativeGridDef = {type: 'latlon', ni: number, nj: number, ll_lon: number, ll_lat: number, ur_lon: number, ur_lat: number} |
+                     {type: 'lcc', ni: number, nj: number, lon_0: number, lat_0: number, lat_std_1: number, lat_std_2: number, 
+                      ll_x: number, ll_y: number, ur_x: number, ur_y: number, fast_math: boolean} |
+                     {type: 'geostationary', ni: number, nj: number, ll_x: number, ll_y: number, ur_x: number, ur_y: number, satellite_lon: number} |
+                     {type: 'radar', ni: number, nj: number, start_rn: number, end_rn: number, start_az: number, end_az: number, 
+                      longitude: number, latitude: number};
+
+// This many native grids are kept set up
+const MAX_NATIVE_GRIDS = 8;
+
+// Native grids, from least to most recently used
+const native_grids: Map<string, any> = new Map();
+
+// Get the native grid for a grid definition, setting it up if it isn't in this worker
+async function getNativeGrid(grid_def: NativeGridDef) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    const grid_key = JSON.stringify(grid_def);
+    let grid = native_grids.get(grid_key);
+
+    if (grid === undefined) {
+        const gd = grid_def;
+        if (gd.type == 'latlon') {
+            grid = new msm.PlateCarreeGrid(gd.ni, gd.nj, gd.ll_lon, gd.ll_lat, gd.ur_lon, gd.ur_lat);
+        }
+        else if (gd.type == 'lcc') {
+            grid = new msm.LambertGrid(gd.ni, gd.nj, gd.lon_0, gd.lat_0, gd.lat_std_1, gd.lat_std_2, gd.ll_x, gd.ll_y, gd.ur_x, gd.ur_y, gd.fast_math);
+        }
+        else if (gd.type == 'geostationary') {
+            grid = new msm.GeostationaryGrid(gd.ni, gd.nj, gd.ll_x, gd.ll_y, gd.ur_x, gd.ur_y, gd.satellite_lon);
+        }
+        else {
+            grid = new msm.RadarSweepGrid(gd.ni, gd.nj, gd.start_rn, gd.end_rn, gd.start_az, gd.end_az, gd.longitude, gd.latitude);
+        }
+
+        if (native_grids.size >= MAX_NATIVE_GRIDS) {
+            const [lru_key, lru_grid] = native_grids.entries().next().value;
+            lru_grid.delete();
+            native_grids.delete(lru_key);
+        }
+    }
+    else {
+        native_grids.delete(grid_key);
+    }
+
+    native_grids.set(grid_key, grid);
+    return grid;
 }
 
+// Earth coordinates at every grid point are kept for this many grids, as they're big
+const MAX_NATIVE_EARTH_COORDS = 2;
+
+// Earth coordinates of native grids, from least to most recently used
+const native_earth_coords: Map<string, EarthCoords> = new Map();
+
+// Get the earth coordinates at every point of a grid. If given a native grid definition, they're computed in this worker instead of being
+//  sent from the main thread.
+async function resolveEarthCoords(earth_coords: EarthCoords | NativeGridDef) {
+    if (!('type' in earth_coords)) return earth_coords;
+
+    const grid_key = JSON.stringify(earth_coords);
+    let coords = native_earth_coords.get(grid_key);
+
+    if (coords === undefined) {
+        const grid = await getNativeGrid(earth_coords);
+        coords = grid.getEarthCoords(undefined, undefined, false, false) as EarthCoords;
+
+        if (native_earth_coords.size >= MAX_NATIVE_EARTH_COORDS) {
+            const lru_key = native_earth_coords.keys().next().value;
+            native_earth_coords.delete(lru_key);
+        }
+    }
+    else {
+        native_earth_coords.delete(grid_key);
+    }
+
+    native_earth_coords.set(grid_key, coords);
+    return coords;
+}
+
+/**
+ * Get the earth coordinates for an n_i x n_j set of points spanning a native grid (by default, every grid point). With edge_i or edge_j, the 
+ * points span the edges of the grid cells instead of the grid points in that dimension.
+ */
+async function gridEarthCoords(grid_def: NativeGridDef, n_i?: number, n_j?: number, edge_i?: boolean, edge_j?: boolean) {
+    const grid = await getNativeGrid(grid_def);
+    return grid.getEarthCoords(n_i, n_j, edge_i === undefined ? false : edge_i, edge_j === undefined ? false : edge_j) as EarthCoords;
+}
+
+/**
+ * Make the triangle strips for drawing the domain of a native grid, in WebMercator coordinates. Only as many rows and columns are kept as are
+ * needed for the mesh to be within pixel_tolerance pixels of the true projected positions at the given zoom. Without a margin in a dimension, 
+ * the domain extends to the edges of the grid cells in that dimension.
+ */
+async function gridDomainBuffers(grid_def: NativeGridDef, margin_r: boolean, margin_s: boolean, pixel_tolerance: number, zoom: number) {
+    const grid = await getNativeGrid(grid_def);
+    return grid.getAdaptiveDomainBuffers(margin_r, margin_s, pixel_tolerance, zoom) as {vertices: Float32Array, tex_coords: Float32Array};
+}
+
+/**
+ * Rotate grid-relative vectors on a native grid to be relative to Earth. Float16 components (given and returned as their raw bits in 
+ * Uint16Arrays) stay float16.
+ */
+async function gridEarthRelativeVectors(grid_def: NativeGridDef, u: ContourableTypedArray, v: ContourableTypedArray) {
+    const grid = await getNativeGrid(grid_def);
+
+    if (u instanceof Float32Array) {
+        return grid.getEarthRelativeVectorsFloat32(u, v, false) as {u: Float32Array | Uint16Array, v: Float32Array | Uint16Array};
+    }
+
+    return grid.getEarthRelativeVectorsFloat16(u, v, true) as {u: Float32Array | Uint16Array, v: Float32Array | Uint16Array};
+}
+
+/**
+ * Compute the speed and meteorological direction (the bearing the vectors point from, in degrees clockwise from north) of vectors on a native 
+ * grid. Float16 components (given and returned as their raw bits in Uint16Arrays) stay float16.
+ */
+async function gridVectorSpeedDirection(grid_def: NativeGridDef, u: ContourableTypedArray, v: ContourableTypedArray, data_are_earth_relative: boolean) {
+    const grid = await getNativeGrid(grid_def);
+
+    if (u instanceof Float32Array) {
+        return grid.getVectorSpeedDirectionFloat32(u, v, data_are_earth_relative, false) as 
+            {speed: Float32Array | Uint16Array, direction: Float32Array | Uint16Array};
+    }
+
+    return grid.getVectorSpeedDirectionFloat16(u, v, data_are_earth_relative, true) as 
+        {speed: Float32Array | Uint16Array, direction: Float32Array | Uint16Array};
+}
+
+/**
+ * Make the billboard positions (in WebMercator coordinates) and texture coordinates for the grid points that are visible at or below 
+ * map_max_zoom. The minimum zoom for each point is packed into its i texture coordinate.
+ */
+async function makeBBElements(field_lats: Float32Array, field_lons: Float32Array, min_zoom: Uint8Array, field_ni: number, field_nj: number, 
+                              map_max_zoom: number) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    return msm.makeBBElements(field_lats, field_lons, min_zoom, field_ni, field_nj, map_max_zoom) as {pts: Float32Array, tex_coords: Float32Array};
+}
+
+/**
+ * Compute the minimum zoom at which each point of a structured grid is visible when thinned by thin_fac (a power of 2)
+ */
+async function structuredMinZoom(ni: number, nj: number, thin_fac: number) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    return msm.makeStructuredMinZoom(ni, nj, thin_fac) as Uint8Array;
+}
+
+/**
+ * Compute the minimum zoom at which each of a set of scattered points is visible when thinned by thin_fac, so that roughly one point is 
+ * visible in each map tile at each zoom
+ */
+async function unstructuredMinZoom(lons: Float32Array, lats: Float32Array, thin_fac: number) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    return msm.makeUnstructuredMinZoom(lons, lats, thin_fac) as Uint8Array;
+}
+
+/**
+ * Contour on a grid with 1D x and y coordinates. With `opts.encode`, the contours come back quantized and delta-encoded (see 
+ * {@link EncodedContourData}) to keep the copy back to the main thread small.
+ */
 async function contourCreator(data: ContourableTypedArray, grid_coords: GridCoords, opts: FieldContourOpts) {
     if (opts.interval === undefined && opts.levels === undefined) {
         throw "Must supply either an interval or levels to contourCreator()"
@@ -37,6 +264,8 @@ async function contourCreator(data: ContourableTypedArray, grid_coords: GridCoor
 
     const interval = opts.interval === undefined ? 0 : opts.interval;
     const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+    const smooth = opts.smooth === undefined ? 0 : opts.smooth;
+    const encode = opts.encode === undefined ? false : opts.encode;
 
     const msm = _msm === null ? await initMSModule({}) : _msm;
     _msm = msm;
@@ -45,13 +274,476 @@ async function contourCreator(data: ContourableTypedArray, grid_coords: GridCoor
     const makeContours = data instanceof Float32Array ? msm.makeContoursFloat32 : msm.makeContoursFloat16;
 
     const levels = opts.levels === undefined ? getContourLevels(data, grid_coords.x.length, grid_coords.y.length, interval) : opts.levels;
-    const contours = makeContours(data, grid_coords.x, grid_coords.y, levels, quad_as_tri);
+    const contours = makeContours(data, grid_coords.x, grid_coords.y, levels, quad_as_tri, smooth, opts.grid_filter, encode, opts.cell_box);
+
+    return contours as ContourData | EncodedContourData;
+}
+
+/**
+ * Contour on a curvilinear grid, where the earth coordinates are given for every grid point (or computed in the worker from a native grid 
+ * definition). The contours are interpolated directly in earth coordinates, so they don't need to be transformed afterward. They're encoded
+ * with `opts.encode`, as for contourCreator().
+ */
+async function contourCreatorCurvilinear(data: ContourableTypedArray, grid_earth_coords: EarthCoords | NativeGridDef, ni: number, nj: number, 
+                                         opts: FieldContourOpts) {
+    if (opts.interval === undefined && opts.levels === undefined) {
+        throw "Must supply either an interval or levels to contourCreatorCurvilinear()"
+    }
+
+    const interval = opts.interval === undefined ? 0 : opts.interval;
+    const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+    const smooth = opts.smooth === undefined ? 0 : opts.smooth;
+    const encode = opts.encode === undefined ? false : opts.encode;
+
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    const getContourLevels = data instanceof Float32Array ? msm.getContourLevelsFloat32 : msm.getContourLevelsFloat16;
+    const makeContours = data instanceof Float32Array ? msm.makeContoursCurvilinearFloat32 : msm.makeContoursCurvilinearFloat16;
+
+    const earth_coords = await resolveEarthCoords(grid_earth_coords);
+    const levels = opts.levels === undefined ? getContourLevels(data, ni, nj, interval) : opts.levels;
+    const contours = makeContours(data, earth_coords.lons, earth_coords.lats, ni, nj, levels, quad_as_tri, smooth, opts.grid_filter, encode, 
+                                  opts.cell_box);
+
+    return contours as ContourData | EncodedContourData;
+}
+
+/**
+ * Contour at several resolutions for drawing at different map zooms. Element k of the result is contoured from the grid decimated by 2^k. The
+ * result may have fewer than n_levels elements if the grid is small.
+ */
+async function contourPyramid(data: ContourableTypedArray, grid_coords: GridCoords, opts: FieldContourOpts, n_levels: number, preserve_extrema: boolean) {
+    if (opts.interval === undefined && opts.levels === undefined) {
+        throw "Must supply either an interval or levels to contourPyramid()"
+    }
+
+    const interval = opts.interval === undefined ? 0 : opts.interval;
+    const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    const getContourLevels = data instanceof Float32Array ? msm.getContourLevelsFloat32 : msm.getContourLevelsFloat16;
+    const makeContourPyramid = data instanceof Float32Array ? msm.makeContourPyramidFloat32 : msm.makeContourPyramidFloat16;
+
+    const levels = opts.levels === undefined ? getContourLevels(data, grid_coords.x.length, grid_coords.y.length, interval) : opts.levels;
+    const pyramid = makeContourPyramid(data, grid_coords.x, grid_coords.y, levels, quad_as_tri, n_levels, preserve_extrema);
+
+    return pyramid as ContourData[];
+}
+
+/**
+ * Same as contourPyramid(), but on a curvilinear grid (see contourCreatorCurvilinear())
+ */
+async function contourPyramidCurvilinear(data: ContourableTypedArray, grid_earth_coords: EarthCoords | NativeGridDef, ni: number, nj: number, 
+                                         opts: FieldContourOpts, n_levels: number, preserve_extrema: boolean) {
+    if (opts.interval === undefined && opts.levels === undefined) {
+        throw "Must supply either an interval or levels to contourPyramidCurvilinear()"
+    }
+
+    const interval = opts.interval === undefined ? 0 : opts.interval;
+    const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    const getContourLevels = data instanceof Float32Array ? msm.getContourLevelsFloat32 : msm.getContourLevelsFloat16;
+    const makeContourPyramid = data instanceof Float32Array ? msm.makeContourPyramidCurvilinearFloat32 : msm.makeContourPyramidCurvilinearFloat16;
+
+    const earth_coords = await resolveEarthCoords(grid_earth_coords);
+    const levels = opts.levels === undefined ? getContourLevels(data, ni, nj, interval) : opts.levels;
+    const pyramid = makeContourPyramid(data, earth_coords.lons, earth_coords.lats, ni, nj, levels, quad_as_tri, n_levels, preserve_extrema);
+
+    return pyramid as ContourData[];
+}
+
+/** A map tile, in the usual z/x/y WebMercator tiling scheme (tile (0, 0) is at the northwest corner) */
+interface TileID {
+    z: number;
+    x: number;
+    y: number;
+}
+
+/** A field to set up tiled contouring for in {@link contourTile} */
+interface TiledContourField {
+    data: ContourableTypedArray;
+    earth_coords: EarthCoords | NativeGridDef;
+    ni: number;
+    nj: number;
+    opts: FieldContourOpts;
+}
+
+// Each field keeps up to this many tiles of contours
+const TILE_CACHE_SIZE = 256;
+
+// Tiled contouring is kept set up for this many fields
+const MAX_TILED_FIELDS = 4;
+
+// Fields with tiled contouring set up, from least to most recently used
+const tiled_contourers: Map<string, any> = new Map();
+
+/**
+ * Contour the grid cells under one map tile. The field is set up once under field_key (which should identify both the field and the 
+ * contouring options), and the worker keeps the most recently used tiles for the most recently used fields. If the field isn't set up in this
+ * worker and isn't given, this returns null, and the caller should call again with the field. The contours are clipped to the tile and come 
+ * back encoded in WebMercator coordinates, and they join up exactly with the contours in the neighboring tiles. The `smooth`, 
+ * `grid_filter`, and `cell_box` options are ignored.
+ */
+async function contourTile(field_key: string, tile: TileID, field?: TiledContourField) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    let contourer = tiled_contourers.get(field_key);
+
+    if (contourer === undefined) {
+        if (field === undefined) return null;
+
+        const {data, ni, nj, opts} = field;
+        const earth_coords = await resolveEarthCoords(field.earth_coords);
+        if (opts.interval === undefined && opts.levels === undefined) {
+            throw "Must supply either an interval or levels to contourTile()"
+        }
+
+        const interval = opts.interval === undefined ? 0 : opts.interval;
+        const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+
+        const getContourLevels = data instanceof Float32Array ? msm.getContourLevelsFloat32 : msm.getContourLevelsFloat16;
+        const TiledContourer = data instanceof Float32Array ? msm.TiledContourerFloat32 : msm.TiledContourerFloat16;
+
+        const levels = opts.levels === undefined ? getContourLevels(data, ni, nj, interval) : opts.levels;
+        contourer = new TiledContourer(data, earth_coords.lons, earth_coords.lats, ni, nj, levels, quad_as_tri, TILE_CACHE_SIZE);
+
+        if (tiled_contourers.size >= MAX_TILED_FIELDS) {
+            const [lru_key, lru_contourer] = tiled_contourers.entries().next().value;
+            lru_contourer.delete();
+            tiled_contourers.delete(lru_key);
+        }
+    }
+    else {
+        tiled_contourers.delete(field_key);
+    }
+
+    tiled_contourers.set(field_key, contourer);
+
+    return contourer.getTile(tile.z, tile.x, tile.y) as EncodedContourData;
+}
+
+/** The nearest point on a contour to a query point, from {@link nearestContour} */
+interface ContourHit {
+    /** Index of the contour, in the order the contours were encoded */
+    contour: number;
+
+    /** Index of the first point of the nearest segment in the contour */
+    segment: number;
+
+    distance: number;
+    x: number;
+    y: number;
+}
+
+// Spatial indices for this many sets of contours are kept
+const MAX_CONTOUR_INDICES = 8;
+
+// Spatial indices for sets of contours, from least to most recently used
+const contour_indices: Map<string, any> = new Map();
+
+// Get the spatial index for a set of contours, building it from the encoded contours if it isn't in this worker. Returns null if it isn't
+//  and the encoded contours weren't given.
+async function getContourIndex(index_key: string, encoded?: EncodedContourData) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    let index = contour_indices.get(index_key);
+
+    if (index === undefined) {
+        if (encoded === undefined) return null;
+        index = new msm.ContourIndex(encoded);
+
+        if (contour_indices.size >= MAX_CONTOUR_INDICES) {
+            const [lru_key, lru_index] = contour_indices.entries().next().value;
+            lru_index.delete();
+            contour_indices.delete(lru_key);
+        }
+    }
+    else {
+        contour_indices.delete(index_key);
+    }
+
+    contour_indices.set(index_key, index);
+    return index;
+}
+
+/**
+ * Get the bounding box (as x_min, y_min, x_max, y_max in `bounds`), arc length, and whether it's closed for each of a set of encoded contours.
+ * The contours are indexed once under index_key, which should identify the contours. If they aren't indexed in this worker and aren't given,
+ * this returns null, and the caller should call again with them.
+ */
+async function contourIndexInfo(index_key: string, encoded?: EncodedContourData) {
+    const index = await getContourIndex(index_key, encoded);
+    if (index === null) return null;
+
+    return index.getInfo() as {bounds: Float32Array, arc_lengths: Float32Array, closed: Uint8Array};
+}
+
+/**
+ * Find the contours with segments in each of a set of boxes (given as x_min, y_min, x_max, y_max for each box), e.g., to cull contours that 
+ * are out of view. The contours in box i are `indices[offsets[i]:offsets[i + 1]]`. Returns null if the contours need to be given (see 
+ * {@link contourIndexInfo}).
+ */
+async function cullContours(index_key: string, boxes: Float32Array, encoded?: EncodedContourData) {
+    const index = await getContourIndex(index_key, encoded);
+    if (index === null) return null;
+
+    return index.cull(boxes) as {offsets: Int32Array, indices: Int32Array};
+}
+
+/**
+ * Find the nearest contour to (x, y) within max_dist. The hit is null if there's no contour that close. Returns null if the contours need to 
+ * be given (see {@link contourIndexInfo}).
+ */
+async function nearestContour(index_key: string, x: number, y: number, max_dist?: number, encoded?: EncodedContourData) {
+    const index = await getContourIndex(index_key, encoded);
+    if (index === null) return null;
+
+    return {hit: index.nearest(x, y, max_dist) as ContourHit | null};
+}
+
+// Spatial indices for this many sets of points are kept
+const MAX_POINT_INDICES = 4;
+
+// Spatial indices for sets of points (e.g., the points of an unstructured grid), from least to most recently used
+const point_indices: Map<string, any> = new Map();
+
+// Get the spatial index for a set of points, building it from the point coordinates if it isn't in this worker. Returns null if it isn't
+//  and the coordinates weren't given.
+async function getPointIndex(index_key: string, lons?: Float32Array, lats?: Float32Array) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    let index = point_indices.get(index_key);
+
+    if (index === undefined) {
+        if (lons === undefined || lats === undefined) return null;
+        index = new msm.MapPointIndex(lons, lats);
+
+        if (point_indices.size >= MAX_POINT_INDICES) {
+            const [lru_key, lru_index] = point_indices.entries().next().value;
+            lru_index.delete();
+            point_indices.delete(lru_key);
+        }
+    }
+    else {
+        point_indices.delete(index_key);
+    }
+
+    point_indices.set(index_key, index);
+    return index;
+}
+
+/**
+ * Find the nearest point in a set of points to each of a batch of query points. The points are indexed once under index_key, which should 
+ * identify the points. Distances are in WebMercator units (fractions of the width of the world), and the index is -1 where there's no point 
+ * within max_dist. If the points aren't indexed in this worker and aren't given, this returns null, and the caller should call again with 
+ * them.
+ */
+async function nearestPoints(index_key: string, query_lons: Float32Array, query_lats: Float32Array, max_dist?: number, lons?: Float32Array, 
+                             lats?: Float32Array) {
+    const index = await getPointIndex(index_key, lons, lats);
+    if (index === null) return null;
+
+    return {indices: index.nearest(query_lons, query_lats, max_dist) as Int32Array};
+}
+
+/**
+ * Find the points within radius (in WebMercator units) of each of a batch of query points. The points near query point i are 
+ * `indices[offsets[i]:offsets[i + 1]]`. Returns null if the points need to be given (see {@link nearestPoints}).
+ */
+async function pointsWithin(index_key: string, query_lons: Float32Array, query_lats: Float32Array, radius: number, lons?: Float32Array, 
+                            lats?: Float32Array) {
+    const index = await getPointIndex(index_key, lons, lats);
+    if (index === null) return null;
+
+    return index.within(query_lons, query_lats, radius) as {offsets: Int32Array, indices: Int32Array};
+}
+
+/**
+ * Find the points in a longitude/latitude box. Returns null if the points need to be given (see {@link nearestPoints}).
+ */
+async function pointsInBox(index_key: string, ll_lon: number, ll_lat: number, ur_lon: number, ur_lat: number, lons?: Float32Array, 
+                           lats?: Float32Array) {
+    const index = await getPointIndex(index_key, lons, lats);
+    if (index === null) return null;
+
+    return {indices: index.range(ll_lon, ll_lat, ur_lon, ur_lat) as Int32Array};
+}
+
+/** A reduction over the members of an ensemble, for {@link ensembleReduce} */
+type EnsembleReduction = {type: 'probability', threshold: number} | {type: 'mean_spread'} | {type: 'percentile', percentile: number} | 
+                         {type: 'paintball', threshold: number};
+
+// This many ensembles (or bands of rows from them) are kept in the WASM heap
+const MAX_ENSEMBLES = 4;
+
+// Ensemble members in the WASM heap, from least to most recently used
+const ensembles: Map<string, any> = new Map();
+
+// Get the members of an ensemble, copying them into the WASM heap if they aren't in this worker. Returns null if they aren't and the 
+//  members weren't given.
+async function getEnsemble(ensemble_key: string, members?: ContourableTypedArray[]) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    let ensemble = ensembles.get(ensemble_key);
+
+    if (ensemble === undefined) {
+        if (members === undefined) return null;
+        ensemble = members[0] instanceof Float32Array ? new msm.EnsembleFloat32(members) : new msm.EnsembleFloat16(members);
+
+        if (ensembles.size >= MAX_ENSEMBLES) {
+            const [lru_key, lru_ensemble] = ensembles.entries().next().value;
+            lru_ensemble.delete();
+            ensembles.delete(lru_key);
+        }
+    }
+    else {
+        ensembles.delete(ensemble_key);
+    }
+
+    ensembles.set(ensemble_key, ensemble);
+    return ensemble;
+}
+
+/**
+ * Reduce over the members of an ensemble (probability of exceeding a threshold, mean and spread, a percentile, or paintball bits). The members 
+ * (which can be a band of rows from the full grids) are kept in this worker under ensemble_key, so repeated reductions (e.g., as the threshold
+ * changes) don't need to send them again. If they aren't in this worker and aren't given, this returns null, and the caller should call again
+ * with them. The results are Float32Arrays (two of them, mean and spread, for `'mean_spread'`).
+ */
+async function ensembleReduce(ensemble_key: string, reduction: EnsembleReduction, members?: ContourableTypedArray[]) {
+    const ensemble = await getEnsemble(ensemble_key, members);
+    if (ensemble === null) return null;
+
+    if (reduction.type == 'mean_spread') {
+        const {mean, spread} = ensemble.meanSpread() as {mean: Float32Array, spread: Float32Array};
+        return [mean, spread];
+    }
+
+    if (reduction.type == 'percentile') {
+        return [ensemble.percentile(reduction.percentile) as Float32Array];
+    }
+
+    if (reduction.type == 'paintball') {
+        return [ensemble.paintball(reduction.threshold) as Float32Array];
+    }
+
+    return [ensemble.probability(reduction.threshold) as Float32Array];
+}
+
+/**
+ * Compute the probability-matched mean of an ensemble (the spatial pattern of the ensemble mean with the distribution of values from the 
+ * members). This needs the whole grids, so the members aren't split into bands or kept in the worker.
+ */
+async function ensemblePMMean(members: ContourableTypedArray[]) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    if (members[0] instanceof Float32Array) {
+        return msm.probabilityMatchedMeanFloat32(members) as Float32Array;
+    }
+
+    return msm.probabilityMatchedMeanFloat16(members) as Float32Array;
+}
+
+/**
+ * Give back the memory that contouring keeps in this worker between calls, e.g., after contouring an unusually large grid
+ */
+async function releaseContourScratch() {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    msm.releaseContourScratch();
+}
+
+// This many compiled expressions are kept in the WASM heap
+const MAX_COMPILED_EXPRESSIONS = 16;
+
+// Compiled expressions, from least to most recently used
+const compiled_expressions: Map<string, any> = new Map();
+
+/**
+ * Evaluate a ComputedScalarField expression (e.g., `'{0} - {1}'`) over a set of fields, which should all be float32 or all be float16. The 
+ * expression is compiled once and cached. Float16 results are returned as their raw bits in a Uint16Array, as Float16Arrays can't be sent
+ * between threads.
+ */
+async function evaluateExpression(expression: string, fields: ContourableTypedArray[]) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    let compiled = compiled_expressions.get(expression);
+
+    if (compiled === undefined) {
+        compiled = new msm.FieldExpression(expression);
+
+        if (compiled_expressions.size >= MAX_COMPILED_EXPRESSIONS) {
+            const [lru_key, lru_compiled] = compiled_expressions.entries().next().value;
+            lru_compiled.delete();
+            compiled_expressions.delete(lru_key);
+        }
+    }
+    else {
+        compiled_expressions.delete(expression);
+    }
+
+    compiled_expressions.set(expression, compiled);
+
+    if (fields[0] instanceof Float32Array) {
+        return compiled.evaluateFloat32(fields) as Float32Array;
+    }
+
+    return compiled.evaluateFloat16(fields) as Uint16Array;
+}
+
+/**
+ * Decode a field from a GRIB2 message. Simple, complex, and PNG packing are supported. The data are reordered to start at the lower-left
+ * corner, and missing values are NaN. Float16 data are returned as their raw bits in a Uint16Array, as Float16Arrays can't be sent between
+ * threads.
+ */
+async function decodeGrib2(msg: Uint8Array, field_index: number, float16: boolean) {
+    const msm = _msm === null ? await initMSModule({}) : _msm;
+    _msm = msm;
+
+    if (float16) {
+        return msm.decodeGrib2Float16(msg, field_index) as {data: Float32Array | Uint16Array, ni: number, nj: number};
+    }
 
-    return contours as ContourData;
+    return msm.decodeGrib2Float32(msg, field_index) as {data: Float32Array | Uint16Array, ni: number, nj: number};
 }
 
 const ep_interface = {
     'contourCreator': contourCreator,
+    'contourCreatorCurvilinear': contourCreatorCurvilinear,
+    'contourPyramid': contourPyramid,
+    'contourPyramidCurvilinear': contourPyramidCurvilinear,
+    'contourTile': contourTile,
+    'releaseContourScratch': releaseContourScratch,
+    'gridEarthCoords': gridEarthCoords,
+    'gridDomainBuffers': gridDomainBuffers,
+    'gridEarthRelativeVectors': gridEarthRelativeVectors,
+    'gridVectorSpeedDirection': gridVectorSpeedDirection,
+    'makeBBElements': makeBBElements,
+    'structuredMinZoom': structuredMinZoom,
+    'unstructuredMinZoom': unstructuredMinZoom,
+    'contourIndexInfo': contourIndexInfo,
+    'cullContours': cullContours,
+    'nearestContour': nearestContour,
+    'nearestPoints': nearestPoints,
+    'pointsWithin': pointsWithin,
+    'pointsInBox': pointsInBox,
+    'ensembleReduce': ensembleReduce,
+    'ensemblePMMean': ensemblePMMean,
+    'evaluateExpression': evaluateExpression,
+    'decodeGrib2': decodeGrib2,
     'init': init,
 }
 
@@ -59,4 +751,4 @@ type ContourCreatorWorker = typeof ep_interface;
 
 Comlink.expose(ep_interface);
 
-export type {ContourCreatorWorker, FieldContourOpts}
+export type {ContourCreatorWorker, NativeGridDef, FieldContourOpts, GridFilterOpts, CellBox, TileID, ContourHit, EnsembleReduction}
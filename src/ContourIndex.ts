@@ -0,0 +1,142 @@
+
+import { EncodedContourData } from "./AutumnTypes";
+import { getContourWorkerPool } from "./PlotComponent";
+import { getViewportBounds } from "./utils";
+
+/** Identifies a contour in contour data (e.g., from {@link RawScalarField.getContours | RawScalarField.getContours()}) as contour `index` at level `value` */
+interface ContourID {
+    value: number;
+    index: number;
+}
+
+/** Info about a contour from {@link ContourIndex.getInfo} */
+interface ContourInfo extends ContourID {
+    /** The bounding box of the contour as [x_min, y_min, x_max, y_max], in the coordinates the contours were made in (see {@link ContourIndex}) */
+    bounds: [number, number, number, number];
+
+    /** The length of the contour, in the coordinates the contours were made in */
+    arc_length: number;
+
+    /** Whether the contour is a closed loop, rather than ending at the edge of the grid */
+    closed: boolean;
+}
+
+/** The nearest contour to a point, from {@link ContourIndex.nearest} */
+interface ContourNearest extends ContourID {
+    /** Distance to the contour, in the coordinates the contours were made in */
+    distance: number;
+
+    /** Longitude of the nearest point on the contour */
+    lon: number;
+
+    /** Latitude of the nearest point on the contour */
+    lat: number;
+}
+
+/**
+ * Bounding boxes, arc lengths, and closed flags for a set of contours, plus a spatial index over their segments for culling the contours that are
+ * out of view and finding the contour under the cursor. The index is built and queried in the contouring worker. The contours are indexed
+ * in the coordinates they were made in (grid coordinates for most grids, or longitude and latitude for radar grids), so bounding boxes,
+ * lengths, and distances are in those coordinates.
+ */
+class ContourIndex {
+    private readonly index_key: string;
+    private readonly encoded: EncodedContourData;
+    private readonly to_index_coords: (lon: number, lat: number) => [number, number];
+    private readonly from_index_coords: (x: number, y: number) => [number, number];
+
+    // Contours in the order they were encoded
+    private readonly ids: ContourID[];
+
+    /**
+     * @internal
+     * @param index_key         - Identifies the contours to the contouring worker
+     * @param encoded           - The encoded contours
+     * @param to_index_coords   - Transform from longitude and latitude to the coordinates the contours were made in
+     * @param from_index_coords - Transform from the coordinates the contours were made in to longitude and latitude
+     */
+    constructor(index_key: string, encoded: EncodedContourData, to_index_coords: (lon: number, lat: number) => [number, number],
+                from_index_coords: (x: number, y: number) => [number, number]) {
+        this.index_key = index_key;
+        this.encoded = encoded;
+        this.to_index_coords = to_index_coords;
+        this.from_index_coords = from_index_coords;
+
+        // Number the contours at each level the same way decodeContourData() does
+        const n_at_level: Record<number, number> = {};
+        this.ids = Array.from(encoded.values).map(value => {
+            const index = value in n_at_level ? n_at_level[value] : 0;
+            n_at_level[value] = index + 1;
+            return {value: value, index: index};
+        });
+    }
+
+    // Run a query in a contouring worker, sending the contours along if that worker hasn't indexed them yet
+    private async query<R>(run: (encoded?: EncodedContourData) => Promise<R | null>) {
+        const result = await run();
+        if (result !== null) return result;
+
+        const result_indexed = await run(this.encoded);
+        if (result_indexed === null) throw `Contour index wasn't set up in the contouring worker`;
+        return result_indexed;
+    }
+
+    /**
+     * Get the bounding box, arc length, and whether it's closed for each contour
+     */
+    public async getInfo() : Promise<ContourInfo[]> {
+        const pool = getContourWorkerPool(undefined, 1);
+        const info = await this.query(encoded => pool.contourIndexInfo(this.index_key, encoded));
+
+        return this.ids.map((id, icntr) => ({...id, arc_length: info.arc_lengths[icntr], closed: info.closed[icntr] != 0,
+            bounds: [info.bounds[4 * icntr], info.bounds[4 * icntr + 1], info.bounds[4 * icntr + 2], info.bounds[4 * icntr + 3]]}));
+    }
+
+    /**
+     * Find the contours in each of a set of map viewports, in one trip to the contouring worker
+     * @param viewports - The viewports in WebMercator coordinates (0 to 1, with y increasing to the south)
+     * @returns the contours with any part in each viewport
+     */
+    public async cull(viewports: {x_min: number, y_min: number, x_max: number, y_max: number}[]) {
+        const boxes = new Float32Array(4 * viewports.length);
+        viewports.forEach((viewport, ivp) => {
+            const {x_min, y_min, x_max, y_max} = getViewportBounds(viewport, this.to_index_coords);
+            boxes.set([x_min, y_min, x_max, y_max], 4 * ivp);
+        });
+
+        const pool = getContourWorkerPool(undefined, 1);
+        const {offsets, indices} = await this.query(encoded => pool.cullContours(this.index_key, boxes, encoded));
+
+        return viewports.map((_, ivp) => Array.from(indices.subarray(offsets[ivp], offsets[ivp + 1])).map(icntr => this.ids[icntr]));
+    }
+
+    /**
+     * Get the distance between two points in the coordinates the contours were made in (e.g., for working out a max_dist for {@link nearest})
+     */
+    public getDistance(lon1: number, lat1: number, lon2: number, lat2: number) {
+        const [x1, y1] = this.to_index_coords(lon1, lat1);
+        const [x2, y2] = this.to_index_coords(lon2, lat2);
+        return Math.hypot(x2 - x1, y2 - y1);
+    }
+
+    /**
+     * Find the nearest contour to a point
+     * @param lon      - Longitude of the point
+     * @param lat      - Latitude of the point
+     * @param max_dist - Only look this far from the point, in the coordinates the contours were made in
+     * @returns the nearest contour and the nearest point on it, or null if there isn't a contour within max_dist
+     */
+    public async nearest(lon: number, lat: number, max_dist?: number) : Promise<ContourNearest | null> {
+        const [x, y] = this.to_index_coords(lon, lat);
+
+        const pool = getContourWorkerPool(undefined, 1);
+        const {hit} = await this.query(encoded => pool.nearestContour(this.index_key, x, y, max_dist, encoded));
+        if (hit === null) return null;
+
+        const [hit_lon, hit_lat] = this.from_index_coords(hit.x, hit.y);
+        return {...this.ids[hit.contour], distance: hit.distance, lon: hit_lon, lat: hit_lat};
+    }
+}
+
+export {ContourIndex};
+export type {ContourID, ContourInfo, ContourNearest};
@@ -0,0 +1,158 @@
+
+import { ContourableTypedArray, TypedArray, isContourable } from "./AutumnTypes";
+import { EnsembleReduction } from "./ContourCreator.worker";
+import { Grid } from "./grids/Grid";
+import { getContourWorkerCount, getContourWorkerPool } from "./PlotComponent";
+import { RawScalarField } from "./RawField";
+import { Cache } from "./utils";
+
+// Ensembles get a number for identifying their members to the contouring workers
+let n_ensembles = 0;
+
+/**
+ * The members of an ensemble on the same grid, for computing probabilities, means, percentiles, and paintball fields in the contouring workers.
+ * The members are split into bands of rows, one for each contouring worker, so the workers reduce over the bands in parallel. Each band is
+ * pinned to its own worker and kept there after the first reduction, so recomputing a probability for a different threshold doesn't send the
+ * members again. The members should be float32 or float16 (all the same type), and missing values (NaN) are left out of the reductions.
+ *
+ * @example
+ * const ensemble = new Ensemble(members);
+ *
+ * // Probability of reflectivity > 40 dBZ, and a paintball field for Paintball
+ * const prob = await ensemble.probability(40);
+ * const paintball = await ensemble.paintball(40);
+ */
+class Ensemble<ArrayType extends TypedArray, GridType extends Grid> {
+    public readonly members: RawScalarField<ArrayType, GridType>[];
+    private readonly ensemble_id: number;
+
+    private readonly mean_spread_cache: Cache<[], Promise<{mean: RawScalarField<Float32Array, GridType>, spread: RawScalarField<Float32Array, GridType>}>>;
+    private readonly pm_mean_cache: Cache<[], Promise<RawScalarField<Float32Array, GridType>>>;
+
+    /**
+     * Create an ensemble
+     * @param members - The ensemble members, which should all be on the same grid
+     */
+    constructor(members: RawScalarField<ArrayType, GridType>[]) {
+        if (members.length == 0) throw `An ensemble needs at least one member`;
+
+        const grid = members[0].grid;
+        members.forEach((member, imem) => {
+            if (member.grid.ni != grid.ni || member.grid.nj != grid.nj)
+                throw `Member ${imem + 1} is on a ${member.grid.ni} x ${member.grid.nj} grid, but member 1 is on a ${grid.ni} x ${grid.nj} grid`;
+            if (!isContourable(member.getTextureData()) || member.dtypes[0] != members[0].dtypes[0])
+                throw `Ensemble members must all be either float16 or float32`;
+        });
+
+        this.members = members;
+        this.ensemble_id = n_ensembles++;
+
+        this.mean_spread_cache = new Cache(async () => {
+            const [mean, spread] = await this.reduce({type: 'mean_spread'});
+            return {mean: this.makeField(mean), spread: this.makeField(spread)};
+        });
+
+        this.pm_mean_cache = new Cache(async () => {
+            const pool = getContourWorkerPool(undefined, 1);
+            return this.makeField(await pool.ensemblePMMean(this.getMemberData()));
+        });
+    }
+
+    /** @internal */
+    get grid() {
+        return this.members[0].grid;
+    }
+
+    private getMemberData() {
+        return this.members.map(member => {
+            const data = member.getTextureData();
+            if (!isContourable(data)) throw `Type check for contourable array failed`;
+            return data;
+        });
+    }
+
+    private makeField(data: Float32Array) {
+        return new RawScalarField<Float32Array, GridType>(this.grid, data);
+    }
+
+    // Run a reduction on each band of rows in the worker it's pinned to, sending the band along if that worker doesn't have it yet, and put
+    //  the bands back together
+    private async reduce(reduction: EnsembleReduction) {
+        const {ni, nj} = this.grid;
+        const pool = getContourWorkerPool(undefined, 1);
+
+        const n_bands = Math.max(1, Math.min(getContourWorkerCount(), nj));
+        const band_rows = Math.ceil(nj / n_bands);
+
+        const band_results = await Promise.all([...Array(n_bands).keys()].map(async iband => {
+            const start = iband * band_rows * ni, end = Math.min(nj, (iband + 1) * band_rows) * ni;
+            const ensemble_key = `${this.ensemble_id}:${iband}/${n_bands}`;
+
+            const worker = pool.onWorker(iband);
+
+            const result = await worker.ensembleReduce(ensemble_key, reduction);
+            if (result !== null) return result;
+
+            // Slice the members, as sending a view would send the whole buffer
+            const band_members = this.getMemberData().map(data => data.slice(start, end) as ContourableTypedArray);
+            const result_band = await worker.ensembleReduce(ensemble_key, reduction, band_members);
+            if (result_band === null) throw `Ensemble wasn't set up in the contouring worker`;
+            return result_band;
+        }));
+
+        return band_results[0].map((_, iout) => {
+            const out = new Float32Array(ni * nj);
+            band_results.forEach((result, iband) => out.set(result[iout], iband * band_rows * ni));
+            return out;
+        });
+    }
+
+    /**
+     * Compute the fraction of members that exceed a threshold at each grid point
+     * @param threshold - The threshold
+     */
+    public async probability(threshold: number) {
+        const [prob] = await this.reduce({type: 'probability', threshold: threshold});
+        return this.makeField(prob);
+    }
+
+    /**
+     * Compute the ensemble mean and spread (the standard deviation of the members about the mean)
+     */
+    public async meanSpread() {
+        return await this.mean_spread_cache.getValue();
+    }
+
+    /**
+     * Compute a percentile of the members at each grid point, interpolating linearly between members
+     * @param percentile - The percentile, from 0 to 100
+     */
+    public async percentile(percentile: number) {
+        if (!(percentile >= 0 && percentile <= 100)) throw `Percentile must be between 0 and 100, but got ${percentile}`;
+
+        const [pct] = await this.reduce({type: 'percentile', percentile: percentile});
+        return this.makeField(pct);
+    }
+
+    /**
+     * Compute the probability-matched mean, which has the spatial pattern of the ensemble mean with the distribution of values from the members,
+     * so it keeps the intensity of features (e.g., heavy rain) that the ensemble mean smooths out. This needs the full grids, so it runs in one
+     * contouring worker.
+     */
+    public async probabilityMatchedMean() {
+        return await this.pm_mean_cache.getValue();
+    }
+
+    /**
+     * Make a field for a {@link Paintball} plot of where each member exceeds a threshold. Works for up to 24 members.
+     * @param threshold - The threshold
+     */
+    public async paintball(threshold: number) {
+        if (this.members.length > 24) throw `Paintball plots only work for up to 24 members, but this ensemble has ${this.members.length}`;
+
+        const [bits] = await this.reduce({type: 'paintball', threshold: threshold});
+        return this.makeField(bits);
+    }
+}
+
+export {Ensemble};
@@ -170,11 +170,11 @@ class Hodographs<GridType extends AutoZoomGrid, MapType extends MapLikeType> ext
         // XXX: This might leak VRAM
         const gl = this.gl_elems.gl;
 
-        this.gl_elems.bg_billboard.updateField(field.getStormMotionGrid());
+        await this.gl_elems.bg_billboard.updateField(field.getStormMotionGrid());
 
         const profiles = this.profile_field.profiles;
         const {lats, lons} = this.profile_field.getProfileCoords();
-        const min_visible_zoom = this.profile_field.grid.getMinVisibleZoom(this.opts.thin_fac);
+        const min_visible_zoom = await this.profile_field.grid.getMinVisibleZoom(this.opts.thin_fac);
         
         const hodo_polyline = profiles.map((prof, iprof) => {
             const iprof_zoom = prof.ilon + prof.jlat * this.profile_field.grid.ni;
@@ -398,5 +398,5 @@ function latFromMercatorY(y: number) {
     }
 }
 
-export {LngLat, lambertConformalConic, rotateSphere, geostationaryProjection};
+export {LngLat, lambertConformalConic, rotateSphere, geostationaryProjection, mercatorXfromLng, mercatorYfromLat, lngFromMercatorX, latFromMercatorY};
 export type {MapLikeType};
\ No newline at end of file
@@ -49,7 +49,7 @@ interface PaintballGLElems<MapType extends MapLikeType> {
  * a field (such as simulated reflectivity greater than 40 dBZ), but could in theory be defined by any arbitrarily complicated method. In autumnplot-gl,
  * the data for the paintball plot is given as a single field with the objects from each member encoded as "bits" in the field. Because the field is made up
  * of single-precision floats, this works for up to 24 members. (Technically speaking, I don't need the quotes around "bits", as they're bits of the 
- * significand of an IEEE 754 float.)
+ * significand of an IEEE 754 float.) {@link Ensemble.paintball} can make this field from the member fields.
  * 
  * ## Grid Compatibility
  * - :white_check_mark: `PlateCarreeGrid`
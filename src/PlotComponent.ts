@@ -12,6 +12,7 @@ const worker = new Worker(new URL('./PlotLayer.worker', import.meta.url));
 const layer_worker = Comlink.wrap<PlotLayerWorker>(worker);
 
 let c_worker_pool: WorkerPool<ContourCreatorWorker> | null = null;
+let c_worker_count = 0;
 function getContourWorkerPool(wasm_base_url: string | undefined, n_workers: number) {
     if (c_worker_pool !== null) {
         return c_worker_pool;
@@ -24,9 +25,16 @@ function getContourWorkerPool(wasm_base_url: string | undefined, n_workers: numb
 
     const pool = createWorkerPool<ContourCreatorWorker>(c_workers, wkr => wkr.init(wasm_base_url));
     c_worker_pool = pool;
+    c_worker_count = n_workers;
     return pool;
 }
 
+// The number of workers in the contouring pool, for splitting up work that can be done in pieces
+function getContourWorkerCount() {
+    getContourWorkerPool(undefined, 1);
+    return c_worker_count;
+}
+
 /** Base class for all plot components */
 abstract class PlotComponent<MapType extends MapLikeType> {
     public abstract onAdd(map: MapType, gl: WebGLAnyRenderingContext) : Promise<void>;
@@ -103,4 +111,4 @@ function getGLFormatTypeAlignment(gl: WebGLAnyRenderingContext, array_dtype: Typ
     return {format: format, type: type, row_alignment: row_alignment};
 }
 
-export { PlotComponent, layer_worker, getContourWorkerPool, getGLFormatTypeAlignment };
+export { PlotComponent, layer_worker, getContourWorkerPool, getContourWorkerCount, getGLFormatTypeAlignment };
@@ -4,49 +4,6 @@ import { LineData, Polyline } from "./AutumnTypes";
 import * as Comlink from 'comlink';
 import { LngLat } from "./Map";
 
-function makeBBElements(field_lats: Float32Array, field_lons: Float32Array, min_zoom: Uint8Array, field_ni: number, field_nj: number, map_max_zoom: number) {
-        
-    const n_coords_per_pt_pts = 2;
-    const n_coords_per_pt_tc = 2;
-
-    const field_n_access = min_zoom.filter(mz => mz <= map_max_zoom).length;
-    const n_elems_pts = field_n_access * n_coords_per_pt_pts;
-    const n_elems_tc = field_n_access * n_coords_per_pt_tc;
-
-    let pts = new Float32Array(n_elems_pts);
-    let tex_coords = new Float32Array(n_elems_tc);
-
-    let istart_pts = 0;
-    let istart_tc = 0;
-
-    for (let ilat = 0; ilat < field_nj; ilat++) {
-        for (let ilon = 0; ilon < field_ni; ilon++) {
-            const idx = ilat * field_ni + ilon;
-            const lat = field_lats[idx];
-            const lon = field_lons[idx];
-            const zoom = min_zoom[idx];
-
-            if (zoom > map_max_zoom || lon === undefined || lat === undefined) continue; // TAS: Adding the checks for lat/lon here may be a bug waiting to happen? Not sure.
-
-            const pt_ll = new LngLat(lon, lat).toMercatorCoord();
-
-            pts[istart_pts + 0] = pt_ll.x; 
-            pts[istart_pts + 1] = pt_ll.y; 
-
-            // Pack the min zoom in with the texture coordinates; only works because the min zoom is always an integer
-            // Another gotcha is that if the i texcoord is 1, then that bump up the zoom that gets unpacked on the GPU, which causes may cause the last column of billboards to
-            //  disappear. To fix this, cap the texcoord at 0.99999, which should be good for textures up to 10^5 pixels in size.
-            tex_coords[istart_tc + 0] = Math.min(ilon / (field_ni - 1), 0.99999) + zoom;
-            tex_coords[istart_tc + 1] = ilat / (field_nj - 1);
-
-            istart_pts += n_coords_per_pt_pts;
-            istart_tc += n_coords_per_pt_tc;
-        }
-    }
-
-    return {'pts': pts, 'tex_coords': tex_coords};
-}
-
 function makeDomainVerticesAndTexCoords(field_lats: Float32Array, field_lons: Float32Array, field_ni: number, field_nj: number, texcoord_margin_r: number, texcoord_margin_s: number) {
     const verts = new Float32Array(2 * 2 * (field_ni - 1) * (field_nj + 1)).fill(0);
     const tex_coords = new Float32Array(2 * 2 * (field_ni - 1) * (field_nj + 1)).fill(0);
@@ -373,7 +330,6 @@ function makePolylines(lines: LineData[]) : Polyline {
 
 
 const ep_interface = {
-    'makeBBElements': makeBBElements, 
     'makeDomainVerticesAndTexCoords': makeDomainVerticesAndTexCoords,
     'makePolyLines': makePolylines,
 }
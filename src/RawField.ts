@@ -1,12 +1,15 @@
 
 import { Float16Array } from "@petamoriken/float16";
-import { ContourData, TypedArray, TypedArrayStr, WebGLAnyRenderingContext, WindProfile, isContourable, isStormRelativeWindProfile } from "./AutumnTypes";
-import { FieldContourOpts } from "./ContourCreator.worker";
+import { ContourData, EncodedContourData, TypedArray, TypedArrayStr, WebGLAnyRenderingContext, WindProfile, isContourable, isStormRelativeWindProfile } from "./AutumnTypes";
+import { CellBox, FieldContourOpts, TileID } from "./ContourCreator.worker";
 import { Grid } from "./grids/Grid";
-import { Cache, getArrayConstructor, zip } from "./utils";
+import { Cache, ContourFileInfo, decodeContourData, getArrayConstructor, getViewportBounds, parseContourFile, zip } from "./utils";
 import { WGLTexture, WGLTextureSpec } from "autumn-wgl";
 import { getContourWorkerPool, getGLFormatTypeAlignment } from "./PlotComponent";
 import { AutoZoomGrid } from "./grids/AutoZoom";
+import { UnstructuredGrid } from "./grids/UnstructuredGrid";
+import { latFromMercatorY, lngFromMercatorX } from "./Map";
+import { ContourIndex } from "./ContourIndex";
 
 type TextureDataType<ArrayType> = ArrayType extends Float32Array ? Float32Array : 
                                  (ArrayType extends Uint8Array ? Uint8Array : 
@@ -36,11 +39,16 @@ function getArrayDType(ary: TypedArray) : TypedArrayStr {
     return 'float16';
 }
 
+// Fields get a number for identifying them and their contours to the contouring workers
+let n_worker_fields = 0;
+
 abstract class ExpressionScalarField<ArrayType extends TypedArray, GridType extends Grid> {
     public abstract updateTexImageData(gl: WebGLAnyRenderingContext, image_mag_filter: number, fill_textures: Map<string, WGLTexture> | null) : Map<string, WGLTexture>;
     public abstract getSamplerIds(): string[];
     public abstract getExpression(): string;
     public abstract renderCPU(): RawScalarField<ArrayType, GridType>;
+    public abstract renderWorker(): Promise<RawScalarField<ArrayType, GridType>>;
+    public abstract getWorkerExpression(fields: RawScalarField<ArrayType, GridType>[]): string;
     public abstract iterateCPU(): Generator<number, void, unknown>;
 
     abstract get grid() : GridType;
@@ -102,7 +110,7 @@ abstract class ExpressionScalarField<ArrayType extends TypedArray, GridType exte
         return this.operand(other, '-');
     }
 
-    public abstract getThinnedField(thin_fac: number, map_max_zoom: number) : this;
+    public abstract getThinnedField(thin_fac: number, map_max_zoom: number) : Promise<this>;
 
     public abstract sampleField(lon: number, lat: number) : number;
     public abstract sampleFieldWithCoord(lon: number, lat: number) : {sample: number, sample_lon: number, sample_lat: number};
@@ -113,7 +121,11 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
     public readonly grid: GridType;
     public readonly data: ArrayType;
 
+    private readonly worker_contour_cache: Cache<[FieldContourOpts], Promise<ContourData | EncodedContourData>>;
     private readonly contour_cache: Cache<[FieldContourOpts], Promise<ContourData>>;
+    private readonly contour_pyramid_cache: Cache<[FieldContourOpts, number, boolean], Promise<ContourData[]>>;
+    private precomputed: {info: ContourFileInfo, encoded: EncodedContourData, contours: ContourData} | null;
+    private worker_field_id: number | null;
 
     /**
      * Create a data field. 
@@ -125,12 +137,15 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
 
         this.grid = grid;
         this.data = data;
+        this.precomputed = null;
+        this.worker_field_id = null;
 
         if (grid.ni * grid.nj != data.length) {
             throw `Data size (${data.length}) doesn't match the grid dimensions (${grid.ni} x ${grid.nj}; expected ${grid.ni * grid.nj} points)`;
         }
 
-        this.contour_cache = new Cache(async (opts: FieldContourOpts) => {
+        // The contours as they come from the contouring worker, which are encoded if opts.encode is set
+        this.worker_contour_cache = new Cache(async (opts: FieldContourOpts) => {
             if (getArrayDType(this.data) != 'float16' && getArrayDType(this.data) != 'float32') 
                 throw `Grid is of type ${getArrayDType(this.data)}, which is not contourable (should be either float16 or float32)`;
 
@@ -138,18 +153,44 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
             if (!isContourable(tex_data)) throw `Type check for contourable array failed`;
 
             const pool = getContourWorkerPool(undefined, 1); // 1 worker is the default; if the user requests more, the pool will be pre-created with the correct number of workers
-            const contour_data = await pool.contourCreator(tex_data, grid.getGridCoords(), opts);
-
-            for (const v in contour_data) {
-                for (let ic = 0; ic < contour_data[v].length; ic++) {
-                    for (let ip = 0; ip < contour_data[v][ic].length; ip++) {
-                        const [x, y] = contour_data[v][ic][ip];
-                        contour_data[v][ic][ip] = grid.transform(x, y, {inverse: true});
-                    }
-                }
+
+            const earth_coords = this.getCurvilinearEarthCoords();
+            if (earth_coords !== null) {
+                return await pool.contourCreatorCurvilinear(tex_data, earth_coords, grid.ni, grid.nj, opts);
+            }
+
+            return await pool.contourCreator(tex_data, grid.getGridCoords(), opts);
+        });
+
+        this.contour_cache = new Cache(async (opts: FieldContourOpts) => {
+            const contours = await this.worker_contour_cache.getValue(opts);
+
+            if (opts.encode) {
+                const encoded = contours as EncodedContourData;
+                if (this.isContouredInEarthCoords()) return decodeContourData(encoded);
+                return decodeContourData(encoded, (x, y) => this.grid.transform(x, y, {inverse: true}));
+            }
+
+            if (this.isContouredInEarthCoords()) return contours as ContourData;
+            return this.contoursToEarthCoords(contours as ContourData);
+        });
+
+        this.contour_pyramid_cache = new Cache(async (opts: FieldContourOpts, n_levels: number, preserve_extrema: boolean) => {
+            if (getArrayDType(this.data) != 'float16' && getArrayDType(this.data) != 'float32') 
+                throw `Grid is of type ${getArrayDType(this.data)}, which is not contourable (should be either float16 or float32)`;
+
+            const tex_data = this.getTextureData();
+            if (!isContourable(tex_data)) throw `Type check for contourable array failed`;
+
+            const pool = getContourWorkerPool(undefined, 1);
+
+            const earth_coords = this.getCurvilinearEarthCoords();
+            if (earth_coords !== null) {
+                return await pool.contourPyramidCurvilinear(tex_data, earth_coords, grid.ni, grid.nj, opts, n_levels, preserve_extrema);
             }
 
-            return contour_data;
+            const pyramid = await pool.contourPyramid(tex_data, grid.getGridCoords(), opts, n_levels, preserve_extrema);
+            return pyramid.map(contour_data => this.contoursToEarthCoords(contour_data));
         });
     }
 
@@ -164,7 +205,7 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
     }
 
     /** @internal */
-    private getTextureData() : TextureDataType<ArrayType> {
+    public getTextureData() : TextureDataType<ArrayType> {
         // Need to give float16 data as uint16s to make WebGL happy: https://github.com/petamoriken/float16/issues/105
         const raw_data = this.data;
         const raw_data_type = getArrayDType(raw_data);
@@ -228,11 +269,215 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
      * @returns contour data as an object
      */
     public async getContours(opts: FieldContourOpts) {
+        if (this.precomputed !== null && this.matchesPrecomputed(opts)) return this.precomputed.contours;
         return await this.contour_cache.getValue(opts);
     }
 
     /**
-     * Create a new field by aggregating a number of fields using a specific function. This computation occurs on the CPU.
+     * Get an index of the contours from {@link getContours} with their bounding boxes, lengths, and whether they're closed, for culling 
+     * contours that are out of view and finding the contour under the cursor
+     * @param opts - Options for doing the contouring, which should be the same as for {@link getContours}
+     */
+    public async getContourIndex(opts: FieldContourOpts) {
+        const to_grid = (lon: number, lat: number) => this.grid.transform(lon, lat);
+        const from_grid = (x: number, y: number) => this.grid.transform(x, y, {inverse: true});
+
+        if (this.precomputed !== null && this.matchesPrecomputed(opts)) {
+            return new ContourIndex(this.getWorkerKey('precomputed'), this.precomputed.encoded, to_grid, from_grid);
+        }
+
+        // The index is built from the encoded contours, which are shared with getContours() if it was asked for them too
+        const encoded_opts = {...opts, encode: true};
+        const encoded = await this.worker_contour_cache.getValue(encoded_opts) as EncodedContourData;
+        const index_key = this.getWorkerKey(`contours:${JSON.stringify(encoded_opts)}`);
+
+        if (this.isContouredInEarthCoords()) {
+            return new ContourIndex(index_key, encoded, (lon, lat) => [lon, lat], (x, y) => [x, y]);
+        }
+
+        return new ContourIndex(index_key, encoded, to_grid, from_grid);
+    }
+
+    // Radar and geostationary grids are curvilinear in earth coordinates, so they get contoured directly in earth coordinates
+    private isContouredInEarthCoords() {
+        return this.grid.type == 'radar' || this.grid.type == 'geostationary';
+    }
+
+    // The earth coordinates to contour on for grids that are contoured in earth coordinates (or null for other grids). Grids with a native
+    //  version are given as their definitions, so the contouring worker computes the coordinates itself.
+    private getCurvilinearEarthCoords() {
+        if (!this.isContouredInEarthCoords()) return null;
+
+        const grid_def = this.grid.getNativeGridDef();
+        return grid_def === null ? this.grid.getEarthCoords() : grid_def;
+    }
+
+    // A key that identifies something about this field (e.g., its contours with some options) to the contouring workers
+    private getWorkerKey(what: string) {
+        if (this.worker_field_id === null) this.worker_field_id = n_worker_fields++;
+        return `${this.worker_field_id}:${what}`;
+    }
+
+    /**
+     * Get contour data for the grid cells under one map tile. Only the cells under the tile get contoured, so for large grids, the work to draw a 
+     * view is proportional to the number of tiles in it. The contours are clipped to the tile and join up exactly with the contours in the 
+     * neighboring tiles, and the contouring worker keeps the most recently used tiles. Doesn't work on unstructured grids.
+     * @param opts - Options for doing the contouring (`smooth`, `grid_filter`, and `cell_box` are ignored)
+     * @param tile - The tile to contour
+     * @returns contour data as an object, like {@link getContours}
+     */
+    public async getTileContours(opts: FieldContourOpts, tile: TileID) {
+        if (getArrayDType(this.data) != 'float16' && getArrayDType(this.data) != 'float32') 
+            throw `Grid is of type ${getArrayDType(this.data)}, which is not contourable (should be either float16 or float32)`;
+
+        if (this.grid.type == 'unstructured') {
+            throw `Tiled contouring isn't supported on unstructured grids`;
+        }
+
+        const field_key = this.getWorkerKey(`tiles:${JSON.stringify(opts)}`);
+
+        const pool = getContourWorkerPool(undefined, 1);
+
+        // The worker only needs the field the first time it sees it
+        let encoded = await pool.contourTile(field_key, tile);
+        if (encoded === null) {
+            const tex_data = this.getTextureData();
+            if (!isContourable(tex_data)) throw `Type check for contourable array failed`;
+
+            const grid_def = this.grid.getNativeGridDef();
+            const earth_coords = grid_def === null ? this.grid.getEarthCoords() : grid_def;
+            const field = {data: tex_data, earth_coords: earth_coords, ni: this.grid.ni, nj: this.grid.nj, opts: opts};
+            encoded = await pool.contourTile(field_key, tile, field);
+        }
+
+        if (encoded === null) throw `Tiled contouring wasn't set up in the contouring worker`;
+        return decodeContourData(encoded, (x, y) => [lngFromMercatorX(x), latFromMercatorY(y)]);
+    }
+
+    /**
+     * Find the box of grid cells that covers a map viewport, for contouring only what's visible (see {@link FieldContourOpts.cell_box}). Only 
+     * works for grids with 1D x and y coordinates (lat/lon, rotated lat/lon, and Lambert conformal grids).
+     * @param viewport - The viewport in WebMercator coordinates (0 to 1, with y increasing to the south)
+     * @param margin   - Number of extra cells to add on each side, so contours don't visibly end at the edge of the view
+     * @returns the cell box, or null if the viewport doesn't overlap the grid
+     */
+    public getViewportCellBox(viewport: {x_min: number, y_min: number, x_max: number, y_max: number}, margin?: number) : CellBox | null {
+        margin = margin === undefined ? 2 : margin;
+
+        if (this.grid.type != 'latlon' && this.grid.type != 'latlonrot' && this.grid.type != 'lcc') {
+            throw `Viewport cell boxes aren't supported on ${this.grid.type} grids`;
+        }
+
+        const coords = this.grid.getGridCoords();
+
+        // Index of the cell containing coordinate val along coordinate array ary, which may be increasing or decreasing
+        const findCell = (ary: Float32Array, val: number) => {
+            const sign = ary[ary.length - 1] >= ary[0] ? 1 : -1;
+            let lo = 0, hi = ary.length - 1;
+            while (hi - lo > 1) {
+                const mid = (lo + hi) >> 1;
+                if ((ary[mid] - val) * sign <= 0) lo = mid;
+                else hi = mid;
+            }
+            return lo;
+        }
+
+        const {x_min, y_min, x_max, y_max} = getViewportBounds(viewport, (lon, lat) => this.grid.transform(lon, lat));
+
+        const grid_x_min = Math.min(coords.x[0], coords.x[coords.x.length - 1]), grid_x_max = Math.max(coords.x[0], coords.x[coords.x.length - 1]);
+        const grid_y_min = Math.min(coords.y[0], coords.y[coords.y.length - 1]), grid_y_max = Math.max(coords.y[0], coords.y[coords.y.length - 1]);
+        if (x_max < grid_x_min || x_min > grid_x_max || y_max < grid_y_min || y_min > grid_y_max) return null;
+
+        const [i_1, i_2] = [findCell(coords.x, x_min), findCell(coords.x, x_max)];
+        const [j_1, j_2] = [findCell(coords.y, y_min), findCell(coords.y, y_max)];
+
+        return {i_min: Math.max(0, Math.min(i_1, i_2) - margin), i_max: Math.min(this.grid.ni - 2, Math.max(i_1, i_2) + margin),
+                j_min: Math.max(0, Math.min(j_1, j_2) - margin), j_max: Math.min(this.grid.nj - 2, Math.max(j_1, j_2) + margin)};
+    }
+
+    /**
+     * Use contours computed ahead of time by the `contourbatch` tool (built with `make contourbatch` in src/cpp) instead of contouring in 
+     * the browser. {@link getContours} and {@link getContourIndex} use them when they're asked for the levels or interval, `quad_as_tri`, and 
+     * `smooth` that the contours were made with (and no `grid_filter` or `cell_box`), and contour in the browser otherwise. 
+     * {@link getContourPyramid} uses them for its finest resolution when they weren't smoothed. Tiles from {@link getTileContours} are 
+     * always contoured in the browser (`contourbatch` can write vector tiles instead).
+     * @param contour_file - The contents of a .apct file written by `contourbatch` for this field and grid
+     */
+    public setPrecomputedContours(contour_file: ArrayBuffer) {
+        const {info, contours: encoded} = parseContourFile(contour_file);
+
+        if (info.ni != this.grid.ni || info.nj != this.grid.nj) {
+            throw `Contour file is for a ${info.ni} x ${info.nj} grid, but this field is on a ${this.grid.ni} x ${this.grid.nj} grid`;
+        }
+
+        // The contours are in the grid's coordinates, so the grids have to line up to within a small fraction of a grid spacing
+        const {x: xs, y: ys} = this.grid.getGridCoords();
+        const x_tol = 1e-3 * Math.abs(xs[xs.length - 1] - xs[0]) / (xs.length - 1);
+        const y_tol = 1e-3 * Math.abs(ys[ys.length - 1] - ys[0]) / (ys.length - 1);
+
+        if (Math.abs(info.grid_x_min - xs[0]) > x_tol || Math.abs(info.grid_x_max - xs[xs.length - 1]) > x_tol || 
+            Math.abs(info.grid_y_min - ys[0]) > y_tol || Math.abs(info.grid_y_max - ys[ys.length - 1]) > y_tol) {
+            throw `Contour file's grid goes from (${info.grid_x_min}, ${info.grid_y_min}) to (${info.grid_x_max}, ${info.grid_y_max}), but this ` +
+                  `field's grid goes from (${xs[0]}, ${ys[0]}) to (${xs[xs.length - 1]}, ${ys[ys.length - 1]})`;
+        }
+
+        const contours = decodeContourData(encoded, (x, y) => this.grid.transform(x, y, {inverse: true}));
+        this.precomputed = {info: info, encoded: encoded, contours: contours};
+    }
+
+    // Whether the precomputed contours are what contouring with these options would give
+    private matchesPrecomputed(opts: FieldContourOpts) {
+        if (this.precomputed === null) return false;
+        const info = this.precomputed.info;
+
+        const quad_as_tri = opts.quad_as_tri === undefined ? false : opts.quad_as_tri;
+        const smooth = opts.smooth === undefined ? 0 : opts.smooth;
+        if (quad_as_tri != info.quad_as_tri || smooth != info.smooth || opts.grid_filter !== undefined || opts.cell_box !== undefined) return false;
+
+        // The file has the levels as float32s, so compare at that precision
+        if (opts.levels !== undefined) {
+            return info.interval == 0 && opts.levels.length == info.levels.length && opts.levels.every((lvl, ilvl) => Math.fround(lvl) == info.levels[ilvl]);
+        }
+
+        return opts.interval !== undefined && info.interval > 0 && Math.fround(opts.interval) == info.interval;
+    }
+
+    /**
+     * Get contour data at several resolutions for drawing at different map zooms
+     * @param opts             - Options for doing the contouring (`smooth` and `grid_filter` are ignored)
+     * @param n_levels         - Maximum number of resolutions. Element k of the result is contoured from the grid decimated by 2^k.
+     * @param preserve_extrema - Decimate by keeping the block extrema instead of the block means, so small highs and lows don't disappear
+     * @returns a list of contour data objects, from the finest resolution to the coarsest
+     */
+    public async getContourPyramid(opts: FieldContourOpts, n_levels: number, preserve_extrema?: boolean) {
+        const pyramid = await this.contour_pyramid_cache.getValue(opts, n_levels, preserve_extrema === undefined ? false : preserve_extrema);
+
+        // The finest resolution is contoured from the full grid, so it's the same as the precomputed contours if they weren't smoothed
+        const pyramid_opts = {levels: opts.levels, interval: opts.interval, quad_as_tri: opts.quad_as_tri};
+        if (this.precomputed !== null && pyramid.length > 0 && this.matchesPrecomputed(pyramid_opts)) {
+            return [this.precomputed.contours, ...pyramid.slice(1)];
+        }
+
+        return pyramid;
+    }
+
+    private contoursToEarthCoords(contour_data: ContourData) {
+        for (const v in contour_data) {
+            for (let ic = 0; ic < contour_data[v].length; ic++) {
+                for (let ip = 0; ip < contour_data[v][ic].length; ip++) {
+                    const [x, y] = contour_data[v][ic][ip];
+                    contour_data[v][ic][ip] = this.grid.transform(x, y, {inverse: true});
+                }
+            }
+        }
+
+        return contour_data;
+    }
+
+    /**
+     * Create a new field by aggregating a number of fields using a specific function. This computation occurs on the CPU. For expressions
+     *  built from arithmetic on fields (e.g., `u.multiply(u).add(v.multiply(v))`), {@link ComputedScalarField.renderWorker | renderWorker()}
+     *  computes the field in a contouring worker instead.
      * @param func - A function that will be applied each element of the field. It should take the same number of arguments as fields you have and return a single number.
      * @param args - The RawScalarFields to aggregate
      * @returns a new gridded field
@@ -244,6 +489,29 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
         return (new ComputedScalarField(args, '', func)).renderCPU();
     }
 
+    /**
+     * Create a field by decoding a GRIB2 message in the contouring worker. Simple, complex, and PNG packing are supported, and missing 
+     * values become NaN.
+     * @param grid        - The grid the field is on. Its dimensions must match the grid in the message.
+     * @param msg         - The GRIB2 message
+     * @param field_index - Which field in the message to decode, counting from 0
+     * @param float16     - Whether to decode to a Float16Array instead of a Float32Array
+     * @returns a new gridded field
+     */
+    public static async fromGrib2<GridType extends Grid>(grid: GridType, msg: Uint8Array, field_index?: number, float16?: boolean) {
+        field_index = field_index === undefined ? 0 : field_index;
+        float16 = float16 === undefined ? false : float16;
+
+        const pool = getContourWorkerPool(undefined, 1);
+        const field = await pool.decodeGrib2(msg, field_index, float16);
+
+        if (field.ni != grid.ni || field.nj != grid.nj) {
+            throw `GRIB2 grid dimensions (${field.ni} x ${field.nj}) don't match the grid (${grid.ni} x ${grid.nj})`;
+        }
+
+        return new RawScalarField(grid, float16 ? new Float16Array(field.data.buffer) : field.data);
+    }
+
     /**
      * Run computations on a scalar field on the CPU (for a `RawScalarField`, this is a no-op). The function blocks the main thread, so avoid calling it if possible.
      * @returns The computed grid in a `RawScalarField`
@@ -252,6 +520,25 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
         return this;
     }
 
+    /**
+     * Run computations on a scalar field in a contouring worker (for a `RawScalarField`, this is a no-op).
+     * @returns The computed grid in a `RawScalarField`
+     */
+    public async renderWorker(): Promise<RawScalarField<ArrayType, GridType>> {
+        return this;
+    }
+
+    /** @internal */
+    public getWorkerExpression(fields: RawScalarField<ArrayType, GridType>[]) {
+        let ifield = fields.indexOf(this);
+        if (ifield < 0) {
+            ifield = fields.length;
+            fields.push(this);
+        }
+
+        return `{${ifield}}`;
+    }
+
     /** @internal */
     public *iterateCPU() {
         for (let i = 0; i < this.data.length; i++) {
@@ -260,8 +547,8 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
     }
 
     /** @internal */
-    public getThinnedField(thin_fac: number, map_max_zoom: number) {
-        const new_grid = this.grid.getThinnedGrid(thin_fac, map_max_zoom)
+    public async getThinnedField(thin_fac: number, map_max_zoom: number) {
+        const new_grid = await this.grid.getThinnedGrid(thin_fac, map_max_zoom);
         const thin_data = new_grid.thinDataArray(this.grid, this.data);
 
         return new RawScalarField(new_grid, thin_data) as this;
@@ -286,6 +573,24 @@ class RawScalarField<ArrayType extends TypedArray, GridType extends Grid> extend
     public sampleField(lon: number, lat: number) {
         return this.sampleFieldWithCoord(lon, lat).sample;
     }
+
+    /**
+     * Sample this field at a batch of latitudes and longitudes (e.g., for hover readouts). On unstructured grids, the nearest grid points are
+     * found with a spatial index in the contouring worker, rather than by scanning all the grid points for each sample.
+     * @param lons - Longitudes of the samples in degrees east
+     * @param lats - Latitudes of the samples in degrees north
+     * @returns The value of the nearest grid point to each sample along with the grid point latitude and longitude, like {@link sampleFieldWithCoord}
+     */
+    public async sampleFieldWithCoords(lons: Float32Array, lats: Float32Array) {
+        if (this.grid instanceof UnstructuredGrid) {
+            const grid = this.grid;
+            const indices = await grid.getNearestGridPoints(lons, lats);
+            return Array.from(indices).map(idx => idx < 0 ? {sample: NaN, sample_lon: NaN, sample_lat: NaN} : 
+                                                            {sample: this.data[idx], sample_lon: grid.coords[idx].lon, sample_lat: grid.coords[idx].lat});
+        }
+
+        return Array.from(lons).map((lon, ismp) => this.sampleFieldWithCoord(lon, lats[ismp]));
+    }
 }
 
 const chars = 'abcdefghijklmnopqrstuvwxyz';
@@ -366,8 +671,9 @@ class ComputedScalarField<ArrayType extends TypedArray, GridType extends Grid> e
     }
 
     /** @internal */
-    public getThinnedField(thin_fac: number, map_max_zoom: number) {
-        return new ComputedScalarField(this.raw_fields.map(f => f.getThinnedField(thin_fac, map_max_zoom)), this.expression, this.cpu_func) as this;
+    public async getThinnedField(thin_fac: number, map_max_zoom: number) {
+        const thin_fields = await Promise.all(this.raw_fields.map(f => f.getThinnedField(thin_fac, map_max_zoom)));
+        return new ComputedScalarField(thin_fields, this.expression, this.cpu_func) as this;
     }
 
     /**
@@ -400,6 +706,40 @@ class ComputedScalarField<ArrayType extends TypedArray, GridType extends Grid> e
         return new RawScalarField<ArrayType, GridType>(this.grid, ary);
     }
 
+    /**
+     * Run computations on a scalar field in a contouring worker, which doesn't block the main thread. The expression is compiled to native code
+     *  in the worker. Fields that aren't all float32 or all float16 are computed on the CPU instead.
+     * @returns The computed grid in a `RawScalarField`
+     */
+    public async renderWorker(): Promise<RawScalarField<ArrayType, GridType>> {
+        const fields: RawScalarField<ArrayType, GridType>[] = [];
+        const expression = this.getWorkerExpression(fields);
+
+        const dtype = fields[0].dtypes[0];
+        if ((dtype != 'float32' && dtype != 'float16') || fields.some(f => f.dtypes[0] != dtype)) {
+            return this.renderCPU();
+        }
+
+        const field_data = fields.map(f => {
+            const data = f.getTextureData();
+            if (!isContourable(data)) throw `Type check for contourable array failed`;
+            return data;
+        });
+
+        const pool = getContourWorkerPool(undefined, 1);
+        const result = await pool.evaluateExpression(expression, field_data);
+
+        const data = dtype == 'float16' ? new Float16Array(result.buffer) : result;
+        return new RawScalarField<ArrayType, GridType>(this.grid, data as ArrayType);
+    }
+
+    /** @internal */
+    public getWorkerExpression(fields: RawScalarField<ArrayType, GridType>[]): string {
+        // Number the raw fields at the leaves of the expression tree, so the whole tree is evaluated in one pass
+        const field_exprs = this.raw_fields.map(f => f.getWorkerExpression(fields));
+        return `(${this.expression.replace(/\{(\d+)\}/g, (_, idx) => field_exprs[parseInt(idx)])})`;
+    }
+
     /** @internal */
     public *iterateCPU(): Generator<number, void, unknown> {
         function* mapGenerator<T extends any[], U>(gen: Generator<T>, func: (...arg: T) => U) {
@@ -541,10 +881,90 @@ abstract class ExpressionVectorField<ArrayType extends TypedArray, GridType exte
         return new ComputedScalarField([this.u, this.v], 'length(vec2({0}, {1}))', Math.hypot);
     }
 
+    // Compute the components in a contouring worker and get their data to send to the worker for the vector kernels
+    private async renderComponentsWorker() {
+        const u = await this.u.renderWorker();
+        const v = await this.v.renderWorker();
+        const u_data = u.getTextureData(), v_data = v.getTextureData();
+
+        if (!isContourable(u_data) || !isContourable(v_data) || u.dtypes[0] != v.dtypes[0])
+            throw `Vector components must both be either float16 or float32`;
+
+        const wrap = (ary: Float32Array | Uint16Array) => (u.dtypes[0] == 'float16' ? new Float16Array(ary.buffer) : ary) as ArrayType;
+        return {u: u_data, v: v_data, wrap: wrap};
+    }
+
+    // Rotation of the grid relative to Earth at each point, for grids that aren't implemented natively in the contouring workers
+    private getVectorRotationCPU() {
+        const {lons, lats} = this.grid.getEarthCoords();
+        return lons.map((lon, icd) => this.relative_to == 'earth' ? 0 : this.grid.getVectorRotationAtPoint(lon, lats[icd]));
+    }
+
+    /**
+     * Rotate this vector field to be relative to Earth. The rotation occurs in a contouring worker for the grids that are implemented natively there,
+     *  and on the CPU otherwise.
+     * @returns A `RawVectorField` with the earth-relative vectors
+     */
+    public async toEarthRelative(): Promise<RawVectorField<ArrayType, GridType>> {
+        const {u, v, wrap} = await this.renderComponentsWorker();
+        if (this.relative_to == 'earth') return new RawVectorField(this.grid, wrap(u), wrap(v), {relative_to: 'earth'});
+
+        const grid_def = this.grid.getNativeGridDef();
+        if (grid_def !== null) {
+            const pool = getContourWorkerPool(undefined, 1);
+            const earth = await pool.gridEarthRelativeVectors(grid_def, u, v);
+            return new RawVectorField(this.grid, wrap(earth.u), wrap(earth.v), {relative_to: 'earth'});
+        }
+
+        const u_ary = wrap(u), v_ary = wrap(v);
+        const rot = this.getVectorRotationCPU();
+        const u_earth = new this.u.aryConstructor(u_ary.length), v_earth = new this.u.aryConstructor(v_ary.length);
+
+        for (let icd = 0; icd < rot.length; icd++) {
+            const cos_rot = Math.cos(rot[icd]), sin_rot = Math.sin(rot[icd]);
+            u_earth[icd] = u_ary[icd] * cos_rot + v_ary[icd] * sin_rot;
+            v_earth[icd] = -u_ary[icd] * sin_rot + v_ary[icd] * cos_rot;
+        }
+
+        return new RawVectorField(this.grid, u_earth, v_earth, {relative_to: 'earth'});
+    }
+
+    /**
+     * Compute the speed and direction of this vector field. The computation occurs in a contouring worker for the grids that are implemented natively
+     *  there, and on the CPU otherwise.
+     * @returns `RawScalarField`s with the speed and the meteorological direction (the bearing the vectors point from, in degrees clockwise from north)
+     */
+    public async getSpeedDirection(): Promise<{speed: RawScalarField<ArrayType, GridType>, direction: RawScalarField<ArrayType, GridType>}> {
+        const {u, v, wrap} = await this.renderComponentsWorker();
+
+        const grid_def = this.grid.getNativeGridDef();
+        if (grid_def !== null) {
+            const pool = getContourWorkerPool(undefined, 1);
+            const {speed, direction} = await pool.gridVectorSpeedDirection(grid_def, u, v, this.relative_to == 'earth');
+            return {speed: new RawScalarField(this.grid, wrap(speed)), direction: new RawScalarField(this.grid, wrap(direction))};
+        }
+
+        const u_ary = wrap(u), v_ary = wrap(v);
+        const rot = this.getVectorRotationCPU();
+        const speed = new this.u.aryConstructor(u_ary.length), direction = new this.u.aryConstructor(u_ary.length);
+
+        for (let icd = 0; icd < rot.length; icd++) {
+            // Same as sampleField()
+            let brg = (Math.PI / 2 - Math.atan2(-v_ary[icd], -u_ary[icd]) + rot[icd]) * 180 / Math.PI;
+            if (brg >= 360) brg -= 360;
+            if (brg < 0) brg += 360;
+
+            speed[icd] = Math.hypot(u_ary[icd], v_ary[icd]);
+            direction[icd] = brg;
+        }
+
+        return {speed: new RawScalarField(this.grid, speed), direction: new RawScalarField(this.grid, direction)};
+    }
+
     /** @internal */
-    public getThinnedField(thin_fac: number, map_max_zoom: number) {
-        const thin_u = this.u.getThinnedField(thin_fac, map_max_zoom);
-        const thin_v = this.v.getThinnedField(thin_fac, map_max_zoom);
+    public async getThinnedField(thin_fac: number, map_max_zoom: number) {
+        const thin_u = await this.u.getThinnedField(thin_fac, map_max_zoom);
+        const thin_v = await this.v.getThinnedField(thin_fac, map_max_zoom);
 
         return new ComputedVectorField(thin_u, thin_v, {relative_to: this.relative_to});
     }
@@ -367,7 +367,7 @@ class StationPlot<GridType extends AutoZoomGrid, MapType extends MapLikeType, Ob
         const font_url = font_url_template.replace('{fontstack}', this.opts.font_face);
 
         const coords = this.field.grid.getEarthCoords();
-        const zoom = this.field.grid.getMinVisibleZoom(this.opts.thin_fac);
+        const zoom = await this.field.grid.getMinVisibleZoom(this.opts.thin_fac);
 
         let ibarb = 0;
 
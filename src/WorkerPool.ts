@@ -4,11 +4,17 @@ import * as Comlink from 'comlink';
 interface WorkerData<T> {
     worker: Comlink.Remote<T>;
     is_busy: boolean;
+    pinned_queue: WorkerPinnedQueueData[];
 }
 
 interface WorkerQueueData {
     args: any[];
     callback: (...args: any[]) => any;
+    on_error: (reason: any) => void;
+}
+
+interface WorkerPinnedQueueData extends WorkerQueueData {
+    path: (string | number | symbol)[];
 }
 
 class WorkerPool_<T> {
@@ -17,7 +23,7 @@ class WorkerPool_<T> {
     private queue: Map<string, WorkerQueueData[]>;
 
     constructor(workers: Worker[], init?: (wkr: Comlink.Remote<T>) => void) {
-        this.workers = workers.map(wkr => ({worker: Comlink.wrap<T>(wkr), is_busy: false}));
+        this.workers = workers.map(wkr => ({worker: Comlink.wrap<T>(wkr), is_busy: false, pinned_queue: []}));
 
         if (init) {
             this.workers.forEach(wkr => init(wkr.worker));
@@ -26,32 +32,55 @@ class WorkerPool_<T> {
         this.queue = new Map();
     }
 
-    call(path: (string | number | symbol)[], args: any[], callback: (...args: any) => any) {
+    call(path: (string | number | symbol)[], args: any[], callback: (...args: any) => any, on_error: (reason: any) => void) {
         const worker_idx = this.workers.map(((w, iw) => [w, iw] as [WorkerData<T>, number])).filter(([w, iw]) => !w.is_busy)[0];
 
         if (worker_idx === undefined) {
-            this.enqueue(path, args, callback);
+            this.enqueue(path, args, callback, on_error);
         }
         else {
             const [worker, iw] = worker_idx;
-            const dequeueAndStart = () => {
-                if (this.queueSize(path) > 0) {
-                    const queue_data = this.dequeue(path);
-                    if (queue_data === undefined) return;
+            this.runOn(worker, path, args, callback, on_error);
+        }
+    }
+
+    // Run on one worker (index modulo the number of workers), waiting for it if it's busy. For work that uses state kept in that worker.
+    callOn(index: number, path: (string | number | symbol)[], args: any[], callback: (...args: any) => any, on_error: (reason: any) => void) {
+        const worker = this.workers[index % this.workers.length];
+
+        if (worker.is_busy) {
+            worker.pinned_queue.push({path: path, args: args, callback: callback, on_error: on_error});
+        }
+        else {
+            this.runOn(worker, path, args, callback, on_error);
+        }
+    }
 
-                    this.startRun(worker, path, queue_data.args).then(queue_data.callback).then(dequeueAndStart);
-                }
+    // When the worker finishes (or the call fails, which goes to on_error), it takes the next call pinned to it, or else the next call to the 
+    //  same path
+    private runOn(worker: WorkerData<T>, path: (string | number | symbol)[], args: any[], callback: (...args: any) => any, 
+                  on_error: (reason: any) => void) {
+        const dequeueAndStart = () => {
+            const pinned_data = worker.pinned_queue.shift();
+            if (pinned_data !== undefined) {
+                this.runOn(worker, pinned_data.path, pinned_data.args, pinned_data.callback, pinned_data.on_error);
             }
+            else if (this.queueSize(path) > 0) {
+                const queue_data = this.dequeue(path);
+                if (queue_data === undefined) return;
 
-            this.startRun(worker, path, args).then(callback).then(dequeueAndStart);
+                this.runOn(worker, path, queue_data.args, queue_data.callback, queue_data.on_error);
+            }
         }
+
+        this.startRun(worker, path, args).then(callback, on_error).then(dequeueAndStart);
     }
 
-    private enqueue(path: (string | number | symbol)[], args: any[], callback: (...args: any) => any) {
+    private enqueue(path: (string | number | symbol)[], args: any[], callback: (...args: any) => any, on_error: (reason: any) => void) {
         const path_str = path.join(".");
         const old_queue = this.queue.get(path_str);
         const new_queue = old_queue ? old_queue : [];
-        new_queue.push({args: args, callback: callback});
+        new_queue.push({args: args, callback: callback, on_error: on_error});
         this.queue.set(path_str, new_queue);
     }
 
@@ -84,19 +113,30 @@ class WorkerPool_<T> {
         path.forEach(p => rem = rem[p]);
 
         worker.is_busy = true;
-        const ret = await rem(...args);
-        worker.is_busy = false;
-        return ret;
+        try {
+            return await rem(...args);
+        }
+        finally {
+            worker.is_busy = false;
+        }
     }
 }
 
-function createProxy<T>(pool: WorkerPool_<T>, path: (string | number | symbol)[], target: object) : any {
+function createProxy<T>(pool: WorkerPool_<T>, path: (string | number | symbol)[], target: object, worker_index?: number) : any {
     const proxy = new Proxy(target, {
         get(tgt, prop: string | number | symbol) {
-            return createProxy(pool, [...path, prop], () => {});
+            if (path.length == 0 && worker_index === undefined && prop == 'onWorker') {
+                return (index: number) => createProxy(pool, [], () => {}, index);
+            }
+
+            return createProxy(pool, [...path, prop], () => {}, worker_index);
         },
         apply(tgt, this_arg, func_args) {
-            return new Promise((resolve, reject) => pool.call(path, func_args, resolve));
+            if (worker_index !== undefined) {
+                return new Promise((resolve, reject) => pool.callOn(worker_index, path, func_args, resolve, reject));
+            }
+
+            return new Promise((resolve, reject) => pool.call(path, func_args, resolve, reject));
         }
     });
 
@@ -107,7 +147,10 @@ type Promisify<T> = (T extends (...args: infer TArguments) => infer TReturn
       ? (...args: TArguments) => Promise<TReturn>
       : unknown);
 
-type WorkerPool<T> = {[K in keyof T]: Promisify<T[K]>};
+type WorkerPoolMethods<T> = {[K in keyof T]: Promisify<T[K]>};
+
+// pool.onWorker(i).method(...) runs the method on worker i (modulo the number of workers), for work that uses state kept in that worker
+type WorkerPool<T> = WorkerPoolMethods<T> & {onWorker: (index: number) => WorkerPoolMethods<T>};
 
 function createWorkerPool<T>(workers: Worker[], init?: (wkr: Comlink.Remote<T>) => void) : WorkerPool<T> {
     const pool = new WorkerPool_<T>(workers, init);
@@ -0,0 +1,363 @@
+
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <filesystem>
+#include <functional>
+#include <memory>
+
+#include "float16_t.hpp"
+#include "marchingsquares.hpp"
+#include "contourcodec.hpp"
+#include "vectortile.hpp"
+#include "map.hpp"
+
+using numeric::float16_t;
+
+// Contour raw float32 or float16 grids on the command line and write them to contour files (see contourcodec.hpp), which the browser
+//  library can load with RawScalarField.setPrecomputedContours(), or to Mapbox Vector Tiles.
+
+struct GridDescriptor {
+    int nx;
+    int ny;
+    float x0;
+    float dx;
+    float y0;
+    float dy;
+    bool float16;
+
+    // Map projection of the grid coordinates ("latlon" or "lcc"), needed for vector tiles
+    std::string proj;
+    float lon_0, lat_0, lat_std_1, lat_std_2;
+};
+
+struct BatchOpts {
+    GridDescriptor grid;
+    std::vector<float> levels;
+    float interval;
+    bool quad_as_tri;
+    int smooth;
+    int n_threads;
+    int min_zoom;
+    int max_zoom;
+    std::string out_dir;
+    std::vector<std::string> input_paths;
+};
+
+void printUsage(const char* prog) {
+    std::cerr << "Usage: " << prog << " -g GRID_FILE (-i INTERVAL | -l LEVEL[,LEVEL...]) [-t THREADS] [-s SMOOTH] [-q] [-z MIN-MAX] [-o OUT_DIR] FIELD_FILE..." << std::endl
+              << std::endl
+              << "Contour raw float32 or float16 grids (lower-left first, rows along x) and write one .apct contour file per field." << std::endl
+              << std::endl
+              << "  -g GRID_FILE  Grid descriptor with whitespace-separated keys and values: nx, ny, x0, dx, y0, dy, and optionally" << std::endl
+              << "                dtype (float32 or float16). The coordinates should be in the grid's projected coordinates. For vector" << std::endl
+              << "                tiles, also give proj: latlon (x is longitude and y is latitude) or lcc (with lon_0, lat_0, lat_std_1," << std::endl
+              << "                and lat_std_2)." << std::endl
+              << "  -i INTERVAL   Contour interval" << std::endl
+              << "  -l LEVELS     Comma-separated contour levels" << std::endl
+              << "  -t THREADS    Number of threads (default: number of cores)" << std::endl
+              << "  -s SMOOTH     Iterations of contour smoothing (default: 0)" << std::endl
+              << "  -q            Split grid cells into triangles when contouring" << std::endl
+              << "  -z MIN-MAX    Write Mapbox Vector Tiles from zoom MIN to MAX to OUT_DIR/FIELD/z/x/y.mvt instead of .apct files" << std::endl
+              << "  -o OUT_DIR    Directory for the contour files (default: .)" << std::endl;
+}
+
+GridDescriptor readGridDescriptor(const std::string& path) {
+    std::ifstream stream(path);
+    if (!stream) throw std::invalid_argument("Couldn't open grid descriptor '" + path + "'");
+
+    GridDescriptor grid = {0, 0, NAN, NAN, NAN, NAN, false, "", NAN, NAN, NAN, NAN};
+    std::string key, val;
+    while (stream >> key >> val) {
+        if (key == "nx") grid.nx = std::stoi(val);
+        else if (key == "ny") grid.ny = std::stoi(val);
+        else if (key == "x0") grid.x0 = std::stof(val);
+        else if (key == "dx") grid.dx = std::stof(val);
+        else if (key == "y0") grid.y0 = std::stof(val);
+        else if (key == "dy") grid.dy = std::stof(val);
+        else if (key == "dtype") {
+            if (val != "float32" && val != "float16") throw std::invalid_argument("dtype must be float32 or float16, not '" + val + "'");
+            grid.float16 = val == "float16";
+        }
+        else if (key == "proj") {
+            if (val != "latlon" && val != "lcc") throw std::invalid_argument("proj must be latlon or lcc, not '" + val + "'");
+            grid.proj = val;
+        }
+        else if (key == "lon_0") grid.lon_0 = std::stof(val);
+        else if (key == "lat_0") grid.lat_0 = std::stof(val);
+        else if (key == "lat_std_1") grid.lat_std_1 = std::stof(val);
+        else if (key == "lat_std_2") grid.lat_std_2 = std::stof(val);
+        else throw std::invalid_argument("Unknown key '" + key + "' in grid descriptor");
+    }
+
+    if (grid.nx < 2 || grid.ny < 2 || std::isnan(grid.x0) || std::isnan(grid.dx) || std::isnan(grid.y0) || std::isnan(grid.dy)) {
+        throw std::invalid_argument("Grid descriptor needs nx and ny (at least 2) and x0, dx, y0, and dy");
+    }
+
+    if (grid.proj == "lcc" && (std::isnan(grid.lon_0) || std::isnan(grid.lat_0) || std::isnan(grid.lat_std_1) || std::isnan(grid.lat_std_2))) {
+        throw std::invalid_argument("The lcc projection needs lon_0, lat_0, lat_std_1, and lat_std_2");
+    }
+
+    return grid;
+}
+
+BatchOpts parseArgs(int argc, char** argv) {
+    BatchOpts opts;
+    opts.interval = 0;
+    opts.quad_as_tri = false;
+    opts.smooth = 0;
+    opts.n_threads = std::max(1u, std::thread::hardware_concurrency());
+    opts.min_zoom = -1;
+    opts.max_zoom = -1;
+    opts.out_dir = ".";
+
+    bool have_grid = false;
+
+    for (int iarg = 1; iarg < argc; iarg++) {
+        std::string arg = argv[iarg];
+        bool has_value = iarg + 1 < argc;
+
+        if (arg == "-g" && has_value) {
+            opts.grid = readGridDescriptor(argv[++iarg]);
+            have_grid = true;
+        }
+        else if (arg == "-i" && has_value) {
+            opts.interval = std::stof(argv[++iarg]);
+        }
+        else if (arg == "-l" && has_value) {
+            std::stringstream levels(argv[++iarg]);
+            std::string level;
+            while (std::getline(levels, level, ',')) opts.levels.push_back(std::stof(level));
+        }
+        else if (arg == "-t" && has_value) {
+            opts.n_threads = std::stoi(argv[++iarg]);
+        }
+        else if (arg == "-s" && has_value) {
+            opts.smooth = std::stoi(argv[++iarg]);
+        }
+        else if (arg == "-q") {
+            opts.quad_as_tri = true;
+        }
+        else if (arg == "-z" && has_value) {
+            std::string zooms = argv[++iarg];
+            size_t dash = zooms.find('-');
+            opts.min_zoom = std::stoi(zooms.substr(0, dash));
+            opts.max_zoom = dash == std::string::npos ? opts.min_zoom : std::stoi(zooms.substr(dash + 1));
+        }
+        else if (arg == "-o" && has_value) {
+            opts.out_dir = argv[++iarg];
+        }
+        else if (arg[0] == '-') {
+            throw std::invalid_argument("Unknown option or missing value for '" + arg + "'");
+        }
+        else {
+            opts.input_paths.push_back(arg);
+        }
+    }
+
+    if (!have_grid) throw std::invalid_argument("A grid descriptor (-g) is required");
+    if (opts.interval <= 0 && opts.levels.size() == 0) throw std::invalid_argument("Either a positive interval (-i) or levels (-l) are required");
+    if (opts.n_threads < 1) throw std::invalid_argument("Need at least 1 thread");
+    if (opts.input_paths.size() == 0) throw std::invalid_argument("No fields to contour");
+    if (opts.min_zoom >= 0 && opts.grid.proj == "") throw std::invalid_argument("Vector tiles need proj in the grid descriptor");
+    if (opts.min_zoom >= 0 && (opts.max_zoom < opts.min_zoom || opts.max_zoom > 24)) {
+        throw std::invalid_argument("Zoom range must be MIN-MAX with 0 <= MIN <= MAX <= 24");
+    }
+
+    return opts;
+}
+
+template<typename T>
+std::vector<T> readField(const std::string& path, const int n_points) {
+    std::ifstream stream(path, std::ios::binary);
+    if (!stream) throw std::invalid_argument("Couldn't open '" + path + "'");
+
+    std::vector<T> field(n_points);
+    stream.read(reinterpret_cast<char*>(field.data()), n_points * sizeof(T));
+    if (stream.gcount() != n_points * sizeof(T) || stream.peek() != std::ifstream::traits_type::eof()) {
+        throw std::invalid_argument("'" + path + "' doesn't have nx * ny " + (sizeof(T) == 2 ? "float16" : "float32") + " values");
+    }
+
+    return field;
+}
+
+std::string getFieldName(const std::string& input_path) {
+    size_t name_start = input_path.find_last_of('/');
+    std::string name = name_start == std::string::npos ? input_path : input_path.substr(name_start + 1);
+
+    size_t ext_start = name.find_last_of('.');
+    if (ext_start != std::string::npos && ext_start > 0) name = name.substr(0, ext_start);
+
+    return name;
+}
+
+// Contour a field, and fill in levels with the levels it was contoured at
+template<typename T>
+std::vector<Contour> contourField(const std::string& input_path, const BatchOpts& opts, const std::vector<float>& xs, const std::vector<float>& ys,
+                                  std::vector<float>& levels) {
+    const int nx = opts.grid.nx, ny = opts.grid.ny;
+    std::vector<T> field = readField<T>(input_path, nx * ny);
+
+    levels = opts.levels.size() > 0 ? opts.levels : getContourLevels(field.data(), nx, ny, opts.interval);
+
+    std::vector<Contour> contours = makeContours(field.data(), xs.data(), ys.data(), nx, ny, levels, opts.quad_as_tri);
+    smoothContours(contours, opts.smooth);
+
+    return contours;
+}
+
+// Transform contours from grid coordinates to WebMercator coordinates
+void contoursToWebMercator(std::vector<Contour>& contours, const GridDescriptor& grid) {
+    WebMercator map_crs;
+    std::function<EarthPoint(const Point&)> toEarth;
+
+    if (grid.proj == "lcc") {
+        LambertConformalConic lcc(grid.lon_0, grid.lat_0, grid.lat_std_1, grid.lat_std_2);
+        toEarth = [lcc](const Point& pt) { return lcc.transform_inverse(GridPoint(pt.x, pt.y)); };
+    }
+    else {
+        toEarth = [](const Point& pt) { return EarthPoint(pt.x, pt.y); };
+    }
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+            GridPoint map_pt = map_crs.transform(toEarth(*plit));
+            plit->x = map_pt.x;
+            plit->y = map_pt.y;
+        }
+    }
+}
+
+void writeFile(const std::string& path, const char* data, const size_t length) {
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(data, length);
+    if (!stream) throw std::invalid_argument("Couldn't write '" + path + "'");
+}
+
+// Run task(0) through task(n_tasks - 1) on n_threads threads. Each thread takes the next task off the list until they're all done. Failed
+//  tasks are reported with the name from task_name and counted in the return value.
+int runParallel(const size_t n_tasks, const int n_threads, std::function<std::string(size_t)> task, std::function<std::string(size_t)> task_name) {
+    std::atomic<size_t> next_task(0);
+    std::atomic<int> n_failed(0);
+    std::mutex log_mutex;
+
+    auto worker = [&]() {
+        for (size_t itask = next_task++; itask < n_tasks; itask = next_task++) {
+            try {
+                std::string message = task(itask);
+
+                if (message.size() > 0) {
+                    std::lock_guard<std::mutex> lock(log_mutex);
+                    std::cout << task_name(itask) << ": " << message << std::endl;
+                }
+            }
+            catch (const std::exception& e) {
+                n_failed++;
+
+                std::lock_guard<std::mutex> lock(log_mutex);
+                std::cerr << task_name(itask) << ": " << e.what() << std::endl;
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (int ithd = 0; ithd < std::min(static_cast<size_t>(n_threads), n_tasks); ithd++) {
+        threads.emplace_back(worker);
+    }
+
+    for (auto it = threads.begin(); it != threads.end(); ++it) {
+        it->join();
+    }
+
+    return n_failed;
+}
+
+int main(int argc, char** argv) {
+    BatchOpts opts;
+    try {
+        opts = parseArgs(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<float> xs(opts.grid.nx), ys(opts.grid.ny);
+    for (int i = 0; i < opts.grid.nx; i++) xs[i] = opts.grid.x0 + i * opts.grid.dx;
+    for (int j = 0; j < opts.grid.ny; j++) ys[j] = opts.grid.y0 + j * opts.grid.dy;
+
+    const bool write_tiles = opts.min_zoom >= 0;
+    const size_t n_fields = opts.input_paths.size();
+    auto fieldName = [&](size_t ifld) { return opts.input_paths[ifld]; };
+
+    // Contour each field. makeContours() keeps its scratch space per thread, so the threads don't share any contouring state.
+    std::vector<std::unique_ptr<ContourTiler>> tilers(n_fields);
+
+    int n_failed = runParallel(n_fields, opts.n_threads, [&](size_t ifld) {
+        const std::string& input_path = opts.input_paths[ifld];
+        std::vector<float> levels;
+        std::vector<Contour> contours = opts.grid.float16 ? contourField<float16_t>(input_path, opts, xs, ys, levels)
+                                                          : contourField<float>(input_path, opts, xs, ys, levels);
+
+        if (write_tiles) {
+            contoursToWebMercator(contours, opts.grid);
+            tilers[ifld] = std::make_unique<ContourTiler>(contours, opts.min_zoom, opts.max_zoom);
+        }
+        else {
+            std::stringstream file(std::ios::out | std::ios::binary);
+            const ContourFileInfo info = {static_cast<uint32_t>(opts.grid.nx), static_cast<uint32_t>(opts.grid.ny), xs.front(), ys.front(), 
+                                          xs.back(), ys.back(), opts.levels.size() > 0 ? 0.f : opts.interval, levels, opts.quad_as_tri, 
+                                          static_cast<uint32_t>(opts.smooth)};
+            writeContourFile(file, encodeContours(contours), info);
+            std::string data = file.str();
+            writeFile(opts.out_dir + "/" + getFieldName(input_path) + ".apct", data.data(), data.size());
+        }
+
+        return std::to_string(contours.size()) + " contours";
+    }, fieldName);
+
+    if (write_tiles) {
+        // Then cut the tiles for all the fields, spreading the tiles over the threads
+        std::vector<std::pair<size_t, TileID>> tiles;
+        for (size_t ifld = 0; ifld < n_fields; ifld++) {
+            if (!tilers[ifld]) continue;
+
+            for (int z = opts.min_zoom; z <= opts.max_zoom; z++) {
+                std::vector<TileID> field_tiles = tilers[ifld]->getTiles(z);
+                for (auto it = field_tiles.begin(); it != field_tiles.end(); ++it) tiles.emplace_back(ifld, *it);
+            }
+        }
+
+        n_failed += runParallel(tiles.size(), opts.n_threads, [&](size_t itile) {
+            auto [ifld, tile] = tiles[itile];
+            std::vector<uint8_t> tile_data = tilers[ifld]->encodeTile(tile);
+            if (tile_data.empty()) return std::string();
+
+            std::string tile_dir = opts.out_dir + "/" + getFieldName(opts.input_paths[ifld]) + "/" + std::to_string(tile.z) + "/" 
+                                 + std::to_string(tile.x);
+            std::error_code err;
+            std::filesystem::create_directories(tile_dir, err);
+            writeFile(tile_dir + "/" + std::to_string(tile.y) + ".mvt", reinterpret_cast<const char*>(tile_data.data()), tile_data.size());
+
+            return std::string();
+        }, [&](size_t itile) {
+            const TileID& tile = tiles[itile].second;
+            return opts.input_paths[tiles[itile].first] + " tile " + std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" 
+                 + std::to_string(tile.y);
+        });
+
+        for (size_t ifld = 0; ifld < n_fields; ifld++) {
+            if (tilers[ifld]) std::cout << opts.input_paths[ifld] << ": tiles written" << std::endl;
+        }
+    }
+
+    return n_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,226 @@
+
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <cstring>
+
+#include "contourcodec.hpp"
+
+static inline uint32_t zigzag(int32_t val) {
+    return (static_cast<uint32_t>(val) << 1) ^ static_cast<uint32_t>(val >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t val) {
+    return static_cast<int32_t>(val >> 1) ^ -static_cast<int32_t>(val & 1);
+}
+
+static inline void writeVarint(std::vector<uint8_t>& data, uint32_t val) {
+    while (val >= 0x80) {
+        data.push_back((val & 0x7f) | 0x80);
+        val >>= 7;
+    }
+    data.push_back(val);
+}
+
+static inline uint32_t readVarint(const std::vector<uint8_t>& data, size_t& pos) {
+    uint32_t val = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= data.size()) throw std::invalid_argument("Encoded contour data ended in the middle of a vertex");
+
+        uint8_t byte = data[pos++];
+        val |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return val;
+    }
+
+    throw std::invalid_argument("Malformed varint in encoded contour data");
+}
+
+static inline int32_t quantize(float val, float min, double scale) {
+    return std::clamp(static_cast<int32_t>(std::round((static_cast<double>(val) - min) * scale)), 0, CONTOUR_QUANT_MAX);
+}
+
+EncodedContours encodeContours(const std::vector<Contour>& contours) {
+    float x_min = INFINITY, y_min = INFINITY, x_max = -INFINITY, y_max = -INFINITY;
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+            x_min = std::min(x_min, plit->x);
+            y_min = std::min(y_min, plit->y);
+            x_max = std::max(x_max, plit->x);
+            y_max = std::max(y_max, plit->y);
+        }
+    }
+
+    if (x_min > x_max) {
+        x_min = y_min = x_max = y_max = 0;
+    }
+
+    return encodeContours(contours, x_min, y_min, x_max, y_max);
+}
+
+EncodedContours encodeContours(const std::vector<Contour>& contours, const float x_min, const float y_min, const float x_max, const float y_max) {
+    EncodedContours encoded = {x_min, y_min, x_max, y_max};
+
+    size_t n_points_total = 0;
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        n_points_total += it->point_list.size();
+    }
+
+    // Do the scaling in double precision, otherwise float rounding on large map coordinates can add almost as much error as the quantization
+    const double x_scale = encoded.x_max > encoded.x_min ? CONTOUR_QUANT_MAX / (static_cast<double>(encoded.x_max) - encoded.x_min) : 0;
+    const double y_scale = encoded.y_max > encoded.y_min ? CONTOUR_QUANT_MAX / (static_cast<double>(encoded.y_max) - encoded.y_min) : 0;
+
+    encoded.values.reserve(contours.size());
+    encoded.n_points.reserve(contours.size());
+    encoded.data.reserve(n_points_total * 2);
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        encoded.values.push_back(it->value);
+        encoded.n_points.push_back(it->point_list.size());
+
+        int32_t qx_last = 0, qy_last = 0;
+        for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+            int32_t qx = quantize(plit->x, encoded.x_min, x_scale);
+            int32_t qy = quantize(plit->y, encoded.y_min, y_scale);
+
+            writeVarint(encoded.data, zigzag(qx - qx_last));
+            writeVarint(encoded.data, zigzag(qy - qy_last));
+
+            qx_last = qx;
+            qy_last = qy;
+        }
+    }
+
+    return encoded;
+}
+
+std::vector<Contour> decodeContours(const EncodedContours& encoded) {
+    if (encoded.values.size() != encoded.n_points.size()) {
+        throw std::invalid_argument("Encoded contours have different numbers of values and point counts");
+    }
+
+    const double x_step = (static_cast<double>(encoded.x_max) - encoded.x_min) / CONTOUR_QUANT_MAX;
+    const double y_step = (static_cast<double>(encoded.y_max) - encoded.y_min) / CONTOUR_QUANT_MAX;
+
+    std::vector<Contour> contours;
+    contours.reserve(encoded.values.size());
+    size_t pos = 0;
+
+    for (int icntr = 0; icntr < encoded.values.size(); icntr++) {
+        std::vector<Point> point_list;
+        point_list.reserve(encoded.n_points[icntr]);
+
+        int32_t qx = 0, qy = 0;
+        for (int ipt = 0; ipt < encoded.n_points[icntr]; ipt++) {
+            qx += unzigzag(readVarint(encoded.data, pos));
+            qy += unzigzag(readVarint(encoded.data, pos));
+
+            point_list.emplace_back(encoded.x_min + qx * x_step, encoded.y_min + qy * y_step);
+        }
+
+        contours.emplace_back(point_list, encoded.values[icntr]);
+    }
+
+    return contours;
+}
+
+static void writeUint32(std::ostream& stream, uint32_t val) {
+    const char bytes[4] = {static_cast<char>(val & 0xff), static_cast<char>((val >> 8) & 0xff), 
+                           static_cast<char>((val >> 16) & 0xff), static_cast<char>((val >> 24) & 0xff)};
+    stream.write(bytes, 4);
+}
+
+static void writeFloat32(std::ostream& stream, float val) {
+    uint32_t bits;
+    memcpy(&bits, &val, 4);
+    writeUint32(stream, bits);
+}
+
+static uint32_t readUint32(std::istream& stream) {
+    unsigned char bytes[4];
+    if (!stream.read(reinterpret_cast<char*>(bytes), 4)) throw std::invalid_argument("Contour file ended early");
+
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+static float readFloat32(std::istream& stream) {
+    uint32_t bits = readUint32(stream);
+    float val;
+    memcpy(&val, &bits, 4);
+    return val;
+}
+
+void writeContourFile(std::ostream& stream, const EncodedContours& encoded, const ContourFileInfo& info) {
+    stream.write("APCT", 4);
+    writeUint32(stream, CONTOUR_FILE_VERSION);
+
+    writeUint32(stream, info.nx);
+    writeUint32(stream, info.ny);
+    writeFloat32(stream, info.grid_x_min);
+    writeFloat32(stream, info.grid_y_min);
+    writeFloat32(stream, info.grid_x_max);
+    writeFloat32(stream, info.grid_y_max);
+    writeFloat32(stream, info.interval);
+    writeUint32(stream, info.levels.size());
+    for (auto it = info.levels.begin(); it != info.levels.end(); ++it) writeFloat32(stream, *it);
+    writeUint32(stream, info.quad_as_tri ? 1 : 0);
+    writeUint32(stream, info.smooth);
+
+    writeFloat32(stream, encoded.x_min);
+    writeFloat32(stream, encoded.y_min);
+    writeFloat32(stream, encoded.x_max);
+    writeFloat32(stream, encoded.y_max);
+
+    writeUint32(stream, encoded.values.size());
+    for (auto it = encoded.values.begin(); it != encoded.values.end(); ++it) writeFloat32(stream, *it);
+    for (auto it = encoded.n_points.begin(); it != encoded.n_points.end(); ++it) writeUint32(stream, *it);
+
+    writeUint32(stream, encoded.data.size());
+    stream.write(reinterpret_cast<const char*>(encoded.data.data()), encoded.data.size());
+}
+
+EncodedContours readContourFile(std::istream& stream, ContourFileInfo& info) {
+    char magic[4];
+    if (!stream.read(magic, 4) || memcmp(magic, "APCT", 4) != 0) throw std::invalid_argument("Not a contour file");
+
+    uint32_t version = readUint32(stream);
+    if (version != CONTOUR_FILE_VERSION) {
+        throw std::invalid_argument("Unsupported contour file version " + std::to_string(version));
+    }
+
+    info.nx = readUint32(stream);
+    info.ny = readUint32(stream);
+    info.grid_x_min = readFloat32(stream);
+    info.grid_y_min = readFloat32(stream);
+    info.grid_x_max = readFloat32(stream);
+    info.grid_y_max = readFloat32(stream);
+    info.interval = readFloat32(stream);
+
+    uint32_t n_levels = readUint32(stream);
+    info.levels.resize(n_levels);
+    for (int ilvl = 0; ilvl < n_levels; ilvl++) info.levels[ilvl] = readFloat32(stream);
+
+    info.quad_as_tri = (readUint32(stream) & 1) != 0;
+    info.smooth = readUint32(stream);
+
+    EncodedContours encoded;
+    encoded.x_min = readFloat32(stream);
+    encoded.y_min = readFloat32(stream);
+    encoded.x_max = readFloat32(stream);
+    encoded.y_max = readFloat32(stream);
+
+    uint32_t n_contours = readUint32(stream);
+    encoded.values.resize(n_contours);
+    encoded.n_points.resize(n_contours);
+    for (int icntr = 0; icntr < n_contours; icntr++) encoded.values[icntr] = readFloat32(stream);
+    for (int icntr = 0; icntr < n_contours; icntr++) encoded.n_points[icntr] = readUint32(stream);
+
+    uint32_t n_bytes = readUint32(stream);
+    encoded.data.resize(n_bytes);
+    if (!stream.read(reinterpret_cast<char*>(encoded.data.data()), n_bytes)) throw std::invalid_argument("Contour file ended early");
+
+    return encoded;
+}
@@ -0,0 +1,52 @@
+
+#ifndef __AUTUMNPLOT_CONTOURCODEC_H__
+#define __AUTUMNPLOT_CONTOURCODEC_H__
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+#include "marchingsquares.hpp"
+
+// Contours with the vertices quantized to 16 bits within the bounding box of all the contours. Each contour is stored as the differences
+//  from one quantized vertex to the next (starting from 0, 0), zigzag-encoded and written as LEB128 varints, x then y. Most differences fit
+//  in one byte, so a vertex usually takes 2-3 bytes instead of 8.
+struct EncodedContours {
+    float x_min, y_min, x_max, y_max;
+    std::vector<float> values;
+    std::vector<uint32_t> n_points;
+    std::vector<uint8_t> data;
+};
+
+const int CONTOUR_QUANT_MAX = 65535;
+
+EncodedContours encodeContours(const std::vector<Contour>& contours);
+
+// Encode with a given bounding box (e.g., a map tile) instead of the one around the contours. Points outside the box are clamped to it.
+EncodedContours encodeContours(const std::vector<Contour>& contours, const float x_min, const float y_min, const float x_max, const float y_max);
+std::vector<Contour> decodeContours(const EncodedContours& encoded);
+
+// What a contour file was contoured from and how, so a reader can check that the contours go with its grid and contouring options
+struct ContourFileInfo {
+    uint32_t nx, ny;
+
+    // Coordinates of the first and last grid points
+    float grid_x_min, grid_y_min, grid_x_max, grid_y_max;
+
+    // The contour interval, or 0 if the levels were given
+    float interval;
+    std::vector<float> levels;
+    bool quad_as_tri;
+    uint32_t smooth;
+};
+
+// Contour files hold one EncodedContours, little-endian: the magic "APCT", a uint32 version, then the ContourFileInfo (uint32 nx and ny,
+//  the grid corners as 4 float32s, a float32 interval, a uint32 level count k, k float32 levels, uint32 flags with bit 1 for quad_as_tri,
+//  and a uint32 smooth), then the bounding box as 4 float32s, a uint32 contour count n, n float32 values, n uint32 point counts, a uint32 
+//  byte count m, and m bytes of vertex data.
+const uint32_t CONTOUR_FILE_VERSION = 2;
+
+void writeContourFile(std::ostream& stream, const EncodedContours& encoded, const ContourFileInfo& info);
+EncodedContours readContourFile(std::istream& stream, ContourFileInfo& info);
+
+#endif
@@ -0,0 +1,110 @@
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "contourindex.hpp"
+
+ContourInfo getContourInfo(const Contour& contour) {
+    ContourInfo info = {INFINITY, INFINITY, -INFINITY, -INFINITY, 0, false};
+    const std::vector<Point>& pts = contour.point_list;
+
+    for (int ipt = 0; ipt < pts.size(); ipt++) {
+        info.x_min = std::min(info.x_min, pts[ipt].x); info.x_max = std::max(info.x_max, pts[ipt].x);
+        info.y_min = std::min(info.y_min, pts[ipt].y); info.y_max = std::max(info.y_max, pts[ipt].y);
+
+        if (ipt > 0) info.arc_length += std::hypot(pts[ipt].x - pts[ipt - 1].x, pts[ipt].y - pts[ipt - 1].y);
+    }
+
+    info.closed = pts.size() > 2 && pts.front() == pts.back();
+    return info;
+}
+
+// Squared distance from (x, y) to the segment from (x0, y0) to (x1, y1), and the closest point on the segment
+static float segmentDist2(float x, float y, float x0, float y0, float x1, float y1, float& x_near, float& y_near) {
+    const float dx = x1 - x0, dy = y1 - y0;
+    const float len2 = dx * dx + dy * dy;
+    const float t = len2 > 0 ? std::clamp(((x - x0) * dx + (y - y0) * dy) / len2, 0.f, 1.f) : 0.f;
+
+    x_near = x0 + t * dx;
+    y_near = y0 + t * dy;
+    return (x - x_near) * (x - x_near) + (y - y_near) * (y - y_near);
+}
+
+ContourIndex::ContourIndex(const std::vector<Contour>& contours, const int node_size) {
+    this->info.reserve(contours.size());
+    this->point_offsets.reserve(contours.size() + 1);
+    this->point_offsets.push_back(0);
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        this->info.push_back(getContourInfo(*it));
+
+        for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+            this->xs.push_back(plit->x);
+            this->ys.push_back(plit->y);
+        }
+        this->point_offsets.push_back(this->xs.size());
+    }
+
+    // One box per point for the segment that starts there. The last point in each contour doesn't start a segment, so its box is NaN to
+    //  leave it out of the index.
+    std::vector<float> boxes(4 * this->xs.size(), NAN);
+    for (int icntr = 0; icntr < contours.size(); icntr++) {
+        for (int ipt = this->point_offsets[icntr]; ipt < this->point_offsets[icntr + 1] - 1; ipt++) {
+            boxes[4 * ipt + 0] = std::min(this->xs[ipt], this->xs[ipt + 1]);
+            boxes[4 * ipt + 1] = std::min(this->ys[ipt], this->ys[ipt + 1]);
+            boxes[4 * ipt + 2] = std::max(this->xs[ipt], this->xs[ipt + 1]);
+            boxes[4 * ipt + 3] = std::max(this->ys[ipt], this->ys[ipt + 1]);
+        }
+    }
+
+    this->segment_index = new BoxIndex(boxes.data(), this->xs.size(), node_size);
+}
+
+ContourIndex::~ContourIndex() {
+    delete this->segment_index;
+}
+
+void ContourIndex::cull(const float* boxes, const int n_boxes, std::vector<int>& offsets, std::vector<int>& indices) const {
+    offsets.assign(n_boxes + 1, 0);
+    indices.clear();
+
+    std::vector<int> segments;
+    std::vector<bool> found(this->info.size(), false);
+
+    for (int ibox = 0; ibox < n_boxes; ibox++) {
+        const float* box = boxes + 4 * ibox;
+        this->segment_index->search(box[0], box[1], box[2], box[3], segments);
+
+        const int start = indices.size();
+        for (auto it = segments.begin(); it != segments.end(); ++it) {
+            const int icntr = std::upper_bound(this->point_offsets.begin(), this->point_offsets.end(), *it) - this->point_offsets.begin() - 1;
+            if (found[icntr]) continue;
+
+            found[icntr] = true;
+            indices.push_back(icntr);
+        }
+
+        std::sort(indices.begin() + start, indices.end());
+        for (int iidx = start; iidx < indices.size(); iidx++) {
+            found[indices[iidx]] = false;
+        }
+
+        offsets[ibox + 1] = indices.size();
+    }
+}
+
+ContourHit ContourIndex::nearest(float x, float y, float max_dist) const {
+    float x_near, y_near;
+    auto dist2 = [&](int iseg) {
+        return segmentDist2(x, y, this->xs[iseg], this->ys[iseg], this->xs[iseg + 1], this->ys[iseg + 1], x_near, y_near);
+    };
+
+    const int iseg = this->segment_index->nearest(x, y, max_dist, dist2);
+    if (iseg < 0) return {-1, -1, NAN, NAN, NAN};
+
+    const int icntr = std::upper_bound(this->point_offsets.begin(), this->point_offsets.end(), iseg) - this->point_offsets.begin() - 1;
+    const float dist = std::sqrt(dist2(iseg));
+
+    return {icntr, iseg - this->point_offsets[icntr], dist, x_near, y_near};
+}
@@ -0,0 +1,59 @@
+
+#ifndef __AUTUMNPLOT_CONTOURINDEX_H__
+#define __AUTUMNPLOT_CONTOURINDEX_H__
+
+#include <vector>
+
+#include "marchingsquares.hpp"
+#include "spatialindex.hpp"
+
+struct ContourInfo {
+    float x_min, y_min, x_max, y_max;
+    float arc_length;
+    bool closed;
+};
+
+ContourInfo getContourInfo(const Contour& contour);
+
+// The nearest point on a contour to a query point. contour is -1 if nothing was found.
+struct ContourHit {
+    int contour;
+    int segment;
+    float distance;
+    float x, y;
+};
+
+// The bounding box, arc length, and whether it's closed for each of a set of contours, plus a packed R-tree over all their segments for
+//  culling the contours that are out of view and finding the contour nearest the cursor without looking at every vertex.
+class ContourIndex {
+    std::vector<ContourInfo> info;
+
+    // The points of all the contours, one contour after another. Contour i has points point_offsets[i] to point_offsets[i + 1] - 1, and
+    //  segments are identified by the index of their first point.
+    std::vector<float> xs, ys;
+    std::vector<int> point_offsets;
+
+    BoxIndex* segment_index;
+
+    public:
+    ContourIndex(const std::vector<Contour>& contours, const int node_size=16);
+    ContourIndex(const ContourIndex& other) = delete;
+    ~ContourIndex();
+
+    const std::vector<ContourInfo>& getInfo() const {
+        return this->info;
+    }
+
+    size_t getNumSegments() const {
+        return this->segment_index->size();
+    }
+
+    // Get the contours that have a segment in each of n_boxes boxes (x_min, y_min, x_max, y_max). The contours in box i are
+    //  indices[offsets[i]:offsets[i + 1]], in increasing order.
+    void cull(const float* boxes, const int n_boxes, std::vector<int>& offsets, std::vector<int>& indices) const;
+
+    // Find the nearest contour to (x, y) within max_dist. The segment in the result is the index of its first point in the contour.
+    ContourHit nearest(float x, float y, float max_dist=INFINITY) const;
+};
+
+#endif
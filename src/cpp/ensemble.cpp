@@ -0,0 +1,216 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "ensemble.hpp"
+#include "float16_t.hpp"
+
+using numeric::float16_t;
+
+// The kernels go through the grid in blocks of this many points, looping over the members for each block. The block sums stay in cache,
+//  and the loops over the points in a block are innermost so they vectorize.
+const int ENSEMBLE_BLOCK_SIZE = 512;
+
+// Load n points of a member as floats, with missing points as 0, and a mask that's 1 where the member isn't missing
+template<typename T>
+static void loadBlock(const T* member, const int n, float* vals, float* mask) {
+    for (int ipt = 0; ipt < n; ipt++) {
+        const float val = member[ipt];
+        mask[ipt] = std::isnan(val) ? 0. : 1.;
+        vals[ipt] = std::isnan(val) ? 0. : val;
+    }
+}
+
+template<typename T>
+void ensembleProbability(const T* const* members, const int n_members, const int n, const float threshold, float* out) {
+    std::vector<float> vals(ENSEMBLE_BLOCK_SIZE), mask(ENSEMBLE_BLOCK_SIZE);
+    std::vector<float> n_exceed(ENSEMBLE_BLOCK_SIZE), n_valid(ENSEMBLE_BLOCK_SIZE);
+
+    for (int start = 0; start < n; start += ENSEMBLE_BLOCK_SIZE) {
+        const int n_block = std::min(ENSEMBLE_BLOCK_SIZE, n - start);
+        std::fill(n_exceed.begin(), n_exceed.end(), 0.);
+        std::fill(n_valid.begin(), n_valid.end(), 0.);
+
+        for (int imem = 0; imem < n_members; imem++) {
+            loadBlock(members[imem] + start, n_block, vals.data(), mask.data());
+
+            for (int ipt = 0; ipt < n_block; ipt++) {
+                n_exceed[ipt] += vals[ipt] > threshold ? mask[ipt] : 0.f;
+                n_valid[ipt] += mask[ipt];
+            }
+        }
+
+        for (int ipt = 0; ipt < n_block; ipt++) {
+            out[start + ipt] = n_valid[ipt] > 0 ? n_exceed[ipt] / n_valid[ipt] : NAN;
+        }
+    }
+}
+
+template<typename T>
+void ensembleMeanSpread(const T* const* members, const int n_members, const int n, float* mean, float* spread) {
+    std::vector<float> vals(ENSEMBLE_BLOCK_SIZE), mask(ENSEMBLE_BLOCK_SIZE);
+    std::vector<float> sum(ENSEMBLE_BLOCK_SIZE), sum_sq(ENSEMBLE_BLOCK_SIZE), n_valid(ENSEMBLE_BLOCK_SIZE);
+
+    for (int start = 0; start < n; start += ENSEMBLE_BLOCK_SIZE) {
+        const int n_block = std::min(ENSEMBLE_BLOCK_SIZE, n - start);
+        std::fill(sum.begin(), sum.end(), 0.);
+        std::fill(sum_sq.begin(), sum_sq.end(), 0.);
+        std::fill(n_valid.begin(), n_valid.end(), 0.);
+
+        for (int imem = 0; imem < n_members; imem++) {
+            loadBlock(members[imem] + start, n_block, vals.data(), mask.data());
+
+            for (int ipt = 0; ipt < n_block; ipt++) {
+                sum[ipt] += vals[ipt];
+                n_valid[ipt] += mask[ipt];
+            }
+        }
+
+        for (int ipt = 0; ipt < n_block; ipt++) {
+            sum[ipt] = n_valid[ipt] > 0 ? sum[ipt] / n_valid[ipt] : 0.f;
+        }
+
+        // Second pass for the squared deviations from the mean, which doesn't lose precision the way the sum of squares minus the square of
+        //  the sum does
+        for (int imem = 0; imem < n_members; imem++) {
+            loadBlock(members[imem] + start, n_block, vals.data(), mask.data());
+
+            for (int ipt = 0; ipt < n_block; ipt++) {
+                const float dev = (vals[ipt] - sum[ipt]) * mask[ipt];
+                sum_sq[ipt] += dev * dev;
+            }
+        }
+
+        for (int ipt = 0; ipt < n_block; ipt++) {
+            mean[start + ipt] = n_valid[ipt] > 0 ? sum[ipt] : NAN;
+            spread[start + ipt] = n_valid[ipt] > 0 ? std::sqrt(sum_sq[ipt] / n_valid[ipt]) : NAN;
+        }
+    }
+}
+
+template<typename T>
+void ensemblePercentile(const T* const* members, const int n_members, const int n, const float percentile, float* out) {
+    if (!(percentile >= 0 && percentile <= 100)) {
+        std::string error = "Percentile must be between 0 and 100, but got " + std::to_string(percentile);
+        throw std::invalid_argument(error);
+    }
+
+    // The block of every member, so each point's values can be gathered without striding through all the member grids
+    std::vector<float> block(n_members * ENSEMBLE_BLOCK_SIZE);
+    std::vector<float> point_vals(n_members);
+
+    for (int start = 0; start < n; start += ENSEMBLE_BLOCK_SIZE) {
+        const int n_block = std::min(ENSEMBLE_BLOCK_SIZE, n - start);
+
+        for (int imem = 0; imem < n_members; imem++) {
+            std::copy(members[imem] + start, members[imem] + start + n_block, block.begin() + imem * ENSEMBLE_BLOCK_SIZE);
+        }
+
+        for (int ipt = 0; ipt < n_block; ipt++) {
+            int n_valid = 0;
+            for (int imem = 0; imem < n_members; imem++) {
+                const float val = block[ipt + imem * ENSEMBLE_BLOCK_SIZE];
+                if (!std::isnan(val)) point_vals[n_valid++] = val;
+            }
+
+            if (n_valid == 0) {
+                out[start + ipt] = NAN;
+                continue;
+            }
+
+            // Only partially sort the values, as only the two on either side of the percentile matter
+            const float rank = percentile / 100 * (n_valid - 1);
+            const int rank_lo = std::floor(rank);
+            const float frac = rank - rank_lo;
+
+            std::nth_element(point_vals.begin(), point_vals.begin() + rank_lo, point_vals.begin() + n_valid);
+            const float val_lo = point_vals[rank_lo];
+
+            if (frac > 0) {
+                const float val_hi = *std::min_element(point_vals.begin() + rank_lo + 1, point_vals.begin() + n_valid);
+                out[start + ipt] = val_lo + frac * (val_hi - val_lo);
+            }
+            else {
+                out[start + ipt] = val_lo;
+            }
+        }
+    }
+}
+
+template<typename T>
+void probabilityMatchedMean(const T* const* members, const int n_members, const int n, float* out) {
+    std::vector<float> mean(n), spread(n);
+    ensembleMeanSpread(members, n_members, n, mean.data(), spread.data());
+
+    // Pool the values from all the members, largest first
+    std::vector<float> pool;
+    pool.reserve(static_cast<size_t>(n) * n_members);
+
+    for (int imem = 0; imem < n_members; imem++) {
+        for (int ipt = 0; ipt < n; ipt++) {
+            const float val = members[imem][ipt];
+            if (!std::isnan(val)) pool.push_back(val);
+        }
+    }
+
+    std::sort(pool.begin(), pool.end(), std::greater<float>());
+
+    // Rank the points by their ensemble mean, largest first
+    std::vector<int> ranks;
+    ranks.reserve(n);
+
+    for (int ipt = 0; ipt < n; ipt++) {
+        out[ipt] = NAN;
+        if (!std::isnan(mean[ipt])) ranks.push_back(ipt);
+    }
+
+    std::sort(ranks.begin(), ranks.end(), [&](int a, int b) { return mean[a] > mean[b]; });
+
+    // The point with rank r gets the middle value of the r-th group of n_members in the pool (or close to it if some member values are
+    //  missing, which changes the size of the pool)
+    const size_t n_pool = pool.size(), n_ranks = ranks.size();
+    for (size_t irank = 0; irank < n_ranks; irank++) {
+        const size_t ipool = std::min(n_pool - 1, static_cast<size_t>((irank + 0.5) * n_pool / n_ranks));
+        out[ranks[irank]] = pool[ipool];
+    }
+}
+
+template<typename T>
+void paintballBits(const T* const* members, const int n_members, const int n, const float threshold, float* out) {
+    if (n_members > PAINTBALL_MAX_MEMBERS) {
+        std::string error = "Paintball plots only work for up to " + std::to_string(PAINTBALL_MAX_MEMBERS) + " members, but got " +
+                            std::to_string(n_members);
+        throw std::invalid_argument(error);
+    }
+
+    std::vector<float> vals(ENSEMBLE_BLOCK_SIZE), mask(ENSEMBLE_BLOCK_SIZE);
+
+    for (int start = 0; start < n; start += ENSEMBLE_BLOCK_SIZE) {
+        const int n_block = std::min(ENSEMBLE_BLOCK_SIZE, n - start);
+        std::fill(out + start, out + start + n_block, 0.);
+
+        for (int imem = 0; imem < n_members; imem++) {
+            const float bit = static_cast<float>(1 << imem);
+            loadBlock(members[imem] + start, n_block, vals.data(), mask.data());
+
+            // The sums are of distinct powers of 2 below 2^24, so they're exact
+            for (int ipt = 0; ipt < n_block; ipt++) {
+                out[start + ipt] += vals[ipt] > threshold ? bit * mask[ipt] : 0.f;
+            }
+        }
+    }
+}
+
+template void ensembleProbability(const float* const* members, const int n_members, const int n, const float threshold, float* out);
+template void ensembleProbability(const float16_t* const* members, const int n_members, const int n, const float threshold, float* out);
+template void ensembleMeanSpread(const float* const* members, const int n_members, const int n, float* mean, float* spread);
+template void ensembleMeanSpread(const float16_t* const* members, const int n_members, const int n, float* mean, float* spread);
+template void ensemblePercentile(const float* const* members, const int n_members, const int n, const float percentile, float* out);
+template void ensemblePercentile(const float16_t* const* members, const int n_members, const int n, const float percentile, float* out);
+template void probabilityMatchedMean(const float* const* members, const int n_members, const int n, float* out);
+template void probabilityMatchedMean(const float16_t* const* members, const int n_members, const int n, float* out);
+template void paintballBits(const float* const* members, const int n_members, const int n, const float threshold, float* out);
+template void paintballBits(const float16_t* const* members, const int n_members, const int n, const float threshold, float* out);
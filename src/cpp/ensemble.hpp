@@ -0,0 +1,36 @@
+
+#ifndef __AUTUMNPLOT_ENSEMBLE_H__
+#define __AUTUMNPLOT_ENSEMBLE_H__
+
+#include <vector>
+
+// The paintball bits are packed into the significand of a float, so they only work for this many members
+const int PAINTBALL_MAX_MEMBERS = 24;
+
+// Reductions over the members of an ensemble. members[i] is n points of member i, and the kernels work point by point, so a band of rows
+//  can be reduced on its own by offsetting the member pointers. Missing (NaN) member values are left out, and points that are missing in
+//  every member are missing in the output.
+
+// Fraction of members that exceed threshold at each point
+template<typename T>
+void ensembleProbability(const T* const* members, const int n_members, const int n, const float threshold, float* out);
+
+// Ensemble mean and spread (standard deviation about the mean) at each point
+template<typename T>
+void ensembleMeanSpread(const T* const* members, const int n_members, const int n, float* mean, float* spread);
+
+// The given percentile (0 to 100) of the members at each point, interpolating linearly between members
+template<typename T>
+void ensemblePercentile(const T* const* members, const int n_members, const int n, const float percentile, float* out);
+
+// Probability-matched mean (Ebert 2001): the spatial pattern of the ensemble mean with the distribution of values from the members. Unlike
+//  the other reductions, this needs the whole grid at once.
+template<typename T>
+void probabilityMatchedMean(const T* const* members, const int n_members, const int n, float* out);
+
+// Pack whether each member exceeds threshold into one field for Paintball, as 1.0 * M1 + 2.0 * M2 + 4.0 * M3 + ... Missing member values
+//  don't exceed the threshold, so the output is never missing. Throws std::invalid_argument for more than PAINTBALL_MAX_MEMBERS members.
+template<typename T>
+void paintballBits(const T* const* members, const int n_members, const int n, const float threshold, float* out);
+
+#endif
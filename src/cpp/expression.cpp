@@ -0,0 +1,265 @@
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+#include "expression.hpp"
+#include "float16_t.hpp"
+
+using numeric::float16_t;
+
+// Recursive descent parser that emits a stack program in postfix order
+class ExprParser {
+    const std::string& expr;
+    size_t pos;
+
+    std::vector<ExprInstr>& program;
+    int& n_fields;
+    int stack_depth;
+    int& max_stack;
+
+    void error(const std::string& msg) const {
+        throw std::invalid_argument("Error parsing expression '" + this->expr + "' at position " + std::to_string(this->pos) + ": " + msg);
+    }
+
+    void skipSpace() {
+        while (this->pos < this->expr.size() && isspace(this->expr[this->pos])) this->pos++;
+    }
+
+    bool accept(char c) {
+        this->skipSpace();
+        if (this->pos < this->expr.size() && this->expr[this->pos] == c) {
+            this->pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        if (!this->accept(c)) this->error(std::string("expected '") + c + "'");
+    }
+
+    std::string identifier() {
+        this->skipSpace();
+        const size_t start = this->pos;
+        while (this->pos < this->expr.size() && (isalnum(this->expr[this->pos]) || this->expr[this->pos] == '_')) this->pos++;
+        return this->expr.substr(start, this->pos - start);
+    }
+
+    // Emit an instruction that pops n_args values and pushes one
+    void emit(ExprOp op, int n_args, int field=0, float value=0) {
+        this->program.push_back(ExprInstr(op, field, value));
+        this->stack_depth += 1 - n_args;
+        this->max_stack = std::max(this->max_stack, this->stack_depth);
+    }
+
+    int arguments() {
+        int n_args = 0;
+        this->expect('(');
+        if (this->accept(')')) return 0;
+
+        do {
+            this->expression();
+            n_args++;
+        } while (this->accept(','));
+
+        this->expect(')');
+        return n_args;
+    }
+
+    void function(const std::string& name) {
+        if (name == "length") {
+            // Only the 2D length of a vector is supported (e.g., for wind speed)
+            this->expect('(');
+            if (this->identifier() != "vec2") this->error("length() only supports vec2 arguments");
+            if (this->arguments() != 2) this->error("vec2() takes 2 arguments");
+            this->expect(')');
+
+            this->emit(ExprOp::Hypot, 2);
+            return;
+        }
+
+        struct FuncSpec { const char* name; ExprOp op; int n_args; };
+        static const FuncSpec funcs[] = {
+            {"min", ExprOp::Min, 2}, {"max", ExprOp::Max, 2}, {"pow", ExprOp::Pow, 2}, {"sqrt", ExprOp::Sqrt, 1}, {"abs", ExprOp::Abs, 1},
+            {"exp", ExprOp::Exp, 1}, {"log", ExprOp::Log, 1}, {"step", ExprOp::Step, 2}, {"clamp", ExprOp::Clamp, 3}, {"hypot", ExprOp::Hypot, 2},
+        };
+
+        for (const FuncSpec& func : funcs) {
+            if (name != func.name) continue;
+
+            const int n_args = this->arguments();
+            if (n_args != func.n_args) this->error(name + "() takes " + std::to_string(func.n_args) + " arguments");
+
+            this->emit(func.op, n_args);
+            return;
+        }
+
+        this->error("unknown function '" + name + "'");
+    }
+
+    void primary() {
+        this->skipSpace();
+        if (this->pos >= this->expr.size()) this->error("unexpected end of expression");
+
+        const char c = this->expr[this->pos];
+
+        if (this->accept('(')) {
+            this->expression();
+            this->expect(')');
+        }
+        else if (this->accept('{')) {
+            char* end;
+            const long field = strtol(this->expr.c_str() + this->pos, &end, 10);
+            if (end == this->expr.c_str() + this->pos || field < 0) this->error("expected a field index");
+            this->pos = end - this->expr.c_str();
+            this->expect('}');
+
+            this->n_fields = std::max(this->n_fields, (int)field + 1);
+            this->emit(ExprOp::Field, 0, field);
+        }
+        else if (isdigit(c) || c == '.') {
+            char* end;
+            const double value = strtod(this->expr.c_str() + this->pos, &end);
+            this->pos = end - this->expr.c_str();
+            this->emit(ExprOp::Const, 0, 0, value);
+        }
+        else if (isalpha(c)) {
+            this->function(this->identifier());
+        }
+        else {
+            this->error(std::string("unexpected character '") + c + "'");
+        }
+    }
+
+    void unary() {
+        if (this->accept('-')) {
+            this->unary();
+            this->emit(ExprOp::Neg, 1);
+        }
+        else if (this->accept('+')) {
+            this->unary();
+        }
+        else {
+            this->primary();
+        }
+    }
+
+    void term() {
+        this->unary();
+        while (true) {
+            if (this->accept('*')) { this->unary(); this->emit(ExprOp::Mul, 2); }
+            else if (this->accept('/')) { this->unary(); this->emit(ExprOp::Div, 2); }
+            else break;
+        }
+    }
+
+    void expression() {
+        this->term();
+        while (true) {
+            if (this->accept('+')) { this->term(); this->emit(ExprOp::Add, 2); }
+            else if (this->accept('-')) { this->term(); this->emit(ExprOp::Sub, 2); }
+            else break;
+        }
+    }
+
+    public:
+    ExprParser(const std::string& expr, std::vector<ExprInstr>& program, int& n_fields, int& max_stack) : 
+        expr(expr), pos(0), program(program), n_fields(n_fields), stack_depth(0), max_stack(max_stack) {}
+
+    void parse() {
+        this->expression();
+        this->skipSpace();
+        if (this->pos != this->expr.size()) this->error("unexpected trailing characters");
+    }
+};
+
+FieldExpression::FieldExpression(const std::string& expression) : n_fields(0), max_stack(0) {
+    ExprParser parser(expression, this->program, this->n_fields, this->max_stack);
+    parser.parse();
+}
+
+// Number of points to evaluate at a time. Each instruction runs over a whole block, so the loops are simple enough to vectorize, and the
+//  stack for a block fits in cache.
+const int EXPR_BLOCK_SIZE = 256;
+
+template<typename T>
+void FieldExpression::evaluate(const T* const* fields, const int n, T* out) const {
+    std::vector<float> stack(this->max_stack * EXPR_BLOCK_SIZE);
+
+    for (int ibegin = 0; ibegin < n; ibegin += EXPR_BLOCK_SIZE) {
+        const int nb = std::min(EXPR_BLOCK_SIZE, n - ibegin);
+        int sp = 0;
+
+        for (const ExprInstr& instr : this->program) {
+            // Pointer to the ith value from the top of the stack (0 is the next free slot)
+            auto slot = [&](int i) { return stack.data() + (sp - i) * EXPR_BLOCK_SIZE; };
+
+            switch (instr.op) {
+                case ExprOp::Field: {
+                    const T* field = fields[instr.field] + ibegin;
+                    float* r = slot(0);
+                    for (int k = 0; k < nb; k++) r[k] = (float)field[k];
+                    sp++;
+                    break;
+                }
+                case ExprOp::Const: {
+                    std::fill(slot(0), slot(0) + nb, instr.value);
+                    sp++;
+                    break;
+                }
+                case ExprOp::Clamp: {
+                    float* x = slot(3);
+                    const float* lo = slot(2);
+                    const float* hi = slot(1);
+                    for (int k = 0; k < nb; k++) x[k] = std::min(std::max(x[k], lo[k]), hi[k]);
+                    sp -= 2;
+                    break;
+                }
+                case ExprOp::Neg:
+                case ExprOp::Sqrt:
+                case ExprOp::Abs:
+                case ExprOp::Exp:
+                case ExprOp::Log: {
+                    float* a = slot(1);
+                    switch (instr.op) {
+                        case ExprOp::Neg:  for (int k = 0; k < nb; k++) a[k] = -a[k]; break;
+                        case ExprOp::Sqrt: for (int k = 0; k < nb; k++) a[k] = sqrtf(a[k]); break;
+                        case ExprOp::Abs:  for (int k = 0; k < nb; k++) a[k] = fabsf(a[k]); break;
+                        case ExprOp::Exp:  for (int k = 0; k < nb; k++) a[k] = expf(a[k]); break;
+                        case ExprOp::Log:  for (int k = 0; k < nb; k++) a[k] = logf(a[k]); break;
+                        default: break;
+                    }
+                    break;
+                }
+                default: {
+                    // Binary operations. min and max propagate NaNs like Math.min and Math.max.
+                    float* a = slot(2);
+                    const float* b = slot(1);
+                    switch (instr.op) {
+                        case ExprOp::Add:   for (int k = 0; k < nb; k++) a[k] = a[k] + b[k]; break;
+                        case ExprOp::Sub:   for (int k = 0; k < nb; k++) a[k] = a[k] - b[k]; break;
+                        case ExprOp::Mul:   for (int k = 0; k < nb; k++) a[k] = a[k] * b[k]; break;
+                        case ExprOp::Div:   for (int k = 0; k < nb; k++) a[k] = a[k] / b[k]; break;
+                        case ExprOp::Min:   for (int k = 0; k < nb; k++) a[k] = (std::isnan(a[k]) || std::isnan(b[k])) ? NAN : std::min(a[k], b[k]); break;
+                        case ExprOp::Max:   for (int k = 0; k < nb; k++) a[k] = (std::isnan(a[k]) || std::isnan(b[k])) ? NAN : std::max(a[k], b[k]); break;
+                        case ExprOp::Pow:   for (int k = 0; k < nb; k++) a[k] = powf(a[k], b[k]); break;
+                        case ExprOp::Step:  for (int k = 0; k < nb; k++) a[k] = std::isnan(b[k]) ? NAN : (b[k] < a[k] ? 0.f : 1.f); break;
+                        case ExprOp::Hypot: for (int k = 0; k < nb; k++) a[k] = sqrtf(a[k] * a[k] + b[k] * b[k]); break;
+                        default: break;
+                    }
+                    sp--;
+                    break;
+                }
+            }
+        }
+
+        for (int k = 0; k < nb; k++) {
+            out[ibegin + k] = T(stack[k]);
+        }
+    }
+}
+
+template void FieldExpression::evaluate(const float* const* fields, const int n, float* out) const;
+template void FieldExpression::evaluate(const float16_t* const* fields, const int n, float16_t* out) const;
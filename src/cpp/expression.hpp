@@ -0,0 +1,40 @@
+
+#ifndef __AUTUMNPLOT_EXPRESSION_H__
+#define __AUTUMNPLOT_EXPRESSION_H__
+
+#include <vector>
+#include <string>
+
+enum class ExprOp {
+    Field, Const, Neg, Add, Sub, Mul, Div, Min, Max, Pow, Sqrt, Abs, Exp, Log, Step, Clamp, Hypot
+};
+
+struct ExprInstr {
+    ExprOp op;
+    int field;
+    float value;
+
+    ExprInstr(ExprOp op, int field=0, float value=0) : op(op), field(field), value(value) {}
+};
+
+// An expression on one or more fields, compiled from the GLSL expressions used by ComputedScalarField (e.g., "{0} - {1}" or 
+//  "length(vec2({0}, {1}))"). Supports +, -, *, /, min, max, pow, sqrt, abs, exp, log, step, clamp, and length(vec2(...)). Throws
+//  std::invalid_argument if the expression can't be parsed.
+class FieldExpression {
+    std::vector<ExprInstr> program;
+    int n_fields;
+    int max_stack;
+
+    public:
+    FieldExpression(const std::string& expression);
+
+    int getNumFields() const {
+        return this->n_fields;
+    }
+
+    // Evaluate the expression over n points. fields[i] is the data for {i} in the expression.
+    template<typename T>
+    void evaluate(const T* const* fields, const int n, T* out) const;
+};
+
+#endif
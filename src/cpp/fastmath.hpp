@@ -0,0 +1,175 @@
+
+#ifndef __AUTUMNPLOT_FASTMATH_H__
+#define __AUTUMNPLOT_FASTMATH_H__
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Polynomial approximations to the transcendental functions used in the map projections. These are meant for computing vertex 
+//  coordinates that end up in float32 buffers, so they're only accurate to about 3e-10 (relative for exp2, absolute for the 
+//  others), which is well below the ~2.4 m float32 resolution in WebMercator coordinates. They don't handle infinities or 
+//  NaNs specially, and the inputs are assumed to be in the range the projections use (e.g., |x| < 1e6 for the trig functions).
+namespace fastmath {
+    const double PI = 3.14159265358979323846;
+    const double PI_2 = 1.57079632679489661923;
+    const double PI_6 = 0.52359877559829887308;
+    const double TAN_PI_12 = 0.26794919243112270647;
+    const double INV_SQRT3 = 0.57735026918962576451;
+    const double LN2 = 0.69314718055994530942;
+    const double SQRT2 = 1.41421356237309504880;
+
+    // Max absolute error about 3e-11
+    inline double log2(const double x) {
+        uint64_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        // Split into exponent and a mantissa in [sqrt(2)/2, sqrt(2))
+        int64_t exponent = static_cast<int64_t>((bits >> 52) & 0x7ff) - 1023;
+        bits = (bits & 0x000fffffffffffffull) | 0x3ff0000000000000ull;
+        double mantissa;
+        std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+        if (mantissa > SQRT2) {
+            mantissa *= 0.5;
+            exponent += 1;
+        }
+
+        // ln(m) = 2 atanh(z), where z = (m - 1) / (m + 1) and |z| < 0.172
+        const double z = (mantissa - 1) / (mantissa + 1);
+        const double z2 = z * z;
+        const double ln_m = 2 * z * (1 + z2 * (1. / 3 + z2 * (1. / 5 + z2 * (1. / 7 + z2 * (1. / 9 + z2 * (1. / 11))))));
+
+        return exponent + ln_m / LN2;
+    }
+
+    inline double log(const double x) {
+        return fastmath::log2(x) * LN2;
+    }
+
+    // Max relative error about 3e-10 for |x| < 1000
+    inline double exp2(const double x) {
+        const double x_round = std::nearbyint(x);
+        const double frac = (x - x_round) * LN2;
+
+        // Taylor series for e^frac with |frac| <= ln(2) / 2
+        const double exp_frac = 1 + frac * (1 + frac * (1. / 2 + frac * (1. / 6 + frac * (1. / 24 + frac * (1. / 120 + frac * (1. / 720 
+                                  + frac * (1. / 5040 + frac * (1. / 40320))))))));
+
+        // Scale by 2^x_round by adding to the exponent
+        uint64_t bits;
+        std::memcpy(&bits, &exp_frac, sizeof(bits));
+        bits += static_cast<uint64_t>(static_cast<int64_t>(x_round)) << 52;
+
+        double result;
+        std::memcpy(&result, &bits, sizeof(result));
+        return result;
+    }
+
+    inline double exp(const double x) {
+        return fastmath::exp2(x / LN2);
+    }
+
+    // x must be positive
+    inline double pow(const double x, const double y) {
+        return fastmath::exp2(y * fastmath::log2(x));
+    }
+
+    // Max absolute error about 1e-11
+    inline void sincos(const double x, double& sin_x, double& cos_x) {
+        // Reduce to |r| <= pi / 4 and a quadrant
+        const double quadrant = std::nearbyint(x / PI_2);
+        const double r = x - quadrant * PI_2;
+        const double r2 = r * r;
+
+        const double sin_r = r * (1 - r2 * (1. / 6 - r2 * (1. / 120 - r2 * (1. / 5040 - r2 * (1. / 362880 - r2 * (1. / 39916800))))));
+        const double cos_r = 1 - r2 * (1. / 2 - r2 * (1. / 24 - r2 * (1. / 720 - r2 * (1. / 40320 - r2 * (1. / 3628800 - r2 * (1. / 479001600))))));
+
+        switch (static_cast<int64_t>(quadrant) & 3) {
+            case 0: sin_x =  sin_r; cos_x =  cos_r; break;
+            case 1: sin_x =  cos_r; cos_x = -sin_r; break;
+            case 2: sin_x = -sin_r; cos_x = -cos_r; break;
+            default: sin_x = -cos_r; cos_x =  sin_r; break;
+        }
+    }
+
+    inline double sin(const double x) {
+        double sin_x, cos_x;
+        fastmath::sincos(x, sin_x, cos_x);
+        return sin_x;
+    }
+
+    inline double cos(const double x) {
+        double sin_x, cos_x;
+        fastmath::sincos(x, sin_x, cos_x);
+        return cos_x;
+    }
+
+    inline double tan(const double x) {
+        double sin_x, cos_x;
+        fastmath::sincos(x, sin_x, cos_x);
+        return sin_x / cos_x;
+    }
+
+    // Max absolute error about 2e-10
+    inline double atan(const double x) {
+        const double abs_x = std::fabs(x);
+
+        // Reduce to [0, 1] using atan(x) = pi / 2 - atan(1 / x), then to [0, tan(pi / 12)] using the addition formula
+        const bool invert = abs_x > 1;
+        double r = invert ? 1 / abs_x : abs_x;
+
+        const bool shift = r > TAN_PI_12;
+        r = shift ? (r - INV_SQRT3) / (1 + r * INV_SQRT3) : r;
+
+        const double r2 = r * r;
+        double atan_r = r * (1 - r2 * (1. / 3 - r2 * (1. / 5 - r2 * (1. / 7 - r2 * (1. / 9 - r2 * (1. / 11 - r2 * (1. / 13)))))));
+
+        atan_r = shift ? atan_r + PI_6 : atan_r;
+        atan_r = invert ? PI_2 - atan_r : atan_r;
+        return std::copysign(atan_r, x);
+    }
+
+    inline double atan2(const double y, const double x) {
+        if (x == 0) {
+            return y == 0 ? 0 : std::copysign(PI_2, y);
+        }
+
+        const double atan_yx = fastmath::atan(y / x);
+
+        if (x > 0) return atan_yx;
+        return y >= 0 ? atan_yx + PI : atan_yx - PI;
+    }
+
+    inline double sinh(const double x) {
+        const double exp_x = fastmath::exp(x);
+        return 0.5 * (exp_x - 1 / exp_x);
+    }
+}
+
+// Math operations for templating the projection formulas on exact vs. approximate math
+struct StdMathOps {
+    static double sin(const double x) { return std::sin(x); }
+    static double cos(const double x) { return std::cos(x); }
+    static double tan(const double x) { return std::tan(x); }
+    static double atan(const double x) { return std::atan(x); }
+    static double atan2(const double y, const double x) { return std::atan2(y, x); }
+    static double pow(const double x, const double y) { return std::pow(x, y); }
+    static double log(const double x) { return std::log(x); }
+    static double sinh(const double x) { return std::sinh(x); }
+    static double hypot(const double x, const double y) { return std::hypot(x, y); }
+};
+
+struct FastMathOps {
+    static double sin(const double x) { return fastmath::sin(x); }
+    static double cos(const double x) { return fastmath::cos(x); }
+    static double tan(const double x) { return fastmath::tan(x); }
+    static double atan(const double x) { return fastmath::atan(x); }
+    static double atan2(const double y, const double x) { return fastmath::atan2(y, x); }
+    static double pow(const double x, const double y) { return fastmath::pow(x, y); }
+    static double log(const double x) { return fastmath::log(x); }
+    static double sinh(const double x) { return fastmath::sinh(x); }
+    static double hypot(const double x, const double y) { return std::sqrt(x * x + y * y); }
+};
+
+#endif
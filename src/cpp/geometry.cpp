@@ -0,0 +1,197 @@
+#include <cmath>
+#include <algorithm>
+
+#include "geometry.hpp"
+#include "map.hpp"
+
+void makeBBElements(const float* field_lats, const float* field_lons, const uint8_t* min_zoom, const int field_ni, const int field_nj, 
+                    const int map_max_zoom, std::vector<float>& pts, std::vector<float>& tex_coords) {
+    WebMercator map_crs;
+
+    const int n_coords_per_pt_pts = 2;
+    const int n_coords_per_pt_tc = 2;
+
+    // Size for every point being visible and trim at the end, so we only need one pass through the field
+    pts.resize(field_ni * field_nj * n_coords_per_pt_pts);
+    tex_coords.resize(field_ni * field_nj * n_coords_per_pt_tc);
+
+    int istart_pts = 0;
+    int istart_tc = 0;
+
+    const float dtc_i = 1. / (field_ni - 1);
+    const float dtc_j = 1. / (field_nj - 1);
+
+    for (int ilat = 0; ilat < field_nj; ilat++) {
+        for (int ilon = 0; ilon < field_ni; ilon++) {
+            const int idx = ilat * field_ni + ilon;
+            const float lat = field_lats[idx];
+            const float lon = field_lons[idx];
+            const int zoom = min_zoom[idx];
+
+            if (zoom > map_max_zoom || std::isnan(lon) || std::isnan(lat)) continue;
+
+            const GridPoint pt_ll = map_crs.transform(EarthPoint(lon, lat));
+
+            pts[istart_pts + 0] = pt_ll.x;
+            pts[istart_pts + 1] = pt_ll.y;
+
+            // Pack the min zoom in with the texture coordinates; only works because the min zoom is always an integer. Cap the i texture
+            //  coordinate at 0.99999, as a texture coordinate of 1 would bump up the zoom that gets unpacked on the GPU and make the last 
+            //  column of billboards disappear. That's good for textures up to 10^5 pixels across.
+            tex_coords[istart_tc + 0] = std::min(ilon * dtc_i, 0.99999f) + zoom;
+            tex_coords[istart_tc + 1] = ilat * dtc_j;
+
+            istart_pts += n_coords_per_pt_pts;
+            istart_tc += n_coords_per_pt_tc;
+        }
+    }
+
+    pts.resize(istart_pts);
+    tex_coords.resize(istart_tc);
+}
+
+void makeDomainVerticesAndTexCoords(const float* map_xs, const float* map_ys, const int field_ni, const int field_nj, const float texcoord_margin_r,
+                                    const float texcoord_margin_s, std::vector<float>& verts, std::vector<float>& tex_coords) {
+    std::vector<float> tex_coords_r(field_ni), tex_coords_s(field_nj);
+
+    const float dr = (1 - 2 * texcoord_margin_r) / (field_ni - 1);
+    const float ds = (1 - 2 * texcoord_margin_s) / (field_nj - 1);
+
+    for (int i = 0; i < field_ni; i++) {
+        tex_coords_r[i] = i * dr + texcoord_margin_r;
+    }
+
+    for (int j = 0; j < field_nj; j++) {
+        tex_coords_s[j] = j * ds + texcoord_margin_s;
+    }
+
+    makeDomainVerticesAndTexCoords(map_xs, map_ys, field_ni, field_nj, tex_coords_r.data(), tex_coords_s.data(), verts, tex_coords);
+}
+
+void makeDomainVerticesAndTexCoords(const float* map_xs, const float* map_ys, const int field_ni, const int field_nj, const float* tex_coords_r,
+                                    const float* tex_coords_s, std::vector<float>& verts, std::vector<float>& tex_coords) {
+    // Each strip has two vertices per row plus a duplicated vertex on each end for the degenerate joins
+    const int n_verts_per_strip = 2 * (field_nj + 1);
+
+    verts.resize(2 * n_verts_per_strip * (field_ni - 1));
+    tex_coords.resize(2 * n_verts_per_strip * (field_ni - 1));
+
+    for (int i = 0; i < field_ni - 1; i++) {
+        const float r = tex_coords_r[i];
+        const float rp1 = tex_coords_r[i + 1];
+
+        float* strip_verts = verts.data() + 2 * n_verts_per_strip * i;
+        float* strip_tcs = tex_coords.data() + 2 * n_verts_per_strip * i;
+
+        // No branches in the inner loop, so the compiler can vectorize it; the ends of the strip get filled in afterward
+        for (int j = 0; j < field_nj; j++) {
+            const int idx = i + j * field_ni;
+            const int ivert = 2 * (2 * j + 1);
+            const float s = tex_coords_s[j];
+
+            strip_verts[ivert + 0] = map_xs[idx];     strip_verts[ivert + 1] = map_ys[idx];
+            strip_verts[ivert + 2] = map_xs[idx + 1]; strip_verts[ivert + 3] = map_ys[idx + 1];
+
+            strip_tcs[ivert + 0] = r;   strip_tcs[ivert + 1] = s;
+            strip_tcs[ivert + 2] = rp1; strip_tcs[ivert + 3] = s;
+        }
+
+        const int ilast = 2 * (n_verts_per_strip - 1);
+
+        strip_verts[0] = strip_verts[2]; strip_verts[1] = strip_verts[3];
+        strip_verts[ilast + 0] = strip_verts[ilast - 2]; strip_verts[ilast + 1] = strip_verts[ilast - 1];
+
+        strip_tcs[0] = strip_tcs[2]; strip_tcs[1] = strip_tcs[3];
+        strip_tcs[ilast + 0] = strip_tcs[ilast - 2]; strip_tcs[ilast + 1] = strip_tcs[ilast - 1];
+    }
+}
+
+// Lines across the domain to check the interpolation error on, and the minimum number of intervals to start from, so that curvature that's 
+//  symmetric about the middle of the domain doesn't get missed
+const int N_REFINE_CHECK_LINES = 17;
+const int N_REFINE_MIN_INTERVALS = 4;
+
+void refineDomainIndices(const std::function<GridPoint(int, int)>& map_coord, const int n_along, const int n_across, const float tolerance, 
+                         std::vector<int>& indices) {
+    indices.clear();
+    if (n_along <= 0) return;
+    if (n_along == 1) {
+        indices.push_back(0);
+        return;
+    }
+
+    const int n_check_lines = std::min(n_across, N_REFINE_CHECK_LINES);
+    std::vector<int> check_lines(n_check_lines);
+
+    for (int iline = 0; iline < n_check_lines; iline++) {
+        check_lines[iline] = n_check_lines > 1 ? (int)round(iline * (n_across - 1.) / (n_check_lines - 1)) : 0;
+    }
+
+    // Map coordinates get computed lazily, as most of the domain shouldn't need to be looked at
+    std::vector<float> xs(n_along * n_check_lines), ys(n_along * n_check_lines);
+    std::vector<bool> computed(n_along * n_check_lines, false);
+
+    auto getMapCoord = [&](int ialong, int iline, float& x, float& y) {
+        const int idx = ialong + iline * n_along;
+        if (!computed[idx]) {
+            const GridPoint pt = map_coord(ialong, check_lines[iline]);
+            xs[idx] = pt.x; ys[idx] = pt.y;
+            computed[idx] = true;
+        }
+
+        x = xs[idx]; y = ys[idx];
+    };
+
+    // Check whether linear interpolation on [ia, ib] is good enough at a few points inside the interval
+    auto isIntervalFlat = [&](int ia, int ib) {
+        const float check_fracs[3] = {0.25, 0.5, 0.75};
+
+        for (int iline = 0; iline < n_check_lines; iline++) {
+            float xa, ya, xb, yb;
+            getMapCoord(ia, iline, xa, ya);
+            getMapCoord(ib, iline, xb, yb);
+
+            for (int ifrac = 0; ifrac < 3; ifrac++) {
+                const int im = ia + (int)round((ib - ia) * check_fracs[ifrac]);
+                if (im <= ia || im >= ib) continue;
+
+                float xm, ym;
+                getMapCoord(im, iline, xm, ym);
+
+                const bool a_nan = std::isnan(xa), b_nan = std::isnan(xb), m_nan = std::isnan(xm);
+                if (a_nan && b_nan && m_nan) continue;
+
+                // The interval crosses the edge of the valid part of the domain (e.g., the edge of a geostationary disk), so keep refining
+                if (a_nan || b_nan || m_nan) return false;
+
+                const float t = (float)(im - ia) / (ib - ia);
+                const float x_interp = xa + t * (xb - xa);
+                const float y_interp = ya + t * (yb - ya);
+
+                if (hypot(xm - x_interp, ym - y_interp) > tolerance) return false;
+            }
+        }
+
+        return true;
+    };
+
+    std::function<void(int, int)> refine = [&](int ia, int ib) {
+        if (ib - ia <= 1 || isIntervalFlat(ia, ib)) {
+            indices.push_back(ia);
+            return;
+        }
+
+        const int im = (ia + ib) / 2;
+        refine(ia, im);
+        refine(im, ib);
+    };
+
+    const int n_intervals = std::max(1, std::min(N_REFINE_MIN_INTERVALS, n_along - 1));
+    for (int iint = 0; iint < n_intervals; iint++) {
+        const int ia = (int)round(iint * (n_along - 1.) / n_intervals);
+        const int ib = (int)round((iint + 1) * (n_along - 1.) / n_intervals);
+        refine(ia, ib);
+    }
+
+    indices.push_back(n_along - 1);
+}
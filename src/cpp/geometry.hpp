@@ -0,0 +1,30 @@
+
+#ifndef __AUTUMNPLOT_GEOMETRY_H__
+#define __AUTUMNPLOT_GEOMETRY_H__
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+
+#include "map.hpp"
+
+// Make the billboard vertices and texture coordinates for the points in a field that are visible at or below map_max_zoom. The min zoom 
+//  is packed into the integer part of the i texture coordinate.
+void makeBBElements(const float* field_lats, const float* field_lons, const uint8_t* min_zoom, const int field_ni, const int field_nj, 
+                    const int map_max_zoom, std::vector<float>& pts, std::vector<float>& tex_coords);
+
+// Make the triangle strip vertices and texture coordinates for a domain from the map coordinates of its points. Each column of cells is
+//  one strip, joined to the next by degenerate triangles. The texture coordinates are inset by the margins on each side.
+void makeDomainVerticesAndTexCoords(const float* map_xs, const float* map_ys, const int field_ni, const int field_nj, const float texcoord_margin_r,
+                                    const float texcoord_margin_s, std::vector<float>& verts, std::vector<float>& tex_coords);
+
+// Same as above, but with the texture coordinates for each column and row given explicitly (e.g., for a domain with uneven spacing)
+void makeDomainVerticesAndTexCoords(const float* map_xs, const float* map_ys, const int field_ni, const int field_nj, const float* tex_coords_r,
+                                    const float* tex_coords_s, std::vector<float>& verts, std::vector<float>& tex_coords);
+
+// Choose the indices along one dimension of a domain to keep so that linearly interpolating the map coordinates between them is within
+//  tolerance of the true map coordinates. map_coord gives the map coordinates at an index along the dimension and an index across it.
+void refineDomainIndices(const std::function<GridPoint(int, int)>& map_coord, const int n_along, const int n_across, const float tolerance, 
+                         std::vector<int>& indices);
+
+#endif
@@ -0,0 +1,632 @@
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include "grib2.hpp"
+#include "float16_t.hpp"
+
+using numeric::float16_t;
+
+static uint32_t readUint(const uint8_t* ptr, const int n_bytes) {
+    uint32_t val = 0;
+    for (int ibyte = 0; ibyte < n_bytes; ibyte++) {
+        val = (val << 8) | ptr[ibyte];
+    }
+    return val;
+}
+
+// GRIB2 stores signed integers as a sign bit followed by the magnitude
+static int32_t readSignMagnitude(const uint8_t* ptr, const int n_bytes) {
+    const uint32_t val = readUint(ptr, n_bytes);
+    const uint32_t sign_bit = 1u << (8 * n_bytes - 1);
+    const int32_t magnitude = val & (sign_bit - 1);
+    return (val & sign_bit) ? -magnitude : magnitude;
+}
+
+static float readFloat(const uint8_t* ptr) {
+    const uint32_t bits = readUint(ptr, 4);
+    float val;
+    std::memcpy(&val, &bits, sizeof(float));
+    return val;
+}
+
+// Reads big-endian (most significant bit first) packed integers, as used in the GRIB2 data section
+class BitReader {
+    const uint8_t* data;
+    size_t n_bits;
+    size_t pos;
+
+    public:
+    BitReader(const uint8_t* data, const size_t n_bytes) : data(data), n_bits(n_bytes * 8), pos(0) {}
+
+    uint32_t read(const int n) {
+        if (n == 0) return 0;
+        if (this->pos + n > this->n_bits) throw std::invalid_argument("GRIB2 data section is truncated");
+
+        uint32_t val = 0;
+        int n_left = n;
+        while (n_left > 0) {
+            const int bit_offset = this->pos & 7;
+            const int n_take = std::min(n_left, 8 - bit_offset);
+            const uint32_t byte = this->data[this->pos >> 3];
+
+            val = (val << n_take) | ((byte >> (8 - bit_offset - n_take)) & ((1u << n_take) - 1));
+            this->pos += n_take;
+            n_left -= n_take;
+        }
+
+        return val;
+    }
+
+    int32_t readSignMagnitude(const int n) {
+        const uint32_t sign = this->read(1);
+        const int32_t magnitude = this->read(n - 1);
+        return sign ? -magnitude : magnitude;
+    }
+
+    void alignToByte() {
+        this->pos = (this->pos + 7) & ~static_cast<size_t>(7);
+    }
+};
+
+// Minimal zlib/DEFLATE decompressor (RFC 1950/1951) for PNG-packed fields
+
+class InflateBits {
+    const uint8_t* data;
+    size_t n_bytes;
+    size_t pos;
+    uint32_t bit_buf;
+    int bit_count;
+
+    public:
+    InflateBits(const uint8_t* data, const size_t n_bytes) : data(data), n_bytes(n_bytes), pos(0), bit_buf(0), bit_count(0) {}
+
+    // DEFLATE packs bits least significant bit first
+    uint32_t read(const int n) {
+        while (this->bit_count < n) {
+            if (this->pos >= this->n_bytes) throw std::invalid_argument("PNG data is truncated");
+            this->bit_buf |= static_cast<uint32_t>(this->data[this->pos++]) << this->bit_count;
+            this->bit_count += 8;
+        }
+
+        const uint32_t val = this->bit_buf & ((1u << n) - 1);
+        this->bit_buf >>= n;
+        this->bit_count -= n;
+        return val;
+    }
+
+    void alignToByte() {
+        this->bit_buf = 0;
+        this->bit_count = 0;
+    }
+
+    const uint8_t* bytes(const size_t n) {
+        if (this->pos + n > this->n_bytes) throw std::invalid_argument("PNG data is truncated");
+        const uint8_t* ptr = this->data + this->pos;
+        this->pos += n;
+        return ptr;
+    }
+};
+
+// Canonical Huffman code, stored as the number of codes of each length and the symbols in code order
+struct Huffman {
+    uint16_t counts[16];
+    uint16_t symbols[288];
+
+    void build(const uint8_t* lengths, const int n_symbols) {
+        std::fill(this->counts, this->counts + 16, 0);
+        for (int isym = 0; isym < n_symbols; isym++) this->counts[lengths[isym]]++;
+        this->counts[0] = 0;
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int len = 1; len < 15; len++) offsets[len + 1] = offsets[len] + this->counts[len];
+
+        for (int isym = 0; isym < n_symbols; isym++) {
+            if (lengths[isym] != 0) this->symbols[offsets[lengths[isym]]++] = isym;
+        }
+    }
+
+    int decode(InflateBits& bits) const {
+        int code = 0, first = 0, index = 0;
+
+        for (int len = 1; len < 16; len++) {
+            code |= bits.read(1);
+            const int count = this->counts[len];
+            if (code - count < first) return this->symbols[index + (code - first)];
+
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        throw std::invalid_argument("Invalid Huffman code in PNG data");
+    }
+};
+
+static const uint16_t LENGTH_BASE[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t LENGTH_EXTRA[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t DIST_BASE[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                                       8193, 12289, 16385, 24577};
+static const uint8_t DIST_EXTRA[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+static void inflateBlock(InflateBits& bits, const Huffman& lit_codes, const Huffman& dist_codes, std::vector<uint8_t>& out) {
+    while (true) {
+        const int sym = lit_codes.decode(bits);
+
+        if (sym < 256) {
+            out.push_back(sym);
+        }
+        else if (sym == 256) {
+            return;
+        }
+        else {
+            const int ilen = sym - 257;
+            if (ilen >= 29) throw std::invalid_argument("Invalid length code in PNG data");
+            const int length = LENGTH_BASE[ilen] + bits.read(LENGTH_EXTRA[ilen]);
+
+            const int idist = dist_codes.decode(bits);
+            if (idist >= 30) throw std::invalid_argument("Invalid distance code in PNG data");
+            const size_t dist = DIST_BASE[idist] + bits.read(DIST_EXTRA[idist]);
+            if (dist > out.size()) throw std::invalid_argument("Invalid distance in PNG data");
+
+            // The copy can overlap what it's writing, so go a byte at a time
+            const size_t start = out.size() - dist;
+            for (int ibyte = 0; ibyte < length; ibyte++) {
+                out.push_back(out[start + ibyte]);
+            }
+        }
+    }
+}
+
+static void inflateZlib(const uint8_t* data, const size_t n_bytes, std::vector<uint8_t>& out) {
+    if (n_bytes < 2 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0) {
+        throw std::invalid_argument("PNG data doesn't have a valid zlib header");
+    }
+
+    InflateBits bits(data + 2, n_bytes - 2);
+    bool last_block = false;
+
+    while (!last_block) {
+        last_block = bits.read(1);
+        const int block_type = bits.read(2);
+
+        if (block_type == 0) {
+            // Stored block
+            bits.alignToByte();
+            const uint8_t* header = bits.bytes(4);
+            const uint16_t len = header[0] | (header[1] << 8);
+            const uint8_t* block = bits.bytes(len);
+            out.insert(out.end(), block, block + len);
+        }
+        else if (block_type == 1) {
+            // Fixed Huffman codes
+            static Huffman fixed_lit, fixed_dist;
+            static bool fixed_built = false;
+            if (!fixed_built) {
+                uint8_t lengths[288];
+                std::fill(lengths, lengths + 144, 8);
+                std::fill(lengths + 144, lengths + 256, 9);
+                std::fill(lengths + 256, lengths + 280, 7);
+                std::fill(lengths + 280, lengths + 288, 8);
+                fixed_lit.build(lengths, 288);
+
+                std::fill(lengths, lengths + 30, 5);
+                fixed_dist.build(lengths, 30);
+                fixed_built = true;
+            }
+
+            inflateBlock(bits, fixed_lit, fixed_dist, out);
+        }
+        else if (block_type == 2) {
+            // Dynamic Huffman codes
+            static const uint8_t CODE_LENGTH_ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+            const int n_lit = bits.read(5) + 257;
+            const int n_dist = bits.read(5) + 1;
+            const int n_code_lengths = bits.read(4) + 4;
+
+            uint8_t lengths[320] = {0};
+            for (int icl = 0; icl < n_code_lengths; icl++) {
+                lengths[CODE_LENGTH_ORDER[icl]] = bits.read(3);
+            }
+
+            Huffman code_length_codes;
+            code_length_codes.build(lengths, 19);
+
+            int ilen = 0;
+            std::fill(lengths, lengths + 320, 0);
+            while (ilen < n_lit + n_dist) {
+                const int sym = code_length_codes.decode(bits);
+                int repeat = 0;
+                uint8_t repeat_len = 0;
+
+                if (sym < 16) {
+                    lengths[ilen++] = sym;
+                    continue;
+                }
+                else if (sym == 16) {
+                    if (ilen == 0) throw std::invalid_argument("Invalid code lengths in PNG data");
+                    repeat_len = lengths[ilen - 1];
+                    repeat = 3 + bits.read(2);
+                }
+                else if (sym == 17) {
+                    repeat = 3 + bits.read(3);
+                }
+                else {
+                    repeat = 11 + bits.read(7);
+                }
+
+                if (ilen + repeat > n_lit + n_dist) throw std::invalid_argument("Invalid code lengths in PNG data");
+                std::fill(lengths + ilen, lengths + ilen + repeat, repeat_len);
+                ilen += repeat;
+            }
+
+            Huffman lit_codes, dist_codes;
+            lit_codes.build(lengths, n_lit);
+            dist_codes.build(lengths + n_lit, n_dist);
+
+            inflateBlock(bits, lit_codes, dist_codes, out);
+        }
+        else {
+            throw std::invalid_argument("Invalid block type in PNG data");
+        }
+    }
+}
+
+// Decode a grayscale or RGB(A) PNG into unfiltered rows. Each row is row_bytes long.
+static void decodePNG(const uint8_t* png, const size_t n_bytes, std::vector<uint8_t>& rows, int& width, int& height, int& bits_per_pixel,
+                      size_t& row_bytes) {
+    static const uint8_t PNG_SIGNATURE[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    if (n_bytes < 8 || std::memcmp(png, PNG_SIGNATURE, 8) != 0) throw std::invalid_argument("GRIB2 data section isn't a PNG");
+
+    std::vector<uint8_t> compressed;
+    int bit_depth = 0, color_type = -1;
+    size_t pos = 8;
+
+    while (pos + 12 <= n_bytes) {
+        const uint32_t chunk_length = readUint(png + pos, 4);
+        const uint8_t* chunk_type = png + pos + 4;
+        const uint8_t* chunk_data = png + pos + 8;
+        if (pos + 12 + chunk_length > n_bytes) throw std::invalid_argument("PNG data is truncated");
+
+        if (std::memcmp(chunk_type, "IHDR", 4) == 0) {
+            width = readUint(chunk_data, 4);
+            height = readUint(chunk_data + 4, 4);
+            bit_depth = chunk_data[8];
+            color_type = chunk_data[9];
+            if (chunk_data[12] != 0) throw std::invalid_argument("Interlaced PNGs aren't supported");
+        }
+        else if (std::memcmp(chunk_type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), chunk_data, chunk_data + chunk_length);
+        }
+        else if (std::memcmp(chunk_type, "IEND", 4) == 0) {
+            break;
+        }
+
+        pos += 12 + chunk_length;
+    }
+
+    int n_channels;
+    switch (color_type) {
+        case 0: n_channels = 1; break;
+        case 2: n_channels = 3; break;
+        case 4: n_channels = 2; break;
+        case 6: n_channels = 4; break;
+        default: throw std::invalid_argument("Unsupported PNG color type " + std::to_string(color_type));
+    }
+
+    bits_per_pixel = bit_depth * n_channels;
+    row_bytes = (static_cast<size_t>(width) * bits_per_pixel + 7) / 8;
+    const int pixel_bytes = std::max(1, bits_per_pixel / 8);
+
+    std::vector<uint8_t> filtered;
+    inflateZlib(compressed.data(), compressed.size(), filtered);
+    if (filtered.size() < (row_bytes + 1) * height) throw std::invalid_argument("PNG image data is truncated");
+
+    // Undo the per-row filters
+    rows.resize(row_bytes * height);
+    for (int irow = 0; irow < height; irow++) {
+        const uint8_t filter = filtered[irow * (row_bytes + 1)];
+        const uint8_t* src = filtered.data() + irow * (row_bytes + 1) + 1;
+        uint8_t* dst = rows.data() + irow * row_bytes;
+        const uint8_t* prev = irow > 0 ? dst - row_bytes : NULL;
+
+        for (size_t ibyte = 0; ibyte < row_bytes; ibyte++) {
+            const int left = ibyte >= pixel_bytes ? dst[ibyte - pixel_bytes] : 0;
+            const int up = prev != NULL ? prev[ibyte] : 0;
+            const int up_left = (prev != NULL && ibyte >= pixel_bytes) ? prev[ibyte - pixel_bytes] : 0;
+            int pred;
+
+            switch (filter) {
+                case 0: pred = 0; break;
+                case 1: pred = left; break;
+                case 2: pred = up; break;
+                case 3: pred = (left + up) / 2; break;
+                case 4: {
+                    const int p = left + up - up_left;
+                    const int pa = abs(p - left), pb = abs(p - up), pc = abs(p - up_left);
+                    pred = (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : up_left);
+                    break;
+                }
+                default: throw std::invalid_argument("Invalid PNG filter type");
+            }
+
+            dst[ibyte] = src[ibyte] + pred;
+        }
+    }
+}
+
+Grib2Field findGrib2Field(const uint8_t* msg, const size_t length, const int field_index) {
+    if (length < 16 || std::memcmp(msg, "GRIB", 4) != 0) throw std::invalid_argument("Not a GRIB message");
+    if (msg[7] != 2) throw std::invalid_argument("Only GRIB edition 2 is supported (got edition " + std::to_string(msg[7]) + ")");
+
+    const size_t msg_length = std::min(static_cast<size_t>(readUint(msg + 12, 4)), length);
+
+    Grib2Field field = {};
+    field.discipline = msg[6];
+    field.grid_template = -1;
+    field.data_template = -1;
+
+    int ifield = 0;
+    size_t pos = 16;
+
+    // Sections 2-7 can repeat for each field in the message, and each one stays in effect until it's replaced
+    while (pos + 5 <= msg_length && std::memcmp(msg + pos, "7777", 4) != 0) {
+        const uint32_t sec_length = readUint(msg + pos, 4);
+        const int sec_number = msg[pos + 4];
+        const uint8_t* sec = msg + pos;
+        if (sec_length < 5 || pos + sec_length > msg_length) throw std::invalid_argument("GRIB2 section " + std::to_string(sec_number) + " is truncated");
+
+        if (sec_number == 3) {
+            field.n_points = readUint(sec + 6, 4);
+            field.grid_template = readUint(sec + 12, 2);
+
+            // Offsets of the scanning mode for the grid templates where Ni and Nj are at octets 31-38
+            int scan_mode_octet = 0;
+            switch (field.grid_template) {
+                case 0: case 40: scan_mode_octet = 72; break;
+                case 10: scan_mode_octet = 60; break;
+                case 20: case 30: scan_mode_octet = 65; break;
+                case 90: scan_mode_octet = 64; break;
+            }
+
+            if (scan_mode_octet > 0 && sec_length >= scan_mode_octet) {
+                field.ni = readUint(sec + 30, 4);
+                field.nj = readUint(sec + 34, 4);
+                field.scan_mode = sec[scan_mode_octet - 1];
+            }
+            else {
+                field.ni = field.nj = 0;
+                field.scan_mode = 0;
+            }
+        }
+        else if (sec_number == 5) {
+            field.n_values = readUint(sec + 5, 4);
+            field.data_template = readUint(sec + 9, 2);
+            field.data_rep = sec;
+            field.data_rep_length = sec_length;
+        }
+        else if (sec_number == 6) {
+            const int indicator = sec[5];
+            if (indicator == 0) {
+                field.bitmap = sec + 6;
+            }
+            else if (indicator == 255) {
+                field.bitmap = NULL;
+            }
+            else if (indicator != 254) {
+                throw std::invalid_argument("Predefined GRIB2 bitmaps aren't supported");
+            }
+        }
+        else if (sec_number == 7) {
+            if (ifield == field_index) {
+                field.data = sec + 5;
+                field.data_length = sec_length - 5;
+                return field;
+            }
+            ifield++;
+        }
+
+        pos += sec_length;
+    }
+
+    throw std::invalid_argument("GRIB2 message only has " + std::to_string(ifield) + " fields");
+}
+
+// Unpack template 5.0 (simple packing). Returns the unscaled packed integers.
+static void unpackSimple(const Grib2Field& field, const int n_bits, std::vector<float>& values) {
+    BitReader bits(field.data, field.data_length);
+    for (int ival = 0; ival < field.n_values; ival++) {
+        values[ival] = bits.read(n_bits);
+    }
+}
+
+// Unpack templates 5.2 and 5.3 (complex packing, with spatial differencing for 5.3). Returns the unscaled integers with missing values as NaN.
+static void unpackComplex(const Grib2Field& field, const int n_bits, std::vector<float>& values) {
+    const uint8_t* drs = field.data_rep;
+    if (field.data_rep_length < (field.data_template == 3 ? 49 : 47)) throw std::invalid_argument("GRIB2 data representation section is truncated");
+
+    const int missing_mgmt = drs[22];
+    const int n_groups = readUint(drs + 31, 4);
+    const int ref_width = drs[35];
+    const int n_bits_width = drs[36];
+    const uint32_t ref_length = readUint(drs + 37, 4);
+    const int length_increment = drs[41];
+    const uint32_t last_length = readUint(drs + 42, 4);
+    const int n_bits_length = drs[46];
+    const int sd_order = field.data_template == 3 ? drs[47] : 0;
+    const int sd_n_bytes = field.data_template == 3 ? drs[48] : 0;
+
+    BitReader bits(field.data, field.data_length);
+
+    // Initial values and minimum for the spatial differencing
+    int32_t sd_init[2] = {0, 0}, sd_min = 0;
+    if (sd_order > 0 && sd_n_bytes > 0) {
+        for (int iinit = 0; iinit < sd_order; iinit++) {
+            sd_init[iinit] = bits.readSignMagnitude(sd_n_bytes * 8);
+        }
+        sd_min = bits.readSignMagnitude(sd_n_bytes * 8);
+    }
+
+    std::vector<uint32_t> group_refs(n_groups), group_widths(n_groups), group_lengths(n_groups);
+    for (int igrp = 0; igrp < n_groups; igrp++) group_refs[igrp] = bits.read(n_bits);
+    bits.alignToByte();
+
+    for (int igrp = 0; igrp < n_groups; igrp++) group_widths[igrp] = bits.read(n_bits_width) + ref_width;
+    bits.alignToByte();
+
+    for (int igrp = 0; igrp < n_groups; igrp++) group_lengths[igrp] = bits.read(n_bits_length) * length_increment + ref_length;
+    bits.alignToByte();
+    if (n_groups > 0) group_lengths[n_groups - 1] = last_length;
+
+    // Check the group lengths before writing anything
+    size_t n_total = 0;
+    for (int igrp = 0; igrp < n_groups; igrp++) n_total += group_lengths[igrp];
+    if (n_total != field.n_values) throw std::invalid_argument("GRIB2 complex packing groups don't add up to the number of values");
+
+    const uint32_t missing_ref = n_bits > 0 && n_bits < 32 ? (1u << n_bits) - 1 : 0xffffffffu;
+    int ival = 0;
+
+    for (int igrp = 0; igrp < n_groups; igrp++) {
+        const uint32_t ref = group_refs[igrp];
+        const int width = group_widths[igrp];
+
+        if (width == 0) {
+            // Constant group. With missing value management, a reference of all ones (or all ones minus 1) means the whole group is missing.
+            const bool missing = missing_mgmt > 0 && (ref == missing_ref || (missing_mgmt == 2 && ref == missing_ref - 1));
+            std::fill(values.begin() + ival, values.begin() + ival + group_lengths[igrp], missing ? NAN : static_cast<float>(ref));
+            ival += group_lengths[igrp];
+            continue;
+        }
+
+        const uint32_t missing_val = width < 32 ? (1u << width) - 1 : 0xffffffffu;
+        for (uint32_t ipt = 0; ipt < group_lengths[igrp]; ipt++) {
+            const uint32_t packed = bits.read(width);
+            const bool missing = missing_mgmt > 0 && (packed == missing_val || (missing_mgmt == 2 && packed == missing_val - 1));
+            values[ival++] = missing ? NAN : static_cast<float>(ref + packed);
+        }
+    }
+
+    if (sd_order == 0) return;
+
+    // Undo the spatial differencing, which runs over the non-missing values only. Integers are exact in double up to 2^53, which float
+    //  isn't, so accumulate in double.
+    double prev1 = 0, prev2 = 0;
+    int n_seen = 0;
+    for (int ival = 0; ival < field.n_values; ival++) {
+        if (std::isnan(values[ival])) continue;
+
+        double val;
+        if (n_seen < sd_order) {
+            val = sd_init[n_seen];
+        }
+        else if (sd_order == 1) {
+            val = values[ival] + sd_min + prev1;
+        }
+        else {
+            val = values[ival] + sd_min + 2 * prev1 - prev2;
+        }
+
+        values[ival] = val;
+        prev2 = prev1;
+        prev1 = val;
+        n_seen++;
+    }
+}
+
+// Unpack template 5.41 (PNG). Returns the unscaled packed integers.
+static void unpackPNG(const Grib2Field& field, std::vector<float>& values) {
+    std::vector<uint8_t> rows;
+    int width, height, bits_per_pixel;
+    size_t row_bytes;
+    decodePNG(field.data, field.data_length, rows, width, height, bits_per_pixel, row_bytes);
+
+    if (static_cast<size_t>(width) * height < field.n_values) throw std::invalid_argument("PNG image is smaller than the number of GRIB2 values");
+
+    // Rows are padded to a whole number of bytes, so start reading each row at its first byte
+    int ival = 0;
+    for (int irow = 0; irow < height && ival < field.n_values; irow++) {
+        BitReader bits(rows.data() + irow * row_bytes, row_bytes);
+        for (int icol = 0; icol < width && ival < field.n_values; icol++) {
+            values[ival++] = bits.read(bits_per_pixel);
+        }
+    }
+}
+
+template<typename T>
+void decodeGrib2Field(const Grib2Field& field, T* out) {
+    const uint8_t* drs = field.data_rep;
+    if (drs == NULL || field.data == NULL) throw std::invalid_argument("GRIB2 field is missing its data sections");
+
+    // All the supported templates start with the same scaling parameters
+    const float ref_val = readFloat(drs + 11);
+    const int bin_scale = readSignMagnitude(drs + 15, 2);
+    const int dec_scale = readSignMagnitude(drs + 17, 2);
+    const int n_bits = drs[19];
+
+    std::vector<float> values(field.n_values);
+
+    switch (field.data_template) {
+        case 0: unpackSimple(field, n_bits, values); break;
+        case 2: case 3: unpackComplex(field, n_bits, values); break;
+        // With no bits per value, every value is the reference value, and the data section can be empty (as for simple packing)
+        case 41: if (n_bits > 0) unpackPNG(field, values); break;
+        default: throw std::invalid_argument("GRIB2 data representation template 5." + std::to_string(field.data_template) + " isn't supported");
+    }
+
+    // Y * 10^D = R + X * 2^E
+    const double bin_fac = ldexp(1., bin_scale);
+    const double dec_fac = pow(10., -dec_scale);
+    for (int ival = 0; ival < field.n_values; ival++) {
+        values[ival] = (ref_val + values[ival] * bin_fac) * dec_fac;
+    }
+
+    // Spread the values out over the grid points in the bitmap
+    std::vector<float> grid(field.n_points);
+    if (field.bitmap != NULL) {
+        int ival = 0;
+        for (int ipt = 0; ipt < field.n_points; ipt++) {
+            const bool present = (field.bitmap[ipt >> 3] >> (7 - (ipt & 7))) & 1;
+            if (present && ival >= field.n_values) throw std::invalid_argument("GRIB2 bitmap has more points than there are values");
+            grid[ipt] = present ? values[ival++] : NAN;
+        }
+    }
+    else {
+        if (field.n_values != field.n_points) throw std::invalid_argument("GRIB2 field has no bitmap, but the number of values doesn't match the grid");
+        grid.swap(values);
+    }
+
+    const int ni = field.ni, nj = field.nj;
+    if (ni <= 0 || nj <= 0 || ni * nj != field.n_points) {
+        std::copy(grid.begin(), grid.end(), out);
+        return;
+    }
+
+    // Reorder from the scanning mode to rows going west to east, starting at the south. Bit 0x80 means i goes west, 0x40 means j goes
+    //  north, 0x20 means the points are in columns, and 0x10 means every other row goes in the opposite direction.
+    const bool i_west = field.scan_mode & 0x80;
+    const bool j_north = field.scan_mode & 0x40;
+    const bool columns = field.scan_mode & 0x20;
+    const bool alternating = field.scan_mode & 0x10;
+    const int n_fast = columns ? nj : ni;
+    const int n_slow = columns ? ni : nj;
+
+    for (int islow = 0; islow < n_slow; islow++) {
+        for (int ifast = 0; ifast < n_fast; ifast++) {
+            const int ifast_scan = (alternating && (islow & 1)) ? n_fast - 1 - ifast : ifast;
+            const int i_scan = columns ? islow : ifast_scan;
+            const int j_scan = columns ? ifast_scan : islow;
+
+            const int i = i_west ? ni - 1 - i_scan : i_scan;
+            const int j = j_north ? j_scan : nj - 1 - j_scan;
+            out[i + j * ni] = grid[ifast + islow * n_fast];
+        }
+    }
+}
+
+template void decodeGrib2Field(const Grib2Field& field, float* out);
+template void decodeGrib2Field(const Grib2Field& field, float16_t* out);
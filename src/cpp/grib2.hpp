@@ -0,0 +1,38 @@
+
+#ifndef __AUTUMNPLOT_GRIB2_H__
+#define __AUTUMNPLOT_GRIB2_H__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// One field in a GRIB2 message. The section pointers point into the message, so the message has to stick around until the field is decoded.
+struct Grib2Field {
+    int discipline;
+    int grid_template;
+    int n_points;
+    int ni;
+    int nj;
+    int scan_mode;
+    int data_template;
+    int n_values;
+
+    const uint8_t* data_rep;
+    size_t data_rep_length;
+    const uint8_t* bitmap;
+    const uint8_t* data;
+    size_t data_length;
+};
+
+// Find field number field_index (counting from 0) in a GRIB2 message. ni and nj are filled in for the grid templates that have them
+//  (3.0, 3.10, 3.20, 3.30, 3.40, and 3.90), and are 0 otherwise.
+Grib2Field findGrib2Field(const uint8_t* msg, const size_t length, const int field_index);
+
+// Decode a field packed with data representation template 5.0 (simple packing), 5.2 or 5.3 (complex packing, optionally with spatial
+//  differencing), or 5.41 (PNG) into out, which must have room for field.n_points values. Missing points (from the bitmap or the complex
+//  packing missing value management) are NaN. If the grid dimensions are known, the output is reordered to start at the lower-left
+//  corner and go along rows, like every other grid in autumnplot-gl.
+template<typename T>
+void decodeGrib2Field(const Grib2Field& field, T* out);
+
+#endif
@@ -0,0 +1,170 @@
+#include <cmath>
+#include <algorithm>
+
+#include "gridfilter.hpp"
+#include "float16_t.hpp"
+
+using numeric::float16_t;
+
+// Convolve the grid with a separable kernel, leaving out missing points. The loops over i are innermost in both passes so they 
+//  vectorize.
+template<typename T>
+static void separableFilter(const T* grid, const int nx, const int ny, const std::vector<float>& kernel, float* out) {
+    const int radius = kernel.size() / 2;
+
+    // Weighted sums of the values and of the weights (the denominator), so missing points don't count toward the average
+    std::vector<float> num_x(nx * ny, 0.), den_x(nx * ny, 0.);
+    std::vector<float> vals(nx), mask(nx);
+
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            const float val = grid[i + j * nx];
+            mask[i] = std::isnan(val) ? 0. : 1.;
+            vals[i] = std::isnan(val) ? 0. : val;
+        }
+
+        float* num_row = num_x.data() + j * nx;
+        float* den_row = den_x.data() + j * nx;
+
+        for (int k = -radius; k <= radius; k++) {
+            const float weight = kernel[k + radius];
+            const int i_start = std::max(0, -k), i_end = std::min(nx, nx - k);
+
+            for (int i = i_start; i < i_end; i++) {
+                num_row[i] += weight * vals[i + k];
+                den_row[i] += weight * mask[i + k];
+            }
+        }
+    }
+
+    std::vector<float> num(nx), den(nx);
+
+    for (int j = 0; j < ny; j++) {
+        std::fill(num.begin(), num.end(), 0.);
+        std::fill(den.begin(), den.end(), 0.);
+
+        const int k_start = std::max(-radius, -j), k_end = std::min(radius, ny - 1 - j);
+        for (int k = k_start; k <= k_end; k++) {
+            const float weight = kernel[k + radius];
+            const float* num_row = num_x.data() + (j + k) * nx;
+            const float* den_row = den_x.data() + (j + k) * nx;
+
+            for (int i = 0; i < nx; i++) {
+                num[i] += weight * num_row[i];
+                den[i] += weight * den_row[i];
+            }
+        }
+
+        for (int i = 0; i < nx; i++) {
+            const int idx = i + j * nx;
+            out[idx] = (std::isnan(static_cast<float>(grid[idx])) || den[i] == 0) ? NAN : num[i] / den[i];
+        }
+    }
+}
+
+template<typename T>
+void gaussianSmooth(const T* grid, const int nx, const int ny, const float sigma, float* out) {
+    const int radius = std::max(1, (int)ceil(3 * sigma));
+    std::vector<float> kernel(2 * radius + 1);
+
+    for (int k = -radius; k <= radius; k++) {
+        kernel[k + radius] = exp(-0.5 * k * k / (sigma * sigma));
+    }
+
+    separableFilter(grid, nx, ny, kernel, out);
+}
+
+template<typename T>
+void boxSmooth(const T* grid, const int nx, const int ny, const int radius, float* out) {
+    std::vector<float> kernel(2 * radius + 1, 1.);
+    separableFilter(grid, nx, ny, kernel, out);
+}
+
+template<typename T>
+void decimateGrid(const T* grid, const int nx, const int ny, const int factor, float* out) {
+    const int nx_out = (nx + factor - 1) / factor;
+    const int ny_out = (ny + factor - 1) / factor;
+
+    std::vector<float> sums(nx_out), counts(nx_out);
+
+    for (int j_out = 0; j_out < ny_out; j_out++) {
+        std::fill(sums.begin(), sums.end(), 0.);
+        std::fill(counts.begin(), counts.end(), 0.);
+
+        for (int j = j_out * factor; j < std::min(ny, (j_out + 1) * factor); j++) {
+            for (int i = 0; i < nx; i++) {
+                const float val = grid[i + j * nx];
+                if (std::isnan(val)) continue;
+
+                sums[i / factor] += val;
+                counts[i / factor] += 1;
+            }
+        }
+
+        for (int i_out = 0; i_out < nx_out; i_out++) {
+            out[i_out + j_out * nx_out] = counts[i_out] == 0 ? NAN : sums[i_out] / counts[i_out];
+        }
+    }
+}
+
+template<typename T>
+void decimateGridExtrema(const T* grid, const int nx, const int ny, const int factor, float* out) {
+    const int nx_out = (nx + factor - 1) / factor;
+    const int ny_out = (ny + factor - 1) / factor;
+
+    std::vector<float> sums(nx_out), counts(nx_out), mins(nx_out), maxs(nx_out);
+
+    for (int j_out = 0; j_out < ny_out; j_out++) {
+        std::fill(sums.begin(), sums.end(), 0.);
+        std::fill(counts.begin(), counts.end(), 0.);
+        std::fill(mins.begin(), mins.end(), INFINITY);
+        std::fill(maxs.begin(), maxs.end(), -INFINITY);
+
+        for (int j = j_out * factor; j < std::min(ny, (j_out + 1) * factor); j++) {
+            for (int i = 0; i < nx; i++) {
+                const float val = grid[i + j * nx];
+                if (std::isnan(val)) continue;
+
+                const int i_out = i / factor;
+                sums[i_out] += val;
+                counts[i_out] += 1;
+                mins[i_out] = std::min(mins[i_out], val);
+                maxs[i_out] = std::max(maxs[i_out], val);
+            }
+        }
+
+        for (int i_out = 0; i_out < nx_out; i_out++) {
+            if (counts[i_out] == 0) {
+                out[i_out + j_out * nx_out] = NAN;
+                continue;
+            }
+
+            const float mean = sums[i_out] / counts[i_out];
+            out[i_out + j_out * nx_out] = maxs[i_out] - mean > mean - mins[i_out] ? maxs[i_out] : mins[i_out];
+        }
+    }
+}
+
+void decimateCoords(const float* coords, const int n, const int factor, float* out) {
+    const int n_out = (n + factor - 1) / factor;
+
+    for (int i_out = 0; i_out < n_out; i_out++) {
+        const int i_end = std::min(n, (i_out + 1) * factor);
+        float sum = 0;
+
+        for (int i = i_out * factor; i < i_end; i++) {
+            sum += coords[i];
+        }
+
+        out[i_out] = sum / (i_end - i_out * factor);
+    }
+}
+
+template void gaussianSmooth(const float* grid, const int nx, const int ny, const float sigma, float* out);
+template void gaussianSmooth(const float16_t* grid, const int nx, const int ny, const float sigma, float* out);
+template void boxSmooth(const float* grid, const int nx, const int ny, const int radius, float* out);
+template void boxSmooth(const float16_t* grid, const int nx, const int ny, const int radius, float* out);
+template void decimateGrid(const float* grid, const int nx, const int ny, const int factor, float* out);
+template void decimateGrid(const float16_t* grid, const int nx, const int ny, const int factor, float* out);
+template void decimateGridExtrema(const float* grid, const int nx, const int ny, const int factor, float* out);
+template void decimateGridExtrema(const float16_t* grid, const int nx, const int ny, const int factor, float* out);
@@ -0,0 +1,29 @@
+
+#ifndef __AUTUMNPLOT_GRIDFILTER_H__
+#define __AUTUMNPLOT_GRIDFILTER_H__
+
+#include <vector>
+
+// Smooth an nx x ny grid with a separable Gaussian filter with standard deviation sigma (in grid points). Missing (NaN) points are left 
+//  out of the weighted average and stay missing in the output.
+template<typename T>
+void gaussianSmooth(const T* grid, const int nx, const int ny, const float sigma, float* out);
+
+// Same as gaussianSmooth(), but with a (2 * radius + 1) x (2 * radius + 1) box filter
+template<typename T>
+void boxSmooth(const T* grid, const int nx, const int ny, const int radius, float* out);
+
+// Decimate an nx x ny grid by averaging factor x factor blocks, leaving out missing points. A block is only missing in the output if all 
+//  its points are. The output is (nx + factor - 1) / factor x (ny + factor - 1) / factor.
+template<typename T>
+void decimateGrid(const T* grid, const int nx, const int ny, const int factor, float* out);
+
+// Same as decimateGrid(), but each block keeps whichever of its minimum or maximum is farther from the block mean, so isolated highs and 
+//  lows survive the decimation instead of being averaged away.
+template<typename T>
+void decimateGridExtrema(const T* grid, const int nx, const int ny, const int factor, float* out);
+
+// Decimate a 1D coordinate array to go with decimateGrid()
+void decimateCoords(const float* coords, const int n, const int factor, float* out);
+
+#endif
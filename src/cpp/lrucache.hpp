@@ -0,0 +1,58 @@
+
+#ifndef __AUTUMNPLOT_LRUCACHE_H__
+#define __AUTUMNPLOT_LRUCACHE_H__
+
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+// A cache that holds a bounded number of values, evicting the least recently used one when it's full
+template<typename K, typename V>
+class LRUCache {
+    typedef std::list<std::pair<K, V>> entry_list_t;
+
+    size_t capacity;
+    entry_list_t entries;
+    std::unordered_map<K, typename entry_list_t::iterator> entries_by_key;
+
+    public:
+    LRUCache(size_t capacity) : capacity(capacity) {}
+
+    // Returns NULL if the key isn't in the cache. The pointer is only good until the next call to put().
+    V* get(const K& key) {
+        auto it = this->entries_by_key.find(key);
+        if (it == this->entries_by_key.end()) return NULL;
+
+        this->entries.splice(this->entries.begin(), this->entries, it->second);
+        return &(it->second->second);
+    }
+
+    V& put(const K& key, V&& value) {
+        auto it = this->entries_by_key.find(key);
+        if (it != this->entries_by_key.end()) {
+            this->entries.erase(it->second);
+            this->entries_by_key.erase(it);
+        }
+
+        this->entries.emplace_front(key, std::move(value));
+        this->entries_by_key[key] = this->entries.begin();
+
+        while (this->entries.size() > this->capacity) {
+            this->entries_by_key.erase(this->entries.back().first);
+            this->entries.pop_back();
+        }
+
+        return this->entries.front().second;
+    }
+
+    size_t size() const {
+        return this->entries.size();
+    }
+
+    void clear() {
+        this->entries.clear();
+        this->entries_by_key.clear();
+    }
+};
+
+#endif
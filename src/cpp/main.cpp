@@ -2,73 +2,372 @@
 #include <chrono>
 #include <iostream>
 #include <cmath>
+#include <string>
+#include <typeinfo>
 
 #include <emscripten/bind.h>
 
 #include "float16_t.hpp"
 #include "marchingsquares.hpp"
 #include "map.hpp"
+#include "lrucache.hpp"
+#include "geometry.hpp"
+#include "thinning.hpp"
+#include "spatialindex.hpp"
+#include "expression.hpp"
+#include "vectorfield.hpp"
+#include "gridfilter.hpp"
+#include "grib2.hpp"
+#include "contourcodec.hpp"
+#include "tiledcontours.hpp"
+#include "contourindex.hpp"
+#include "ensemble.hpp"
 
 using numeric::float16_t;
 
+template<typename T>
+emscripten::val makeTypedArray(const std::vector<T>& vec, const char* array_type) {
+    auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
+    emscripten::val memview = emscripten::val::global(array_type).new_(memory, reinterpret_cast<uintptr_t>(vec.data()), vec.size());
+
+    // Copy out of the WASM heap, as the vector is going away (and the heap may get reallocated)
+    return memview.call<emscripten::val>("slice");
+}
+
+emscripten::val makeFloat32Array(const std::vector<float>& vec) {
+    return makeTypedArray(vec, "Float32Array");
+}
+
+emscripten::val makeUint8Array(const std::vector<uint8_t>& vec) {
+    return makeTypedArray(vec, "Uint8Array");
+}
+
+emscripten::val makeInt32Array(const std::vector<int>& vec) {
+    return makeTypedArray(vec, "Int32Array");
+}
+
+// Copy a typed array from JS into the WASM heap
+template<typename T>
+std::vector<T> copyArrayFromJS(const emscripten::val& ary, size_t n) {
+    auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
+
+    std::vector<T> vec(n);
+    auto memview = ary["constructor"].new_(memory, reinterpret_cast<uintptr_t>(vec.data()), n);
+    memview.call<void>("set", ary);
+
+    return vec;
+}
+
+// Buffers in the WASM heap for the grids and coordinates passed to the contouring functions. These are kept between calls, so contouring
+//  grids of the same size over and over doesn't allocate once they've grown to the largest grid they've seen.
+struct ContourStaging {
+    std::vector<float> xs;
+    std::vector<float> ys;
+    std::vector<float> data_float32;
+    std::vector<float16_t> data_float16;
+
+    template<typename T>
+    std::vector<T>& data() {
+        if constexpr (std::is_same_v<T, float>) {
+            return this->data_float32;
+        }
+        else {
+            return this->data_float16;
+        }
+    }
+
+    void release() {
+        std::vector<float>().swap(this->xs);
+        std::vector<float>().swap(this->ys);
+        std::vector<float>().swap(this->data_float32);
+        std::vector<float16_t>().swap(this->data_float16);
+    }
+};
+
+static ContourStaging contour_staging;
+
+// Copy a typed array from JS into a staging buffer, growing it if need be
+template<typename T>
+T* stageArrayFromJS(const emscripten::val& ary, size_t n, std::vector<T>& buffer) {
+    if (buffer.size() < n) buffer.resize(n);
+
+    // Get the heap after resizing, as growing the buffer may have grown the heap
+    auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
+    auto memview = ary["constructor"].new_(memory, reinterpret_cast<uintptr_t>(buffer.data()), n);
+    memview.call<void>("set", ary);
+
+    return buffer.data();
+}
+
+void checkGridSize(size_t grid_size, int nx, int ny) {
+    if (nx * ny != grid_size) {
+        std::string error = "Mismatch between the length of the vector and nx and ny";
+        throw std::invalid_argument(error);
+    }
+}
+
+// Run a kernel that fills two arrays, and return them as float32 or as float16 (as the raw bits in a Uint16Array)
+template<typename F>
+emscripten::val makeArrayPair(const char* name_1, const char* name_2, size_t n, bool float16_output, F kernel) {
+    auto pair_obj = emscripten::val::object();
+
+    if (float16_output) {
+        std::vector<float16_t> ary_1(n), ary_2(n);
+        kernel(ary_1.data(), ary_2.data());
+
+        pair_obj.set(name_1, makeTypedArray(ary_1, "Uint16Array"));
+        pair_obj.set(name_2, makeTypedArray(ary_2, "Uint16Array"));
+    }
+    else {
+        std::vector<float> ary_1(n), ary_2(n);
+        kernel(ary_1.data(), ary_2.data());
+
+        pair_obj.set(name_1, makeFloat32Array(ary_1));
+        pair_obj.set(name_2, makeFloat32Array(ary_2));
+    }
+
+    return pair_obj;
+}
+
+struct MapCoords {
+    std::vector<float> xs;
+    std::vector<float> ys;
+};
+
+// Computed coordinates are cached by grid definition, as lots of fields tend to come in on the same few grids. The keys hold the whole 
+//  definition (see StructuredGrid::definitionKey()), so different grids can't collide.
+const size_t GRID_CACHE_SIZE = 8;
+LRUCache<std::string, MapCoords> map_coords_cache(GRID_CACHE_SIZE);
+LRUCache<std::string, std::vector<float>> vector_rotation_cache(GRID_CACHE_SIZE);
+
 template<typename P, typename T>
 class StructuredGrid {
     unsigned int ni, nj;
     T ll_crnr, ur_crnr;
     P projection;
 
+    // Edge coordinates are offset by half a grid spacing from the center coordinates and have one more point in each dimension
+    void getGridCoords(unsigned int n_i, unsigned int n_j, std::vector<float>& is, std::vector<float>& js, bool edge_i=false, bool edge_j=false) const {
+        float start_i, end_i, start_j, end_j;
+
+        if constexpr (is_earth_point<T>) {
+            start_i = this->ll_crnr.lon; end_i = this->ur_crnr.lon;
+            start_j = this->ll_crnr.lat; end_j = this->ur_crnr.lat;
+        }
+        else {
+            start_i = this->ll_crnr.x; end_i = this->ur_crnr.x;
+            start_j = this->ll_crnr.y; end_j = this->ur_crnr.y;
+        }
+
+        if (edge_i && this->ni > 1) {
+            const float di_full = (end_i - start_i) / (this->ni - 1);
+            start_i -= di_full / 2; end_i += di_full / 2;
+        }
+
+        if (edge_j && this->nj > 1) {
+            const float dj_full = (end_j - start_j) / (this->nj - 1);
+            start_j -= dj_full / 2; end_j += dj_full / 2;
+        }
+
+        is.resize(n_i);
+        js.resize(n_j);
+
+        // A single point goes at the start of the range rather than dividing by zero
+        const float di = n_i > 1 ? (end_i - start_i) / (n_i - 1) : 0;
+        const float dj = n_j > 1 ? (end_j - start_j) / (n_j - 1) : 0;
+
+        for (int i = 0; i < n_i; i++) {
+            is[i] = start_i + i * di;
+        }
+
+        for (int j = 0; j < n_j; j++) {
+            js[j] = start_j + j * dj;
+        }
+    }
+
     public:
     StructuredGrid(unsigned int ni, unsigned int nj, const T& ll_crnr, const T& ur_crnr, const P& projection) : ni(ni), nj(nj), ll_crnr(ll_crnr), ur_crnr(ur_crnr), projection(projection) {}
     StructuredGrid(const StructuredGrid& other) : ni(other.ni), nj(other.nj), ll_crnr(other.ll_crnr), ur_crnr(other.ur_crnr), projection(other.projection) {}
     
     T getGridCoord(unsigned int i, unsigned int j) const {
         if constexpr (is_earth_point<T>) {
-            const float dlon = (this->ur_crnr.lon - this->ll_crnr.lon) / (this->ni - 1);
-            const float dlat = (this->ur_crnr.lat - this->ll_crnr.lat) / (this->nj - 1);
+            const float dlon = this->ni > 1 ? (this->ur_crnr.lon - this->ll_crnr.lon) / (this->ni - 1) : 0;
+            const float dlat = this->nj > 1 ? (this->ur_crnr.lat - this->ll_crnr.lat) / (this->nj - 1) : 0;
 
-            return T(this->ll_crnr.lon + i * dlon, this->ll_crnr.dlat + j * dlat);
+            return T(this->ll_crnr.lon + i * dlon, this->ll_crnr.lat + j * dlat);
         }
         else {
-            const float dx = (this->ur_crnr.x - this->ll_crnr.x) / this->ni;
-            const float dy = (this->ur_crnr.y - this->ll_crnr.y) / this->nj;
+            const float dx = this->ni > 1 ? (this->ur_crnr.x - this->ll_crnr.x) / (this->ni - 1) : 0;
+            const float dy = this->nj > 1 ? (this->ur_crnr.y - this->ll_crnr.y) / (this->nj - 1) : 0;
 
             return T(this->ll_crnr.x + i * dx, this->ll_crnr.y + j * dy);
         }
     }
 
-    emscripten::val getMapCoords(const emscripten::val& simplify_ni_, const emscripten::val& simplify_nj_) const {
-        const unsigned int simplify_ni = simplify_ni_.as<unsigned int>();
-        const unsigned int simplify_nj = simplify_nj_.as<unsigned int>();
+    // Compute the earth coordinates for an n_i x n_j subset of points spanning the grid
+    void getEarthCoords(unsigned int n_i, unsigned int n_j, std::vector<float>& lons, std::vector<float>& lats, bool edge_i=false, bool edge_j=false) const {
+        std::vector<float> is, js;
+        this->getGridCoords(n_i, n_j, is, js, edge_i, edge_j);
+        this->getEarthCoordsAt(is, js, lons, lats);
+    }
 
-        WebMercator map_crs;
+    // Compute the earth coordinates for the grid points at the outer product of is and js
+    void getEarthCoordsAt(const std::vector<float>& is, const std::vector<float>& js, std::vector<float>& lons, std::vector<float>& lats) const {
+        const unsigned int n_i = is.size();
+        const unsigned int n_j = js.size();
 
-        std::vector<float> xs(this->ni * this->nj);
-        std::vector<float> ys(this->ni * this->nj);
+        lons.resize(n_i * n_j);
+        lats.resize(n_i * n_j);
 
-        for (int i = 0; i < this->ni; i++) {
-            for (int j = 0; j < this->nj; j++) {
-                const int idx = i + ni * j;
-                T grid_coord = this->getGridCoord(i, j);
-                EarthPoint earth_coord = this->projection.transform_inverse(grid_coord);
-                GridPoint map_coord = map_crs.transform(earth_coord);
+        if constexpr (has_grid_transform_inverse<P>) {
+            this->projection.transform_inverse_grid(is.data(), n_i, js.data(), n_j, lons.data(), lats.data());
+        }
+        else {
+            for (int j = 0; j < n_j; j++) {
+                for (int i = 0; i < n_i; i++) {
+                    const int idx = i + n_i * j;
+                    EarthPoint earth_coord = this->projection.transform_inverse(T(is[i], js[j]));
 
-                xs[idx] = map_coord.x;
-                ys[idx] = map_coord.y;
+                    lons[idx] = earth_coord.lon;
+                    lats[idx] = earth_coord.lat;
+                }
             }
         }
+    }
+
+    // Earth coordinates for JS, at the grid points (or the cell edges, which have one more point in that dimension) by default
+    emscripten::val getEarthCoordArrays(const emscripten::val& n_i_, const emscripten::val& n_j_, bool edge_i, bool edge_j) const {
+        const unsigned int n_i = n_i_.isUndefined() ? (edge_i ? this->ni + 1 : this->ni) : n_i_.as<unsigned int>();
+        const unsigned int n_j = n_j_.isUndefined() ? (edge_j ? this->nj + 1 : this->nj) : n_j_.as<unsigned int>();
 
-        auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
-        auto xs_ary = emscripten::val::global("Float32Array").new_(memory, reinterpret_cast<uintptr_t>(xs.data()), xs.size());
-        auto ys_ary = emscripten::val::global("Float32Array").new_(memory, reinterpret_cast<uintptr_t>(ys.data()), ys.size());
+        std::vector<float> lons, lats;
+        this->getEarthCoords(n_i, n_j, lons, lats, edge_i, edge_j);
 
         auto coords_obj = emscripten::val::object();
-        coords_obj.set("x", xs_ary);
-        coords_obj.set("y", ys_ary);
+        coords_obj.set("lons", makeFloat32Array(lons));
+        coords_obj.set("lats", makeFloat32Array(lats));
 
         return coords_obj;
     }
 
-    emscripten::val getVectorRotation() const {
+    // The projection type, size, corners, and projection parameters, as bytes for a cache key
+    std::string definitionKey() const {
+        std::string key(typeid(P).name());
+        key.push_back('\0');
+        appendKeyBytes(key, this->ni);
+        appendKeyBytes(key, this->nj);
+
+        if constexpr (is_earth_point<T>) {
+            appendKeyBytes(key, this->ll_crnr.lon); appendKeyBytes(key, this->ll_crnr.lat);
+            appendKeyBytes(key, this->ur_crnr.lon); appendKeyBytes(key, this->ur_crnr.lat);
+        }
+        else {
+            appendKeyBytes(key, this->ll_crnr.x); appendKeyBytes(key, this->ll_crnr.y);
+            appendKeyBytes(key, this->ur_crnr.x); appendKeyBytes(key, this->ur_crnr.y);
+        }
+
+        this->projection.appendDefinition(key);
+        return key;
+    }
+
+    const MapCoords& computeMapCoords(unsigned int simplify_ni, unsigned int simplify_nj, bool edge_i=false, bool edge_j=false) const {
+        std::string key = this->definitionKey();
+        appendKeyBytes(key, simplify_ni);
+        appendKeyBytes(key, simplify_nj);
+        appendKeyBytes(key, edge_i);
+        appendKeyBytes(key, edge_j);
+
+        MapCoords* cached = map_coords_cache.get(key);
+        if (cached != NULL) return *cached;
+
+        WebMercator map_crs;
+
+        std::vector<float> lons, lats;
+        this->getEarthCoords(simplify_ni, simplify_nj, lons, lats, edge_i, edge_j);
+
+        MapCoords coords;
+        coords.xs.resize(lons.size());
+        coords.ys.resize(lats.size());
+        map_crs.transform(lons.data(), lats.data(), lons.size(), coords.xs.data(), coords.ys.data());
+
+        return map_coords_cache.put(key, std::move(coords));
+    }
+
+    emscripten::val getMapCoords(const emscripten::val& simplify_ni_, const emscripten::val& simplify_nj_) const {
+        const unsigned int simplify_ni = simplify_ni_.isUndefined() ? this->ni : simplify_ni_.as<unsigned int>();
+        const unsigned int simplify_nj = simplify_nj_.isUndefined() ? this->nj : simplify_nj_.as<unsigned int>();
+
+        const MapCoords& coords = this->computeMapCoords(simplify_ni, simplify_nj);
+
+        auto coords_obj = emscripten::val::object();
+        coords_obj.set("x", makeFloat32Array(coords.xs));
+        coords_obj.set("y", makeFloat32Array(coords.ys));
+
+        return coords_obj;
+    }
+
+    // Make the triangle strips for drawing the domain, keeping only as many rows and columns as are needed for the mesh to be within
+    //  pixel_tolerance pixels of the true projected positions at the given zoom.
+    emscripten::val getAdaptiveDomainBuffers(bool margin_r, bool margin_s, float pixel_tolerance, float zoom) const {
+        const float texcoord_margin_r = margin_r ? 1. / (2 * this->ni) : 0;
+        const float texcoord_margin_s = margin_s ? 1. / (2 * this->nj) : 0;
+
+        const unsigned int domain_ni = margin_r ? this->ni : this->ni + 1;
+        const unsigned int domain_nj = margin_s ? this->nj : this->nj + 1;
+
+        std::vector<float> is, js;
+        this->getGridCoords(domain_ni, domain_nj, is, js, !margin_r, !margin_s);
+
+        WebMercator map_crs;
+        auto mapCoord = [&](float grid_i, float grid_j) {
+            EarthPoint earth_coord = this->projection.transform_inverse(T(grid_i, grid_j));
+            if (std::isnan(earth_coord.lon) || std::isnan(earth_coord.lat)) return GridPoint(NAN, NAN);
+            return map_crs.transform(earth_coord);
+        };
+
+        // Map coordinates are in units of the width of the world, which is 512 pixels at zoom 0
+        const float tolerance = pixel_tolerance / (512 * pow(2, zoom));
+
+        std::vector<int> keep_is, keep_js;
+        refineDomainIndices([&](int i, int j) { return mapCoord(is[i], js[j]); }, domain_ni, domain_nj, tolerance, keep_is);
+        refineDomainIndices([&](int j, int i) { return mapCoord(is[i], js[j]); }, domain_nj, domain_ni, tolerance, keep_js);
+
+        std::vector<float> sub_is(keep_is.size()), sub_js(keep_js.size());
+        std::vector<float> tex_coords_r(keep_is.size()), tex_coords_s(keep_js.size());
+
+        for (int ii = 0; ii < keep_is.size(); ii++) {
+            sub_is[ii] = is[keep_is[ii]];
+            tex_coords_r[ii] = (float)keep_is[ii] / (domain_ni - 1) * (1 - 2 * texcoord_margin_r) + texcoord_margin_r;
+        }
+
+        for (int jj = 0; jj < keep_js.size(); jj++) {
+            sub_js[jj] = js[keep_js[jj]];
+            tex_coords_s[jj] = (float)keep_js[jj] / (domain_nj - 1) * (1 - 2 * texcoord_margin_s) + texcoord_margin_s;
+        }
+
+        std::vector<float> lons, lats;
+        this->getEarthCoordsAt(sub_is, sub_js, lons, lats);
+
+        std::vector<float> map_xs(lons.size()), map_ys(lats.size());
+        map_crs.transform(lons.data(), lats.data(), lons.size(), map_xs.data(), map_ys.data());
+
+        std::vector<float> verts, tex_coords;
+        makeDomainVerticesAndTexCoords(map_xs.data(), map_ys.data(), sub_is.size(), sub_js.size(), tex_coords_r.data(), tex_coords_s.data(), 
+                                       verts, tex_coords);
+
+        auto domain_obj = emscripten::val::object();
+        domain_obj.set("vertices", makeFloat32Array(verts));
+        domain_obj.set("tex_coords", makeFloat32Array(tex_coords));
+
+        return domain_obj;
+    }
+
+    const std::vector<float>& computeVectorRotation() const {
+        const std::string key = this->definitionKey();
+
+        std::vector<float>* cached = vector_rotation_cache.get(key);
+        if (cached != NULL) return *cached;
+
         std::vector<float> rot_vals(this->ni * this->nj);
 
         for (int i = 0; i < this->ni; i++) {
@@ -88,70 +387,174 @@ class StructuredGrid {
             }
         }
 
-        auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
-        auto ary = emscripten::val::global("Float32Array").new_(memory, reinterpret_cast<uintptr_t>(rot_vals.data()), rot_vals.size());
+        return vector_rotation_cache.put(key, std::move(rot_vals));
+    }
+
+    emscripten::val getVectorRotation() const {
+        return makeFloat32Array(this->computeVectorRotation());
+    }
+
+    // Rotate grid-relative u and v on this grid to earth-relative
+    template<typename U>
+    emscripten::val getEarthRelativeVectors(const emscripten::val& u, const emscripten::val& v, bool float16_output) const {
+        checkGridSize(u["length"].as<int>(), this->ni, this->nj);
+        checkGridSize(v["length"].as<int>(), this->ni, this->nj);
+
+        const int n = this->ni * this->nj;
+        std::vector<U> u_ary = copyArrayFromJS<U>(u, n);
+        std::vector<U> v_ary = copyArrayFromJS<U>(v, n);
+        const std::vector<float>& rot = this->computeVectorRotation();
+
+        return makeArrayPair("u", "v", n, float16_output, [&](auto* u_earth, auto* v_earth) {
+            rotateVectorsToEarth(u_ary.data(), v_ary.data(), rot.data(), n, u_earth, v_earth);
+        });
+    }
+
+    // Compute the speed and meteorological direction of u and v on this grid
+    template<typename U>
+    emscripten::val getVectorSpeedDirection(const emscripten::val& u, const emscripten::val& v, bool data_are_earth_relative, bool float16_output) const {
+        checkGridSize(u["length"].as<int>(), this->ni, this->nj);
+        checkGridSize(v["length"].as<int>(), this->ni, this->nj);
 
-        return ary;
+        const int n = this->ni * this->nj;
+        std::vector<U> u_ary = copyArrayFromJS<U>(u, n);
+        std::vector<U> v_ary = copyArrayFromJS<U>(v, n);
+        const float* rot = data_are_earth_relative ? NULL : this->computeVectorRotation().data();
+
+        return makeArrayPair("speed", "direction", n, float16_output, [&](auto* speed, auto* direction) {
+            vectorSpeedDirection(u_ary.data(), v_ary.data(), rot, n, speed, direction);
+        });
     }
 };
 
+class PlateCarreeGrid : public StructuredGrid<PlateCarree, EarthPoint> {
+    public:
+    PlateCarreeGrid(unsigned int ni, unsigned int nj, float ll_lon, float ll_lat, float ur_lon, float ur_lat)
+        : StructuredGrid(ni, nj, EarthPoint(ll_lon, ll_lat), EarthPoint(ur_lon, ur_lat), PlateCarree()) {}
+};
+
 class LambertGrid : public StructuredGrid<LambertConformalConic, GridPoint> {
     public:
     LambertGrid(unsigned int ni, unsigned int nj, float lon_0, float lat_0, float lat_std_1, float lat_std_2,
-                float ll_x, float ll_y, float ur_x, float ur_y) : StructuredGrid(ni, nj, GridPoint(ll_x, ll_y), GridPoint(ur_x, ur_y),
-                                                                                 LambertConformalConic(lon_0, lat_0, lat_std_1, lat_std_2)) {}
+                float ll_x, float ll_y, float ur_x, float ur_y, bool fast_math=false) : StructuredGrid(ni, nj, GridPoint(ll_x, ll_y), GridPoint(ur_x, ur_y),
+                                                                                 LambertConformalConic(lon_0, lat_0, lat_std_1, lat_std_2, fast_math)) {}
 };
 
-void checkGridSize(size_t grid_size, int nx, int ny) {
-    if (nx * ny != grid_size) {
-        std::string error = "Mismatch between the length of the vector and nx and ny";
-        throw std::invalid_argument(error);
+class GeostationaryGrid : public StructuredGrid<Geostationary, GridPoint> {
+    public:
+    GeostationaryGrid(unsigned int ni, unsigned int nj, float ll_x, float ll_y, float ur_x, float ur_y, float satellite_lon) 
+        : StructuredGrid(ni, nj, GridPoint(ll_x, ll_y), GridPoint(ur_x, ur_y), Geostationary(satellite_lon)) {}
+};
+
+class RadarSweepGrid : public StructuredGrid<RadarSweep, GridPoint> {
+    public:
+    RadarSweepGrid(unsigned int nr, unsigned int nt, float start_rn, float end_rn, float start_az, float end_az, float longitude, float latitude)
+        : StructuredGrid(nr, nt, GridPoint(start_rn, start_az), GridPoint(end_rn, end_az), RadarSweep(longitude, latitude)) {}
+};
+
+// A spatial index over a set of points in map coordinates. Query points are given as longitudes and latitudes, and distances are in map 
+//  units (fractions of the width of the world).
+class MapPointIndex {
+    PointIndex* index;
+    WebMercator map_crs;
+
+    GridPoint toMapCoords(float lon, float lat) const {
+        return this->map_crs.transform(EarthPoint(lon, lat));
     }
-}
 
-template<typename T>
-emscripten::val makeContoursWASM(const emscripten::val& data, const emscripten::val& xs, const emscripten::val& ys, const emscripten::val& values,
-                                 const emscripten::val& quad_as_tri_) {
-    auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
+    public:
+    MapPointIndex(const emscripten::val& lons, const emscripten::val& lats) {
+        const int n_pts = lons["length"].as<int>();
+        checkGridSize(lats["length"].as<int>(), n_pts, 1);
 
-    int nx = xs["length"].as<int>();
-    int ny = ys["length"].as<int>();
+        std::vector<float> lons_ary = copyArrayFromJS<float>(lons, n_pts);
+        std::vector<float> lats_ary = copyArrayFromJS<float>(lats, n_pts);
 
-    checkGridSize(data["length"].as<int>(), nx, ny);
+        std::vector<float> xs(n_pts), ys(n_pts);
+        this->map_crs.transform(lons_ary.data(), lats_ary.data(), n_pts, xs.data(), ys.data());
 
-    auto t0 = std::chrono::steady_clock::now();
-    float* xs_ary = new float[nx];
-    auto xs_memview = xs["constructor"].new_(memory, reinterpret_cast<uintptr_t>(xs_ary), nx);
-    xs_memview.call<void>("set", xs);
+        this->index = new PointIndex(xs.data(), ys.data(), n_pts);
+    }
+
+    MapPointIndex(const MapPointIndex& other) = delete;
 
-    float* ys_ary = new float[ny];
-    auto ys_memview = ys["constructor"].new_(memory, reinterpret_cast<uintptr_t>(ys_ary), ny);
-    ys_memview.call<void>("set", ys);
+    ~MapPointIndex() {
+        delete this->index;
+    }
 
-    T* data_ary = new T[nx * ny];
-    auto data_memview = data["constructor"].new_(memory, reinterpret_cast<uintptr_t>(data_ary), nx * ny);
-    data_memview.call<void>("set", data);
+    // Get the index of the nearest point to each query point, or -1 if there's no point within max_dist
+    emscripten::val nearest(const emscripten::val& lons, const emscripten::val& lats, const emscripten::val& max_dist_) const {
+        const int n_query = lons["length"].as<int>();
+        checkGridSize(lats["length"].as<int>(), n_query, 1);
 
-    int n_levels = values["length"].as<int>();
-    std::vector<float> levels(n_levels, 0);
-    for (int ilev = 0; ilev < n_levels; ilev++) {
-        levels[ilev] = values[ilev].as<float>();
+        const float max_dist = max_dist_.isUndefined() ? INFINITY : max_dist_.as<float>();
+
+        std::vector<float> lons_ary = copyArrayFromJS<float>(lons, n_query);
+        std::vector<float> lats_ary = copyArrayFromJS<float>(lats, n_query);
+
+        std::vector<int> result(n_query);
+        for (int iqry = 0; iqry < n_query; iqry++) {
+            const GridPoint pt = this->toMapCoords(lons_ary[iqry], lats_ary[iqry]);
+            result[iqry] = this->index->nearest(pt.x, pt.y, max_dist);
+        }
+
+        return makeInt32Array(result);
     }
 
-    bool quad_as_tri = quad_as_tri_.as<bool>();
+    // Get the indices of the points within radius of each query point. The indices for query point i are indices[offsets[i]:offsets[i + 1]].
+    emscripten::val within(const emscripten::val& lons, const emscripten::val& lats, float radius) const {
+        const int n_query = lons["length"].as<int>();
+        checkGridSize(lats["length"].as<int>(), n_query, 1);
 
-    auto t1 = std::chrono::steady_clock::now();
+        std::vector<float> lons_ary = copyArrayFromJS<float>(lons, n_query);
+        std::vector<float> lats_ary = copyArrayFromJS<float>(lats, n_query);
 
-    std::vector<Contour> contours = makeContours(data_ary, xs_ary, ys_ary, nx, ny, levels, quad_as_tri);
+        std::vector<int> offsets(n_query + 1, 0);
+        std::vector<int> indices, query_result;
 
-    auto t2 = std::chrono::steady_clock::now();
- 
-    delete[] xs_ary;
-    delete[] ys_ary;
-    delete[] data_ary;
+        for (int iqry = 0; iqry < n_query; iqry++) {
+            const GridPoint pt = this->toMapCoords(lons_ary[iqry], lats_ary[iqry]);
+            this->index->within(pt.x, pt.y, radius, query_result);
 
-    auto t3 = std::chrono::steady_clock::now();
+            indices.insert(indices.end(), query_result.begin(), query_result.end());
+            offsets[iqry + 1] = indices.size();
+        }
+
+        auto result_obj = emscripten::val::object();
+        result_obj.set("offsets", makeInt32Array(offsets));
+        result_obj.set("indices", makeInt32Array(indices));
+
+        return result_obj;
+    }
+
+    // Get the indices of the points in a lat/lon bounding box
+    emscripten::val range(float ll_lon, float ll_lat, float ur_lon, float ur_lat) const {
+        // y increases southward in map coordinates
+        const GridPoint ll = this->toMapCoords(ll_lon, ll_lat);
+        const GridPoint ur = this->toMapCoords(ur_lon, ur_lat);
+
+        std::vector<int> result;
+        this->index->range(ll.x, ur.y, ur.x, ll.y, result);
+
+        return makeInt32Array(result);
+    }
 
+    unsigned int size() const {
+        return this->index->size();
+    }
+};
+
+std::vector<float> unpackLevels(const emscripten::val& values) {
+    int n_levels = values["length"].as<int>();
+    std::vector<float> levels(n_levels, 0);
+    for (int ilev = 0; ilev < n_levels; ilev++) {
+        levels[ilev] = values[ilev].as<float>();
+    }
+
+    return levels;
+}
+
+emscripten::val packContours(const std::vector<Contour>& contours) {
     emscripten::val js_contours = emscripten::val::object();
     std::unordered_map<float, int> js_contours_added;
 
@@ -170,18 +573,635 @@ emscripten::val makeContoursWASM(const emscripten::val& data, const emscripten::
             js_contours[value][contour_index].call<void>("push", emscripten::val::array(std::vector<float>{plit->x, plit->y}));
         }
     }
-    auto t4 = std::chrono::steady_clock::now();
+
+    return js_contours;
+}
+
+// Pack contours that are already encoded (see contourcodec.hpp). If the contours were contoured in a cell box, cut_flags marks the ones that
+//  were cut at the edge of the box.
+emscripten::val packEncodedContours(const EncodedContours& encoded, const std::vector<uint8_t>* cut_flags=nullptr) {
+    emscripten::val js_contours = emscripten::val::object();
+    js_contours.set("x_min", encoded.x_min);
+    js_contours.set("y_min", encoded.y_min);
+    js_contours.set("x_max", encoded.x_max);
+    js_contours.set("y_max", encoded.y_max);
+    js_contours.set("values", makeFloat32Array(encoded.values));
+    js_contours.set("n_points", makeTypedArray(encoded.n_points, "Uint32Array"));
+    js_contours.set("data", makeUint8Array(encoded.data));
+    if (cut_flags != nullptr) js_contours.set("cut_flags", makeUint8Array(*cut_flags));
+
+    return js_contours;
+}
+
+// Pack contours in the quantized, delta-encoded form instead of as nested JS arrays
+emscripten::val packContoursEncoded(const std::vector<Contour>& contours, const std::vector<uint8_t>* cut_flags=nullptr) {
+    return packEncodedContours(encodeContours(contours), cut_flags);
+}
+
+// Unpack encoded contours (as from packEncodedContours()) from JS
+EncodedContours unpackEncodedContours(const emscripten::val& encoded_) {
+    EncodedContours encoded;
+    encoded.x_min = encoded_["x_min"].as<float>();
+    encoded.y_min = encoded_["y_min"].as<float>();
+    encoded.x_max = encoded_["x_max"].as<float>();
+    encoded.y_max = encoded_["y_max"].as<float>();
+
+    const int n_contours = encoded_["values"]["length"].as<int>();
+    checkGridSize(encoded_["n_points"]["length"].as<int>(), n_contours, 1);
+
+    encoded.values = copyArrayFromJS<float>(encoded_["values"], n_contours);
+    encoded.n_points = copyArrayFromJS<uint32_t>(encoded_["n_points"], n_contours);
+    encoded.data = copyArrayFromJS<uint8_t>(encoded_["data"], encoded_["data"]["length"].as<int>());
+
+    return encoded;
+}
+
+// Unpack a cell box ({i_min, j_min, i_max, j_max}) from JS. Returns false if there isn't one. The box is given in cells of the original 
+//  grid, so it's shrunk to match if the grid is decimated.
+bool unpackCellBox(const emscripten::val& box_, const int decimate, CellBox& box) {
+    if (box_.isUndefined() || box_.isNull()) return false;
+
+    box.i_min = box_["i_min"].as<int>() / decimate;
+    box.j_min = box_["j_min"].as<int>() / decimate;
+    box.i_max = box_["i_max"].as<int>() / decimate;
+    box.j_max = box_["j_max"].as<int>() / decimate;
+    return true;
+}
+
+struct GridFilterOpts {
+    float gaussian_sigma;
+    int box_radius;
+    int decimate;
+    bool preserve_extrema;
+
+    bool isActive() const {
+        return this->gaussian_sigma > 0 || this->box_radius > 0 || this->decimate > 1;
+    }
+};
+
+// Unpack the grid filter options ({gaussian_sigma, box_radius, decimate, preserve_extrema}, all optional) from JS
+GridFilterOpts unpackGridFilter(const emscripten::val& filter) {
+    GridFilterOpts opts = {0., 0, 1, false};
+    if (filter.isUndefined() || filter.isNull()) return opts;
+
+    if (!filter["gaussian_sigma"].isUndefined()) opts.gaussian_sigma = filter["gaussian_sigma"].as<float>();
+    if (!filter["box_radius"].isUndefined()) opts.box_radius = filter["box_radius"].as<int>();
+    if (!filter["decimate"].isUndefined()) opts.decimate = std::max(1, filter["decimate"].as<int>());
+    if (!filter["preserve_extrema"].isUndefined()) opts.preserve_extrema = filter["preserve_extrema"].as<bool>();
+
+    return opts;
+}
+
+// Smooth and then decimate a grid before contouring it. Returns the filtered grid, which is nx_out x ny_out.
+template<typename T>
+std::vector<float> applyGridFilter(const T* grid, int nx, int ny, const GridFilterOpts& opts, int& nx_out, int& ny_out) {
+    std::vector<float> smoothed(nx * ny);
+
+    if (opts.gaussian_sigma > 0) {
+        gaussianSmooth(grid, nx, ny, opts.gaussian_sigma, smoothed.data());
+    }
+    else if (opts.box_radius > 0) {
+        boxSmooth(grid, nx, ny, opts.box_radius, smoothed.data());
+    }
+    else {
+        std::copy(grid, grid + nx * ny, smoothed.begin());
+    }
+
+    nx_out = (nx + opts.decimate - 1) / opts.decimate;
+    ny_out = (ny + opts.decimate - 1) / opts.decimate;
+    if (opts.decimate == 1) return smoothed;
+
+    std::vector<float> decimated(nx_out * ny_out);
+    if (opts.preserve_extrema) {
+        decimateGridExtrema(smoothed.data(), nx, ny, opts.decimate, decimated.data());
+    }
+    else {
+        decimateGrid(smoothed.data(), nx, ny, opts.decimate, decimated.data());
+    }
+    return decimated;
+}
+
+template<typename T>
+emscripten::val filterGridWASM(const emscripten::val& data, int nx, int ny, const emscripten::val& filter_) {
+    checkGridSize(data["length"].as<int>(), nx, ny);
+
+    std::vector<T> data_ary = copyArrayFromJS<T>(data, nx * ny);
+    GridFilterOpts filter = unpackGridFilter(filter_);
+
+    int nx_filt, ny_filt;
+    std::vector<float> data_filt = applyGridFilter(data_ary.data(), nx, ny, filter, nx_filt, ny_filt);
+
+    auto filt_obj = emscripten::val::object();
+    filt_obj.set("data", makeFloat32Array(data_filt));
+    filt_obj.set("nx", nx_filt);
+    filt_obj.set("ny", ny_filt);
+
+    return filt_obj;
+}
+
+// Decode a field from a GRIB2 message (a Uint8Array). The data come back as a Float32Array, or for float16, as the raw bits in a Uint16Array.
+template<typename T>
+emscripten::val decodeGrib2WASM(const emscripten::val& msg, int field_index) {
+    size_t length = msg["length"].as<size_t>();
+    std::vector<uint8_t> msg_ary = copyArrayFromJS<uint8_t>(msg, length);
+
+    Grib2Field field = findGrib2Field(msg_ary.data(), length, field_index);
+
+    std::vector<T> data(field.n_points);
+    decodeGrib2Field(field, data.data());
+
+    auto field_obj = emscripten::val::object();
+    if constexpr (std::is_same_v<T, float>) {
+        field_obj.set("data", makeFloat32Array(data));
+    }
+    else {
+        field_obj.set("data", makeTypedArray(data, "Uint16Array"));
+    }
+    field_obj.set("ni", field.ni);
+    field_obj.set("nj", field.nj);
+    field_obj.set("n_points", field.n_points);
+    field_obj.set("grid_template", field.grid_template);
+
+    return field_obj;
+}
+
+template<typename T>
+emscripten::val makeContoursWASM(const emscripten::val& data, const emscripten::val& xs, const emscripten::val& ys, const emscripten::val& values,
+                                 const emscripten::val& quad_as_tri_, const emscripten::val& smooth_, const emscripten::val& filter_,
+                                 const emscripten::val& encode_, const emscripten::val& cell_box_) {
+    int nx = xs["length"].as<int>();
+    int ny = ys["length"].as<int>();
+
+    checkGridSize(data["length"].as<int>(), nx, ny);
+
+    auto t0 = std::chrono::steady_clock::now();
+    const float* xs_ary = stageArrayFromJS(xs, nx, contour_staging.xs);
+    const float* ys_ary = stageArrayFromJS(ys, ny, contour_staging.ys);
+    const T* data_ary = stageArrayFromJS(data, nx * ny, contour_staging.data<T>());
+
+    std::vector<float> levels = unpackLevels(values);
+
+    bool quad_as_tri = quad_as_tri_.as<bool>();
+    int smooth = smooth_.isUndefined() ? 0 : smooth_.as<int>();
+
+    auto t1 = std::chrono::steady_clock::now();
+
+    GridFilterOpts filter = unpackGridFilter(filter_);
+    std::vector<Contour> contours;
+
+    CellBox box;
+    std::vector<uint8_t> cut_flags;
+    const bool has_box = unpackCellBox(cell_box_, filter.isActive() ? filter.decimate : 1, box);
+
+    if (filter.isActive()) {
+        // Contour the filtered grid straight from the WASM heap, rather than sending it back to JS first
+        int nx_filt, ny_filt;
+        std::vector<float> data_filt = applyGridFilter(data_ary, nx, ny, filter, nx_filt, ny_filt);
+
+        std::vector<float> xs_filt(nx_filt), ys_filt(ny_filt);
+        decimateCoords(xs_ary, nx, filter.decimate, xs_filt.data());
+        decimateCoords(ys_ary, ny, filter.decimate, ys_filt.data());
+
+        contours = has_box ? makeContoursInBox(data_filt.data(), xs_filt.data(), ys_filt.data(), nx_filt, ny_filt, levels, quad_as_tri, box, cut_flags)
+                           : makeContours(data_filt.data(), xs_filt.data(), ys_filt.data(), nx_filt, ny_filt, levels, quad_as_tri);
+    }
+    else {
+        contours = has_box ? makeContoursInBox(data_ary, xs_ary, ys_ary, nx, ny, levels, quad_as_tri, box, cut_flags)
+                           : makeContours(data_ary, xs_ary, ys_ary, nx, ny, levels, quad_as_tri);
+    }
+
+    smoothContours(contours, smooth);
+
+    auto t2 = std::chrono::steady_clock::now();
+
+    bool encode = !encode_.isUndefined() && encode_.as<bool>();
+    emscripten::val js_contours = encode ? packContoursEncoded(contours, has_box ? &cut_flags : nullptr) : packContours(contours);
+
+    auto t3 = std::chrono::steady_clock::now();
 
 #ifdef PROFILE
     std::cout << "Time to Unpack: " << std::chrono::duration_cast<std::chrono::microseconds>(t1 - t0).count() / 1000. << " ms" << std::endl;
     std::cout << "Time to Contour: " << std::chrono::duration_cast<std::chrono::microseconds>(t2 - t1).count() / 1000. << " ms" << std::endl;
-    std::cout << "Time to Delete: " << std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count() / 1000. << " ms" << std::endl;
-    std::cout << "Time to Pack: " << std::chrono::duration_cast<std::chrono::microseconds>(t4 - t3).count() / 1000. << " ms" << std::endl;
+    std::cout << "Time to Pack: " << std::chrono::duration_cast<std::chrono::microseconds>(t3 - t2).count() / 1000. << " ms" << std::endl;
 #endif
 
     return js_contours;
 }
 
+template<typename T>
+emscripten::val makeContoursCurvilinearWASM(const emscripten::val& data, const emscripten::val& xs, const emscripten::val& ys, int nx, int ny, 
+                                            const emscripten::val& values, const emscripten::val& quad_as_tri_, const emscripten::val& smooth_,
+                                            const emscripten::val& filter_, const emscripten::val& encode_, const emscripten::val& cell_box_) {
+    checkGridSize(data["length"].as<int>(), nx, ny);
+    checkGridSize(xs["length"].as<int>(), nx, ny);
+    checkGridSize(ys["length"].as<int>(), nx, ny);
+
+    const float* xs_ary = stageArrayFromJS(xs, nx * ny, contour_staging.xs);
+    const float* ys_ary = stageArrayFromJS(ys, nx * ny, contour_staging.ys);
+    const T* data_ary = stageArrayFromJS(data, nx * ny, contour_staging.data<T>());
+
+    std::vector<float> levels = unpackLevels(values);
+    bool quad_as_tri = quad_as_tri_.as<bool>();
+    int smooth = smooth_.isUndefined() ? 0 : smooth_.as<int>();
+
+    GridFilterOpts filter = unpackGridFilter(filter_);
+    std::vector<Contour> contours;
+
+    CellBox box;
+    std::vector<uint8_t> cut_flags;
+    const bool has_box = unpackCellBox(cell_box_, filter.isActive() ? filter.decimate : 1, box);
+
+    if (filter.isActive()) {
+        int nx_filt, ny_filt;
+        std::vector<float> data_filt = applyGridFilter(data_ary, nx, ny, filter, nx_filt, ny_filt);
+
+        std::vector<float> xs_filt(nx_filt * ny_filt), ys_filt(nx_filt * ny_filt);
+        decimateGrid(xs_ary, nx, ny, filter.decimate, xs_filt.data());
+        decimateGrid(ys_ary, nx, ny, filter.decimate, ys_filt.data());
+
+        contours = has_box ? makeContoursCurvilinearInBox(data_filt.data(), xs_filt.data(), ys_filt.data(), nx_filt, ny_filt, levels, quad_as_tri, box, cut_flags)
+                           : makeContoursCurvilinear(data_filt.data(), xs_filt.data(), ys_filt.data(), nx_filt, ny_filt, levels, quad_as_tri);
+    }
+    else {
+        contours = has_box ? makeContoursCurvilinearInBox(data_ary, xs_ary, ys_ary, nx, ny, levels, quad_as_tri, box, cut_flags)
+                           : makeContoursCurvilinear(data_ary, xs_ary, ys_ary, nx, ny, levels, quad_as_tri);
+    }
+
+    smoothContours(contours, smooth);
+
+    bool encode = !encode_.isUndefined() && encode_.as<bool>();
+    return encode ? packContoursEncoded(contours, has_box ? &cut_flags : nullptr) : packContours(contours);
+}
+
+// Contour a grid at several resolutions. Returns an array of contour objects like makeContoursWASM(), where element k is contoured from the 
+//  grid decimated by 2^k.
+template<typename T>
+emscripten::val makeContourPyramidWASM(const emscripten::val& data, const emscripten::val& xs, const emscripten::val& ys, const emscripten::val& values,
+                                       bool quad_as_tri, int n_levels, bool preserve_extrema) {
+    int nx = xs["length"].as<int>();
+    int ny = ys["length"].as<int>();
+
+    checkGridSize(data["length"].as<int>(), nx, ny);
+
+    std::vector<float> xs_ary = copyArrayFromJS<float>(xs, nx);
+    std::vector<float> ys_ary = copyArrayFromJS<float>(ys, ny);
+    std::vector<T> data_ary = copyArrayFromJS<T>(data, nx * ny);
+    std::vector<float> levels = unpackLevels(values);
+
+    auto pyramid = makeContourPyramid(data_ary.data(), xs_ary.data(), ys_ary.data(), nx, ny, levels, n_levels, quad_as_tri, preserve_extrema);
+
+    emscripten::val js_pyramid = emscripten::val::array();
+    for (auto it = pyramid.begin(); it != pyramid.end(); ++it) {
+        js_pyramid.call<void>("push", packContours(*it));
+    }
+
+    return js_pyramid;
+}
+
+template<typename T>
+emscripten::val makeContourPyramidCurvilinearWASM(const emscripten::val& data, const emscripten::val& xs, const emscripten::val& ys, int nx, int ny,
+                                                  const emscripten::val& values, bool quad_as_tri, int n_levels, bool preserve_extrema) {
+    checkGridSize(data["length"].as<int>(), nx, ny);
+    checkGridSize(xs["length"].as<int>(), nx, ny);
+    checkGridSize(ys["length"].as<int>(), nx, ny);
+
+    std::vector<float> xs_ary = copyArrayFromJS<float>(xs, nx * ny);
+    std::vector<float> ys_ary = copyArrayFromJS<float>(ys, nx * ny);
+    std::vector<T> data_ary = copyArrayFromJS<T>(data, nx * ny);
+    std::vector<float> levels = unpackLevels(values);
+
+    auto pyramid = makeContourPyramidCurvilinear(data_ary.data(), xs_ary.data(), ys_ary.data(), nx, ny, levels, n_levels, quad_as_tri, preserve_extrema);
+
+    emscripten::val js_pyramid = emscripten::val::array();
+    for (auto it = pyramid.begin(); it != pyramid.end(); ++it) {
+        js_pyramid.call<void>("push", packContours(*it));
+    }
+
+    return js_pyramid;
+}
+
+// Contour a grid that arrives in blocks of rows (see ContourStream). Closed contours come back from pushRows() as soon as they close, and the
+//  contours that are still open come back from finish().
+template<typename T>
+class ContourStreamWASM {
+    ContourStream<T>* stream;
+    int nx;
+
+    public:
+    ContourStreamWASM(const emscripten::val& xs, const emscripten::val& values, bool quad_as_tri) {
+        this->nx = xs["length"].as<int>();
+
+        std::vector<float> xs_ary = copyArrayFromJS<float>(xs, this->nx);
+        this->stream = new ContourStream<T>(xs_ary.data(), this->nx, unpackLevels(values), quad_as_tri);
+    }
+
+    ContourStreamWASM(const ContourStreamWASM& other) = delete;
+
+    ~ContourStreamWASM() {
+        delete this->stream;
+    }
+
+    // rows is an nx x ys.length block of the grid, and ys are the y coordinates of the rows
+    emscripten::val pushRows(const emscripten::val& rows, const emscripten::val& ys) {
+        const int n_rows = ys["length"].as<int>();
+        checkGridSize(rows["length"].as<int>(), this->nx, n_rows);
+
+        std::vector<T> rows_ary = copyArrayFromJS<T>(rows, this->nx * n_rows);
+        std::vector<float> ys_ary = copyArrayFromJS<float>(ys, n_rows);
+
+        return packContours(this->stream->pushRows(rows_ary.data(), ys_ary.data(), n_rows));
+    }
+
+    emscripten::val finish() {
+        return packContours(this->stream->finish());
+    }
+};
+
+// Contour a grid one map tile at a time (see TiledContourer). getTile() returns the encoded contours in WebMercator coordinates, like 
+//  makeContoursWASM() does with encode set, and the most recent tiles are cached.
+template<typename T>
+class TiledContourerWASM {
+    TiledContourer<T>* contourer;
+
+    public:
+    TiledContourerWASM(const emscripten::val& data, const emscripten::val& lons, const emscripten::val& lats, int nx, int ny, 
+                       const emscripten::val& values, bool quad_as_tri, int cache_size) {
+        checkGridSize(data["length"].as<int>(), nx, ny);
+        checkGridSize(lons["length"].as<int>(), nx, ny);
+        checkGridSize(lats["length"].as<int>(), nx, ny);
+
+        std::vector<T> data_ary = copyArrayFromJS<T>(data, nx * ny);
+        std::vector<float> lons_ary = copyArrayFromJS<float>(lons, nx * ny);
+        std::vector<float> lats_ary = copyArrayFromJS<float>(lats, nx * ny);
+
+        this->contourer = new TiledContourer<T>(data_ary.data(), lons_ary.data(), lats_ary.data(), nx, ny, unpackLevels(values), quad_as_tri, 
+                                                cache_size);
+    }
+
+    TiledContourerWASM(const TiledContourerWASM& other) = delete;
+
+    ~TiledContourerWASM() {
+        delete this->contourer;
+    }
+
+    emscripten::val getTile(int z, int x, int y) {
+        return packEncodedContours(this->contourer->getTile({z, x, y}));
+    }
+
+    unsigned int getCacheSize() const {
+        return this->contourer->getCacheSize();
+    }
+};
+
+// Bounding boxes, arc lengths, and closed flags for a set of encoded contours, plus a spatial index over their segments (see ContourIndex).
+//  Contours are numbered in the order they're encoded.
+class ContourIndexWASM {
+    ContourIndex* index;
+
+    public:
+    ContourIndexWASM(const emscripten::val& encoded) {
+        this->index = new ContourIndex(decodeContours(unpackEncodedContours(encoded)));
+    }
+
+    ContourIndexWASM(const ContourIndexWASM& other) = delete;
+
+    ~ContourIndexWASM() {
+        delete this->index;
+    }
+
+    // Returns {bounds, arc_lengths, closed}, where bounds has x_min, y_min, x_max, and y_max for each contour
+    emscripten::val getInfo() const {
+        const std::vector<ContourInfo>& info = this->index->getInfo();
+        std::vector<float> bounds(4 * info.size()), arc_lengths(info.size());
+        std::vector<uint8_t> closed(info.size());
+
+        for (int icntr = 0; icntr < info.size(); icntr++) {
+            bounds[4 * icntr + 0] = info[icntr].x_min; bounds[4 * icntr + 1] = info[icntr].y_min;
+            bounds[4 * icntr + 2] = info[icntr].x_max; bounds[4 * icntr + 3] = info[icntr].y_max;
+            arc_lengths[icntr] = info[icntr].arc_length;
+            closed[icntr] = info[icntr].closed;
+        }
+
+        auto info_obj = emscripten::val::object();
+        info_obj.set("bounds", makeFloat32Array(bounds));
+        info_obj.set("arc_lengths", makeFloat32Array(arc_lengths));
+        info_obj.set("closed", makeUint8Array(closed));
+
+        return info_obj;
+    }
+
+    // Get the contours in each of a set of boxes (x_min, y_min, x_max, y_max for each box). The contours in box i are 
+    //  indices[offsets[i]:offsets[i + 1]].
+    emscripten::val cull(const emscripten::val& boxes) const {
+        const int n_boxes = boxes["length"].as<int>() / 4;
+        std::vector<float> boxes_ary = copyArrayFromJS<float>(boxes, 4 * n_boxes);
+
+        std::vector<int> offsets, indices;
+        this->index->cull(boxes_ary.data(), n_boxes, offsets, indices);
+
+        auto result_obj = emscripten::val::object();
+        result_obj.set("offsets", makeInt32Array(offsets));
+        result_obj.set("indices", makeInt32Array(indices));
+
+        return result_obj;
+    }
+
+    // Get the nearest contour to (x, y) as {contour, segment, distance, x, y}, or null if there isn't one within max_dist
+    emscripten::val nearest(float x, float y, const emscripten::val& max_dist_) const {
+        const float max_dist = max_dist_.isUndefined() ? INFINITY : max_dist_.as<float>();
+        ContourHit hit = this->index->nearest(x, y, max_dist);
+        if (hit.contour < 0) return emscripten::val::null();
+
+        auto hit_obj = emscripten::val::object();
+        hit_obj.set("contour", hit.contour);
+        hit_obj.set("segment", hit.segment);
+        hit_obj.set("distance", hit.distance);
+        hit_obj.set("x", hit.x);
+        hit_obj.set("y", hit.y);
+
+        return hit_obj;
+    }
+};
+
+// Unstructured grids wrap their points onto rows of a fixed length, so the last row may be partly empty. The points past the end of the
+//  arrays are left out.
+emscripten::val makeBBElementsWASM(const emscripten::val& field_lats, const emscripten::val& field_lons, const emscripten::val& min_zoom, 
+                                   int field_ni, int field_nj, int map_max_zoom) {
+    const int n_pts = field_lats["length"].as<int>();
+    checkGridSize(field_lons["length"].as<int>(), n_pts, 1);
+    checkGridSize(min_zoom["length"].as<int>(), n_pts, 1);
+
+    if (n_pts > field_ni * field_nj) {
+        std::string error = "Got " + std::to_string(n_pts) + " points, which is more than fit on a " + std::to_string(field_ni) + " x " + 
+                            std::to_string(field_nj) + " grid";
+        throw std::invalid_argument(error);
+    }
+
+    std::vector<float> lats_ary = copyArrayFromJS<float>(field_lats, n_pts);
+    std::vector<float> lons_ary = copyArrayFromJS<float>(field_lons, n_pts);
+    std::vector<uint8_t> min_zoom_ary = copyArrayFromJS<uint8_t>(min_zoom, n_pts);
+
+    lats_ary.resize(field_ni * field_nj, NAN);
+    lons_ary.resize(field_ni * field_nj, NAN);
+    min_zoom_ary.resize(field_ni * field_nj, 0);
+
+    std::vector<float> pts, tex_coords;
+    makeBBElements(lats_ary.data(), lons_ary.data(), min_zoom_ary.data(), field_ni, field_nj, map_max_zoom, pts, tex_coords);
+
+    auto elems_obj = emscripten::val::object();
+    elems_obj.set("pts", makeFloat32Array(pts));
+    elems_obj.set("tex_coords", makeFloat32Array(tex_coords));
+
+    return elems_obj;
+}
+
+emscripten::val makeStructuredMinZoomWASM(int ni, int nj, float thin_fac) {
+    std::vector<uint8_t> min_zoom(ni * nj);
+    makeStructuredMinZoom(ni, nj, thin_fac, min_zoom.data());
+    return makeUint8Array(min_zoom);
+}
+
+emscripten::val makeUnstructuredMinZoomWASM(const emscripten::val& lons, const emscripten::val& lats, float thin_fac) {
+    const int n_pts = lons["length"].as<int>();
+    checkGridSize(lats["length"].as<int>(), n_pts, 1);
+
+    std::vector<float> lons_ary = copyArrayFromJS<float>(lons, n_pts);
+    std::vector<float> lats_ary = copyArrayFromJS<float>(lats, n_pts);
+
+    std::vector<uint8_t> min_zoom(n_pts);
+    makeUnstructuredMinZoom(lons_ary.data(), lats_ary.data(), n_pts, thin_fac, min_zoom.data());
+    return makeUint8Array(min_zoom);
+}
+
+// A compiled ComputedScalarField expression. Float16 results come back as the raw bits in a Uint16Array.
+class FieldExpressionWASM {
+    FieldExpression expression;
+
+    public:
+    FieldExpressionWASM(const std::string& expression) : expression(expression) {}
+
+    template<typename T>
+    emscripten::val evaluate(const emscripten::val& fields) const {
+        const int n_fields = fields["length"].as<int>();
+        if (n_fields < this->expression.getNumFields()) {
+            std::string error = "Expression needs " + std::to_string(this->expression.getNumFields()) + " fields, but got " + std::to_string(n_fields);
+            throw std::invalid_argument(error);
+        }
+
+        const int n = n_fields > 0 ? fields[0]["length"].as<int>() : 0;
+
+        std::vector<std::vector<T>> fields_ary(n_fields);
+        std::vector<const T*> field_ptrs(n_fields);
+
+        for (int ifld = 0; ifld < n_fields; ifld++) {
+            checkGridSize(fields[ifld]["length"].as<int>(), n, 1);
+            fields_ary[ifld] = copyArrayFromJS<T>(fields[ifld], n);
+            field_ptrs[ifld] = fields_ary[ifld].data();
+        }
+
+        std::vector<T> result(n);
+        this->expression.evaluate(field_ptrs.data(), n, result.data());
+
+        if constexpr (std::is_same_v<T, float16_t>) {
+            return makeTypedArray(result, "Uint16Array");
+        }
+        else {
+            return makeFloat32Array(result);
+        }
+    }
+
+    int getNumFields() const {
+        return this->expression.getNumFields();
+    }
+};
+
+// Copy the members of an ensemble (a JS array of typed arrays, all the same length) into the WASM heap
+template<typename T>
+std::vector<std::vector<T>> copyMembersFromJS(const emscripten::val& members) {
+    const int n_members = members["length"].as<int>();
+    const int n = n_members > 0 ? members[0]["length"].as<int>() : 0;
+
+    std::vector<std::vector<T>> members_ary(n_members);
+    for (int imem = 0; imem < n_members; imem++) {
+        checkGridSize(members[imem]["length"].as<int>(), n, 1);
+        members_ary[imem] = copyArrayFromJS<T>(members[imem], n);
+    }
+
+    return members_ary;
+}
+
+// The members of an ensemble (or a band of rows from them), kept in the WASM heap so they can be reduced over and over (e.g., for 
+//  probabilities as the threshold changes) without copying them in each time. All the reductions return Float32Arrays.
+template<typename T>
+class EnsembleWASM {
+    std::vector<std::vector<T>> members;
+    std::vector<const T*> member_ptrs;
+    int n;
+
+    public:
+    EnsembleWASM(const emscripten::val& members) : members(copyMembersFromJS<T>(members)) {
+        this->n = this->members.size() > 0 ? this->members[0].size() : 0;
+
+        for (auto it = this->members.begin(); it != this->members.end(); ++it) {
+            this->member_ptrs.push_back(it->data());
+        }
+    }
+
+    EnsembleWASM(const EnsembleWASM& other) = delete;
+
+    emscripten::val probability(float threshold) const {
+        std::vector<float> prob(this->n);
+        ensembleProbability(this->member_ptrs.data(), this->member_ptrs.size(), this->n, threshold, prob.data());
+        return makeFloat32Array(prob);
+    }
+
+    // Returns {mean, spread}
+    emscripten::val meanSpread() const {
+        std::vector<float> mean(this->n), spread(this->n);
+        ensembleMeanSpread(this->member_ptrs.data(), this->member_ptrs.size(), this->n, mean.data(), spread.data());
+
+        auto mean_spread_obj = emscripten::val::object();
+        mean_spread_obj.set("mean", makeFloat32Array(mean));
+        mean_spread_obj.set("spread", makeFloat32Array(spread));
+
+        return mean_spread_obj;
+    }
+
+    emscripten::val percentile(float percentile) const {
+        std::vector<float> pct(this->n);
+        ensemblePercentile(this->member_ptrs.data(), this->member_ptrs.size(), this->n, percentile, pct.data());
+        return makeFloat32Array(pct);
+    }
+
+    emscripten::val paintball(float threshold) const {
+        std::vector<float> bits(this->n);
+        paintballBits(this->member_ptrs.data(), this->member_ptrs.size(), this->n, threshold, bits.data());
+        return makeFloat32Array(bits);
+    }
+};
+
+// The probability-matched mean needs the whole grid at once, so it's separate from EnsembleWASM, which may only have a band of rows
+template<typename T>
+emscripten::val probabilityMatchedMeanWASM(const emscripten::val& members) {
+    std::vector<std::vector<T>> members_ary = copyMembersFromJS<T>(members);
+    const int n = members_ary.size() > 0 ? members_ary[0].size() : 0;
+
+    std::vector<const T*> member_ptrs;
+    for (auto it = members_ary.begin(); it != members_ary.end(); ++it) {
+        member_ptrs.push_back(it->data());
+    }
+
+    std::vector<float> pm_mean(n);
+    probabilityMatchedMean(member_ptrs.data(), member_ptrs.size(), n, pm_mean.data());
+    return makeFloat32Array(pm_mean);
+}
+
+// Give back the memory that contouring keeps between calls (e.g., after contouring an unusually large grid)
+void releaseContourScratchWASM() {
+    releaseContourScratch();
+    contour_staging.release();
+}
+
 template<typename T>
 emscripten::val getContourLevelsWASM(const emscripten::val& grid, int nx, int ny, float interval) {
     auto memory = emscripten::val::module_property("HEAPU8")["buffer"];
@@ -206,8 +1226,122 @@ emscripten::val getContourLevelsWASM(const emscripten::val& grid, int nx, int ny
 }
 
 EMSCRIPTEN_BINDINGS(marching_squares) {
+    emscripten::class_<PlateCarreeGrid>("PlateCarreeGrid")
+        .constructor<unsigned int, unsigned int, float, float, float, float>()
+        .function("getEarthCoords", &PlateCarreeGrid::getEarthCoordArrays)
+        .function("getMapCoords", &PlateCarreeGrid::getMapCoords)
+        .function("getAdaptiveDomainBuffers", &PlateCarreeGrid::getAdaptiveDomainBuffers)
+        .function("getVectorRotation", &PlateCarreeGrid::getVectorRotation)
+        .function("getEarthRelativeVectorsFloat32", &PlateCarreeGrid::getEarthRelativeVectors<float>)
+        .function("getEarthRelativeVectorsFloat16", &PlateCarreeGrid::getEarthRelativeVectors<float16_t>)
+        .function("getVectorSpeedDirectionFloat32", &PlateCarreeGrid::getVectorSpeedDirection<float>)
+        .function("getVectorSpeedDirectionFloat16", &PlateCarreeGrid::getVectorSpeedDirection<float16_t>);
+
+    emscripten::class_<LambertGrid>("LambertGrid")
+        .constructor<unsigned int, unsigned int, float, float, float, float, float, float, float, float>()
+        .constructor<unsigned int, unsigned int, float, float, float, float, float, float, float, float, bool>()
+        .function("getEarthCoords", &LambertGrid::getEarthCoordArrays)
+        .function("getMapCoords", &LambertGrid::getMapCoords)
+        .function("getAdaptiveDomainBuffers", &LambertGrid::getAdaptiveDomainBuffers)
+        .function("getVectorRotation", &LambertGrid::getVectorRotation)
+        .function("getEarthRelativeVectorsFloat32", &LambertGrid::getEarthRelativeVectors<float>)
+        .function("getEarthRelativeVectorsFloat16", &LambertGrid::getEarthRelativeVectors<float16_t>)
+        .function("getVectorSpeedDirectionFloat32", &LambertGrid::getVectorSpeedDirection<float>)
+        .function("getVectorSpeedDirectionFloat16", &LambertGrid::getVectorSpeedDirection<float16_t>);
+
+    emscripten::class_<GeostationaryGrid>("GeostationaryGrid")
+        .constructor<unsigned int, unsigned int, float, float, float, float, float>()
+        .function("getEarthCoords", &GeostationaryGrid::getEarthCoordArrays)
+        .function("getMapCoords", &GeostationaryGrid::getMapCoords)
+        .function("getAdaptiveDomainBuffers", &GeostationaryGrid::getAdaptiveDomainBuffers)
+        .function("getVectorRotation", &GeostationaryGrid::getVectorRotation)
+        .function("getEarthRelativeVectorsFloat32", &GeostationaryGrid::getEarthRelativeVectors<float>)
+        .function("getEarthRelativeVectorsFloat16", &GeostationaryGrid::getEarthRelativeVectors<float16_t>)
+        .function("getVectorSpeedDirectionFloat32", &GeostationaryGrid::getVectorSpeedDirection<float>)
+        .function("getVectorSpeedDirectionFloat16", &GeostationaryGrid::getVectorSpeedDirection<float16_t>);
+
+    emscripten::class_<RadarSweepGrid>("RadarSweepGrid")
+        .constructor<unsigned int, unsigned int, float, float, float, float, float, float>()
+        .function("getEarthCoords", &RadarSweepGrid::getEarthCoordArrays)
+        .function("getMapCoords", &RadarSweepGrid::getMapCoords)
+        .function("getAdaptiveDomainBuffers", &RadarSweepGrid::getAdaptiveDomainBuffers)
+        .function("getVectorRotation", &RadarSweepGrid::getVectorRotation)
+        .function("getEarthRelativeVectorsFloat32", &RadarSweepGrid::getEarthRelativeVectors<float>)
+        .function("getEarthRelativeVectorsFloat16", &RadarSweepGrid::getEarthRelativeVectors<float16_t>)
+        .function("getVectorSpeedDirectionFloat32", &RadarSweepGrid::getVectorSpeedDirection<float>)
+        .function("getVectorSpeedDirectionFloat16", &RadarSweepGrid::getVectorSpeedDirection<float16_t>);
+
+    emscripten::class_<MapPointIndex>("MapPointIndex")
+        .constructor<const emscripten::val&, const emscripten::val&>()
+        .function("nearest", &MapPointIndex::nearest)
+        .function("within", &MapPointIndex::within)
+        .function("range", &MapPointIndex::range)
+        .function("size", &MapPointIndex::size);
+
+    emscripten::class_<ContourIndexWASM>("ContourIndex")
+        .constructor<const emscripten::val&>()
+        .function("getInfo", &ContourIndexWASM::getInfo)
+        .function("cull", &ContourIndexWASM::cull)
+        .function("nearest", &ContourIndexWASM::nearest);
+
+    emscripten::class_<FieldExpressionWASM>("FieldExpression")
+        .constructor<const std::string&>()
+        .function("evaluateFloat32", &FieldExpressionWASM::evaluate<float>)
+        .function("evaluateFloat16", &FieldExpressionWASM::evaluate<float16_t>)
+        .function("getNumFields", &FieldExpressionWASM::getNumFields);
+
+    emscripten::class_<EnsembleWASM<float>>("EnsembleFloat32")
+        .constructor<const emscripten::val&>()
+        .function("probability", &EnsembleWASM<float>::probability)
+        .function("meanSpread", &EnsembleWASM<float>::meanSpread)
+        .function("percentile", &EnsembleWASM<float>::percentile)
+        .function("paintball", &EnsembleWASM<float>::paintball);
+
+    emscripten::class_<EnsembleWASM<float16_t>>("EnsembleFloat16")
+        .constructor<const emscripten::val&>()
+        .function("probability", &EnsembleWASM<float16_t>::probability)
+        .function("meanSpread", &EnsembleWASM<float16_t>::meanSpread)
+        .function("percentile", &EnsembleWASM<float16_t>::percentile)
+        .function("paintball", &EnsembleWASM<float16_t>::paintball);
+
+    emscripten::class_<ContourStreamWASM<float>>("ContourStreamFloat32")
+        .constructor<const emscripten::val&, const emscripten::val&, bool>()
+        .function("pushRows", &ContourStreamWASM<float>::pushRows)
+        .function("finish", &ContourStreamWASM<float>::finish);
+
+    emscripten::class_<ContourStreamWASM<float16_t>>("ContourStreamFloat16")
+        .constructor<const emscripten::val&, const emscripten::val&, bool>()
+        .function("pushRows", &ContourStreamWASM<float16_t>::pushRows)
+        .function("finish", &ContourStreamWASM<float16_t>::finish);
+
+    emscripten::class_<TiledContourerWASM<float>>("TiledContourerFloat32")
+        .constructor<const emscripten::val&, const emscripten::val&, const emscripten::val&, int, int, const emscripten::val&, bool, int>()
+        .function("getTile", &TiledContourerWASM<float>::getTile)
+        .function("getCacheSize", &TiledContourerWASM<float>::getCacheSize);
+
+    emscripten::class_<TiledContourerWASM<float16_t>>("TiledContourerFloat16")
+        .constructor<const emscripten::val&, const emscripten::val&, const emscripten::val&, int, int, const emscripten::val&, bool, int>()
+        .function("getTile", &TiledContourerWASM<float16_t>::getTile)
+        .function("getCacheSize", &TiledContourerWASM<float16_t>::getCacheSize);
+
     emscripten::function("makeContoursFloat32", &makeContoursWASM<float>);
     emscripten::function("makeContoursFloat16", &makeContoursWASM<float16_t>);
+    emscripten::function("makeContoursCurvilinearFloat32", &makeContoursCurvilinearWASM<float>);
+    emscripten::function("makeContoursCurvilinearFloat16", &makeContoursCurvilinearWASM<float16_t>);
+    emscripten::function("makeContourPyramidFloat32", &makeContourPyramidWASM<float>);
+    emscripten::function("makeContourPyramidFloat16", &makeContourPyramidWASM<float16_t>);
+    emscripten::function("makeContourPyramidCurvilinearFloat32", &makeContourPyramidCurvilinearWASM<float>);
+    emscripten::function("makeContourPyramidCurvilinearFloat16", &makeContourPyramidCurvilinearWASM<float16_t>);
+    emscripten::function("releaseContourScratch", &releaseContourScratchWASM);
     emscripten::function("getContourLevelsFloat32", &getContourLevelsWASM<float>);
     emscripten::function("getContourLevelsFloat16", &getContourLevelsWASM<float16_t>);
+    emscripten::function("makeBBElements", &makeBBElementsWASM);
+    emscripten::function("filterGridFloat32", &filterGridWASM<float>);
+    emscripten::function("filterGridFloat16", &filterGridWASM<float16_t>);
+    emscripten::function("decodeGrib2Float32", &decodeGrib2WASM<float>);
+    emscripten::function("decodeGrib2Float16", &decodeGrib2WASM<float16_t>);
+    emscripten::function("probabilityMatchedMeanFloat32", &probabilityMatchedMeanWASM<float>);
+    emscripten::function("probabilityMatchedMeanFloat16", &probabilityMatchedMeanWASM<float16_t>);
+    emscripten::function("makeStructuredMinZoom", &makeStructuredMinZoomWASM);
+    emscripten::function("makeUnstructuredMinZoom", &makeUnstructuredMinZoomWASM);
 }
\ No newline at end of file
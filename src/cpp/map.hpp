@@ -1,9 +1,17 @@
 
+#ifndef __AUTUMNPLOT_MAP_H__
+#define __AUTUMNPLOT_MAP_H__
+
+
 #include <cmath>
 #include <iostream>
 #include <algorithm>
 #include <type_traits>
 #include <utility>
+#include <vector>
+#include <string>
+
+#include "fastmath.hpp"
 
 struct GridPoint {
     float x;
@@ -57,6 +65,25 @@ struct is_earth_point_t<T, std::void_t<
 template <typename T>
 inline constexpr bool is_earth_point = is_earth_point_t<T>::value;
 
+template <typename T, typename=void>
+struct has_grid_transform_inverse_t : std::false_type {};
+
+template <typename T>
+struct has_grid_transform_inverse_t<T, std::void_t<
+    decltype(std::declval<T>().transform_inverse_grid(std::declval<const float*>(), 0, std::declval<const float*>(), 0, 
+                                                      std::declval<float*>(), std::declval<float*>()))
+>> : std::true_type {};
+
+template <typename T>
+inline constexpr bool has_grid_transform_inverse = has_grid_transform_inverse_t<T>::value;
+
+// Append the bytes of a value to a cache key. Keys are compared in full, so two grid definitions only share a cache entry if they're the 
+//  same bit for bit.
+template<typename T>
+inline void appendKeyBytes(std::string& key, const T& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
 template<typename T>
 constexpr T degToRad(const T deg) {
     return deg * M_PI / 180;
@@ -82,6 +109,8 @@ class PlateCarree : MapProjection<EarthPoint, EarthPoint> {
     EarthPoint transform_inverse(const EarthPoint& pt) const {
         return pt;
     }
+
+    void appendDefinition(std::string& key) const {}
 };
 
 // Formulas from https://pubs.usgs.gov/pp/1395/report.pdf
@@ -108,10 +137,43 @@ class LambertConformalConic : MapProjection<EarthPoint, GridPoint> {
 
     double F, n;
     double rho_0;
+    bool fast_math;
 
+    template<typename M=StdMathOps>
     double computeT(const double lat) const {
-        const double sin_lat = sin(lat);
-        return tan(M_PI / 4 - lat / 2) * pow((1 + this->eccen * sin_lat) / (1 - this->eccen * sin_lat), this->eccen / 2);
+        const double sin_lat = M::sin(lat);
+        return M::tan(M_PI / 4 - lat / 2) * M::pow((1 + this->eccen * sin_lat) / (1 - this->eccen * sin_lat), this->eccen / 2);
+    }
+
+    template<typename M>
+    GridPoint transform_(const EarthPoint& pt) const {
+        const double lon = degToRad(pt.lon);
+        const double lat = degToRad(pt.lat);
+
+        const double t = this->computeT<M>(lat);
+        const double rho = this->semimajor * this->F * M::pow(t, this->n);
+        const double theta = this->n * (lon - this->lon_0);
+
+        const double x = rho * M::sin(theta);
+        const double y = this->rho_0 - rho * M::cos(theta);
+
+        return GridPoint(x, y);
+    }
+
+    template<typename M>
+    EarthPoint transform_inverse_(const GridPoint& pt) const {
+        const double theta = M::atan2(pt.x, this->rho_0 - pt.y);
+        const double lon = theta / this->n + this->lon_0;
+        const double rho = copysign(M::hypot(pt.x, this->rho_0 - pt.y), this->n);
+        const double t = M::pow(rho / (this->semimajor * this->F), 1 / this->n);
+
+        const double chi = M_PI / 2 - 2 * M::atan(t);
+        const double sin_2chi = M::sin(2 * chi);
+        const double cos_2chi = M::cos(2 * chi);
+
+        const double lat = chi + sin_2chi * (this->Ap + cos_2chi * (this->Bp + cos_2chi * (this->Cp + this->Dp * cos_2chi)));
+
+        return EarthPoint(radToDeg(lon), radToDeg(lat));
     }
 
     double computeM(const double lat) const {
@@ -120,7 +182,11 @@ class LambertConformalConic : MapProjection<EarthPoint, GridPoint> {
     }
 
     public:
-    LambertConformalConic(const float lon_0, const float lat_0, const float lat_std_1, const float lat_std_2) {
+    // If fast_math is true, the transforms use the polynomial approximations in fastmath.hpp. Over CONUS (the HRRR domain), the positions 
+    //  agree with the exact transforms to within about 1 m (0.8 m measured for the inverse and 0.3 m for the forward transform), which is 
+    //  about the float32 rounding of the coordinates.
+    LambertConformalConic(const float lon_0, const float lat_0, const float lat_std_1, const float lat_std_2, const bool fast_math=false) {
+        this->fast_math = fast_math;
         this->lon_0 = degToRad(lon_0);
         this->lat_0 = degToRad(lat_0);
         this->lat_std_1 = degToRad(lat_std_1);
@@ -147,35 +213,294 @@ class LambertConformalConic : MapProjection<EarthPoint, GridPoint> {
     }
 
     LambertConformalConic(const LambertConformalConic& other) : lon_0(other.lon_0), lat_0(other.lat_0), lat_std_1(other.lat_std_1), lat_std_2(other.lat_std_2),
-                                                                n(other.n), F(other.F), rho_0(other.rho_0) {}
+                                                                n(other.n), F(other.F), rho_0(other.rho_0), fast_math(other.fast_math) {}
+
+    void appendDefinition(std::string& key) const {
+        appendKeyBytes(key, this->lon_0);
+        appendKeyBytes(key, this->lat_0);
+        appendKeyBytes(key, this->lat_std_1);
+        appendKeyBytes(key, this->lat_std_2);
+        appendKeyBytes(key, this->fast_math);
+    }
+
+    GridPoint transform(const EarthPoint& pt) const {
+        return this->fast_math ? this->transform_<FastMathOps>(pt) : this->transform_<StdMathOps>(pt);
+    }
+
+    EarthPoint transform_inverse(const GridPoint& pt) const {
+        return this->fast_math ? this->transform_inverse_<FastMathOps>(pt) : this->transform_inverse_<StdMathOps>(pt);
+    }
+};
+
+// Formulas from the GOES-R Product Definition and Users' Guide (PUG), volume 3, section 4.2.8. Grid coordinates are the E-W (x) and 
+//  N-S (y) scan angles in radians. Points that are off the Earth's disk (or not visible from the satellite) transform to NaN.
+class Geostationary : MapProjection<EarthPoint, GridPoint> {
+    private:
+    double lon_0;
+    double height;
+
+    // GRS 80 spheroid (as used by the GOES-R fixed grid)
+    const double r_eq = 6378137.0;
+    const double r_pol = 6356752.31414;
+    const double r_eq2_r_pol2 = (this->r_eq * this->r_eq) / (this->r_pol * this->r_pol);
+    const double eccen2 = 1 - (this->r_pol * this->r_pol) / (this->r_eq * this->r_eq);
+
+    double c_quad;
+
+    void computeLonLat(const double sin_x, const double cos_x, const double sin_y, const double cos_y, float& lon, float& lat) const {
+        const double a_quad = sin_x * sin_x + cos_x * cos_x * (cos_y * cos_y + this->r_eq2_r_pol2 * sin_y * sin_y);
+        const double b_quad = -2 * this->height * cos_x * cos_y;
+        const double disc = b_quad * b_quad - 4 * a_quad * this->c_quad;
+
+        if (disc < 0) {
+            // Scan angle doesn't intersect the Earth
+            lon = NAN;
+            lat = NAN;
+            return;
+        }
+
+        const double r_s = (-b_quad - sqrt(disc)) / (2 * a_quad);
+        const double s_x = r_s * cos_x * cos_y;
+        const double s_y = -r_s * sin_x;
+        const double s_z = r_s * cos_x * sin_y;
+        const double h_sx = this->height - s_x;
+
+        lon = radToDeg(this->lon_0 - atan(s_y / h_sx));
+        lat = radToDeg(atan(this->r_eq2_r_pol2 * s_z / sqrt(h_sx * h_sx + s_y * s_y)));
+    }
+
+    public:
+    Geostationary(const float lon_0, const double height=42164160.0) {
+        this->lon_0 = degToRad(lon_0);
+        this->height = height;
+        this->c_quad = this->height * this->height - this->r_eq * this->r_eq;
+    }
+
+    Geostationary(const Geostationary& other) : lon_0(other.lon_0), height(other.height), c_quad(other.c_quad) {}
+
+    void appendDefinition(std::string& key) const {
+        appendKeyBytes(key, this->lon_0);
+        appendKeyBytes(key, this->height);
+    }
 
     GridPoint transform(const EarthPoint& pt) const {
         const double lon = degToRad(pt.lon);
         const double lat = degToRad(pt.lat);
 
-        const double t = this->computeT(lat);
-        const double rho = this->semimajor * this->F * pow(t, this->n);
-        const double theta = this->n * (lon - this->lon_0);
+        const double lat_c = atan(tan(lat) / this->r_eq2_r_pol2);
+        const double cos_lat_c = cos(lat_c);
+        const double r_c = this->r_pol / sqrt(1 - this->eccen2 * cos_lat_c * cos_lat_c);
+
+        const double s_x = this->height - r_c * cos_lat_c * cos(lon - this->lon_0);
+        const double s_y = -r_c * cos_lat_c * sin(lon - this->lon_0);
+        const double s_z = r_c * sin(lat_c);
+
+        if (this->height * (this->height - s_x) < s_y * s_y + this->r_eq2_r_pol2 * s_z * s_z) {
+            // Point is on the far side of the Earth from the satellite
+            return GridPoint(NAN, NAN);
+        }
 
-        const double x = rho * sin(theta);
-        const double y = this->rho_0 - rho * cos(theta);
+        const double x = asin(-s_y / sqrt(s_x * s_x + s_y * s_y + s_z * s_z));
+        const double y = atan(s_z / s_x);
 
         return GridPoint(x, y);
     }
 
     EarthPoint transform_inverse(const GridPoint& pt) const {
-        const double theta = atan2(pt.x, this->rho_0 - pt.y);
-        const double lon = theta / this->n + this->lon_0;
-        const double rho = copysign(hypot(pt.x, this->rho_0 - pt.y), this->n);
-        const double t = pow(rho / (this->semimajor * this->F), 1 / this->n);
+        float lon, lat;
+        this->computeLonLat(sin(pt.x), cos(pt.x), sin(pt.y), cos(pt.y), lon, lat);
+        return EarthPoint(lon, lat);
+    }
 
-        const double chi = M_PI / 2 - 2 * atan(t);
-        const double sin_2chi = sin(2 * chi);
-        const double cos_2chi = cos(2 * chi);
+    void transform(const float* lons, const float* lats, const size_t n, float* xs, float* ys) const {
+        for (size_t idx = 0; idx < n; idx++) {
+            const GridPoint pt = this->transform(EarthPoint(lons[idx], lats[idx]));
+            xs[idx] = pt.x;
+            ys[idx] = pt.y;
+        }
+    }
 
-        const double lat = chi + sin_2chi * (this->Ap + cos_2chi * (this->Bp + cos_2chi * (this->Cp + this->Dp * cos_2chi)));
+    void transform_inverse(const float* xs, const float* ys, const size_t n, float* lons, float* lats) const {
+        for (size_t idx = 0; idx < n; idx++) {
+            this->computeLonLat(sin(xs[idx]), cos(xs[idx]), sin(ys[idx]), cos(ys[idx]), lons[idx], lats[idx]);
+        }
+    }
 
-        return EarthPoint(radToDeg(lon), radToDeg(lat));
+    // Inverse transform for every combination of the nx scan angles in xs and the ny scan angles in ys (output is x-fastest). The 
+    //  trig functions of the scan angles are only computed once per row and column.
+    void transform_inverse_grid(const float* xs, const int nx, const float* ys, const int ny, float* lons, float* lats) const {
+        std::vector<double> sin_xs(nx), cos_xs(nx);
+        for (int i = 0; i < nx; i++) {
+            sin_xs[i] = sin(xs[i]);
+            cos_xs[i] = cos(xs[i]);
+        }
+
+        for (int j = 0; j < ny; j++) {
+            const double sin_y = sin(ys[j]);
+            const double cos_y = cos(ys[j]);
+
+            for (int i = 0; i < nx; i++) {
+                const int idx = i + nx * j;
+                this->computeLonLat(sin_xs[i], cos_xs[i], sin_y, cos_y, lons[idx], lats[idx]);
+            }
+        }
+    }
+};
+
+// Geometry for a radar sweep centered on the radar site. Grid coordinates are the (ground) range in meters and the azimuth in degrees 
+//  clockwise from north. The inverse transform is Vincenty's direct formula (https://doi.org/10.1179/sre.1975.23.176.88) with a single
+//  correction to the angular distance instead of iterating to convergence, which is good to 1.5 m out to 500 km on the WGS 84 ellipsoid.
+class RadarSweep : MapProjection<EarthPoint, GridPoint> {
+    private:
+    double lon_0;
+    double lat_0;
+
+    // WGS 84 spheroid
+    const double semimajor = 6378137.0;
+    const double semiminor = 6356752.314245;
+    const double flat = 1 - this->semiminor / this->semimajor;
+
+    double sin_u_0, cos_u_0;
+
+    // Everything in Vincenty's formula that depends only on the azimuth
+    struct AzimuthTerms {
+        double sin_az, cos_az;
+        double sigma_1;
+        double sin_alpha, cos2_alpha;
+        double A, B, C;
+    };
+
+    AzimuthTerms computeAzimuthTerms(const double az) const {
+        AzimuthTerms terms;
+        terms.sin_az = sin(degToRad(az));
+        terms.cos_az = cos(degToRad(az));
+        terms.sigma_1 = atan2(this->sin_u_0 / this->cos_u_0, terms.cos_az);
+        terms.sin_alpha = this->cos_u_0 * terms.sin_az;
+        terms.cos2_alpha = 1 - terms.sin_alpha * terms.sin_alpha;
+
+        const double u2 = terms.cos2_alpha * (this->semimajor * this->semimajor - this->semiminor * this->semiminor) / (this->semiminor * this->semiminor);
+        terms.A = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+        terms.B = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+        terms.C = this->flat / 16 * terms.cos2_alpha * (4 + this->flat * (4 - 3 * terms.cos2_alpha));
+
+        return terms;
+    }
+
+    void computeLonLat(const AzimuthTerms& terms, const double rn_b, float& lon, float& lat) const {
+        double sigma = rn_b / terms.A;
+        double cos_2sigma_m = cos(2 * terms.sigma_1 + sigma);
+        double sin_sigma = sin(sigma);
+        double cos_sigma = cos(sigma);
+
+        const double cos2_2sigma_m = cos_2sigma_m * cos_2sigma_m;
+        const double dsigma = terms.B * sin_sigma * (cos_2sigma_m + terms.B / 4 * (cos_sigma * (-1 + 2 * cos2_2sigma_m) 
+                                                      - terms.B / 6 * cos_2sigma_m * (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * cos2_2sigma_m)));
+
+        sigma += dsigma;
+        cos_2sigma_m = cos(2 * terms.sigma_1 + sigma);
+        sin_sigma = sin(sigma);
+        cos_sigma = cos(sigma);
+
+        const double tmp = this->sin_u_0 * sin_sigma - this->cos_u_0 * cos_sigma * terms.cos_az;
+        const double lat_2 = atan2(this->sin_u_0 * cos_sigma + this->cos_u_0 * sin_sigma * terms.cos_az, 
+                                   (1 - this->flat) * sqrt(terms.sin_alpha * terms.sin_alpha + tmp * tmp));
+        const double lambda = atan2(sin_sigma * terms.sin_az, this->cos_u_0 * cos_sigma - this->sin_u_0 * sin_sigma * terms.cos_az);
+        const double L = lambda - (1 - terms.C) * this->flat * terms.sin_alpha 
+                                * (sigma + terms.C * sin_sigma * (cos_2sigma_m + terms.C * cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m)));
+
+        lon = radToDeg(this->lon_0 + L);
+        lat = radToDeg(lat_2);
+    }
+
+    public:
+    RadarSweep(const float lon_0, const float lat_0) {
+        this->lon_0 = degToRad(lon_0);
+        this->lat_0 = degToRad(lat_0);
+
+        const double tan_u_0 = (1 - this->flat) * tan(this->lat_0);
+        this->cos_u_0 = 1 / sqrt(1 + tan_u_0 * tan_u_0);
+        this->sin_u_0 = tan_u_0 * this->cos_u_0;
+    }
+
+    RadarSweep(const RadarSweep& other) : lon_0(other.lon_0), lat_0(other.lat_0), sin_u_0(other.sin_u_0), cos_u_0(other.cos_u_0) {}
+
+    void appendDefinition(std::string& key) const {
+        appendKeyBytes(key, this->lon_0);
+        appendKeyBytes(key, this->lat_0);
+    }
+
+    // Vincenty's inverse formula. This one iterates, as it's only used for one-off lookups.
+    GridPoint transform(const EarthPoint& pt) const {
+        const double L = degToRad(pt.lon) - this->lon_0;
+        const double tan_u_2 = (1 - this->flat) * tan(degToRad(pt.lat));
+        const double cos_u_2 = 1 / sqrt(1 + tan_u_2 * tan_u_2);
+        const double sin_u_2 = tan_u_2 * cos_u_2;
+
+        double lambda = L, lambda_prev;
+        double sin_sigma, cos_sigma, sigma, cos2_alpha, cos_2sigma_m;
+        double sin_lambda, cos_lambda;
+        int n_iter = 0;
+
+        do {
+            sin_lambda = sin(lambda);
+            cos_lambda = cos(lambda);
+
+            const double tmp = this->cos_u_0 * sin_u_2 - this->sin_u_0 * cos_u_2 * cos_lambda;
+            sin_sigma = sqrt(cos_u_2 * sin_lambda * cos_u_2 * sin_lambda + tmp * tmp);
+            if (sin_sigma == 0) return GridPoint(0., 0.);
+
+            cos_sigma = this->sin_u_0 * sin_u_2 + this->cos_u_0 * cos_u_2 * cos_lambda;
+            sigma = atan2(sin_sigma, cos_sigma);
+
+            const double sin_alpha = this->cos_u_0 * cos_u_2 * sin_lambda / sin_sigma;
+            cos2_alpha = 1 - sin_alpha * sin_alpha;
+            cos_2sigma_m = cos2_alpha != 0 ? cos_sigma - 2 * this->sin_u_0 * sin_u_2 / cos2_alpha : 0;
+
+            const double C = this->flat / 16 * cos2_alpha * (4 + this->flat * (4 - 3 * cos2_alpha));
+            lambda_prev = lambda;
+            lambda = L + (1 - C) * this->flat * sin_alpha * (sigma + C * sin_sigma * (cos_2sigma_m + C * cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m)));
+        } while (fabs(lambda - lambda_prev) > 1e-12 && ++n_iter < 100);
+
+        if (n_iter >= 100) {
+            // Failed to converge (nearly antipodal points)
+            return GridPoint(NAN, NAN);
+        }
+
+        const double u2 = cos2_alpha * (this->semimajor * this->semimajor - this->semiminor * this->semiminor) / (this->semiminor * this->semiminor);
+        const double A = 1 + u2 / 16384 * (4096 + u2 * (-768 + u2 * (320 - 175 * u2)));
+        const double B = u2 / 1024 * (256 + u2 * (-128 + u2 * (74 - 47 * u2)));
+        const double dsigma = B * sin_sigma * (cos_2sigma_m + B / 4 * (cos_sigma * (-1 + 2 * cos_2sigma_m * cos_2sigma_m) 
+                                                - B / 6 * cos_2sigma_m * (-3 + 4 * sin_sigma * sin_sigma) * (-3 + 4 * cos_2sigma_m * cos_2sigma_m)));
+
+        const double rn = this->semiminor * A * (sigma - dsigma);
+        double az = radToDeg(atan2(cos_u_2 * sin_lambda, this->cos_u_0 * sin_u_2 - this->sin_u_0 * cos_u_2 * cos_lambda));
+        if (az < 0) az += 360;
+
+        return GridPoint(rn, az);
+    }
+
+    EarthPoint transform_inverse(const GridPoint& pt) const {
+        float lon, lat;
+        this->computeLonLat(this->computeAzimuthTerms(pt.y), pt.x / this->semiminor, lon, lat);
+        return EarthPoint(lon, lat);
+    }
+
+    // Inverse transform for every combination of the nr ranges in rns and the naz azimuths in azs (output is range-fastest). The 
+    //  azimuth-dependent terms are computed once per radial.
+    void transform_inverse_grid(const float* rns, const int nr, const float* azs, const int naz, float* lons, float* lats) const {
+        std::vector<double> rns_b(nr);
+        for (int i = 0; i < nr; i++) {
+            rns_b[i] = rns[i] / this->semiminor;
+        }
+
+        for (int j = 0; j < naz; j++) {
+            const AzimuthTerms terms = this->computeAzimuthTerms(azs[j]);
+
+            for (int i = 0; i < nr; i++) {
+                const int idx = i + nr * j;
+                this->computeLonLat(terms, rns_b[i], lons[idx], lats[idx]);
+            }
+        }
     }
 };
 
@@ -198,6 +523,12 @@ class RotateSphere : MapProjection<EarthPoint, EarthPoint> {
 
     RotateSphere(const RotateSphere& other) : np_lon(other.np_lon), np_lat(other.np_lat), lon_shift(other.lon_shift), sin_np_lat(other.sin_np_lat), cos_np_lat(other.cos_np_lat) {}
 
+    void appendDefinition(std::string& key) const {
+        appendKeyBytes(key, this->np_lon);
+        appendKeyBytes(key, this->np_lat);
+        appendKeyBytes(key, this->lon_shift);
+    }
+
     EarthPoint transform(const EarthPoint& pt) const {
         const double lon = degToRad(pt.lon);
         const double lat = degToRad(pt.lat);
@@ -249,6 +580,21 @@ class WebMercator : MapProjection<EarthPoint, GridPoint> {
 
         return EarthPoint(lon, lat);
     }
+
+    // NaN coordinates (e.g., off the disk for a geostationary satellite) stay NaN instead of getting clamped to the edge of the map
+    void transform(const float* lons, const float* lats, const size_t n, float* xs, float* ys) const {
+        for (size_t idx = 0; idx < n; idx++) {
+            if (std::isnan(lons[idx]) || std::isnan(lats[idx])) {
+                xs[idx] = NAN;
+                ys[idx] = NAN;
+                continue;
+            }
+
+            const GridPoint pt = this->transform(EarthPoint(lons[idx], lats[idx]));
+            xs[idx] = pt.x;
+            ys[idx] = pt.y;
+        }
+    }
 };
 
 /*
@@ -273,4 +619,6 @@ int main(int argc, char** argv) {
 
     return 0;
 }
-*/
\ No newline at end of file
+*/
+
+#endif
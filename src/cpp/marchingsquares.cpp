@@ -1,12 +1,13 @@
 
 #include <vector>
-#include <unordered_map>
 #include <iostream>
 #include <chrono>
 #include <cmath>
+#include <algorithm>
 
 #include "float16_t.hpp"
 #include "marchingsquares.hpp"
+#include "gridfilter.hpp"
 
 using numeric::float16_t;
 
@@ -39,18 +40,10 @@ class MarchingSquaresSegmentList {
             return this->isegs[iposs + 1] - this->isegs[iposs];
         }
 
-        std::vector<Point> getPointList(const int iposs, const int iseg, const bool reverse) const {
+        const Point* getPoints(const int iposs, const int iseg, int& n_points) const {
             const uint8_t isegs = iseg + this->isegs[iposs];
-            const uint8_t ipts_begin = this->ipoints[isegs];
-            const uint8_t ipts_end = this->ipoints[isegs + 1];
-
-            std::vector<Point> pt_list(this->points.begin() + ipts_begin, this->points.begin() + ipts_end);
-
-            if (reverse) {
-                return std::vector<Point>(pt_list.rbegin(), pt_list.rend());
-            }
-
-            return pt_list;
+            n_points = this->ipoints[isegs + 1] - this->ipoints[isegs];
+            return this->points.data() + this->ipoints[isegs];
         }
 
         template <std::size_t LP, std::size_t LS, std::size_t LT>
@@ -180,10 +173,14 @@ void searchInterval(const std::vector<float>& vec, const float val_lb, const flo
     }
 }
 
-MarchingSquaresSegmentList* selectSegmentList(const bool quad_as_tri) {
-    if (quad_as_tri)
-        return MarchingSquaresSegmentList::make<NPTS_TRI, NNPTS_TRI, NNSEGS_TRI>(MARCHING_SQUARES_POINTS_TRI, MARCHING_SQUARES_NPOINTS_TRI, MARCHING_SQUARES_NSEGS_TRI);
-    return MarchingSquaresSegmentList::make<NPTS_QUAD, NNPTS_QUAD, NNSEGS_QUAD>(MARCHING_SQUARES_POINTS_QUAD, MARCHING_SQUARES_NPOINTS_QUAD, MARCHING_SQUARES_NSEGS_QUAD);
+// The segment lists are built once and shared by every call
+const MarchingSquaresSegmentList* selectSegmentList(const bool quad_as_tri) {
+    static const MarchingSquaresSegmentList* segments_tri = 
+        MarchingSquaresSegmentList::make<NPTS_TRI, NNPTS_TRI, NNSEGS_TRI>(MARCHING_SQUARES_POINTS_TRI, MARCHING_SQUARES_NPOINTS_TRI, MARCHING_SQUARES_NSEGS_TRI);
+    static const MarchingSquaresSegmentList* segments_quad = 
+        MarchingSquaresSegmentList::make<NPTS_QUAD, NNPTS_QUAD, NNSEGS_QUAD>(MARCHING_SQUARES_POINTS_QUAD, MARCHING_SQUARES_NPOINTS_QUAD, MARCHING_SQUARES_NSEGS_QUAD);
+
+    return quad_as_tri ? segments_tri : segments_quad;
 }
 
 #define MIN(a, b) (a < b ? a : b)
@@ -191,219 +188,725 @@ MarchingSquaresSegmentList* selectSegmentList(const bool quad_as_tri) {
 #define MAX(a, b) (a > b ? a : b)
 #define MAX4(a, b, c, d) (MAX(MAX(a, b), MAX(c, d)))
 
-template<typename T>
-std::vector<Contour> makeContours(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri) {
-    T esw, ese, enw, ene;
+static const uint64_t EMPTY_KEY = UINT64_MAX;
+
+size_t EndpointTable::slot(const uint64_t key) const {
+    uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 32;
+    return hash & (this->keys.size() - 1);
+}
+
+void EndpointTable::grow() {
+    std::vector<uint64_t> old_keys(std::max<size_t>(64, this->keys.size() * 2), EMPTY_KEY);
+    std::vector<int> old_values(old_keys.size());
+    old_keys.swap(this->keys);
+    old_values.swap(this->values);
+    this->n_entries = 0;
+
+    for (size_t islot = 0; islot < old_keys.size(); islot++) {
+        if (old_keys[islot] != EMPTY_KEY) this->insert(old_keys[islot], old_values[islot]);
+    }
+}
+
+void EndpointTable::clear() {
+    std::fill(this->keys.begin(), this->keys.end(), EMPTY_KEY);
+    this->n_entries = 0;
+}
+
+int EndpointTable::find(const uint64_t key) const {
+    if (this->keys.size() == 0) return -1;
+
+    const size_t mask = this->keys.size() - 1;
+    for (size_t islot = this->slot(key); this->keys[islot] != EMPTY_KEY; islot = (islot + 1) & mask) {
+        if (this->keys[islot] == key) return this->values[islot];
+    }
+
+    return -1;
+}
+
+void EndpointTable::insert(const uint64_t key, const int value) {
+    if ((this->n_entries + 1) * 2 > this->keys.size()) this->grow();
+
+    const size_t mask = this->keys.size() - 1;
+    size_t islot = this->slot(key);
+    while (this->keys[islot] != EMPTY_KEY && this->keys[islot] != key) {
+        islot = (islot + 1) & mask;
+    }
+
+    if (this->keys[islot] == EMPTY_KEY) this->n_entries++;
+    this->keys[islot] = key;
+    this->values[islot] = value;
+}
+
+void EndpointTable::erase(const uint64_t key) {
+    if (this->keys.size() == 0) return;
+
+    const size_t mask = this->keys.size() - 1;
+    size_t islot = this->slot(key);
+    while (this->keys[islot] != key) {
+        if (this->keys[islot] == EMPTY_KEY) return;
+        islot = (islot + 1) & mask;
+    }
+
+    // Shift the entries after this one back so the probe sequences stay unbroken (no tombstones)
+    size_t jslot = islot;
+    while (true) {
+        jslot = (jslot + 1) & mask;
+        if (this->keys[jslot] == EMPTY_KEY) break;
+
+        const size_t kslot = this->slot(this->keys[jslot]);
+        const bool can_move = islot <= jslot ? (kslot <= islot || kslot > jslot) : (kslot <= islot && kslot > jslot);
+        if (can_move) {
+            this->keys[islot] = this->keys[jslot];
+            this->values[islot] = this->values[jslot];
+            islot = jslot;
+        }
+    }
+
+    this->keys[islot] = EMPTY_KEY;
+    this->n_entries--;
+}
+
+void EndpointTable::release() {
+    std::vector<uint64_t>().swap(this->keys);
+    std::vector<int>().swap(this->values);
+    this->n_entries = 0;
+}
+
+int ContourScratch::newFragment(const int value_index) {
+    int ifrag;
+    if (this->free_fragments.size() > 0) {
+        ifrag = this->free_fragments.back();
+        this->free_fragments.pop_back();
+    }
+    else {
+        ifrag = this->fragments.size();
+        this->fragments.emplace_back();
+    }
+
+    this->fragments[ifrag].value_index = value_index;
+    this->fragments[ifrag].serial = this->n_serials;
+    this->open_order[value_index].emplace_back(ifrag, this->n_serials++);
+    return ifrag;
+}
+
+void ContourScratch::freeFragment(const int ifrag) {
+    // Clearing the buffers keeps their capacity for the next fragment that uses this slot
+    Fragment& frag = this->fragments[ifrag];
+    frag.head.clear();
+    frag.tail.clear();
+    frag.value_index = -1;
+    this->free_fragments.push_back(ifrag);
+}
+
+void ContourScratch::appendFragment(Fragment& frag, const Fragment& other) {
+    frag.tail.insert(frag.tail.end(), other.head.rbegin(), other.head.rend());
+    frag.tail.insert(frag.tail.end(), other.tail.begin(), other.tail.end());
+}
+
+void ContourScratch::copyPoints(const Fragment& frag, const bool close, std::vector<Point>& point_list) const {
+    point_list.reserve(frag.head.size() + frag.tail.size() + (close ? 1 : 0));
+    point_list.insert(point_list.end(), frag.head.rbegin(), frag.head.rend());
+    point_list.insert(point_list.end(), frag.tail.begin(), frag.tail.end());
+    if (close) point_list.push_back(point_list.front());
+}
+
+void ContourScratch::release() {
+    std::vector<Fragment>().swap(this->fragments);
+    std::vector<int>().swap(this->free_fragments);
+    std::vector<std::vector<std::pair<int, uint32_t>>>().swap(this->open_order);
+    std::vector<Point>().swap(this->segment);
+    this->frags_by_start.release();
+    this->frags_by_end.release();
+}
+
+void ContourScratch::resetFragments(const int n_values) {
+    this->frags_by_start.clear();
+    this->frags_by_end.clear();
+
+    this->n_serials = 0;
+    if (this->open_order.size() < n_values) this->open_order.resize(n_values);
+    for (int idx = 0; idx < n_values; idx++) {
+        this->open_order[idx].clear();
+    }
+}
+
+template<typename T, typename F>
+void ContourScratch::traceCell(const T esw, const T ese, const T enw, const T ene, const int i, const int j, const int nx, const std::vector<float>& values, 
+                               const bool quad_as_tri, const F& place_point, std::vector<Contour>& contours) {
+    const MarchingSquaresSegmentList* segments = selectSegmentList(quad_as_tri);
     float c;
     char segs_idx;
-    std::vector<Contour> contours;
-    std::unordered_map<float, std::unordered_map<Point, Contour*>> contour_frags_by_start;
-    std::unordered_map<float, std::unordered_map<Point, Contour*>> contour_frags_by_end;
 
-    const MarchingSquaresSegmentList* segments = selectSegmentList(quad_as_tri);
+    T min_grid_val = MIN4(esw, ese, enw, ene);
+    T max_grid_val = MAX4(esw, ese, enw, ene);
+    unsigned int val_idx_lb, val_idx_ub;
+    searchInterval(values, min_grid_val, max_grid_val, val_idx_lb, val_idx_ub);
 
-    if (values.size() == 0) {
-        return contours;
+    if (quad_as_tri && val_idx_lb <= val_idx_ub) {
+        c = ((float)esw + (float)ese + (float)enw + (float)ene) * 0.25;
     }
 
-    for (int i = 0; i < nx - 1; i++) {
-        for (int j = 0; j < ny - 1; j++) {
-            esw = grid[i + nx * j];
-            ese = grid[(i + 1) + nx * j];
-            enw = grid[i + nx * (j + 1)];
-            ene = grid[(i + 1) + nx * (j + 1)];
+    // Segments always start and end on a cell edge, so key the fragment end points by the edge they're on and the contour value
+    const uint64_t n_values = values.size();
+    auto endpointKey = [&](const Point& local_pt, const unsigned int value_idx) {
+        const uint64_t i_edge = i + static_cast<uint64_t>(local_pt.x), j_edge = j + static_cast<uint64_t>(local_pt.y);
+        const uint64_t edge = 2 * (i_edge + j_edge * nx) + (local_pt.x == 0 || local_pt.x == 1 ? 1 : 0);
+        return edge * n_values + value_idx;
+    };
 
-            if (std::isnan(esw) || std::isnan(ese) || std::isnan(enw) || std::isnan(ene)) continue;
+    for (unsigned int idx = val_idx_lb; idx <= val_idx_ub; idx++) {
+        float value = values[idx];
 
-            T min_grid_val = MIN4(esw, ese, enw, ene);
-            T max_grid_val = MAX4(esw, ese, enw, ene);
-            unsigned int val_idx_lb, val_idx_ub;
-            searchInterval(values, min_grid_val, max_grid_val, val_idx_lb, val_idx_ub);
+        segs_idx = char((float)esw > value) + (char((float)ese > value) << 1) + (char((float)ene > value) << 2) + (char((float)enw > value) << 3);
+        bool reverse_segs = false;
 
-            if (quad_as_tri && val_idx_lb <= val_idx_ub) {
-                c = ((float)esw + (float)ese + (float)enw + (float)ene) * 0.25;
+        if (quad_as_tri) {
+            segs_idx += (char(c > value) << 4);
+        }
+        else {
+            if (segs_idx == 5 && abs((float)(esw + ene) * 0.5 - value) > abs((float)(ese + enw) * 0.5 - value)) {
+                segs_idx = 10;
+                reverse_segs = true;
+            }
+            else if (segs_idx == 10 && abs((float)(esw + ene) * 0.5 - value) < abs((float)(ese + enw) * 0.5 - value)) {
+                segs_idx = 5;
+                reverse_segs = true;
             }
+        }
+
+        for (int iseg = 0; iseg < segments->getNumberOfSegments(segs_idx); iseg++) {
+            int n_seg_pts;
+            const Point* seg_pts = segments->getPoints(segs_idx, iseg, n_seg_pts);
 
-            for (unsigned int idx = val_idx_lb; idx <= val_idx_ub; idx++) {
-                float value = values[idx];
+            const Point& seg_start = seg_pts[reverse_segs ? n_seg_pts - 1 : 0];
+            const Point& seg_end = seg_pts[reverse_segs ? 0 : n_seg_pts - 1];
+            const uint64_t start_key = endpointKey(seg_start, idx);
+            const uint64_t end_key = endpointKey(seg_end, idx);
+
+            std::vector<Point>& square_seg = this->segment;
+            square_seg.clear();
+            for (int ipt = 0; ipt < n_seg_pts; ipt++) {
+                square_seg.push_back(place_point(seg_pts[reverse_segs ? n_seg_pts - 1 - ipt : ipt], value));
+            }
 
-                segs_idx = char((float)esw > value) + (char((float)ese > value) << 1) + (char((float)ene > value) << 2) + (char((float)enw > value) << 3);
-                bool reverse_segs = false;
+            const int ifrag1 = this->frags_by_end.find(start_key);
+            const int ifrag2 = this->frags_by_start.find(end_key);
 
-                if (quad_as_tri) {
-                    segs_idx += (char(c > value) << 4);
+            if (ifrag1 >= 0 && ifrag2 >= 0) {
+                // This segment joins two other contour fragments we've seen
+                Fragment& frag1 = this->fragments[ifrag1];
+                frag1.tail.insert(frag1.tail.end(), square_seg.begin() + 1, square_seg.end() - 1);
+
+                this->frags_by_start.erase(end_key);
+                this->frags_by_end.erase(start_key);
+
+                if (ifrag1 != ifrag2) {
+                    // This is really two different contour fragments, so we need to splice them together. The spliced fragment ends where 
+                    //  the second one did.
+                    this->appendFragment(frag1, this->fragments[ifrag2]);
+                    this->frags_by_end.insert(this->fragments[ifrag2].end_key, ifrag1);
+                    frag1.end_key = this->fragments[ifrag2].end_key;
+                    this->freeFragment(ifrag2);
                 }
                 else {
-                    if (segs_idx == 5 && abs((float)(esw + ene) * 0.5 - value) > abs((float)(ese + enw) * 0.5 - value)) {
-                        segs_idx = 10;
-                        reverse_segs = true;
-                    }
-                    else if (segs_idx == 10 && abs((float)(esw + ene) * 0.5 - value) < abs((float)(ese + enw) * 0.5 - value)) {
-                        segs_idx = 5;
-                        reverse_segs = true;
-                    }
-                }
-
-                for (int iseg = 0; iseg < segments->getNumberOfSegments(segs_idx); iseg++) {
-                    Contour *square_seg = new Contour(segments->getPointList(segs_idx, iseg, reverse_segs), value);
-
-                    for (auto it = square_seg->point_list.begin(); it != square_seg->point_list.end(); ++it) {
-                        it->x += i;
-                        it->y += j;
-                    }
-
-                    Point start_pt = square_seg->point_list.front();
-                    Point end_pt = square_seg->point_list.back();
-
-                    bool start_seen = contour_frags_by_end[value].find(start_pt) != contour_frags_by_end[value].end();
-                    bool end_seen = contour_frags_by_start[value].find(end_pt) != contour_frags_by_start[value].end();
-
-                    if (start_seen && end_seen) {
-                        // This segment joins two other contour fragments we've seen
-                        Contour* frag1 = contour_frags_by_end[value][start_pt];
-                        Contour* frag2 = contour_frags_by_start[value][end_pt];
-
-                        frag1->point_list.insert(frag1->point_list.end(), square_seg->point_list.begin() + 1, square_seg->point_list.end() - 1);
-
-                        if (frag1 != frag2) {
-                            // This is really two different contour fragments, so we need to splice them together
-                            frag1->point_list.insert(frag1->point_list.end(), frag2->point_list.begin(), frag2->point_list.end());
-                        }
-                        else {
-                            // This is actually the same contour fragment, so we're closing it.
-                            frag1->point_list.push_back(frag2->point_list.front());
-                            contours.push_back(*frag1);
-                        }
-
-                        contour_frags_by_start[value].erase(end_pt);
-                        contour_frags_by_end[value].erase(start_pt);
-
-                        if (frag1 != frag2) {
-                            // This contour isn't closed yet, so put it back in the maps
-                            contour_frags_by_start[value][frag1->point_list.front()] = frag1;
-                            contour_frags_by_end[value][frag1->point_list.back()] = frag1;
-
-                            delete frag2;
-                            frag2 = NULL;
-                        }
-                        else {
-                            delete frag1;
-                            frag1 = NULL;
-                        }
-
-                        delete square_seg;
-                    }
-                    else if (start_seen) {
-                        // The starting point for this segment is the ending point for some other contour
-                        Contour* frag = contour_frags_by_end[value][start_pt];
-                        frag->point_list.insert(frag->point_list.end(), square_seg->point_list.begin() + 1, square_seg->point_list.end());
-
-                        contour_frags_by_end[value].erase(start_pt);
-                        contour_frags_by_end[value][end_pt] = frag;
-                        delete square_seg;
-                    } 
-                    else if (end_seen) {
-                        // The ending point for this segment is the start point for some other contour
-                        Contour* frag = contour_frags_by_start[value][end_pt];
-                        frag->point_list.insert(frag->point_list.begin(), square_seg->point_list.begin(), square_seg->point_list.end() - 1);
-
-                        contour_frags_by_start[value].erase(end_pt);
-                        contour_frags_by_start[value][start_pt] = frag;
-                        delete square_seg;
-                    }
-                    else {
-                        // New contour segment
-                        contour_frags_by_start[value][start_pt] = square_seg;
-                        contour_frags_by_end[value][end_pt] = square_seg;
-                    }
+                    // This is actually the same contour fragment, so we're closing it.
+                    contours.emplace_back(std::vector<Point>(), value);
+                    this->copyPoints(frag1, true, contours.back().point_list);
+                    this->freeFragment(ifrag1);
                 }
             }
+            else if (ifrag1 >= 0) {
+                // The starting point for this segment is the ending point for some other contour
+                Fragment& frag = this->fragments[ifrag1];
+                frag.tail.insert(frag.tail.end(), square_seg.begin() + 1, square_seg.end());
+
+                this->frags_by_end.erase(start_key);
+                this->frags_by_end.insert(end_key, ifrag1);
+                frag.end_key = end_key;
+            } 
+            else if (ifrag2 >= 0) {
+                // The ending point for this segment is the start point for some other contour
+                Fragment& frag = this->fragments[ifrag2];
+                frag.head.insert(frag.head.end(), square_seg.rbegin() + 1, square_seg.rend());
+
+                this->frags_by_start.erase(end_key);
+                this->frags_by_start.insert(start_key, ifrag2);
+            }
+            else {
+                // New contour segment
+                const int ifrag = this->newFragment(idx);
+                Fragment& frag = this->fragments[ifrag];
+                frag.tail.assign(square_seg.begin(), square_seg.end());
+                frag.end_key = end_key;
+
+                this->frags_by_start.insert(start_key, ifrag);
+                this->frags_by_end.insert(end_key, ifrag);
+            }
         }
     }
+}
+
+void ContourScratch::collectOpenContours(const std::vector<float>& values, std::vector<Contour>& contours) {
+    // The contours that intersect the edge of the grid will still be open fragments, so add them to the contour list
+    for (int idx = 0; idx < values.size(); idx++) {
+        for (auto it = this->open_order[idx].rbegin(); it != this->open_order[idx].rend(); ++it) {
+            const std::pair<int, uint32_t>& open = *it;
+            const Fragment& frag = this->fragments[open.first];
+            if (frag.value_index != idx || frag.serial != open.second) continue;
+
+            contours.emplace_back(std::vector<Point>(), values[idx]);
+            this->copyPoints(frag, false, contours.back().point_list);
+            this->freeFragment(open.first);
+        }
+
+        this->open_order[idx].clear();
+    }
+}
+
+template<typename T>
+std::vector<Contour> ContourScratch::traceContours(const T* grid, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri) {
+    std::vector<Contour> contours;
+
+    if (values.size() == 0) {
+        return contours;
+    }
+
+    this->resetFragments(values.size());
 
-    for (auto vit = values.begin(); vit != values.end(); ++vit) {
-        float value = *vit;
+    for (int i = 0; i < nx - 1; i++) {
+        for (int j = 0; j < ny - 1; j++) {
+            T esw = grid[i + nx * j];
+            T ese = grid[(i + 1) + nx * j];
+            T enw = grid[i + nx * (j + 1)];
+            T ene = grid[(i + 1) + nx * (j + 1)];
 
-        // The contours that intersect the edge of the grid will still be in the "fragments" maps, so add them to the contour list
-        for (auto it = contour_frags_by_start[value].begin(); it != contour_frags_by_start[value].end(); ++it) {
-            Contour* contour = it->second;
-            contours.push_back(*contour);
+            if (std::isnan(esw) || std::isnan(ese) || std::isnan(enw) || std::isnan(ene)) continue;
 
-            delete contour;
-            contour = NULL;
+            // Leave the points in grid index space; they get interpolated once all the contours are traced
+            auto place_point = [i, j](const Point& local_pt, const float value) { return Point(local_pt.x + i, local_pt.y + j); };
+            this->traceCell(esw, ese, enw, ene, i, j, nx, values, quad_as_tri, place_point, contours);
         }
     }
 
-    // Do the actual interpolation
+    this->collectOpenContours(values, contours);
+
+    return contours;
+}
+
+// Coordinates for a rectilinear grid, given as 1-D arrays of the x and y coordinates
+struct RectilinearCoords {
+    const float* xs;
+    const float* ys;
+
+    RectilinearCoords(const float* xs, const float* ys) : xs(xs), ys(ys) {}
+
+    Point at(const int i, const int j) const {
+        return Point(this->xs[i], this->ys[j]);
+    }
+
+    Point center(const int i, const int j) const {
+        return Point((this->xs[i] + this->xs[i + 1]) * 0.5, (this->ys[j] + this->ys[j + 1]) * 0.5);
+    }
+};
+
+// Coordinates for a curvilinear grid, given as 2-D arrays of the x and y coordinates of every grid point
+struct CurvilinearCoords {
+    const float* xs;
+    const float* ys;
+    const int nx;
+
+    CurvilinearCoords(const float* xs, const float* ys, const int nx) : xs(xs), ys(ys), nx(nx) {}
+
+    Point at(const int i, const int j) const {
+        const int idx = i + this->nx * j;
+        return Point(this->xs[idx], this->ys[idx]);
+    }
+
+    Point center(const int i, const int j) const {
+        const int idx_sw = i + this->nx * j;
+        const int idx_nw = i + this->nx * (j + 1);
+        return Point((this->xs[idx_sw] + this->xs[idx_sw + 1] + this->xs[idx_nw] + this->xs[idx_nw + 1]) * 0.25, 
+                     (this->ys[idx_sw] + this->ys[idx_sw + 1] + this->ys[idx_nw] + this->ys[idx_nw + 1]) * 0.25);
+    }
+};
+
+inline Point lerp(const Point& pt1, const Point& pt2, const float alpha) {
+    return Point(pt1.x * (1 - alpha) + pt2.x * alpha, pt1.y * (1 - alpha) + pt2.y * alpha);
+}
+
+// Interpolate a point given in the local coordinates of cell (i, j) (0 to 1 in each direction) to the coordinates of the grid. Points on the
+//  cell edges are interpolated along the edge, and points inside the cell are interpolated toward the cell center.
+template<typename C>
+inline Point interpolateCellPoint(const Point& local_pt, const float value, const int i, const int j, const float grid_sw, const float grid_se, 
+                                  const float grid_nw, const float grid_ne, const C& coords) {
+    if (local_pt.y == 0) {
+        return lerp(coords.at(i, j), coords.at(i + 1, j), (value - grid_sw) / (grid_se - grid_sw));
+    }
+    else if (local_pt.y == 1) {
+        return lerp(coords.at(i, j + 1), coords.at(i + 1, j + 1), (value - grid_nw) / (grid_ne - grid_nw));
+    }
+    else if (local_pt.x == 0) {
+        return lerp(coords.at(i, j), coords.at(i, j + 1), (value - grid_sw) / (grid_nw - grid_sw));
+    }
+    else if (local_pt.x == 1) {
+        return lerp(coords.at(i + 1, j), coords.at(i + 1, j + 1), (value - grid_se) / (grid_ne - grid_se));
+    }
+
+    // Neither x nor y are 0 or 1, so we're in the middle of the cell, and it's time to use the center point
+    float grid_c = (grid_sw + grid_se + grid_nw + grid_ne) * 0.25;
+    Point pt_c = coords.center(i, j);
+
+    if (local_pt.x < 0.5 && local_pt.y < 0.5) {
+        return lerp(coords.at(i, j), pt_c, (value - grid_sw) / (grid_c - grid_sw));
+    }
+    else if (local_pt.x > 0.5 && local_pt.y < 0.5) {
+        return lerp(coords.at(i + 1, j), pt_c, (value - grid_se) / (grid_c - grid_se));
+    }
+    else if (local_pt.x < 0.5 && local_pt.y > 0.5) {
+        return lerp(coords.at(i, j + 1), pt_c, (value - grid_nw) / (grid_c - grid_nw));
+    }
+
+    return lerp(coords.at(i + 1, j + 1), pt_c, (value - grid_ne) / (grid_c - grid_ne));
+}
+
+// Convert the contour points from grid index space to the coordinates of the grid
+template<typename T, typename C>
+void interpolateContours(std::vector<Contour>& contours, const T* grid, const C& coords, const int nx, const int ny) {
     for (auto it = contours.begin(); it != contours.end(); ++it) {
         float value = it->value;
 
         for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
-            float x_floor = floorf(plit->x), y_floor = floorf(plit->y);
-            int i = static_cast<int>(x_floor), j = static_cast<int>(y_floor);
+            // Points on the east or north edge of the grid belong to the last column or row of cells
+            const int i = std::min(static_cast<int>(floorf(plit->x)), nx - 2);
+            const int j = std::min(static_cast<int>(floorf(plit->y)), ny - 2);
 
-            if (x_floor != plit->x && y_floor == plit->y) {
-                // y is either 0 or 1, but x is not, so it's on either the north or south edge of the cell
-                float grid1 = static_cast<float>(grid[i + j * nx]);
-                float grid2 = static_cast<float>(grid[(i + 1) + j * nx]);
-                float alpha = (value - grid1) / (grid2 - grid1);
+            const float grid_sw = static_cast<float>(grid[i + nx * j]);
+            const float grid_se = static_cast<float>(grid[(i + 1) + nx * j]);
+            const float grid_nw = static_cast<float>(grid[i + nx * (j + 1)]);
+            const float grid_ne = static_cast<float>(grid[(i + 1) + nx * (j + 1)]);
 
-                plit->x = xs[i] * (1 - alpha) + xs[i + 1] * alpha;
-                plit->y = ys[j];
-            }
-            else if (x_floor == plit->x && y_floor != plit->y) {
-                // x is either 0 or 1, but y is not, so it's either on the east or west edge of the cell
-                float grid1 = static_cast<float>(grid[i + j * nx]);
-                float grid2 = static_cast<float>(grid[i + (j + 1) * nx]);
-                float alpha = (value - grid1) / (grid2 - grid1);
-
-                plit->x = xs[i];
-                plit->y = ys[j] * (1 - alpha) + ys[j + 1] * alpha;
-            }
-            else {
-                // neither x nor y are 0 or 1, so we're in the middle of the cell, and it's time to use the center point
-                float grid_sw = static_cast<float>(grid[i + nx * j]);
-                float grid_se = static_cast<float>(grid[(i + 1) + nx * j]);
-                float grid_nw = static_cast<float>(grid[i + nx * (j + 1)]);
-                float grid_ne = static_cast<float>(grid[(i + 1) + nx * (j + 1)]);
-                float grid_c = (grid_sw + grid_se + grid_nw + grid_ne) * 0.25;
-                float x_c = (xs[i] + xs[i + 1]) * 0.5;
-                float y_c = (ys[j] + ys[j + 1]) * 0.5;
-
-                float residual_x = plit->x - x_floor;
-                float residual_y = plit->y - y_floor;
-
-                if (residual_x < 0.5 && residual_y < 0.5) {
-                    float alpha = (value - grid_sw) / (grid_c - grid_sw);
-                    plit->x = xs[i] * (1 - alpha) + x_c * alpha;
-                    plit->y = ys[j] * (1 - alpha) + y_c * alpha;
-                }
-                else if (residual_x > 0.5 && residual_y < 0.5) {
-                    float alpha = (value - grid_se) / (grid_c - grid_se);
-                    plit->x = xs[i + 1] * (1 - alpha) + x_c * alpha;
-                    plit->y = ys[j] * (1 - alpha) + y_c * alpha;
-                }
-                else if (residual_x < 0.5 && residual_y > 0.5) {
-                    float alpha = (value - grid_nw) / (grid_c - grid_nw);
-                    plit->x = xs[i] * (1 - alpha) + x_c * alpha;
-                    plit->y = ys[j + 1] * (1 - alpha) + y_c * alpha;
-                }
-                else {
-                    float alpha = (value - grid_ne) / (grid_c - grid_ne);
-                    plit->x = xs[i + 1] * (1 - alpha) + x_c * alpha;
-                    plit->y = ys[j + 1] * (1 - alpha) + y_c * alpha;
-                }
-            }
+            *plit = interpolateCellPoint(Point(plit->x - i, plit->y - j), value, i, j, grid_sw, grid_se, grid_nw, grid_ne, coords);
         }
     }
+}
+
+template<typename T>
+std::vector<Contour> makeContours(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri,
+                                  ContourScratch& scratch) {
+    std::vector<Contour> contours = scratch.traceContours(grid, nx, ny, values, quad_as_tri);
+    interpolateContours(contours, grid, RectilinearCoords(xs, ys), nx, ny);
+    return contours;
+};
+
+template<typename T>
+std::vector<Contour> makeContoursCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri,
+                                             ContourScratch& scratch) {
+    std::vector<Contour> contours = scratch.traceContours(grid, nx, ny, values, quad_as_tri);
+    interpolateContours(contours, grid, CurvilinearCoords(xs, ys, nx), nx, ny);
+    return contours;
+};
+
+// Each thread (i.e., each contouring worker) keeps its own scratch space between calls
+static ContourScratch& getThreadScratch() {
+    static thread_local ContourScratch scratch;
+    return scratch;
+}
+
+void releaseContourScratch() {
+    getThreadScratch().release();
+}
+
+template<typename T>
+std::vector<Contour> makeContours(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri) {
+    return makeContours(grid, xs, ys, nx, ny, values, quad_as_tri, getThreadScratch());
+};
+
+template<typename T>
+std::vector<Contour> makeContoursCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri) {
+    return makeContoursCurvilinear(grid, xs, ys, nx, ny, values, quad_as_tri, getThreadScratch());
+};
+
+// Copy the cells in the box out of the grid and trace them, then move the contours back to the full grid's index space, so they can be 
+//  interpolated with the full grid's coordinates
+template<typename T, typename C>
+static std::vector<Contour> makeContoursInBox_(const T* grid, const C& coords, const int nx, const int ny, const std::vector<float>& values, 
+                                               const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags) {
+    const int i_min = std::max(box.i_min, 0), i_max = std::min(box.i_max, nx - 2);
+    const int j_min = std::max(box.j_min, 0), j_max = std::min(box.j_max, ny - 2);
+
+    cut_flags.clear();
+    if (i_min > i_max || j_min > j_max) return {};
+
+    const int sub_nx = i_max - i_min + 2, sub_ny = j_max - j_min + 2;
+    std::vector<T> sub_grid(sub_nx * sub_ny);
+    for (int j = 0; j < sub_ny; j++) {
+        std::copy(grid + i_min + nx * (j + j_min), grid + i_min + sub_nx + nx * (j + j_min), sub_grid.begin() + sub_nx * j);
+    }
 
-    delete segments;
+    std::vector<Contour> contours = getThreadScratch().traceContours(sub_grid.data(), sub_nx, sub_ny, values, quad_as_tri);
+
+    // An end on the edge of the box is a cut if that edge isn't also the edge of the grid
+    auto isCut = [&](const Point& pt) {
+        return (pt.x == 0 && i_min > 0) || (pt.x == sub_nx - 1 && i_max < nx - 2) || (pt.y == 0 && j_min > 0) || (pt.y == sub_ny - 1 && j_max < ny - 2);
+    };
+
+    cut_flags.resize(contours.size());
+    for (int icntr = 0; icntr < contours.size(); icntr++) {
+        std::vector<Point>& point_list = contours[icntr].point_list;
+
+        uint8_t flags = 0;
+        if (!(point_list.front() == point_list.back())) {
+            if (isCut(point_list.front())) flags |= CONTOUR_CUT_START;
+            if (isCut(point_list.back())) flags |= CONTOUR_CUT_END;
+        }
+        cut_flags[icntr] = flags;
+
+        for (auto plit = point_list.begin(); plit != point_list.end(); ++plit) {
+            plit->x += i_min;
+            plit->y += j_min;
+        }
+    }
 
+    interpolateContours(contours, grid, coords, nx, ny);
     return contours;
+}
+
+template<typename T>
+std::vector<Contour> makeContoursInBox(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                       const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags) {
+    return makeContoursInBox_(grid, RectilinearCoords(xs, ys), nx, ny, values, quad_as_tri, box, cut_flags);
+}
+
+template<typename T>
+std::vector<Contour> makeContoursCurvilinearInBox(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                  const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags) {
+    return makeContoursInBox_(grid, CurvilinearCoords(xs, ys, nx), nx, ny, values, quad_as_tri, box, cut_flags);
+}
+
+// Coordinates for the two rows of a streamed grid that the current row of cells sits between
+struct RowPairCoords {
+    const float* xs;
+    const float y_south;
+    const float y_north;
+    const int j_south;
+
+    RowPairCoords(const float* xs, const float y_south, const float y_north, const int j_south) : xs(xs), y_south(y_south), y_north(y_north), j_south(j_south) {}
+
+    Point at(const int i, const int j) const {
+        return Point(this->xs[i], j == this->j_south ? this->y_south : this->y_north);
+    }
+
+    Point center(const int i, const int j) const {
+        return Point((this->xs[i] + this->xs[i + 1]) * 0.5, (this->y_south + this->y_north) * 0.5);
+    }
 };
 
+template<typename T>
+ContourStream<T>::ContourStream(const float* xs, const int nx, const std::vector<float>& values, const bool quad_as_tri) : 
+    xs(xs, xs + nx), values(values), quad_as_tri(quad_as_tri), last_row(nx), last_y(0.), n_rows(0) {
+    this->scratch.resetFragments(values.size());
+}
+
+template<typename T>
+std::vector<Contour> ContourStream<T>::pushRows(const T* rows, const float* ys, const int n_rows) {
+    std::vector<Contour> contours;
+    const int nx = this->xs.size();
+
+    for (int irow = 0; irow < n_rows; irow++) {
+        const T* row = rows + irow * nx;
+
+        if (this->n_rows > 0 && this->values.size() > 0) {
+            // Trace the row of cells between the last row and this one. The points are interpolated right away, since the rows won't be 
+            //  around after this.
+            const int j = this->n_rows - 1;
+            RowPairCoords coords(this->xs.data(), this->last_y, ys[irow], j);
+
+            for (int i = 0; i < nx - 1; i++) {
+                T esw = this->last_row[i];
+                T ese = this->last_row[i + 1];
+                T enw = row[i];
+                T ene = row[i + 1];
+
+                if (std::isnan(esw) || std::isnan(ese) || std::isnan(enw) || std::isnan(ene)) continue;
+
+                auto place_point = [&](const Point& local_pt, const float value) {
+                    return interpolateCellPoint(local_pt, value, i, j, static_cast<float>(esw), static_cast<float>(ese), static_cast<float>(enw), 
+                                                static_cast<float>(ene), coords);
+                };
+                this->scratch.traceCell(esw, ese, enw, ene, i, j, nx, this->values, this->quad_as_tri, place_point, contours);
+            }
+        }
+
+        std::copy(row, row + nx, this->last_row.begin());
+        this->last_y = ys[irow];
+        this->n_rows++;
+    }
+
+    return contours;
+}
+
+template<typename T>
+std::vector<Contour> ContourStream<T>::finish() {
+    std::vector<Contour> contours;
+    this->scratch.collectOpenContours(this->values, contours);
+    return contours;
+}
+
+template class ContourStream<float>;
+template class ContourStream<float16_t>;
+
+template std::vector<Contour> ContourScratch::traceContours(const float* grid, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri);
+template std::vector<Contour> ContourScratch::traceContours(const float16_t* grid, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri);
+template std::vector<Contour> makeContours(const float* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri,
+                                           ContourScratch& scratch);
+template std::vector<Contour> makeContours(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri,
+                                           ContourScratch& scratch);
+template std::vector<Contour> makeContoursCurvilinear(const float* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, 
+                                                      const bool quad_as_tri, ContourScratch& scratch);
+template std::vector<Contour> makeContoursCurvilinear(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, 
+                                                      const bool quad_as_tri, ContourScratch& scratch);
 template std::vector<Contour> makeContours(const float* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri);
 template std::vector<Contour> makeContours(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri);
+template std::vector<Contour> makeContoursCurvilinear(const float* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri);
+template std::vector<Contour> makeContoursCurvilinear(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& value, const bool quad_as_tri);
+
+// Halve a pyramid level. Each level is decimated from the one before it, so building the whole pyramid costs less than one extra pass 
+//  over the full-resolution grid.
+template<typename T>
+static void decimatePyramidLevel(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const bool curvilinear, 
+                                 const bool preserve_extrema, std::vector<float>& grid_out, std::vector<float>& xs_out, std::vector<float>& ys_out) {
+    const int nx_out = (nx + 1) / 2, ny_out = (ny + 1) / 2;
+    grid_out.resize(nx_out * ny_out);
+
+    if (preserve_extrema) {
+        decimateGridExtrema(grid, nx, ny, 2, grid_out.data());
+    }
+    else {
+        decimateGrid(grid, nx, ny, 2, grid_out.data());
+    }
+
+    if (curvilinear) {
+        xs_out.resize(nx_out * ny_out);
+        ys_out.resize(nx_out * ny_out);
+        decimateGrid(xs, nx, ny, 2, xs_out.data());
+        decimateGrid(ys, nx, ny, 2, ys_out.data());
+    }
+    else {
+        xs_out.resize(nx_out);
+        ys_out.resize(ny_out);
+        decimateCoords(xs, nx, 2, xs_out.data());
+        decimateCoords(ys, ny, 2, ys_out.data());
+    }
+}
+
+template<typename T>
+static std::vector<std::vector<Contour>> makeContourPyramid_(const T* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                             const std::vector<float>& values, const int n_levels, const bool quad_as_tri, 
+                                                             const bool preserve_extrema, const bool curvilinear) {
+    auto contour = [&](const auto* lev_grid, const float* lev_xs, const float* lev_ys, int lev_nx, int lev_ny) {
+        return curvilinear ? makeContoursCurvilinear(lev_grid, lev_xs, lev_ys, lev_nx, lev_ny, values, quad_as_tri)
+                           : makeContours(lev_grid, lev_xs, lev_ys, lev_nx, lev_ny, values, quad_as_tri);
+    };
+
+    std::vector<std::vector<Contour>> pyramid;
+    pyramid.push_back(contour(grid, xs, ys, nx, ny));
+
+    std::vector<float> lev_grid, lev_xs, lev_ys, next_grid, next_xs, next_ys;
+    int lev_nx = nx, lev_ny = ny;
+
+    for (int ilev = 1; ilev < n_levels && lev_nx > 2 && lev_ny > 2; ilev++) {
+        if (ilev == 1) {
+            decimatePyramidLevel(grid, xs, ys, lev_nx, lev_ny, curvilinear, preserve_extrema, next_grid, next_xs, next_ys);
+        }
+        else {
+            decimatePyramidLevel(lev_grid.data(), lev_xs.data(), lev_ys.data(), lev_nx, lev_ny, curvilinear, preserve_extrema, next_grid, next_xs, next_ys);
+        }
+
+        lev_grid.swap(next_grid);
+        lev_xs.swap(next_xs);
+        lev_ys.swap(next_ys);
+        lev_nx = (lev_nx + 1) / 2;
+        lev_ny = (lev_ny + 1) / 2;
+
+        pyramid.push_back(contour(lev_grid.data(), lev_xs.data(), lev_ys.data(), lev_nx, lev_ny));
+    }
+
+    return pyramid;
+}
+
+template<typename T>
+std::vector<std::vector<Contour>> makeContourPyramid(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                     const int n_levels, const bool quad_as_tri, const bool preserve_extrema) {
+    return makeContourPyramid_(grid, xs, ys, nx, ny, values, n_levels, quad_as_tri, preserve_extrema, false);
+}
+
+template<typename T>
+std::vector<std::vector<Contour>> makeContourPyramidCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                                const std::vector<float>& values, const int n_levels, const bool quad_as_tri, 
+                                                                const bool preserve_extrema) {
+    return makeContourPyramid_(grid, xs, ys, nx, ny, values, n_levels, quad_as_tri, preserve_extrema, true);
+}
+
+template std::vector<Contour> makeContoursInBox(const float* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags);
+template std::vector<Contour> makeContoursInBox(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags);
+template std::vector<Contour> makeContoursCurvilinearInBox(const float* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                           const std::vector<float>& values, const bool quad_as_tri, const CellBox& box, 
+                                                           std::vector<uint8_t>& cut_flags);
+template std::vector<Contour> makeContoursCurvilinearInBox(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                           const std::vector<float>& values, const bool quad_as_tri, const CellBox& box, 
+                                                           std::vector<uint8_t>& cut_flags);
+
+template std::vector<std::vector<Contour>> makeContourPyramid(const float* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                              const std::vector<float>& values, const int n_levels, const bool quad_as_tri, const bool preserve_extrema);
+template std::vector<std::vector<Contour>> makeContourPyramid(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                              const std::vector<float>& values, const int n_levels, const bool quad_as_tri, const bool preserve_extrema);
+template std::vector<std::vector<Contour>> makeContourPyramidCurvilinear(const float* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                                         const std::vector<float>& values, const int n_levels, const bool quad_as_tri, 
+                                                                         const bool preserve_extrema);
+template std::vector<std::vector<Contour>> makeContourPyramidCurvilinear(const float16_t* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                                         const std::vector<float>& values, const int n_levels, const bool quad_as_tri, 
+                                                                         const bool preserve_extrema);
+
+void smoothContours(std::vector<Contour>& contours, const int n_iterations) {
+    std::vector<Point> smoothed;
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        std::vector<Point>& pts = it->point_list;
+        if (pts.size() < 3) continue;
+
+        const bool is_closed = pts.front() == pts.back();
+
+        for (int iter = 0; iter < n_iterations; iter++) {
+            const int n_segs = pts.size() - 1;
+            smoothed.clear();
+            smoothed.reserve(2 * n_segs + 1);
+
+            if (!is_closed) smoothed.push_back(pts.front());
+
+            // Replace each segment with points 1/4 and 3/4 of the way along it. Open contours keep the first and last points instead of
+            //  cutting the first and last segments.
+            for (int iseg = 0; iseg < n_segs; iseg++) {
+                const Point& pt1 = pts[iseg];
+                const Point& pt2 = pts[iseg + 1];
+
+                if (is_closed || iseg > 0) smoothed.push_back(lerp(pt1, pt2, 0.25));
+                if (is_closed || iseg < n_segs - 1) smoothed.push_back(lerp(pt1, pt2, 0.75));
+            }
+
+            if (is_closed) {
+                smoothed.push_back(smoothed.front());
+            }
+            else {
+                smoothed.push_back(pts.back());
+            }
+
+            pts.swap(smoothed);
+        }
+    }
+}
 
 template<typename T>
 std::vector<float> getContourLevels(T* grid, int nx, int ny, float interval) noexcept {
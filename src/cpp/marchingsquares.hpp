@@ -3,6 +3,7 @@
 #define __AUTUMNPLOT_MARCHINGSQUARES_H__
 
 #include <vector>
+#include <cstdint>
 
 template<typename T>
 bool isClose_(T a, T b) {
@@ -49,6 +50,8 @@ struct Contour {
     float value;
 
     Contour(const std::vector<Point>& point_list, const float value) noexcept : point_list(point_list), value(value) {};
+    Contour(const Contour& other) = default;
+    Contour(Contour&& other) noexcept = default;
 
     bool isClose(const Contour& other) const noexcept {
         bool equals = this->value == other.value && this->point_list.size() == other.point_list.size();
@@ -80,9 +83,161 @@ struct Contour {
     }
 };
 
+// Open-addressed hash table from contour fragment end points to fragment indices. Clearing it keeps its slots, so it doesn't allocate 
+//  again once it has grown to the size of the largest grid it has seen.
+class EndpointTable {
+    std::vector<uint64_t> keys;
+    std::vector<int> values;
+    size_t n_entries;
+
+    size_t slot(const uint64_t key) const;
+    void grow();
+
+    public:
+        EndpointTable() : n_entries(0) {}
+
+        void clear();
+        int find(const uint64_t key) const;
+        void insert(const uint64_t key, const int value);
+        void erase(const uint64_t key);
+        void release();
+};
+
+// Reusable working memory for contouring. Contour fragments are kept in a pool of point buffers that are recycled as fragments get 
+//  joined, and the buffers and end point tables are kept between calls, so repeated contouring with the same scratch space (e.g., a worker 
+//  cycling through forecast hours) stops allocating once it has warmed up, apart from the returned contours themselves.
+class ContourScratch {
+    // A fragment's points are head (reversed) followed by tail, so points can be added to either end without moving the others
+    struct Fragment {
+        std::vector<Point> head;
+        std::vector<Point> tail;
+        int value_index;
+        uint32_t serial;
+        uint64_t end_key;
+    };
+
+    std::vector<Fragment> fragments;
+    std::vector<int> free_fragments;
+    std::vector<Point> segment;
+    EndpointTable frags_by_start;
+    EndpointTable frags_by_end;
+
+    // The fragments for each contour value in the order they were started, as (fragment index, serial) pairs. The contours that reach the 
+    //  edge of the grid come out newest first, which doesn't depend on hashing and matches the hash map-based tracer on small grids. 
+    //  Fragment slots get reused, so an entry only counts if the fragment in that slot still has the same serial. The lists are cleared in 
+    //  place, so they keep their capacity between calls.
+    std::vector<std::vector<std::pair<int, uint32_t>>> open_order;
+    uint32_t n_serials;
+
+    int newFragment(const int value_index);
+    void freeFragment(const int ifrag);
+    void appendFragment(Fragment& frag, const Fragment& other);
+    void copyPoints(const Fragment& frag, const bool close, std::vector<Point>& point_list) const;
+
+    void resetFragments(const int n_values);
+    void collectOpenContours(const std::vector<float>& values, std::vector<Contour>& contours);
+
+    // Trace cell (i, j) and join its segments onto the open fragments. place_point maps points from the cell's local coordinates to the 
+    //  coordinates stored in the fragments, and contours that close are added to contours.
+    template<typename T, typename F>
+    void traceCell(const T esw, const T ese, const T enw, const T ene, const int i, const int j, const int nx, const std::vector<float>& values, 
+                   const bool quad_as_tri, const F& place_point, std::vector<Contour>& contours);
+
+    template<typename T> friend class ContourStream;
+
+    public:
+        // Trace out the contours in grid index space
+        template<typename T>
+        std::vector<Contour> traceContours(const T* grid, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri);
+
+        // Give all the memory back (e.g., after contouring an unusually large grid)
+        void release();
+};
+
+// Push-style contouring for grids that arrive a few rows at a time (e.g., as they're decoded). Only the last row and the open contour 
+//  fragments are kept between pushes, and contours are returned as soon as they close. The points are in grid coordinates (the xs given to 
+//  the constructor and the y coordinates given with each row).
+template<typename T>
+class ContourStream {
+    std::vector<float> xs;
+    std::vector<float> values;
+    bool quad_as_tri;
+    std::vector<T> last_row;
+    float last_y;
+    int n_rows;
+    ContourScratch scratch;
+
+    public:
+        ContourStream(const float* xs, const int nx, const std::vector<float>& values, const bool quad_as_tri);
+
+        // Add the next n_rows rows of the grid (an nx x n_rows row-major block) with y coordinates ys. Returns the contours that closed.
+        std::vector<Contour> pushRows(const T* rows, const float* ys, const int n_rows);
+
+        // Finish the grid and return the contours that are still open (the ones that end at the edge of the grid or at missing data)
+        std::vector<Contour> finish();
+
+        int getNumRows() const { return this->n_rows; }
+};
+
+// Contour the grid using the given scratch space. The versions without a scratch argument use a scratch space that's kept per thread.
+template<typename T>
+std::vector<Contour> makeContours(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri,
+                                  ContourScratch& scratch);
+
 template<typename T>
 std::vector<Contour> makeContours(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri);
 
+// Same as makeContours(), but xs and ys are nx x ny arrays giving the coordinates of every grid point
+template<typename T>
+std::vector<Contour> makeContoursCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri,
+                                             ContourScratch& scratch);
+
+template<typename T>
+std::vector<Contour> makeContoursCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, const bool quad_as_tri);
+
+// Give back the memory in this thread's scratch space
+void releaseContourScratch();
+
+// A box of grid cells, from cell (i_min, j_min) to cell (i_max, j_max), inclusive. Cell (i, j) has grid point (i, j) at its lower-left corner.
+struct CellBox {
+    int i_min;
+    int j_min;
+    int i_max;
+    int j_max;
+};
+
+// Flags for contour ends that were cut off at the edge of a cell box, as opposed to ending at the edge of the grid or at missing data
+const uint8_t CONTOUR_CUT_START = 1;
+const uint8_t CONTOUR_CUT_END = 2;
+
+// Contour only the cells in box (clamped to the grid), e.g., the cells in view plus a margin. The contours are the same as makeContours() 
+//  would give inside the box. cut_flags gets CONTOUR_CUT_START and/or CONTOUR_CUT_END for each contour whose ends were cut at the box edge.
+template<typename T>
+std::vector<Contour> makeContoursInBox(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                       const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags);
+
+// Same as makeContoursInBox(), but for curvilinear grids (see makeContoursCurvilinear())
+template<typename T>
+std::vector<Contour> makeContoursCurvilinearInBox(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                  const bool quad_as_tri, const CellBox& box, std::vector<uint8_t>& cut_flags);
+
+// Contour the grid at up to n_levels resolutions for drawing at different map zooms. Level k is the grid decimated by 2^k (block averages,
+//  or block extrema if preserve_extrema is set, so small highs and lows still get closed contours). Stops early once the decimated grid 
+//  gets down to 2 points on a side, so the result may have fewer than n_levels levels.
+template<typename T>
+std::vector<std::vector<Contour>> makeContourPyramid(const T* grid, const float* xs, const float* ys, const int nx, const int ny, const std::vector<float>& values, 
+                                                     const int n_levels, const bool quad_as_tri, const bool preserve_extrema);
+
+// Same as makeContourPyramid(), but for curvilinear grids (see makeContoursCurvilinear())
+template<typename T>
+std::vector<std::vector<Contour>> makeContourPyramidCurvilinear(const T* grid, const float* xs, const float* ys, const int nx, const int ny, 
+                                                                const std::vector<float>& values, const int n_levels, const bool quad_as_tri, 
+                                                                const bool preserve_extrema);
+
+// Smooth contours in place with n_iterations passes of Chaikin's corner cutting. Closed contours stay closed, and open contours keep their 
+//  end points, so they still end at the edge of the grid or missing data.
+void smoothContours(std::vector<Contour>& contours, const int n_iterations);
+
 template<typename T>
 std::vector<float> getContourLevels(T* grid, int nx, int ny, float interval) noexcept;
 
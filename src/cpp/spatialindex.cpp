@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <queue>
+
+#include "spatialindex.hpp"
+
+PointIndex::PointIndex(const float* xs, const float* ys, const int n_pts, const int node_size) : node_size(node_size) {
+    for (int ipt = 0; ipt < n_pts; ipt++) {
+        if (std::isnan(xs[ipt]) || std::isnan(ys[ipt])) continue;
+        this->ids.push_back(ipt);
+    }
+
+    if (this->ids.size() > 0) {
+        this->sortRange(xs, ys, 0, this->ids.size() - 1, 0);
+    }
+
+    // Store the coordinates in tree order, so the queries walk through memory sequentially
+    this->coords.resize(2 * this->ids.size());
+    for (int i = 0; i < this->ids.size(); i++) {
+        this->coords[2 * i + 0] = xs[this->ids[i]];
+        this->coords[2 * i + 1] = ys[this->ids[i]];
+    }
+}
+
+void PointIndex::sortRange(const float* xs, const float* ys, int left, int right, int axis) {
+    if (right - left <= this->node_size) return;
+
+    const int median = (left + right) / 2;
+    const float* vals = axis == 0 ? xs : ys;
+
+    std::nth_element(this->ids.begin() + left, this->ids.begin() + median, this->ids.begin() + right + 1, 
+                     [&](int a, int b) { return vals[a] < vals[b]; });
+
+    this->sortRange(xs, ys, left, median - 1, 1 - axis);
+    this->sortRange(xs, ys, median + 1, right, 1 - axis);
+}
+
+void PointIndex::range(float min_x, float min_y, float max_x, float max_y, std::vector<int>& result) const {
+    result.clear();
+    if (this->ids.size() == 0) return;
+
+    std::vector<int> stack = {0, (int)this->ids.size() - 1, 0};
+
+    while (stack.size() > 0) {
+        const int axis = stack.back(); stack.pop_back();
+        const int right = stack.back(); stack.pop_back();
+        const int left = stack.back(); stack.pop_back();
+
+        if (right - left <= this->node_size) {
+            for (int i = left; i <= right; i++) {
+                const float x = this->coords[2 * i], y = this->coords[2 * i + 1];
+                if (x >= min_x && x <= max_x && y >= min_y && y <= max_y) result.push_back(this->ids[i]);
+            }
+            continue;
+        }
+
+        const int median = (left + right) / 2;
+        const float x = this->coords[2 * median], y = this->coords[2 * median + 1];
+        if (x >= min_x && x <= max_x && y >= min_y && y <= max_y) result.push_back(this->ids[median]);
+
+        const float val = axis == 0 ? x : y;
+        const float min_val = axis == 0 ? min_x : min_y;
+        const float max_val = axis == 0 ? max_x : max_y;
+
+        if (min_val <= val) {
+            stack.push_back(left); stack.push_back(median - 1); stack.push_back(1 - axis);
+        }
+        if (max_val >= val) {
+            stack.push_back(median + 1); stack.push_back(right); stack.push_back(1 - axis);
+        }
+    }
+}
+
+void PointIndex::within(float qx, float qy, float radius, std::vector<int>& result) const {
+    result.clear();
+    if (this->ids.size() == 0) return;
+
+    const float r2 = radius * radius;
+    std::vector<int> stack = {0, (int)this->ids.size() - 1, 0};
+
+    while (stack.size() > 0) {
+        const int axis = stack.back(); stack.pop_back();
+        const int right = stack.back(); stack.pop_back();
+        const int left = stack.back(); stack.pop_back();
+
+        if (right - left <= this->node_size) {
+            for (int i = left; i <= right; i++) {
+                const float dx = this->coords[2 * i] - qx, dy = this->coords[2 * i + 1] - qy;
+                if (dx * dx + dy * dy <= r2) result.push_back(this->ids[i]);
+            }
+            continue;
+        }
+
+        const int median = (left + right) / 2;
+        const float dx = this->coords[2 * median] - qx, dy = this->coords[2 * median + 1] - qy;
+        if (dx * dx + dy * dy <= r2) result.push_back(this->ids[median]);
+
+        const float val = this->coords[2 * median + axis];
+        const float qval = axis == 0 ? qx : qy;
+
+        if (qval - radius <= val) {
+            stack.push_back(left); stack.push_back(median - 1); stack.push_back(1 - axis);
+        }
+        if (qval + radius >= val) {
+            stack.push_back(median + 1); stack.push_back(right); stack.push_back(1 - axis);
+        }
+    }
+}
+
+void PointIndex::nearestRange(int left, int right, int axis, float qx, float qy, int& id_nearest, float& dist2_nearest) const {
+    if (left > right) return;
+
+    auto checkPoint = [&](int i) {
+        const float dx = this->coords[2 * i] - qx, dy = this->coords[2 * i + 1] - qy;
+        const float dist2 = dx * dx + dy * dy;
+
+        // Break ties by id, so the result doesn't depend on the layout of the tree
+        if (dist2 < dist2_nearest || (dist2 == dist2_nearest && this->ids[i] < id_nearest)) {
+            dist2_nearest = dist2;
+            id_nearest = this->ids[i];
+        }
+    };
+
+    if (right - left <= this->node_size) {
+        for (int i = left; i <= right; i++) {
+            checkPoint(i);
+        }
+        return;
+    }
+
+    const int median = (left + right) / 2;
+    checkPoint(median);
+
+    // Search the side of the split the query point is on first, and then only search the other side if it could have a closer point
+    const float diff = (axis == 0 ? qx : qy) - this->coords[2 * median + axis];
+    if (diff < 0) {
+        this->nearestRange(left, median - 1, 1 - axis, qx, qy, id_nearest, dist2_nearest);
+        if (diff * diff <= dist2_nearest) this->nearestRange(median + 1, right, 1 - axis, qx, qy, id_nearest, dist2_nearest);
+    }
+    else {
+        this->nearestRange(median + 1, right, 1 - axis, qx, qy, id_nearest, dist2_nearest);
+        if (diff * diff <= dist2_nearest) this->nearestRange(left, median - 1, 1 - axis, qx, qy, id_nearest, dist2_nearest);
+    }
+}
+
+int PointIndex::nearest(float qx, float qy, float max_dist) const {
+    // Start with a placeholder id that any point exactly max_dist away will replace
+    int id_nearest = INT_MAX;
+    float dist2_nearest = max_dist * max_dist;
+
+    this->nearestRange(0, (int)this->ids.size() - 1, 0, qx, qy, id_nearest, dist2_nearest);
+    return id_nearest == INT_MAX ? -1 : id_nearest;
+}
+
+// Position along a Hilbert curve through a 2^16 x 2^16 grid (from https://github.com/rawrunprotected/hilbert_curves, public domain)
+static uint32_t hilbert(uint32_t x, uint32_t y) {
+    uint32_t a = x ^ y;
+    uint32_t b = 0xFFFF ^ a;
+    uint32_t c = 0xFFFF ^ (x | y);
+    uint32_t d = x & (y ^ 0xFFFF);
+
+    uint32_t A = a | (b >> 1);
+    uint32_t B = (a >> 1) ^ a;
+    uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+    uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+    B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+    C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+    D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+    a = A; b = B; c = C; d = D;
+    A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+    B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+    C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+    D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+    a = A; b = B; c = C; d = D;
+    C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+    D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+    a = C ^ (C >> 1);
+    b = D ^ (D >> 1);
+
+    uint32_t i0 = x ^ y;
+    uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+    i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+    i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+    i0 = (i0 | (i0 << 2)) & 0x33333333;
+    i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+    i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+    i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+    i1 = (i1 | (i1 << 2)) & 0x33333333;
+    i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+    return (i1 << 1) | i0;
+}
+
+BoxIndex::BoxIndex(const float* boxes, const int n_boxes, const int node_size) : n_items(0), node_size(node_size) {
+    std::vector<int> ids;
+    float min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+
+    for (int ibox = 0; ibox < n_boxes; ibox++) {
+        const float* box = boxes + 4 * ibox;
+        if (std::isnan(box[0]) || std::isnan(box[1]) || std::isnan(box[2]) || std::isnan(box[3])) continue;
+
+        ids.push_back(ibox);
+        min_x = std::min(min_x, box[0]); min_y = std::min(min_y, box[1]);
+        max_x = std::max(max_x, box[2]); max_y = std::max(max_y, box[3]);
+    }
+
+    this->n_items = ids.size();
+    if (this->n_items == 0) return;
+
+    // Work out how many nodes there are on each level, up to a single root
+    int n_nodes = this->n_items, n_level = this->n_items;
+    this->level_bounds.push_back(n_nodes);
+    do {
+        n_level = (n_level + node_size - 1) / node_size;
+        n_nodes += n_level;
+        this->level_bounds.push_back(n_nodes);
+    } while (n_level != 1);
+
+    const float hilbert_max = 0xFFFF;
+    const float width = max_x > min_x ? max_x - min_x : 1, height = max_y > min_y ? max_y - min_y : 1;
+
+    std::vector<uint32_t> hilbert_values(n_boxes);
+    for (auto it = ids.begin(); it != ids.end(); ++it) {
+        const float* box = boxes + 4 * *it;
+        const uint32_t hx = hilbert_max * ((box[0] + box[2]) / 2 - min_x) / width;
+        const uint32_t hy = hilbert_max * ((box[1] + box[3]) / 2 - min_y) / height;
+        hilbert_values[*it] = hilbert(hx, hy);
+    }
+
+    std::sort(ids.begin(), ids.end(), [&](int a, int b) { 
+        return hilbert_values[a] < hilbert_values[b] || (hilbert_values[a] == hilbert_values[b] && a < b); 
+    });
+
+    this->boxes.resize(4 * n_nodes);
+    this->indices.resize(n_nodes);
+
+    for (int inode = 0; inode < this->n_items; inode++) {
+        std::copy(boxes + 4 * ids[inode], boxes + 4 * ids[inode] + 4, this->boxes.begin() + 4 * inode);
+        this->indices[inode] = ids[inode];
+    }
+
+    // Each node on the next level up covers the next node_size nodes on this level and points to the first of them
+    int pos = 0, parent = this->n_items;
+    for (int ilvl = 0; ilvl < this->level_bounds.size() - 1; ilvl++) {
+        const int end = this->level_bounds[ilvl];
+
+        while (pos < end) {
+            float node_min_x = INFINITY, node_min_y = INFINITY, node_max_x = -INFINITY, node_max_y = -INFINITY;
+            const int first_child = pos;
+
+            for (int ichild = 0; ichild < node_size && pos < end; ichild++, pos++) {
+                node_min_x = std::min(node_min_x, this->boxes[4 * pos + 0]);
+                node_min_y = std::min(node_min_y, this->boxes[4 * pos + 1]);
+                node_max_x = std::max(node_max_x, this->boxes[4 * pos + 2]);
+                node_max_y = std::max(node_max_y, this->boxes[4 * pos + 3]);
+            }
+
+            this->boxes[4 * parent + 0] = node_min_x; this->boxes[4 * parent + 1] = node_min_y;
+            this->boxes[4 * parent + 2] = node_max_x; this->boxes[4 * parent + 3] = node_max_y;
+            this->indices[parent] = first_child;
+            parent++;
+        }
+    }
+}
+
+// The end of the level that a node is on
+int BoxIndex::levelEnd(int node) const {
+    return *std::upper_bound(this->level_bounds.begin(), this->level_bounds.end(), node);
+}
+
+float BoxIndex::boxDist2(int node, float x, float y) const {
+    const float* box = this->boxes.data() + 4 * node;
+    const float dx = std::max({box[0] - x, 0.f, x - box[2]});
+    const float dy = std::max({box[1] - y, 0.f, y - box[3]});
+    return dx * dx + dy * dy;
+}
+
+void BoxIndex::search(float min_x, float min_y, float max_x, float max_y, std::vector<int>& result) const {
+    result.clear();
+    if (this->n_items == 0) return;
+
+    // The stack holds the first node of each group of siblings left to look at, starting from the root
+    std::vector<int> stack = {(int)this->indices.size() - 1};
+
+    while (stack.size() > 0) {
+        const int first = stack.back(); stack.pop_back();
+        const int end = std::min(first + this->node_size, this->levelEnd(first));
+
+        for (int node = first; node < end; node++) {
+            const float* box = this->boxes.data() + 4 * node;
+            if (box[2] < min_x || box[0] > max_x || box[3] < min_y || box[1] > max_y) continue;
+
+            if (first < this->n_items) {
+                result.push_back(this->indices[node]);
+            }
+            else {
+                stack.push_back(this->indices[node]);
+            }
+        }
+    }
+}
+
+int BoxIndex::nearest(float x, float y, float max_dist, const std::function<float(int)>& item_dist2) const {
+    if (this->n_items == 0) return -1;
+
+    const float max_dist2 = max_dist * max_dist;
+
+    // Nodes and items, ordered by distance. Nodes are stored as the first of their children, and items as -(id + 1).
+    typedef std::pair<float, int> queue_entry_t;
+    std::priority_queue<queue_entry_t, std::vector<queue_entry_t>, std::greater<queue_entry_t>> queue;
+
+    int first = this->indices.size() - 1;
+
+    while (true) {
+        const int end = std::min(first + this->node_size, this->levelEnd(first));
+
+        for (int node = first; node < end; node++) {
+            const float dist2 = this->boxDist2(node, x, y);
+            if (dist2 > max_dist2) continue;
+
+            if (first < this->n_items) {
+                const float item_dist = item_dist2(this->indices[node]);
+                if (item_dist <= max_dist2) queue.emplace(item_dist, -(this->indices[node] + 1));
+            }
+            else {
+                queue.emplace(dist2, this->indices[node]);
+            }
+        }
+
+        // Once the closest thing left is an item, nothing else can be closer
+        if (queue.empty()) return -1;
+        if (queue.top().second < 0) return -queue.top().second - 1;
+
+        first = queue.top().second;
+        queue.pop();
+    }
+}
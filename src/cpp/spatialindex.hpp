@@ -0,0 +1,65 @@
+
+#ifndef __AUTUMNPLOT_SPATIALINDEX_H__
+#define __AUTUMNPLOT_SPATIALINDEX_H__
+
+#include <vector>
+#include <cmath>
+#include <functional>
+
+// A static KD-tree over a set of points, packed into flat arrays. The points are sorted so that each node is the median of its range 
+//  along alternating axes, with small ranges left unsorted as leaves. Points with NaN coordinates are left out.
+class PointIndex {
+    int node_size;
+    std::vector<int> ids;
+    std::vector<float> coords;
+
+    void sortRange(const float* xs, const float* ys, int left, int right, int axis);
+    void nearestRange(int left, int right, int axis, float x, float y, int& id_nearest, float& dist2_nearest) const;
+
+    public:
+    PointIndex(const float* xs, const float* ys, const int n_pts, const int node_size=64);
+
+    size_t size() const {
+        return this->ids.size();
+    }
+
+    // Get the ids of all points in a bounding box
+    void range(float min_x, float min_y, float max_x, float max_y, std::vector<int>& result) const;
+
+    // Get the ids of all points within radius of (x, y)
+    void within(float x, float y, float radius, std::vector<int>& result) const;
+
+    // Get the id of the nearest point to (x, y) that's within max_dist, or -1 if there isn't one
+    int nearest(float x, float y, float max_dist=INFINITY) const;
+};
+
+// A static R-tree over a set of boxes, packed into flat arrays (after flatbush, https://github.com/mourner/flatbush). The boxes are sorted 
+//  along a Hilbert curve through their centers and then grouped node_size at a time into the nodes of each level, so there are no 
+//  insertions or node splits. The nodes are stored from the leaves up to the root. Boxes with NaN coordinates are left out.
+class BoxIndex {
+    int n_items;
+    int node_size;
+    std::vector<float> boxes;
+    std::vector<int> indices;
+    std::vector<int> level_bounds;
+
+    int levelEnd(int node) const;
+    float boxDist2(int node, float x, float y) const;
+
+    public:
+    // boxes has x_min, y_min, x_max, and y_max for each box
+    BoxIndex(const float* boxes, const int n_boxes, const int node_size=16);
+
+    size_t size() const {
+        return this->n_items;
+    }
+
+    // Get the ids of all boxes that overlap a bounding box
+    void search(float min_x, float min_y, float max_x, float max_y, std::vector<int>& result) const;
+
+    // Get the id of the nearest item to (x, y) that's within max_dist, or -1 if there isn't one. item_dist2 gives the squared distance from
+    //  (x, y) to an item, which can't be less than the squared distance to its box.
+    int nearest(float x, float y, float max_dist, const std::function<float(int)>& item_dist2) const;
+};
+
+#endif
@@ -3,9 +3,31 @@
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <cstring>
 
+#include "float16_t.hpp"
 #include "marchingsquares.hpp"
 #include "map.hpp"
+#include "lrucache.hpp"
+#include "fastmath.hpp"
+#include "geometry.hpp"
+#include "thinning.hpp"
+#include "spatialindex.hpp"
+#include "expression.hpp"
+#include "vectorfield.hpp"
+#include "gridfilter.hpp"
+#include "grib2.hpp"
+#include "contourcodec.hpp"
+#include "vectortile.hpp"
+#include "tiledcontours.hpp"
+#include "contourindex.hpp"
+#include "ensemble.hpp"
+
+using numeric::float16_t;
 
 struct ContourTestCase {
     const char* name;
@@ -15,44 +37,1810 @@ struct ContourTestCase {
     std::vector<Contour> expected;
 };
 
-void testContour(const ContourTestCase& test_case) {
-    const int nx = 2, ny = 2;
+void testContour(const ContourTestCase& test_case) {
+    const int nx = 2, ny = 2;
+
+    float x_grid[nx] = {0, 1};
+    float y_grid[ny] = {0, 1};
+    std::vector<float> contour_vals(1, {test_case.value});
+    
+    std::vector<Contour> contours = makeContours(test_case.grid, x_grid, y_grid, nx, ny, contour_vals, test_case.quad_as_tri);
+
+    bool passed = true;
+    try {
+        if (contours.size() != test_case.expected.size()) {
+            throw std::string("Incorrect number of contours");
+        }
+
+        std::stringstream ss;
+        for (int idx = 0; idx < contours.size(); idx++) {
+            if (!contours[idx].isClose(test_case.expected[idx])) {
+                if (ss.str().length() == 0) {
+                    ss << "Contour data is wrong ";
+                }
+
+                ss << std::endl << "    Received " << contours[idx] << std::endl << "    Expected " << test_case.expected[idx];
+            }
+        }
+
+        if (ss.str().length() > 0) {
+            throw ss.str();
+        }
+    }
+    catch (std::string exc) {
+        std::cout << test_case.name << " test failed: " << exc << std::endl;
+        passed = false;
+    }
+
+    if (passed) {
+        std::cout << test_case.name << " test passed" << std::endl;
+    }
+}
+
+void reportTest(const char* name, const std::string& failure) {
+    if (failure.length() == 0) {
+        std::cout << name << " test passed" << std::endl;
+    }
+    else {
+        std::cout << name << " test failed: " << failure << std::endl;
+    }
+}
+
+void testContourCurvilinear() {
+    const int nx = 3, ny = 3;
+    float grid[nx * ny] = {0, 1, 3, 2, 4, 1, 5, 2, 0};
+    float x_grid[nx] = {0, 1, 2};
+    float y_grid[ny] = {0, 1, 2};
+    std::vector<float> contour_vals = {0.5, 1.5, 2.5, 3.5};
+
+    // Skew the grid; the interpolation is linear, so the contours should be skewed the same way
+    float x_grid_2d[nx * ny], y_grid_2d[nx * ny];
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            x_grid_2d[i + nx * j] = x_grid[i] + 0.5 * y_grid[j];
+            y_grid_2d[i + nx * j] = 2 * y_grid[j];
+        }
+    }
+
+    std::stringstream ss;
+    for (const bool quad_as_tri : {false, true}) {
+        std::vector<Contour> contours = makeContours(grid, x_grid, y_grid, nx, ny, contour_vals, quad_as_tri);
+        std::vector<Contour> contours_2d = makeContoursCurvilinear(grid, x_grid_2d, y_grid_2d, nx, ny, contour_vals, quad_as_tri);
+
+        if (contours.size() != contours_2d.size()) {
+            ss << std::endl << "    Incorrect number of contours (quad_as_tri=" << quad_as_tri << ")";
+            continue;
+        }
+
+        for (int idx = 0; idx < contours.size(); idx++) {
+            std::vector<Point> expected_pts;
+            for (auto it = contours[idx].point_list.begin(); it != contours[idx].point_list.end(); ++it) {
+                expected_pts.push_back(Point(it->x + 0.5 * it->y, 2 * it->y));
+            }
+
+            Contour expected(expected_pts, contours[idx].value);
+            if (!contours_2d[idx].isClose(expected)) {
+                ss << std::endl << "    Received " << contours_2d[idx] << std::endl << "    Expected " << expected;
+            }
+        }
+    }
+
+    reportTest("Curvilinear contour", ss.str());
+}
+
+void testLRUCache() {
+    LRUCache<int, std::string> cache(2);
+    std::stringstream ss;
+
+    cache.put(1, "one");
+    cache.put(2, "two");
+    cache.get(1);
+    cache.put(3, "three");
+
+    if (cache.size() != 2) ss << std::endl << "    Cache has " << cache.size() << " entries, expected 2";
+    if (cache.get(2) != NULL) ss << std::endl << "    Least recently used entry wasn't evicted";
+    if (cache.get(1) == NULL || *cache.get(1) != "one") ss << std::endl << "    Recently used entry was evicted";
+    if (cache.get(3) == NULL || *cache.get(3) != "three") ss << std::endl << "    Newest entry is missing";
+
+    reportTest("LRU cache", ss.str());
+}
+
+void testFastMath() {
+    double err_log2 = 0, err_exp2 = 0, err_sincos = 0, err_atan = 0, err_atan2 = 0;
+
+    for (double x = 1e-6; x < 1e6; x *= 1.0007) {
+        err_log2 = std::max(err_log2, fabs(fastmath::log2(x) - std::log2(x)));
+    }
+    for (double x = -60; x < 60; x += 0.00037) {
+        err_exp2 = std::max(err_exp2, fabs(fastmath::exp2(x) / std::exp2(x) - 1));
+    }
+    for (double x = -20; x < 20; x += 0.000123) {
+        err_sincos = std::max(err_sincos, std::max(fabs(fastmath::sin(x) - std::sin(x)), fabs(fastmath::cos(x) - std::cos(x))));
+    }
+    for (double x = -1e4; x < 1e4; x += 0.00731) {
+        err_atan = std::max(err_atan, fabs(fastmath::atan(x) - std::atan(x)));
+    }
+    for (double ang = -3.14; ang < 3.14; ang += 0.001) {
+        err_atan2 = std::max(err_atan2, fabs(fastmath::atan2(3 * sin(ang), 3 * cos(ang)) - std::atan2(3 * sin(ang), 3 * cos(ang))));
+    }
+
+    std::stringstream ss;
+    if (err_log2 > 3e-11) ss << std::endl << "    log2 error was " << err_log2;
+    if (err_exp2 > 3e-10) ss << std::endl << "    exp2 error was " << err_exp2;
+    if (err_sincos > 1e-11) ss << std::endl << "    sin/cos error was " << err_sincos;
+    if (err_atan > 2e-10) ss << std::endl << "    atan error was " << err_atan;
+    if (err_atan2 > 2e-10) ss << std::endl << "    atan2 error was " << err_atan2;
+
+    reportTest("Fast math", ss.str());
+}
+
+void testLambertFastMath() {
+    // HRRR domain
+    const float lon_0 = -97.5, lat_0 = 38.5, lat_std = 38.5;
+    const int ni = 1799, nj = 1059;
+    const float dx = 3000;
+
+    LambertConformalConic lcc(lon_0, lat_0, lat_std, lat_std);
+    LambertConformalConic lcc_fast(lon_0, lat_0, lat_std, lat_std, true);
+    GridPoint ll_crnr = lcc.transform(EarthPoint(-122.719528, 21.138123));
+
+    const double meters_per_degree = 111320.;
+    double max_error_inv = 0, max_error_fwd = 0;
+
+    for (int j = 0; j < nj; j += 4) {
+        std::vector<EarthPoint> pts_exact, pts_fast;
+        for (int i = 0; i < ni; i += 4) {
+            pts_exact.push_back(lcc.transform_inverse(GridPoint(ll_crnr.x + i * dx, ll_crnr.y + j * dx)));
+            pts_fast.push_back(lcc_fast.transform_inverse(GridPoint(ll_crnr.x + i * dx, ll_crnr.y + j * dx)));
+        }
+
+        for (int ipt = 0; ipt < pts_exact.size(); ipt++) {
+            // Compare in double, since the float32 lat/lons themselves are only good to about a meter
+            const EarthPoint& pt = pts_exact[ipt];
+            const double dlon = (pts_fast[ipt].lon - pt.lon) * cos(degToRad(pt.lat));
+            const double dlat = pts_fast[ipt].lat - pt.lat;
+            max_error_inv = std::max(max_error_inv, hypot(dlon, dlat) * meters_per_degree);
+
+            GridPoint gpt = lcc.transform(pt);
+            GridPoint gpt_fast = lcc_fast.transform(pt);
+            max_error_fwd = std::max(max_error_fwd, (double)hypot(gpt_fast.x - gpt.x, gpt_fast.y - gpt.y));
+        }
+    }
+
+    std::stringstream ss;
+    // Float32 lat/lons and grid coordinates limit what we can resolve, so the error here is dominated by rounding
+    if (max_error_inv > 1.5 || max_error_fwd > 1.5) {
+        ss << std::endl << "    Max error was " << max_error_inv << " m (inverse) and " << max_error_fwd << " m (forward)";
+    }
+
+    reportTest("Lambert fast math", ss.str());
+}
+
+void testBBElements() {
+    const int ni = 3, nj = 2;
+    float lats[ni * nj] = {30, 30, 30, 40, 40, 40};
+    float lons[ni * nj] = {-100, -90, NAN, -100, -90, -80};
+    uint8_t min_zoom[ni * nj] = {0, 2, 0, 1, 3, 2};
+
+    std::vector<float> pts, tex_coords;
+    makeBBElements(lats, lons, min_zoom, ni, nj, 2, pts, tex_coords);
+
+    std::stringstream ss;
+    WebMercator wm;
+    GridPoint pt_expected = wm.transform(EarthPoint(-80.f, 40.f));
+
+    // Points 0, 1, 3, and 5 are visible at zoom 2 (point 2 has a NaN coordinate)
+    if (pts.size() != 8 || tex_coords.size() != 8) {
+        ss << std::endl << "    Got " << pts.size() / 2 << " billboards, expected 4";
+    }
+    else {
+        if (pts[6] != pt_expected.x || pts[7] != pt_expected.y) {
+            ss << std::endl << "    Last billboard was at {x=" << pts[6] << ", y=" << pts[7] << "}, expected " << pt_expected;
+        }
+
+        if (!isClose_(tex_coords[2], 2.5f) || !isClose_(tex_coords[6], 2.99999f) || tex_coords[7] != 1) {
+            ss << std::endl << "    Texture coordinates are wrong";
+        }
+    }
+
+    reportTest("Billboard elements", ss.str());
+}
+
+void testDomainVertices() {
+    const int ni = 3, nj = 2;
+    float xs[ni * nj] = {0, 1, 2, 0, 1, 2};
+    float ys[ni * nj] = {0, 0, 0, 1, 1, 1};
+
+    std::vector<float> verts, tex_coords;
+    makeDomainVerticesAndTexCoords(xs, ys, ni, nj, 0.25, 0., verts, tex_coords);
+
+    std::stringstream ss;
+
+    // Two strips of 6 vertices each (4 for the cells plus the degenerate joins on each end)
+    if (verts.size() != 24 || tex_coords.size() != 24) {
+        ss << std::endl << "    Got " << verts.size() / 2 << " vertices, expected 12";
+    }
+    else {
+        float verts_expected[24] = {0, 0, 0, 0, 1, 0, 0, 1, 1, 1, 1, 1,
+                                    1, 0, 1, 0, 2, 0, 1, 1, 2, 1, 2, 1};
+        float tex_coords_expected[24] = {0.25, 0, 0.25, 0, 0.5, 0, 0.25, 1, 0.5, 1, 0.5, 1, 
+                                         0.5, 0, 0.5, 0, 0.75, 0, 0.5, 1, 0.75, 1, 0.75, 1};
+
+        for (int ivert = 0; ivert < 24; ivert++) {
+            if (verts[ivert] != verts_expected[ivert]) {
+                ss << std::endl << "    Vertex coordinate " << ivert << " was " << verts[ivert] << ", expected " << verts_expected[ivert];
+            }
+
+            if (!isClose_(tex_coords[ivert], tex_coords_expected[ivert])) {
+                ss << std::endl << "    Texture coordinate " << ivert << " was " << tex_coords[ivert] << ", expected " << tex_coords_expected[ivert];
+            }
+        }
+    }
+
+    reportTest("Domain vertices", ss.str());
+}
+
+void testRefineDomain() {
+    std::stringstream ss;
+    WebMercator wm;
+
+    // A global lat/lon grid; x in the map is linear in longitude, so only the minimum number of columns should get kept
+    const int n_lon = 361, n_lat = 161;
+    auto latLonMapCoord = [&](int ilon, int ilat) { return wm.transform(EarthPoint(-180.f + ilon, -80.f + ilat)); };
+
+    const float tolerance = 0.5 / (512 * 64);
+    std::vector<int> keep_lons, keep_lats;
+    refineDomainIndices(latLonMapCoord, n_lon, n_lat, tolerance, keep_lons);
+    refineDomainIndices([&](int ilat, int ilon) { return latLonMapCoord(ilon, ilat); }, n_lat, n_lon, tolerance, keep_lats);
+
+    if (keep_lons.size() != 5) {
+        ss << std::endl << "    Kept " << keep_lons.size() << " columns on a lat/lon grid, expected 5";
+    }
+
+    if (keep_lats.size() <= 5 || keep_lats.size() >= n_lat) {
+        ss << std::endl << "    Kept " << keep_lats.size() << " rows on a lat/lon grid";
+    }
+
+    // A Lambert grid; check the interpolation error at every row between the kept rows
+    LambertConformalConic lcc(-97.5, 38.5, 38.5, 38.5);
+    const int ni = 200, nj = 150;
+    auto lccMapCoord = [&](int j, int i) { 
+        return wm.transform(lcc.transform_inverse(GridPoint(-2.7e6f + i * 3.e4f, -1.6e6f + j * 3.e4f))); 
+    };
+
+    std::vector<int> keep_js;
+    refineDomainIndices(lccMapCoord, nj, ni, tolerance, keep_js);
+
+    if (keep_js.front() != 0 || keep_js.back() != nj - 1) {
+        ss << std::endl << "    Kept rows don't span the Lambert grid";
+    }
+
+    float max_err = 0;
+    for (int ikeep = 0; ikeep < keep_js.size() - 1; ikeep++) {
+        const int ja = keep_js[ikeep], jb = keep_js[ikeep + 1];
+        for (int i = 0; i < ni; i += 11) {
+            const GridPoint pa = lccMapCoord(ja, i), pb = lccMapCoord(jb, i);
+            for (int j = ja + 1; j < jb; j++) {
+                const GridPoint pt = lccMapCoord(j, i);
+                const float t = (float)(j - ja) / (jb - ja);
+                max_err = std::max(max_err, (float)hypot(pt.x - (pa.x + t * (pb.x - pa.x)), pt.y - (pa.y + t * (pb.y - pa.y))));
+            }
+        }
+    }
+
+    // Only a sample of the rows and columns get checked, so allow a little slop
+    if (max_err > 2 * tolerance) {
+        ss << std::endl << "    Max error on the Lambert grid was " << max_err * 512 * 64 << " pixels, expected less than 0.5";
+    }
+
+    if (keep_js.size() >= nj) {
+        ss << std::endl << "    Kept all the rows on the Lambert grid";
+    }
+
+    reportTest("Refine domain", ss.str());
+}
+
+// Straight ports of the JS min zoom computations the native versions replaced (a modulo loop for structured grids and kd-tree thinning
+//  for unstructured grids), to check the native versions against
+int getMinZoomReference(int jlat, int ilon, float thin_fac) {
+    int zoom = 1;
+    while (fmod(jlat, thin_fac) != 0 || fmod(ilon, thin_fac) != 0) {
+        zoom += 1;
+        thin_fac /= 2;
+    }
+    return zoom;
+}
+
+void thinReference(const std::vector<GridPoint>& pts, double x, double y, int depth, int offset, std::vector<int>& min_zoom) {
+    const double size = pow(0.5, depth + 1);
+    int n_in_cell = 0, ipt_nearest = -1;
+    double dist_nearest = INFINITY;
+
+    for (int ipt = 0; ipt < pts.size(); ipt++) {
+        const double dist = std::max(fabs(pts[ipt].x - x), fabs(pts[ipt].y - y));
+        if (dist < size) {
+            n_in_cell++;
+            if (dist < dist_nearest) { dist_nearest = dist; ipt_nearest = ipt; }
+        }
+    }
+
+    if (n_in_cell > 0 && min_zoom[ipt_nearest] == 24) min_zoom[ipt_nearest] = std::max(depth - offset, 0);
+
+    if (n_in_cell > 1 && depth < 24 + offset) {
+        thinReference(pts, x - size / 2, y - size / 2, depth + 1, offset, min_zoom);
+        thinReference(pts, x + size / 2, y - size / 2, depth + 1, offset, min_zoom);
+        thinReference(pts, x - size / 2, y + size / 2, depth + 1, offset, min_zoom);
+        thinReference(pts, x + size / 2, y + size / 2, depth + 1, offset, min_zoom);
+    }
+}
+
+void testMinZoom() {
+    std::stringstream ss;
+
+    const int ni = 37, nj = 21;
+    std::vector<uint8_t> min_zoom(ni * nj);
+    makeStructuredMinZoom(ni, nj, 8, min_zoom.data());
+
+    int n_wrong = 0;
+    for (int j = 0; j < nj; j++) {
+        for (int i = 0; i < ni; i++) {
+            if (min_zoom[i + j * ni] != getMinZoomReference(j, i, 8)) n_wrong++;
+        }
+    }
+
+    if (n_wrong > 0) {
+        ss << std::endl << "    " << n_wrong << " structured grid points had the wrong min zoom";
+    }
+
+    // Scattered points over the US, with a cluster of close points and a point with a missing location
+    const int n_pts = 400;
+    std::vector<float> lons(n_pts), lats(n_pts);
+    unsigned int seed = 12345;
+    auto rand01 = [&]() { seed = seed * 1103515245 + 12345; return ((seed >> 8) & 0xffff) / 65536.f; };
+
+    for (int ipt = 0; ipt < n_pts; ipt++) {
+        lons[ipt] = ipt < 20 ? -97.44 + 0.001 * rand01() : -125 + 58 * rand01();
+        lats[ipt] = ipt < 20 ? 35.18 + 0.001 * rand01() : 25 + 24 * rand01();
+    }
+    lons[n_pts - 1] = NAN;
+
+    std::vector<uint8_t> min_zoom_pts(n_pts);
+    makeUnstructuredMinZoom(lons.data(), lats.data(), n_pts, 4, min_zoom_pts.data());
+
+    WebMercator wm;
+    std::vector<GridPoint> map_pts;
+    for (int ipt = 0; ipt < n_pts - 1; ipt++) {
+        map_pts.push_back(wm.transform(EarthPoint(lons[ipt], lats[ipt])));
+    }
+
+    std::vector<int> min_zoom_expected(n_pts - 1, 24);
+    thinReference(map_pts, 0.5, 0.5, -1, 2, min_zoom_expected);
+
+    // At the highest zooms, the quadtree cells are about as small as float precision in map coordinates, so points can land right on 
+    //  the cell edges, where the reference drops them from both cells. So only check the points thinned in below that.
+    n_wrong = 0;
+    for (int ipt = 0; ipt < n_pts - 1; ipt++) {
+        if (min_zoom_pts[ipt] != min_zoom_expected[ipt] && std::min<int>(min_zoom_pts[ipt], min_zoom_expected[ipt]) < 20) n_wrong++;
+    }
+
+    if (n_wrong > 0) {
+        ss << std::endl << "    " << n_wrong << " scattered points had the wrong min zoom";
+    }
+
+    if (min_zoom_pts[n_pts - 1] != 24) {
+        ss << std::endl << "    Point with a missing location had min zoom " << (int)min_zoom_pts[n_pts - 1] << ", expected 24";
+    }
+
+    reportTest("Min zoom", ss.str());
+}
+
+void testPointIndex() {
+    std::stringstream ss;
+
+    const int n_pts = 2000;
+    std::vector<float> xs(n_pts), ys(n_pts);
+    unsigned int seed = 6789;
+    auto rand01 = [&]() { seed = seed * 1103515245 + 12345; return ((seed >> 8) & 0xffff) / 65536.f; };
+
+    for (int ipt = 0; ipt < n_pts; ipt++) {
+        xs[ipt] = rand01();
+        ys[ipt] = rand01();
+    }
+    xs[17] = NAN;
+
+    PointIndex index(xs.data(), ys.data(), n_pts, 16);
+
+    if (index.size() != n_pts - 1) {
+        ss << std::endl << "    Index has " << index.size() << " points, expected " << n_pts - 1;
+    }
+
+    // Check the queries against brute force
+    int n_wrong_nearest = 0, n_wrong_within = 0, n_wrong_range = 0;
+    std::vector<int> result;
+
+    for (int iqry = 0; iqry < 50; iqry++) {
+        const float qx = rand01(), qy = rand01();
+
+        int ipt_nearest = -1;
+        float dist2_nearest = INFINITY;
+        std::vector<int> within_expected, range_expected;
+
+        for (int ipt = 0; ipt < n_pts; ipt++) {
+            if (std::isnan(xs[ipt])) continue;
+
+            const float dx = xs[ipt] - qx, dy = ys[ipt] - qy;
+            const float dist2 = dx * dx + dy * dy;
+            if (dist2 < dist2_nearest) { dist2_nearest = dist2; ipt_nearest = ipt; }
+            if (dist2 <= 0.05f * 0.05f) within_expected.push_back(ipt);
+            if (xs[ipt] >= qx && xs[ipt] <= qx + 0.1f && ys[ipt] >= qy && ys[ipt] <= qy + 0.05f) range_expected.push_back(ipt);
+        }
+
+        if (index.nearest(qx, qy) != ipt_nearest) n_wrong_nearest++;
+
+        index.within(qx, qy, 0.05, result);
+        std::sort(result.begin(), result.end());
+        if (result != within_expected) n_wrong_within++;
+
+        index.range(qx, qy, qx + 0.1, qy + 0.05, result);
+        std::sort(result.begin(), result.end());
+        if (result != range_expected) n_wrong_range++;
+    }
+
+    if (n_wrong_nearest > 0) ss << std::endl << "    " << n_wrong_nearest << " nearest point queries were wrong";
+    if (n_wrong_within > 0) ss << std::endl << "    " << n_wrong_within << " radius queries were wrong";
+    if (n_wrong_range > 0) ss << std::endl << "    " << n_wrong_range << " bounding box queries were wrong";
+
+    if (index.nearest(-1, -1, 0.5) != -1) {
+        ss << std::endl << "    Nearest point query found a point farther away than the max distance";
+    }
+
+    reportTest("Point index", ss.str());
+}
+
+void testFieldExpression() {
+    std::stringstream ss;
+
+    const int n = 600;
+    std::vector<float> u(n), v(n);
+    for (int i = 0; i < n; i++) {
+        u[i] = 0.1 * i - 30;
+        v[i] = 20 - 0.05 * i;
+    }
+    u[5] = NAN;
+    const float* fields[2] = {u.data(), v.data()};
+
+    struct ExprCase { std::string expr; std::function<float(float, float)> func; };
+    std::vector<ExprCase> cases = {
+        {"length(vec2({0}, {1}))", [](float a, float b) { return hypot(a, b); }},
+        {"{0} - {1}", [](float a, float b) { return a - b; }},
+        {"-{0} * 2.5 + {1} / 4.000000", [](float a, float b) { return -a * 2.5 + b / 4; }},
+        {"max(sqrt(abs({0})), {1}) - min({0}, 3.)", [](float a, float b) { return std::max(sqrtf(fabsf(a)), b) - std::min(a, 3.f); }},
+        {"step(0., {0}) * clamp({1}, -5., 5.)", [](float a, float b) { return (a < 0 ? 0 : 1) * std::min(std::max(b, -5.f), 5.f); }},
+        {"pow({0} * {0}, 0.5) + exp(log(2.))", [](float a, float b) { return fabsf(a) + 2; }},
+    };
+
+    std::vector<float> result(n);
+    for (auto it = cases.begin(); it != cases.end(); ++it) {
+        FieldExpression expr(it->expr);
+        expr.evaluate(fields, n, result.data());
+
+        int n_wrong = 0;
+        for (int i = 0; i < n; i++) {
+            const float expected = std::isnan(u[i]) ? NAN : it->func(u[i], v[i]);
+            if (std::isnan(expected) != std::isnan(result[i]) || (!std::isnan(expected) && fabs(result[i] - expected) > 1e-5 * std::max(1.f, fabsf(expected)))) n_wrong++;
+        }
+
+        if (n_wrong > 0) ss << std::endl << "    " << n_wrong << " points were wrong for '" << it->expr << "'";
+    }
+
+    // Float16 fields
+    std::vector<float16_t> u16(n), v16(n), result16(n);
+    for (int i = 0; i < n; i++) { u16[i] = u[i]; v16[i] = v[i]; }
+    const float16_t* fields16[2] = {u16.data(), v16.data()};
+
+    FieldExpression expr16("{0} + {1}");
+    expr16.evaluate(fields16, n, result16.data());
+    if (fabs((float)result16[100] - (float)(float16_t)((float)u16[100] + (float)v16[100])) > 0) {
+        ss << std::endl << "    Float16 result was " << (float)result16[100] << ", expected " << (float)u16[100] + (float)v16[100];
+    }
+
+    if (FieldExpression("{0} * {2}").getNumFields() != 3) {
+        ss << std::endl << "    Wrong number of fields";
+    }
+
+    // Malformed expressions should throw
+    const std::vector<std::string> bad_exprs = {"{0} +", "foo({0})", "({0}", "{0} {1}", "min({0})"};
+    for (auto it = bad_exprs.begin(); it != bad_exprs.end(); ++it) {
+        try {
+            FieldExpression expr(*it);
+            ss << std::endl << "    '" << *it << "' didn't throw";
+        }
+        catch (const std::invalid_argument& e) {}
+    }
+
+    reportTest("Field expression", ss.str());
+}
+
+void testVectorKernels() {
+    std::stringstream ss;
+
+    // Grid-relative vectors, with east pointing along the grid +y axis at the first two points
+    const int n = 4;
+    float u[n] = {0, 1, 3, -2};
+    float v[n] = {1, 0, 4, -2};
+    float rot[n] = {M_PI / 2, M_PI / 2, 0, 0};
+
+    float u_earth[n], v_earth[n];
+    rotateVectorsToEarth(u, v, rot, n, u_earth, v_earth);
+
+    const float u_earth_expected[n] = {1, 0, 3, -2};
+    const float v_earth_expected[n] = {0, -1, 4, -2};
+
+    for (int i = 0; i < n; i++) {
+        if (fabs(u_earth[i] - u_earth_expected[i]) > 1e-6 || fabs(v_earth[i] - v_earth_expected[i]) > 1e-6) {
+            ss << std::endl << "    Earth-relative vector " << i << " was (" << u_earth[i] << ", " << v_earth[i] << "), expected (" 
+               << u_earth_expected[i] << ", " << v_earth_expected[i] << ")";
+        }
+    }
+
+    // Speed and direction, with float16 output
+    float16_t speed[n], direction[n];
+    vectorSpeedDirection(u, v, rot, n, speed, direction);
+
+    const float speed_expected[n] = {1, 1, 5, 2 * sqrtf(2)};
+    const float direction_expected[n] = {270, 0, 216.8699, 45};
+
+    for (int i = 0; i < n; i++) {
+        if (fabs((float)speed[i] - speed_expected[i]) > 1e-2 || fabs((float)direction[i] - direction_expected[i]) > 0.2) {
+            ss << std::endl << "    Speed/direction " << i << " was (" << (float)speed[i] << ", " << (float)direction[i] << "), expected (" 
+               << speed_expected[i] << ", " << direction_expected[i] << ")";
+        }
+    }
+
+    // Earth-relative input
+    float speed32[n], direction32[n];
+    vectorSpeedDirection(u_earth, v_earth, (const float*)NULL, n, speed32, direction32);
+    if (fabs(direction32[0] - 270) > 1e-3 || fabs(direction32[1] - 0) > 1e-3) {
+        ss << std::endl << "    Directions for earth-relative vectors were " << direction32[0] << " and " << direction32[1] << ", expected 270 and 0";
+    }
+
+    reportTest("Vector kernels", ss.str());
+}
+
+void testSmoothContours() {
+    std::stringstream ss;
+
+    std::vector<Contour> contours = {
+        Contour({Point(0, 0), Point(1, 0), Point(1, 1), Point(0, 1), Point(0, 0)}, 1.),
+        Contour({Point(0, 0), Point(2, 0), Point(2, 2)}, 2.),
+    };
+
+    smoothContours(contours, 2);
+
+    // Closed contour: 4 segments -> 8 segments -> 16 segments, and still closed
+    const std::vector<Point>& closed = contours[0].point_list;
+    if (closed.size() != 17 || !(closed.front() == closed.back())) {
+        ss << std::endl << "    Closed contour had " << closed.size() << " points, expected 17 and closed";
+    }
+    else if (hypot(closed[0].x - 0.375, closed[0].y) > 1e-6) {
+        ss << std::endl << "    First point of the closed contour was " << closed[0] << ", expected {0.375, 0}";
+    }
+
+    // Open contour: end points are kept; 2 segments -> 3 segments -> 5 segments
+    const std::vector<Point>& open = contours[1].point_list;
+    if (open.size() != 6) {
+        ss << std::endl << "    Open contour had " << open.size() << " points, expected 6";
+    }
+    else if (!(open.front() == Point(0, 0)) || !(open.back() == Point(2, 2))) {
+        ss << std::endl << "    Open contour end points moved to " << open.front() << " and " << open.back();
+    }
+
+    // The corners get cut, so no points should be left at the corner of the open contour
+    for (auto it = open.begin(); it != open.end(); ++it) {
+        if (hypot(it->x - 2, it->y) < 0.1) ss << std::endl << "    Open contour still has its corner";
+    }
+
+    reportTest("Smooth contours", ss.str());
+}
+
+void testGridFilter() {
+    std::stringstream ss;
+
+    // Smoothing shouldn't change a linear field, except near the edges and the missing point, where the weights aren't symmetric
+    const int nx = 20, ny = 15;
+    std::vector<float> grid(nx * ny);
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = 2 * i + 3 * j;
+        }
+    }
+    grid[7 + 7 * nx] = NAN;
+
+    std::vector<float> smoothed(nx * ny), boxed(nx * ny);
+    gaussianSmooth(grid.data(), nx, ny, 1.5, smoothed.data());
+    boxSmooth(grid.data(), nx, ny, 2, boxed.data());
+
+    float max_err_gauss = 0, max_err_box = 0;
+    for (int j = 5; j < ny - 5; j++) {
+        for (int i = 5; i < nx - 5; i++) {
+            const int idx = i + j * nx;
+            if (std::isnan(grid[idx])) continue;
+
+            if (abs(i - 7) <= 5 && abs(j - 7) <= 5) continue;
+
+            max_err_gauss = std::max(max_err_gauss, fabsf(smoothed[idx] - grid[idx]));
+            max_err_box = std::max(max_err_box, fabsf(boxed[idx] - grid[idx]));
+        }
+    }
+
+    if (max_err_gauss > 1e-4 || max_err_box > 1e-4) {
+        ss << std::endl << "    Smoothing changed a linear field by " << max_err_gauss << " (Gaussian) and " << max_err_box << " (box)";
+    }
+
+    if (!std::isnan(smoothed[7 + 7 * nx]) || std::isnan(smoothed[8 + 7 * nx])) {
+        ss << std::endl << "    Missing points weren't handled correctly";
+    }
+
+    // Decimate by 4: blocks are averaged, skipping the missing point, and the partial blocks at the edges are averaged over what's there
+    const int factor = 4;
+    const int nx_dec = 5, ny_dec = 4;
+    std::vector<float> decimated(nx_dec * ny_dec);
+    decimateGrid(grid.data(), nx, ny, factor, decimated.data());
+
+    // Block (1, 1) covers i = 4-7, j = 4-7, minus (7, 7)
+    float block_sum = 0;
+    for (int j = 4; j < 8; j++) {
+        for (int i = 4; i < 8; i++) {
+            if (i != 7 || j != 7) block_sum += 2 * i + 3 * j;
+        }
+    }
+
+    if (fabs(decimated[1 + 1 * nx_dec] - block_sum / 15) > 1e-4) {
+        ss << std::endl << "    Decimated block was " << decimated[1 + 1 * nx_dec] << ", expected " << block_sum / 15;
+    }
+
+    // Last row of blocks only covers j = 12-14
+    if (fabs(decimated[0 + 3 * nx_dec] - (2 * 1.5 + 3 * 13)) > 1e-4) {
+        ss << std::endl << "    Partial decimated block was " << decimated[0 + 3 * nx_dec] << ", expected " << 2 * 1.5 + 3 * 13;
+    }
+
+    float xs[6] = {0, 1, 2, 3, 4, 5}, xs_dec[2];
+    decimateCoords(xs, 6, 4, xs_dec);
+    if (xs_dec[0] != 1.5 || xs_dec[1] != 4.5) {
+        ss << std::endl << "    Decimated coordinates were " << xs_dec[0] << " and " << xs_dec[1] << ", expected 1.5 and 4.5";
+    }
+
+    reportTest("Grid filter", ss.str());
+}
+
+void testContourScratch() {
+    std::stringstream ss;
+
+    // The end point table should agree with a std::map through a random series of inserts and erases, including colliding keys
+    EndpointTable table;
+    std::map<uint64_t, int> reference;
+    uint64_t state = 12345;
+
+    for (int iop = 0; iop < 20000; iop++) {
+        state = state * 6364136223846793005ull + 1442695040888963407ull;
+        const uint64_t key = (state >> 33) % 3000;
+
+        if ((state >> 20) % 3 == 0) {
+            table.erase(key);
+            reference.erase(key);
+        }
+        else {
+            table.insert(key, iop);
+            reference[key] = iop;
+        }
+    }
+
+    int n_mismatch = 0;
+    for (uint64_t key = 0; key < 3000; key++) {
+        auto it = reference.find(key);
+        if (table.find(key) != (it == reference.end() ? -1 : it->second)) n_mismatch++;
+    }
+
+    if (n_mismatch > 0) {
+        ss << std::endl << "    End point table disagreed with std::map for " << n_mismatch << " keys";
+    }
+
+    // Contouring with a reused scratch space should give exactly the same contours as with a fresh one
+    const int nx = 40, ny = 30;
+    std::vector<float> grid(nx * ny), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = i;
+    for (int j = 0; j < ny; j++) ys[j] = j;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = sinf(i * 0.3) * cosf(j * 0.4) + 0.1 * i;
+        }
+    }
+    std::vector<float> levels = {-0.5, 0., 0.5, 1., 1.5, 2.};
+
+    ContourScratch reused;
+    makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, true, reused);
+    std::vector<Contour> contours_reused = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, false, reused);
+
+    ContourScratch fresh;
+    std::vector<Contour> contours_fresh = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, false, fresh);
+
+    if (contours_reused.size() != contours_fresh.size()) {
+        ss << std::endl << "    Reused scratch gave " << contours_reused.size() << " contours, expected " << contours_fresh.size();
+    }
+    else {
+        for (int idx = 0; idx < contours_fresh.size(); idx++) {
+            if (contours_reused[idx].value != contours_fresh[idx].value || contours_reused[idx].point_list != contours_fresh[idx].point_list) {
+                ss << std::endl << "    Contour " << idx << " differed with a reused scratch space";
+                break;
+            }
+        }
+    }
+
+    reportTest("Contour scratch", ss.str());
+}
+
+// Put a contour in a form that doesn't depend on where tracing started on closed contours
+std::vector<Point> canonicalContour(const Contour& contour) {
+    std::vector<Point> pts = contour.point_list;
+    if (pts.size() > 1 && pts.front() == pts.back()) {
+        pts.pop_back();
+        auto lowest = std::min_element(pts.begin(), pts.end(), [](const Point& a, const Point& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+        std::rotate(pts.begin(), lowest, pts.end());
+    }
+    return pts;
+}
+
+void testContourStream() {
+    std::stringstream ss;
+
+    const int nx = 37, ny = 29;
+    std::vector<float> grid(nx * ny), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = i * 0.5;
+    for (int j = 0; j < ny; j++) ys[j] = 10 + j * j * 0.1;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = sinf(i * 0.35) * cosf(j * 0.3) + 0.05 * i;
+        }
+    }
+    grid[10 + 12 * nx] = NAN;
+    std::vector<float> levels = {-0.75, -0.25, 0.25, 0.75, 1.25};
+
+    for (const bool quad_as_tri : {false, true}) {
+        std::vector<Contour> batch = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, quad_as_tri);
+
+        // Push the rows in uneven blocks
+        ContourStream<float> stream(xs.data(), nx, levels, quad_as_tri);
+        std::vector<Contour> streamed;
+        int n_closed_early = 0;
+        for (int j = 0; j < ny; ) {
+            const int n_rows = std::min(ny - j, 1 + j % 4);
+            std::vector<Contour> closed = stream.pushRows(grid.data() + j * nx, ys.data() + j, n_rows);
+            n_closed_early += closed.size();
+            streamed.insert(streamed.end(), closed.begin(), closed.end());
+            j += n_rows;
+        }
+
+        std::vector<Contour> open = stream.finish();
+        streamed.insert(streamed.end(), open.begin(), open.end());
+
+        if (n_closed_early == 0) {
+            ss << std::endl << "    No closed contours came back before finish() (quad_as_tri=" << quad_as_tri << ")";
+        }
+
+        auto canonicalize = [](const std::vector<Contour>& contours) {
+            std::vector<std::pair<float, std::vector<Point>>> canon;
+            for (auto it = contours.begin(); it != contours.end(); ++it) canon.push_back({it->value, canonicalContour(*it)});
+            std::sort(canon.begin(), canon.end(), [](const auto& a, const auto& b) {
+                if (a.first != b.first) return a.first < b.first;
+                return std::lexicographical_compare(a.second.begin(), a.second.end(), b.second.begin(), b.second.end(), 
+                                                    [](const Point& p, const Point& q) { return p.x < q.x || (p.x == q.x && p.y < q.y); });
+            });
+            return canon;
+        };
+
+        if (canonicalize(batch) != canonicalize(streamed)) {
+            ss << std::endl << "    Streamed contours didn't match the batch contours (quad_as_tri=" << quad_as_tri << "; " << streamed.size() 
+               << " streamed, " << batch.size() << " batch)";
+        }
+    }
+
+    reportTest("Contour stream", ss.str());
+}
+
+void testContourPyramid() {
+    std::stringstream ss;
+
+    // A flat field with a one-point spike. Averaging smears the spike out below the contour level, but keeping the block extrema doesn't.
+    const int nx = 64, ny = 64;
+    std::vector<float> grid(nx * ny, 0.), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = i;
+    for (int j = 0; j < ny; j++) ys[j] = j;
+    grid[20 + 20 * nx] = 10.;
+
+    std::vector<float> levels = {5.};
+    auto averaged = makeContourPyramid(grid.data(), xs.data(), ys.data(), nx, ny, levels, 10, false, false);
+    auto extrema = makeContourPyramid(grid.data(), xs.data(), ys.data(), nx, ny, levels, 10, false, true);
+
+    // 64 -> 32 -> 16 -> 8 -> 4 -> 2
+    if (averaged.size() != 6 || extrema.size() != 6) {
+        ss << std::endl << "    Pyramid had " << averaged.size() << " and " << extrema.size() << " levels, expected 6";
+    }
+
+    if (averaged.size() > 1 && (averaged[0].size() != 1 || averaged[1].size() != 0)) {
+        ss << std::endl << "    Averaged pyramid had " << averaged[0].size() << " and " << averaged[1].size() << " contours on the first two levels, expected 1 and 0";
+    }
+
+    for (int ilev = 0; ilev < extrema.size(); ilev++) {
+        if (extrema[ilev].size() != 1) {
+            ss << std::endl << "    Extrema-preserving pyramid had " << extrema[ilev].size() << " contours on level " << ilev << ", expected 1";
+            continue;
+        }
+
+        // The contour should still be around the spike
+        const Point& pt = extrema[ilev][0].point_list[0];
+        if (fabsf(pt.x - 20) > (1 << ilev) * 2 || fabsf(pt.y - 20) > (1 << ilev) * 2) {
+            ss << std::endl << "    Contour on level " << ilev << " started at " << pt << ", which is too far from the spike";
+        }
+    }
+
+    reportTest("Contour pyramid", ss.str());
+}
+
+// Packs integers most significant bit first, like the GRIB2 data section
+struct TestBitWriter {
+    std::vector<uint8_t> bytes;
+    int n_bits = 0;
+
+    void put(uint32_t val, int n) {
+        for (int ibit = n - 1; ibit >= 0; ibit--) {
+            if (this->n_bits % 8 == 0) this->bytes.push_back(0);
+            this->bytes.back() |= ((val >> ibit) & 1) << (7 - this->n_bits % 8);
+            this->n_bits++;
+        }
+    }
+
+    void align() {
+        this->n_bits = (this->n_bits + 7) / 8 * 8;
+    }
+};
+
+void appendUint(std::vector<uint8_t>& buf, uint64_t val, int n_bytes) {
+    for (int ibyte = n_bytes - 1; ibyte >= 0; ibyte--) buf.push_back((val >> (8 * ibyte)) & 0xff);
+}
+
+void appendSection(std::vector<uint8_t>& msg, int number, const std::vector<uint8_t>& body) {
+    appendUint(msg, body.size() + 5, 4);
+    msg.push_back(number);
+    msg.insert(msg.end(), body.begin(), body.end());
+}
+
+// Scaling parameters that start every supported data representation template
+std::vector<uint8_t> makeGrib2Scaling(float ref_val, int bin_scale, int dec_scale, int n_bits) {
+    std::vector<uint8_t> body;
+    uint32_t ref_bits;
+    memcpy(&ref_bits, &ref_val, 4);
+    appendUint(body, ref_bits, 4);
+    appendUint(body, (bin_scale < 0 ? 0x8000 : 0) | abs(bin_scale), 2);
+    appendUint(body, (dec_scale < 0 ? 0x8000 : 0) | abs(dec_scale), 2);
+    body.push_back(n_bits);
+    body.push_back(0);
+    return body;
+}
+
+// A GRIB2 message with one field on an ni x nj template 3.0 grid
+std::vector<uint8_t> makeGrib2Message(int ni, int nj, int scan_mode, int drs_template, const std::vector<uint8_t>& drs_body, int n_values, 
+                                      const std::vector<uint8_t>& data, const std::vector<uint8_t>& bitmap) {
+    std::vector<uint8_t> sections;
+    appendSection(sections, 1, std::vector<uint8_t>(16, 0));
+
+    std::vector<uint8_t> gds = {0};
+    appendUint(gds, ni * nj, 4);
+    appendUint(gds, 0, 4);
+    std::vector<uint8_t> grid_template(58, 0);
+    for (int ibyte = 0; ibyte < 4; ibyte++) {
+        grid_template[16 + ibyte] = (ni >> (8 * (3 - ibyte))) & 0xff;
+        grid_template[20 + ibyte] = (nj >> (8 * (3 - ibyte))) & 0xff;
+    }
+    grid_template[57] = scan_mode;
+    gds.insert(gds.end(), grid_template.begin(), grid_template.end());
+    appendSection(sections, 3, gds);
+
+    appendSection(sections, 4, std::vector<uint8_t>(4, 0));
+
+    std::vector<uint8_t> drs;
+    appendUint(drs, n_values, 4);
+    appendUint(drs, drs_template, 2);
+    drs.insert(drs.end(), drs_body.begin(), drs_body.end());
+    appendSection(sections, 5, drs);
+
+    std::vector<uint8_t> bms = {static_cast<uint8_t>(bitmap.size() > 0 ? 0 : 255)};
+    bms.insert(bms.end(), bitmap.begin(), bitmap.end());
+    appendSection(sections, 6, bms);
+
+    appendSection(sections, 7, data);
+
+    std::vector<uint8_t> msg = {'G', 'R', 'I', 'B', 0, 0, 0, 2};
+    appendUint(msg, 16 + sections.size() + 4, 8);
+    msg.insert(msg.end(), sections.begin(), sections.end());
+    msg.insert(msg.end(), {'7', '7', '7', '7'});
+    return msg;
+}
+
+void testContourInBox() {
+    std::stringstream ss;
+
+    const int nx = 60, ny = 50;
+    std::vector<float> grid(nx * ny), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = i * 2.;
+    for (int j = 0; j < ny; j++) ys[j] = j * 3.;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = sinf(i * 0.25) * cosf(j * 0.2);
+        }
+    }
+    std::vector<float> levels = {-0.5, 0., 0.5};
+
+    std::vector<Contour> full = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, false);
+
+    // A box bigger than the grid should give the same contours as contouring everything, with nothing cut
+    std::vector<uint8_t> cut_flags;
+    std::vector<Contour> everything = makeContoursInBox(grid.data(), xs.data(), ys.data(), nx, ny, levels, false, {-5, -5, nx + 5, ny + 5}, cut_flags);
+
+    bool same = everything.size() == full.size();
+    for (int icntr = 0; same && icntr < full.size(); icntr++) {
+        same = everything[icntr].isClose(full[icntr]);
+    }
+    if (!same) ss << std::endl << "    Contouring in a box covering the grid didn't match contouring the grid";
+    if (std::count(cut_flags.begin(), cut_flags.end(), 0) != cut_flags.size()) ss << std::endl << "    Contours in a box covering the grid were cut";
+
+    // In a smaller box, every point should be in the box, contours should be cut exactly where they end on the box edges inside the grid, 
+    //  and closed contours should match the ones from the full grid
+    const CellBox box = {10, 0, 29, 19};
+    const float x_min = xs[box.i_min], x_max = xs[box.i_max + 1], y_min = ys[box.j_min], y_max = ys[box.j_max + 1];
+    std::vector<Contour> boxed = makeContoursInBox(grid.data(), xs.data(), ys.data(), nx, ny, levels, false, box, cut_flags);
+
+    int n_cut = 0;
+    for (int icntr = 0; icntr < boxed.size(); icntr++) {
+        const std::vector<Point>& pts = boxed[icntr].point_list;
+        for (auto it = pts.begin(); it != pts.end(); ++it) {
+            if (it->x < x_min || it->x > x_max || it->y < y_min || it->y > y_max) {
+                ss << std::endl << "    Point " << *it << " is outside the box";
+                break;
+            }
+        }
+
+        // The south edge of this box is the edge of the grid, so ends there aren't cuts
+        auto onCutEdge = [&](const Point& pt) { return pt.x == x_min || pt.x == x_max || pt.y == y_max; };
+        const bool closed = pts.front() == pts.back();
+        const uint8_t expected = closed ? 0 : ((onCutEdge(pts.front()) ? CONTOUR_CUT_START : 0) | (onCutEdge(pts.back()) ? CONTOUR_CUT_END : 0));
+        if (cut_flags[icntr] != expected) {
+            ss << std::endl << "    Contour " << icntr << " had cut flags " << (int)cut_flags[icntr] << ", expected " << (int)expected;
+        }
+        if (cut_flags[icntr] != 0) n_cut++;
+
+        if (closed && std::none_of(full.begin(), full.end(), [&](const Contour& c) { return c.isClose(boxed[icntr]); })) {
+            ss << std::endl << "    Closed contour " << icntr << " in the box isn't in the full grid's contours";
+        }
+    }
+
+    if (n_cut == 0) ss << std::endl << "    No contours were cut by the box";
 
-    float x_grid[nx] = {0, 1};
-    float y_grid[ny] = {0, 1};
-    std::vector<float> contour_vals(1, {test_case.value});
-    
-    std::vector<Contour> contours = makeContours(test_case.grid, x_grid, y_grid, nx, ny, contour_vals, test_case.quad_as_tri);
+    reportTest("Contour in box", ss.str());
+}
 
-    bool passed = true;
+void testGrib2() {
+    std::stringstream ss;
+    const int ni = 4, nj = 3;
+
+    auto checkFieldOnGrid = [&](const char* name, const std::vector<uint8_t>& msg, const std::vector<float>& expected, const int field_ni, 
+                                const int field_nj) {
+        try {
+            Grib2Field field = findGrib2Field(msg.data(), msg.size(), 0);
+            if (field.ni != field_ni || field.nj != field_nj) {
+                ss << std::endl << "    " << name << ": grid was " << field.ni << " x " << field.nj;
+                return;
+            }
+
+            std::vector<float> decoded(field.n_points);
+            std::vector<float16_t> decoded_f16(field.n_points);
+            decodeGrib2Field(field, decoded.data());
+            decodeGrib2Field(field, decoded_f16.data());
+
+            for (int ipt = 0; ipt < expected.size(); ipt++) {
+                const bool match = std::isnan(expected[ipt]) ? std::isnan(decoded[ipt]) : fabsf(decoded[ipt] - expected[ipt]) < 1e-4;
+                const bool match_f16 = std::isnan(expected[ipt]) ? std::isnan((float)decoded_f16[ipt]) 
+                                                                 : fabsf((float)decoded_f16[ipt] - expected[ipt]) < 1e-2 * fabsf(expected[ipt]) + 1e-3;
+                if (!match || !match_f16) {
+                    ss << std::endl << "    " << name << ": point " << ipt << " was " << decoded[ipt] << " (" << (float)decoded_f16[ipt] 
+                       << " for float16), expected " << expected[ipt];
+                    break;
+                }
+            }
+        }
+        catch (const std::invalid_argument& e) {
+            ss << std::endl << "    " << name << ": " << e.what();
+        }
+    };
+
+    auto checkField = [&](const char* name, const std::vector<uint8_t>& msg, const std::vector<float>& expected) {
+        checkFieldOnGrid(name, msg, expected, ni, nj);
+    };
+
+    // The packed values are in the default scanning order (rows from north to south), but the decoded values start in the south
+    auto flipRows = [&](const std::vector<float>& scan_order) {
+        std::vector<float> flipped(ni * nj);
+        for (int j = 0; j < nj; j++) {
+            std::copy(scan_order.begin() + (nj - 1 - j) * ni, scan_order.begin() + (nj - j) * ni, flipped.begin() + j * ni);
+        }
+        return flipped;
+    };
+
+    // Simple packing with a bitmap: Y = (10 + X * 2^1) / 10^1
+    {
+        const uint32_t packed[ni * nj] = {0, 5, 9, 3, 0, 12, 7, 1, 2, 2, 15, 4};
+        const bool present[ni * nj] = {true, true, false, true, true, true, true, true, false, true, true, true};
+
+        TestBitWriter data, bitmap;
+        std::vector<float> expected;
+        int n_values = 0;
+        for (int ipt = 0; ipt < ni * nj; ipt++) {
+            bitmap.put(present[ipt], 1);
+            if (present[ipt]) {
+                data.put(packed[ipt], 4);
+                n_values++;
+            }
+            expected.push_back(present[ipt] ? (10 + packed[ipt] * 2) / 10. : NAN);
+        }
+
+        checkField("Simple packing", makeGrib2Message(ni, nj, 0, 0, makeGrib2Scaling(10, 1, 1, 4), n_values, data.bytes, bitmap.bytes), flipRows(expected));
+    }
+
+    // Complex packing with second-order spatial differencing and a missing value, in two groups
+    {
+        const int values[ni * nj] = {100, 103, 107, 110, -1, 112, 111, 108, 104, 101, 99, 98};
+        std::vector<int> nonmissing;
+        for (int ipt = 0; ipt < ni * nj; ipt++) {
+            if (values[ipt] >= 0) nonmissing.push_back(values[ipt]);
+        }
+
+        std::vector<int> diffs = {0, 0};
+        for (int ival = 2; ival < nonmissing.size(); ival++) {
+            diffs.push_back(nonmissing[ival] - 2 * nonmissing[ival - 1] + nonmissing[ival - 2]);
+        }
+        const int min_diff = *std::min_element(diffs.begin() + 2, diffs.end());
+
+        // Put the differences back in grid order, with the missing value
+        std::vector<int> stream;
+        for (int ipt = 0, ival = 0; ipt < ni * nj; ipt++) {
+            stream.push_back(values[ipt] < 0 ? -1 : (ival < 2 ? 0 : diffs[ival] - min_diff));
+            if (values[ipt] >= 0) ival++;
+        }
+
+        // Two groups of 6, each 4 bits wide with a reference of 0, so the missing value is 15
+        TestBitWriter data;
+        auto putSignMagnitude = [&](int val) { data.put(val < 0, 1); data.put(abs(val), 15); };
+        putSignMagnitude(nonmissing[0]);
+        putSignMagnitude(nonmissing[1]);
+        putSignMagnitude(min_diff);
+        data.put(0, 8); data.put(0, 8); data.align();
+        data.put(4, 4); data.put(4, 4); data.align();
+        data.put(6, 4); data.put(6, 4); data.align();
+        for (int ipt = 0; ipt < ni * nj; ipt++) data.put(stream[ipt] < 0 ? 15 : stream[ipt], 4);
+
+        std::vector<uint8_t> drs = makeGrib2Scaling(0, 0, 0, 8);
+        drs.insert(drs.end(), {1, 1});                   // Group splitting method, missing value management
+        appendUint(drs, 0, 4); appendUint(drs, 0, 4);   // Missing value substitutes
+        appendUint(drs, 2, 4);                           // Number of groups
+        drs.insert(drs.end(), {0, 4});                   // Group width reference and bits
+        appendUint(drs, 0, 4);                           // Group length reference
+        drs.push_back(1);                                // Group length increment
+        appendUint(drs, 6, 4);                           // Last group length
+        drs.insert(drs.end(), {4, 2, 2});                // Group length bits, spatial differencing order and octets
+
+        std::vector<float> expected;
+        for (int ipt = 0; ipt < ni * nj; ipt++) expected.push_back(values[ipt] < 0 ? NAN : values[ipt]);
+
+        checkField("Complex packing", makeGrib2Message(ni, nj, 0, 3, drs, ni * nj, data.bytes, {}), flipRows(expected));
+    }
+
+    // An 8-bit grayscale PNG with a single IDAT chunk holding a zlib stream
+    auto makePNG = [&](const int width, const int height, const std::vector<uint8_t>& zlib) {
+        std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        auto appendChunk = [&](const char* type, const std::vector<uint8_t>& chunk) {
+            appendUint(png, chunk.size(), 4);
+            png.insert(png.end(), type, type + 4);
+            png.insert(png.end(), chunk.begin(), chunk.end());
+            appendUint(png, 0, 4); // The CRC isn't checked
+        };
+        std::vector<uint8_t> ihdr;
+        appendUint(ihdr, width, 4); appendUint(ihdr, height, 4);
+        ihdr.insert(ihdr.end(), {8, 0, 0, 0, 0});
+        appendChunk("IHDR", ihdr);
+        appendChunk("IDAT", zlib);
+        appendChunk("IEND", {});
+        return png;
+    };
+
+    // The samples for the PNG tests, with the "sub" and "up" filters on the second and third rows. Scanning mode 0x40 means the rows already
+    //  go from south to north.
+    const uint8_t png_samples[ni * nj] = {10, 20, 30, 40, 15, 25, 35, 45, 200, 150, 100, 50};
+    std::vector<float> png_expected;
+    for (int ipt = 0; ipt < ni * nj; ipt++) png_expected.push_back(-5 + png_samples[ipt] * 0.25);
+
+    // PNG with the image data stored without compression
+    {
+        const uint8_t* samples = png_samples;
+        std::vector<uint8_t> raw;
+        for (int j = 0; j < nj; j++) {
+            const int filter = j;
+            raw.push_back(filter);
+            for (int i = 0; i < ni; i++) {
+                const int pred = filter == 1 ? (i > 0 ? samples[i - 1 + j * ni] : 0) : (filter == 2 ? samples[i + (j - 1) * ni] : 0);
+                raw.push_back(samples[i + j * ni] - pred);
+            }
+        }
+
+        std::vector<uint8_t> zlib = {0x78, 0x01, 0x01};
+        appendUint(zlib, (raw.size() & 0xff) << 8 | raw.size() >> 8, 2);
+        appendUint(zlib, (~raw.size() & 0xff) << 8 | (~raw.size() >> 8 & 0xff), 2);
+        zlib.insert(zlib.end(), raw.begin(), raw.end());
+        uint32_t adler_a = 1, adler_b = 0;
+        for (auto it = raw.begin(); it != raw.end(); ++it) {
+            adler_a = (adler_a + *it) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+        appendUint(zlib, adler_b << 16 | adler_a, 4);
+
+        const std::vector<uint8_t> png = makePNG(ni, nj, zlib);
+
+        checkField("PNG packing", makeGrib2Message(ni, nj, 0x40, 41, makeGrib2Scaling(-5, -2, 0, 8), ni * nj, png, {}), png_expected);
+    }
+
+    // The same PNG compressed by zlib with fixed Huffman codes
+    {
+        const std::vector<uint8_t> zlib = {
+            0x78, 0x01, 0x63, 0xe0, 0x12, 0x91, 0xd3, 0x60, 0xe4, 0xe7, 0xe2, 0xe2, 0x62, 0xda, 0x59, 0xeb, 0xc8, 0x0a, 0x00, 0x0b, 0x0e, 0x02, 
+            0x11,
+        };
+
+        checkField("PNG packing (fixed Huffman)", makeGrib2Message(ni, nj, 0x40, 41, makeGrib2Scaling(-5, -2, 0, 8), ni * nj, makePNG(ni, nj, zlib), {}), 
+                   png_expected);
+    }
+
+    // A 16 x 8 PNG with samples of (i * j) % 7 * 30 and no row filters, compressed by zlib with dynamic Huffman codes
+    {
+        const int png_ni = 16, png_nj = 8;
+        const std::vector<uint8_t> zlib = {
+            0x78, 0xda, 0x65, 0xcd, 0x31, 0x01, 0x00, 0x30, 0x10, 0xc2, 0x40, 0x94, 0xa0, 0x04, 0x25, 0x28, 0x41, 0x09, 0x4a, 0x10, 0xd8, 0xed, 
+            0x97, 0x66, 0xb9, 0x31, 0xc0, 0x17, 0xe5, 0x74, 0x07, 0xa0, 0x8c, 0xee, 0x01, 0x78, 0x2a, 0x73, 0x00, 0x61, 0x35, 0x1f, 0x40, 0xcd, 
+            0x45, 0x07, 0xb0, 0xc6, 0xe2, 0xf1, 0x4d, 0x1f, 0x59, 0xea, 0x1f, 0xff,
+        };
+
+        std::vector<float> expected;
+        for (int j = 0; j < png_nj; j++) {
+            for (int i = 0; i < png_ni; i++) expected.push_back((i * j) % 7 * 30);
+        }
+
+        checkFieldOnGrid("PNG packing (dynamic Huffman)", makeGrib2Message(png_ni, png_nj, 0x40, 41, makeGrib2Scaling(0, 0, 0, 8), png_ni * png_nj, 
+                                                                          makePNG(png_ni, png_nj, zlib), {}), expected, png_ni, png_nj);
+    }
+
+    // PNG packing with 0 bits per value has an empty data section, and every value is the reference value
+    {
+        TestBitWriter bitmap;
+        std::vector<float> expected;
+        int n_values = 0;
+        for (int ipt = 0; ipt < ni * nj; ipt++) {
+            const bool present = ipt % 5 != 2;
+            bitmap.put(present, 1);
+            if (present) n_values++;
+            expected.push_back(present ? 273.15 : NAN);
+        }
+
+        checkField("PNG packing (constant field)", makeGrib2Message(ni, nj, 0x40, 41, makeGrib2Scaling(273.15, 0, 0, 0), n_values, {}, bitmap.bytes), 
+                   expected);
+    }
+
+    reportTest("GRIB2", ss.str());
+}
+
+void testContourCodec() {
+    std::stringstream ss;
+
+    const int nx = 1000, ny = 700;
+    std::vector<float> grid(nx * ny), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = -2.5e6 + i * 3000.;
+    for (int j = 0; j < ny; j++) ys[j] = -1.5e6 + j * 3000.;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = sinf(i * 0.011) * cosf(j * 0.013) + 0.002 * i;
+        }
+    }
+    std::vector<float> levels = {-0.5, 0., 0.5, 1., 1.5, 2.};
+
+    std::vector<Contour> contours = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, levels, false);
+    EncodedContours encoded = encodeContours(contours);
+    std::vector<Contour> decoded = decodeContours(encoded);
+
+    // Every decoded vertex should be within half a quantization step of the original
+    const float x_tol = 0.5 * (encoded.x_max - encoded.x_min) / CONTOUR_QUANT_MAX * 1.01;
+    const float y_tol = 0.5 * (encoded.y_max - encoded.y_min) / CONTOUR_QUANT_MAX * 1.01;
+    size_t n_points = 0;
+
+    if (decoded.size() != contours.size()) {
+        ss << std::endl << "    Decoded " << decoded.size() << " contours, expected " << contours.size();
+    }
+    else {
+        for (int icntr = 0; icntr < contours.size(); icntr++) {
+            const std::vector<Point>& orig = contours[icntr].point_list;
+            const std::vector<Point>& dec = decoded[icntr].point_list;
+
+            if (decoded[icntr].value != contours[icntr].value || dec.size() != orig.size()) {
+                ss << std::endl << "    Contour " << icntr << " has value " << decoded[icntr].value << " and " << dec.size() 
+                   << " points, expected " << contours[icntr].value << " and " << orig.size();
+                break;
+            }
+
+            bool matches = true;
+            for (int ipt = 0; ipt < orig.size(); ipt++) {
+                matches &= fabsf(dec[ipt].x - orig[ipt].x) <= x_tol && fabsf(dec[ipt].y - orig[ipt].y) <= y_tol;
+            }
+
+            if (!matches) {
+                ss << std::endl << "    Contour " << icntr << " vertices are off by more than the quantization error";
+                break;
+            }
+
+            n_points += orig.size();
+        }
+    }
+
+    // Most steps along a contour are less than a grid spacing, so they should fit in a byte or two
+    const float ratio = n_points * 2 * sizeof(float) / static_cast<float>(encoded.data.size());
+    if (ratio < 3) {
+        ss << std::endl << "    Encoded vertices are only " << ratio << "x smaller than float32";
+    }
+
+    // Writing and reading a contour file should give back the same encoded contours
+    std::stringstream file(std::ios::in | std::ios::out | std::ios::binary);
+    const ContourFileInfo info = {nx, ny, xs.front(), ys.front(), xs.back(), ys.back(), 0.f, levels, true, 2};
+    writeContourFile(file, encoded, info);
     try {
-        if (contours.size() != test_case.expected.size()) {
-            throw std::string("Incorrect number of contours");
+        ContourFileInfo read_info;
+        EncodedContours read = readContourFile(file, read_info);
+        if (read.x_min != encoded.x_min || read.y_max != encoded.y_max || read.values != encoded.values || read.n_points != encoded.n_points 
+            || read.data != encoded.data) {
+            ss << std::endl << "    Contour file didn't round trip";
         }
+        if (read_info.nx != nx || read_info.ny != ny || read_info.grid_x_min != xs.front() || read_info.grid_y_max != ys.back() 
+            || read_info.interval != 0.f || read_info.levels != levels || !read_info.quad_as_tri || read_info.smooth != 2) {
+            ss << std::endl << "    Contour file info didn't round trip";
+        }
+    }
+    catch (const std::invalid_argument& e) {
+        ss << std::endl << "    Reading contour file: " << e.what();
+    }
 
-        std::stringstream ss;
-        for (int idx = 0; idx < contours.size(); idx++) {
-            if (!contours[idx].isClose(test_case.expected[idx])) {
-                if (ss.str().length() == 0) {
-                    ss << "Contour data is wrong ";
+    // Truncated data shouldn't run off the end
+    encoded.data.resize(encoded.data.size() / 2);
+    try {
+        decodeContours(encoded);
+        ss << std::endl << "    Truncated data didn't throw an error";
+    }
+    catch (const std::invalid_argument& e) {}
+
+    reportTest("Contour codec", ss.str());
+}
+
+// Just enough of a protobuf reader to pull the features back out of a vector tile
+struct TestProtobufReader {
+    const std::vector<uint8_t>& buf;
+    size_t pos, end;
+
+    TestProtobufReader(const std::vector<uint8_t>& buf, size_t pos, size_t end) : buf(buf), pos(pos), end(end) {}
+
+    uint64_t varint() {
+        uint64_t val = 0;
+        for (int shift = 0; pos < end; shift += 7) {
+            uint8_t byte = buf[pos++];
+            val |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) break;
+        }
+        return val;
+    }
+
+    // Calls func(field, reader for the contents) for length-delimited fields, and skips the others
+    template<typename F>
+    void forEachMessage(F func) {
+        while (pos < end) {
+            uint64_t tag = varint();
+            int wire_type = tag & 0x7;
+            if (wire_type == 0) varint();
+            else if (wire_type == 1) pos += 8;
+            else if (wire_type == 5) pos += 4;
+            else {
+                size_t len = varint();
+                TestProtobufReader sub(buf, pos, pos + len);
+                func(tag >> 3, sub);
+                pos += len;
+            }
+        }
+    }
+};
+
+void testVectorTile() {
+    std::stringstream ss;
+
+    // Collinear points should simplify down to the end points, but a spike should stay
+    std::vector<Point> line = {{0, 0}, {1, 0.01}, {2, 0}, {3, 1}, {4, 0}, {5, 0}};
+    std::vector<Point> simplified = simplifyPolyline(line, 0.1);
+    std::vector<Point> simplified_expected = {{0, 0}, {2, 0}, {3, 1}, {4, 0}, {5, 0}};
+    if (simplified != simplified_expected) {
+        ss << std::endl << "    Simplified line had " << simplified.size() << " points, expected " << simplified_expected.size();
+    }
+
+    // A line that goes through the box twice should come out in two pieces, cut at the edges
+    std::vector<Point> zigzag = {{-1, 0.5}, {0.5, 0.5}, {0.5, 2}, {0.75, 2}, {0.75, 0.25}, {2, 0.25}};
+    auto pieces = clipPolyline(zigzag, 0, 0, 1, 1);
+    std::vector<std::vector<Point>> pieces_expected = {{{0, 0.5}, {0.5, 0.5}, {0.5, 1}}, {{0.75, 1}, {0.75, 0.25}, {1, 0.25}}};
+    if (pieces != pieces_expected) {
+        ss << std::endl << "    Clipped line had " << pieces.size() << " pieces, expected " << pieces_expected.size();
+    }
+
+    // Two square contours in WebMercator coordinates. At zoom 1, the first is all in tile (0, 0) and the second straddles tiles (0, 1) 
+    //  and (1, 1).
+    std::vector<Contour> contours;
+    contours.emplace_back(std::vector<Point>{{0.125, 0.125}, {0.25, 0.125}, {0.25, 0.25}, {0.125, 0.25}, {0.125, 0.125}}, 5);
+    contours.emplace_back(std::vector<Point>{{0.375, 0.625}, {0.625, 0.625}, {0.625, 0.75}, {0.375, 0.75}, {0.375, 0.625}}, 10);
+
+    ContourTiler tiler(contours, 0, 1, 4096, 64, 1, "height");
+
+    std::vector<TileID> tiles = tiler.getTiles(1);
+    std::vector<TileID> tiles_expected = {{1, 0, 0}, {1, 0, 1}, {1, 1, 1}};
+    if (tiles != tiles_expected) {
+        ss << std::endl << "    Found " << tiles.size() << " tiles at zoom 1, expected " << tiles_expected.size();
+    }
+
+    // Decode tile (1, 0, 0) and check the layer and the first square in tile coordinates
+    std::vector<uint8_t> tile = tiler.encodeTile({1, 0, 0});
+    std::string layer_name;
+    std::vector<uint32_t> geometry;
+    int n_features = 0;
+
+    TestProtobufReader(tile, 0, tile.size()).forEachMessage([&](int field, TestProtobufReader& layer) {
+        if (field != 3) return;
+        layer.forEachMessage([&](int field, TestProtobufReader& sub) {
+            if (field == 1) layer_name = std::string(tile.begin() + sub.pos, tile.begin() + sub.end);
+            if (field != 2) return;
+
+            n_features++;
+            sub.forEachMessage([&](int field, TestProtobufReader& packed) {
+                while (field == 4 && packed.pos < packed.end) geometry.push_back(packed.varint());
+            });
+        });
+    });
+
+    // MoveTo (1024, 1024), then LineTo x 4 around the square, with the coordinates as zigzag-encoded deltas
+    std::vector<uint32_t> geometry_expected = {9, 2048, 2048, 34, 2048, 0, 0, 2048, 2047, 0, 0, 2047};
+
+    if (layer_name != "height" || n_features != 1) {
+        ss << std::endl << "    Tile had layer '" << layer_name << "' with " << n_features << " features, expected 'height' with 1";
+    }
+    else if (geometry != geometry_expected) {
+        ss << std::endl << "    Tile geometry didn't match";
+    }
+
+    if (tiler.encodeTile({1, 1, 0}).size() != 0) {
+        ss << std::endl << "    Empty tile wasn't empty";
+    }
+
+    reportTest("Vector tile", ss.str());
+}
+
+void testTiledContours() {
+    std::stringstream ss;
+
+    // A global grid from 0 to 360 E (so it crosses the antimeridian), with the field repeating at 0 and 360
+    const int nx = 181, ny = 81;
+    std::vector<float> grid(nx * ny), lons(nx * ny), lats(nx * ny);
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            lons[i + nx * j] = i * 2.;
+            lats[i + nx * j] = -80. + j * 2.;
+            grid[i + nx * j] = sinf((i % (nx - 1)) * 2. * M_PI / 60. + 0.3) * cosf(j * 0.15);
+        }
+    }
+    std::vector<float> levels = {-0.5, 0., 0.5};
+
+    const int z = 2, n_tiles = 1 << z;
+    const double tile_size = 1. / n_tiles;
+    TiledContourer<float> contourer(grid.data(), lons.data(), lats.data(), nx, ny, levels, false, 4);
+
+    std::vector<std::vector<Contour>> tiles(n_tiles * n_tiles);
+    for (int ty = 0; ty < n_tiles; ty++) {
+        for (int tx = 0; tx < n_tiles; tx++) {
+            tiles[tx + n_tiles * ty] = decodeContours(contourer.getTile({z, tx, ty}));
+        }
+    }
+
+    if (contourer.getCacheSize() != 4) ss << std::endl << "    Tile cache had " << contourer.getCacheSize() << " tiles, expected 4";
+
+    const EncodedContours& tile_1 = contourer.getTile({z, 1, 1});
+    const std::vector<uint8_t> tile_1_data = tile_1.data;
+    if (contourer.getTile({z, 1, 1}).data != tile_1_data) ss << std::endl << "    Cached tile didn't match";
+
+    // Every point should be in its tile, and every line that ends on the edge of a tile should pick up at the same point in the next tile
+    auto onEdge = [](float val) { return std::fabs(val * n_tiles - std::round(val * n_tiles)) < 1e-5; };
+    auto hasEnd = [&](int tx, int ty, float value, float x, float y) {
+        const std::vector<Contour>& contours = tiles[(tx + n_tiles) % n_tiles + n_tiles * ty];
+        return std::any_of(contours.begin(), contours.end(), [&](const Contour& c) {
+            if (c.value != value) return false;
+            const Point& pf = c.point_list.front(), &pb = c.point_list.back();
+            return (std::fabs(pf.x - x) < 1e-6 && std::fabs(pf.y - y) < 1e-6) || (std::fabs(pb.x - x) < 1e-6 && std::fabs(pb.y - y) < 1e-6);
+        });
+    };
+
+    int n_stitched = 0;
+    for (int ty = 0; ty < n_tiles; ty++) {
+        for (int tx = 0; tx < n_tiles; tx++) {
+            const float x_min = tx * tile_size, x_max = (tx + 1) * tile_size, y_min = ty * tile_size, y_max = (ty + 1) * tile_size;
+            const std::vector<Contour>& contours = tiles[tx + n_tiles * ty];
+
+            for (auto it = contours.begin(); it != contours.end(); ++it) {
+                for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+                    if (plit->x < x_min - 1e-6 || plit->x > x_max + 1e-6 || plit->y < y_min - 1e-6 || plit->y > y_max + 1e-6) {
+                        ss << std::endl << "    Point " << *plit << " is outside tile (" << tx << ", " << ty << ")";
+                        break;
+                    }
                 }
 
-                ss << std::endl << "    Received " << contours[idx] << std::endl << "    Expected " << test_case.expected[idx];
+                for (const Point& end : {it->point_list.front(), it->point_list.back()}) {
+                    if (it->point_list.front() == it->point_list.back()) break;
+
+                    // Lines that end at a corner could pick up in any of the other three tiles, so skip those
+                    int next_tx = tx, next_ty = ty;
+                    if (onEdge(end.x) && onEdge(end.y)) continue;
+                    else if (onEdge(end.x)) next_tx += std::fabs(end.x - x_min) < 1e-5 ? -1 : 1;
+                    else if (onEdge(end.y)) next_ty += std::fabs(end.y - y_min) < 1e-5 ? -1 : 1;
+                    else continue;
+
+                    if (!hasEnd(next_tx, next_ty, it->value, next_tx < 0 ? end.x + 1 : (next_tx >= n_tiles ? end.x - 1 : end.x), end.y)) {
+                        ss << std::endl << "    Contour ending at " << end << " in tile (" << tx << ", " << ty << ") doesn't continue in the next tile";
+                    }
+                    n_stitched++;
+                }
             }
         }
+    }
 
-        if (ss.str().length() > 0) {
-            throw ss.str();
+    if (n_stitched == 0) ss << std::endl << "    No contours crossed tile edges";
+
+    // Every point from contouring the whole grid should be in the tiles
+    std::vector<float> map_xs(nx * ny), map_ys(nx * ny);
+    WebMercator().transform(lons.data(), lats.data(), nx * ny, map_xs.data(), map_ys.data());
+    std::vector<Contour> full = makeContoursCurvilinear(grid.data(), map_xs.data(), map_ys.data(), nx, ny, levels, false);
+
+    const float quant_tolerance = 2 * tile_size / CONTOUR_QUANT_MAX;
+    int n_missing = 0;
+    for (auto it = full.begin(); it != full.end(); ++it) {
+        for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+            const float x = plit->x >= 1 ? plit->x - 1 : plit->x;
+            const int tx = std::min(static_cast<int>(x * n_tiles), n_tiles - 1), ty = std::min(static_cast<int>(plit->y * n_tiles), n_tiles - 1);
+            const std::vector<Contour>& contours = tiles[tx + n_tiles * ty];
+
+            const bool found = std::any_of(contours.begin(), contours.end(), [&](const Contour& c) {
+                return c.value == it->value && std::any_of(c.point_list.begin(), c.point_list.end(), [&](const Point& pt) {
+                    return std::fabs(pt.x - x) <= quant_tolerance && std::fabs(pt.y - plit->y) <= quant_tolerance;
+                });
+            });
+            if (!found) n_missing++;
         }
     }
-    catch (std::string exc) {
-        std::cout << test_case.name << " test failed: " << exc << std::endl;
-        passed = false;
+
+    if (n_missing > 0) ss << std::endl << "    " << n_missing << " points from contouring the whole grid weren't in the tiles";
+
+    reportTest("Tiled contours", ss.str());
+}
+
+void testContourIndex() {
+    std::stringstream ss;
+
+    const int nx = 80, ny = 60;
+    std::vector<float> grid(nx * ny), xs(nx), ys(ny);
+    for (int i = 0; i < nx; i++) xs[i] = i * 0.5;
+    for (int j = 0; j < ny; j++) ys[j] = j * 0.5;
+    for (int j = 0; j < ny; j++) {
+        for (int i = 0; i < nx; i++) {
+            grid[i + j * nx] = sinf(i * 0.2) * cosf(j * 0.25) + 0.01 * i;
+        }
     }
 
-    if (passed) {
-        std::cout << test_case.name << " test passed" << std::endl;
+    std::vector<Contour> contours = makeContours(grid.data(), xs.data(), ys.data(), nx, ny, {-0.5, 0., 0.5}, false);
+    ContourIndex index(contours, 8);
+
+    // Check the bounding boxes, arc lengths, and closed flags against the points
+    const std::vector<ContourInfo>& info = index.getInfo();
+    int n_closed = 0, n_segments = 0;
+    for (int icntr = 0; icntr < contours.size(); icntr++) {
+        const std::vector<Point>& pts = contours[icntr].point_list;
+        float arc_length = 0;
+        bool in_box = true;
+        for (int ipt = 0; ipt < pts.size(); ipt++) {
+            in_box = in_box && pts[ipt].x >= info[icntr].x_min && pts[ipt].x <= info[icntr].x_max && 
+                               pts[ipt].y >= info[icntr].y_min && pts[ipt].y <= info[icntr].y_max;
+            if (ipt > 0) arc_length += std::hypot(pts[ipt].x - pts[ipt - 1].x, pts[ipt].y - pts[ipt - 1].y);
+        }
+        n_segments += pts.size() - 1;
+
+        if (!in_box) ss << std::endl << "    Contour " << icntr << " isn't in its bounding box";
+        if (std::fabs(arc_length - info[icntr].arc_length) > 1e-4 * arc_length) {
+            ss << std::endl << "    Contour " << icntr << " had arc length " << info[icntr].arc_length << ", expected " << arc_length;
+        }
+        if (info[icntr].closed != (pts.front() == pts.back())) ss << std::endl << "    Contour " << icntr << " had the wrong closed flag";
+        if (info[icntr].closed) n_closed++;
+    }
+
+    if (n_closed == 0 || n_closed == contours.size()) ss << std::endl << "    Expected both open and closed contours";
+    if (index.getNumSegments() != n_segments) ss << std::endl << "    Index has " << index.getNumSegments() << " segments, expected " << n_segments;
+
+    // Culling should find the same contours as checking every segment
+    std::vector<float> boxes = {5, 5, 10, 8, 0, 0, 40, 30, -10, -10, -5, -5, 20.1, 10.1, 20.2, 10.2};
+    std::vector<int> offsets, indices;
+    index.cull(boxes.data(), boxes.size() / 4, offsets, indices);
+
+    for (int ibox = 0; ibox < boxes.size() / 4; ibox++) {
+        const float* box = boxes.data() + 4 * ibox;
+        std::vector<int> expected;
+        for (int icntr = 0; icntr < contours.size(); icntr++) {
+            const std::vector<Point>& pts = contours[icntr].point_list;
+            for (int ipt = 0; ipt + 1 < pts.size(); ipt++) {
+                if (std::max(pts[ipt].x, pts[ipt + 1].x) >= box[0] && std::min(pts[ipt].x, pts[ipt + 1].x) <= box[2] &&
+                    std::max(pts[ipt].y, pts[ipt + 1].y) >= box[1] && std::min(pts[ipt].y, pts[ipt + 1].y) <= box[3]) {
+                    expected.push_back(icntr);
+                    break;
+                }
+            }
+        }
+
+        std::vector<int> culled(indices.begin() + offsets[ibox], indices.begin() + offsets[ibox + 1]);
+        if (culled != expected) ss << std::endl << "    Box " << ibox << " had " << culled.size() << " contours, expected " << expected.size();
+    }
+
+    // The nearest contour should be as close as the closest segment of any contour
+    auto segmentDist = [](float x, float y, const Point& p0, const Point& p1) {
+        const float dx = p1.x - p0.x, dy = p1.y - p0.y;
+        const float len2 = dx * dx + dy * dy;
+        const float t = len2 > 0 ? std::clamp(((x - p0.x) * dx + (y - p0.y) * dy) / len2, 0.f, 1.f) : 0.f;
+        return std::hypot(x - p0.x - t * dx, y - p0.y - t * dy);
+    };
+
+    for (int iqry = 0; iqry < 50; iqry++) {
+        const float qx = fmodf(iqry * 7.31, 45.) - 2, qy = fmodf(iqry * 3.77, 33.) - 2;
+
+        float dist_expected = INFINITY;
+        for (auto it = contours.begin(); it != contours.end(); ++it) {
+            for (int ipt = 0; ipt + 1 < it->point_list.size(); ipt++) {
+                dist_expected = std::min(dist_expected, segmentDist(qx, qy, it->point_list[ipt], it->point_list[ipt + 1]));
+            }
+        }
+
+        ContourHit hit = index.nearest(qx, qy);
+        if (hit.contour < 0 || std::fabs(hit.distance - dist_expected) > 1e-5) {
+            ss << std::endl << "    Nearest contour to (" << qx << ", " << qy << ") was " << hit.distance << " away, expected " << dist_expected;
+            continue;
+        }
+
+        const std::vector<Point>& pts = contours[hit.contour].point_list;
+        if (std::fabs(segmentDist(qx, qy, pts[hit.segment], pts[hit.segment + 1]) - hit.distance) > 1e-5 || 
+            std::fabs(std::hypot(hit.x - qx, hit.y - qy) - hit.distance) > 1e-5) {
+            ss << std::endl << "    Nearest point to (" << qx << ", " << qy << ") wasn't on the segment it was reported on";
+        }
+
+        if (index.nearest(qx, qy, dist_expected * 0.5).contour != -1 && dist_expected > 0) {
+            ss << std::endl << "    Found a contour near (" << qx << ", " << qy << ") beyond the maximum distance";
+        }
+    }
+
+    reportTest("Contour index", ss.str());
+}
+
+void testEnsemble() {
+    std::stringstream ss;
+
+    // Enough points to go past one block, with a few missing member values and one point missing in every member
+    const int n_members = 7, n = 1300;
+    std::vector<std::vector<float>> members(n_members, std::vector<float>(n));
+    std::vector<const float*> member_ptrs(n_members);
+    for (int imem = 0; imem < n_members; imem++) {
+        for (int ipt = 0; ipt < n; ipt++) {
+            members[imem][ipt] = 10 * sinf(ipt * 0.013 + imem * 0.9) + 0.3 * imem;
+        }
+        members[imem][(imem * 37) % n] = NAN;
+        members[imem][n - 1] = NAN;
+        member_ptrs[imem] = members[imem].data();
+    }
+
+    auto pointVals = [&](int ipt) {
+        std::vector<float> vals;
+        for (int imem = 0; imem < n_members; imem++) {
+            if (!std::isnan(members[imem][ipt])) vals.push_back(members[imem][ipt]);
+        }
+        std::sort(vals.begin(), vals.end());
+        return vals;
+    };
+
+    const float threshold = 2.5;
+    std::vector<float> prob(n), mean(n), spread(n), pct(n), bits(n);
+    ensembleProbability(member_ptrs.data(), n_members, n, threshold, prob.data());
+    ensembleMeanSpread(member_ptrs.data(), n_members, n, mean.data(), spread.data());
+    ensemblePercentile(member_ptrs.data(), n_members, n, 90, pct.data());
+    paintballBits(member_ptrs.data(), n_members, n, threshold, bits.data());
+
+    for (int ipt = 0; ipt < n; ipt++) {
+        std::vector<float> vals = pointVals(ipt);
+
+        if (vals.empty()) {
+            if (!std::isnan(prob[ipt]) || !std::isnan(mean[ipt]) || !std::isnan(spread[ipt]) || !std::isnan(pct[ipt]) || bits[ipt] != 0) {
+                ss << std::endl << "    Point " << ipt << " is missing in every member, but the output wasn't missing";
+            }
+            continue;
+        }
+
+        float n_exceed = 0, sum = 0, sum_sq = 0, bits_expected = 0;
+        for (auto it = vals.begin(); it != vals.end(); ++it) {
+            n_exceed += *it > threshold;
+            sum += *it;
+        }
+        for (auto it = vals.begin(); it != vals.end(); ++it) {
+            sum_sq += (*it - sum / vals.size()) * (*it - sum / vals.size());
+        }
+        for (int imem = 0; imem < n_members; imem++) {
+            if (members[imem][ipt] > threshold) bits_expected += 1 << imem;
+        }
+
+        const float rank = 0.9 * (vals.size() - 1);
+        const int rank_lo = std::floor(rank);
+        const float pct_expected = rank_lo + 1 < vals.size() ? vals[rank_lo] + (rank - rank_lo) * (vals[rank_lo + 1] - vals[rank_lo]) : vals[rank_lo];
+
+        if (std::fabs(prob[ipt] - n_exceed / vals.size()) > 1e-6) ss << std::endl << "    Wrong probability at point " << ipt;
+        if (std::fabs(mean[ipt] - sum / vals.size()) > 1e-4) ss << std::endl << "    Wrong mean at point " << ipt;
+        if (std::fabs(spread[ipt] - std::sqrt(sum_sq / vals.size())) > 1e-4) ss << std::endl << "    Wrong spread at point " << ipt;
+        if (std::fabs(pct[ipt] - pct_expected) > 1e-4) ss << std::endl << "    Wrong percentile at point " << ipt;
+        if (bits[ipt] != bits_expected) ss << std::endl << "    Wrong paintball bits at point " << ipt;
+    }
+
+    // The probability-matched mean should be ordered the same way as the ensemble mean, with values from the members
+    std::vector<float> pm_mean(n);
+    probabilityMatchedMean(member_ptrs.data(), n_members, n, pm_mean.data());
+
+    std::vector<int> order;
+    for (int ipt = 0; ipt < n; ipt++) {
+        if (std::isnan(mean[ipt]) != std::isnan(pm_mean[ipt])) ss << std::endl << "    Wrong missing points in the PM mean at point " << ipt;
+        if (!std::isnan(mean[ipt])) order.push_back(ipt);
+    }
+    std::sort(order.begin(), order.end(), [&](int a, int b) { return mean[a] < mean[b]; });
+
+    for (int iord = 1; iord < order.size(); iord++) {
+        if (pm_mean[order[iord]] < pm_mean[order[iord - 1]]) {
+            ss << std::endl << "    PM mean isn't ordered like the ensemble mean at point " << order[iord];
+            break;
+        }
+    }
+
+    const float pm_min = *std::min_element(pm_mean.begin(), pm_mean.end() - 1), pm_max = *std::max_element(pm_mean.begin(), pm_mean.end() - 1);
+    const float mean_min = *std::min_element(mean.begin(), mean.end() - 1), mean_max = *std::max_element(mean.begin(), mean.end() - 1);
+    if (pm_min > mean_min || pm_max < mean_max) ss << std::endl << "    PM mean should be at least as extreme as the ensemble mean";
+
+    // float16 members should give the same probabilities as the float16 values rounded to float32
+    std::vector<std::vector<float16_t>> members_f16(n_members, std::vector<float16_t>(n));
+    std::vector<std::vector<float>> members_rounded(n_members, std::vector<float>(n));
+    std::vector<const float16_t*> member_ptrs_f16(n_members);
+    std::vector<const float*> member_ptrs_rounded(n_members);
+    for (int imem = 0; imem < n_members; imem++) {
+        for (int ipt = 0; ipt < n; ipt++) {
+            members_f16[imem][ipt] = members[imem][ipt];
+            members_rounded[imem][ipt] = members_f16[imem][ipt];
+        }
+        member_ptrs_f16[imem] = members_f16[imem].data();
+        member_ptrs_rounded[imem] = members_rounded[imem].data();
+    }
+
+    std::vector<float> prob_f16(n), prob_rounded(n);
+    ensembleProbability(member_ptrs_f16.data(), n_members, n - 1, threshold, prob_f16.data());
+    ensembleProbability(member_ptrs_rounded.data(), n_members, n - 1, threshold, prob_rounded.data());
+    if (!std::equal(prob_f16.begin(), prob_f16.end() - 1, prob_rounded.begin())) ss << std::endl << "    Wrong probabilities for float16 members";
+
+    // Paintball only has room for 24 members
+    std::vector<const float*> too_many(PAINTBALL_MAX_MEMBERS + 1, members[0].data());
+    try {
+        paintballBits(too_many.data(), too_many.size(), n, threshold, bits.data());
+        ss << std::endl << "    Expected an exception for too many paintball members";
+    }
+    catch (const std::invalid_argument& e) {}
+
+    reportTest("Ensemble", ss.str());
+}
+
+void testGeostationary() {
+    Geostationary geos(-75.2);
+    std::stringstream ss;
+
+    // Round trip at some points on the disk
+    std::vector<EarthPoint> pts = {{-97.44, 35.18}, {-75.2, 0.}, {-60., -20.}, {-120., 45.}};
+    for (auto it = pts.begin(); it != pts.end(); ++it) {
+        EarthPoint pt_rt = geos.transform_inverse(geos.transform(*it));
+        if (fabs(pt_rt.lon - it->lon) > 1e-3 || fabs(pt_rt.lat - it->lat) > 1e-3) {
+            ss << std::endl << "    Round trip of " << *it << " gave " << pt_rt;
+        }
+    }
+
+    // Off-disk scan angles and points on the far side of the Earth should be NaN
+    EarthPoint pt_off = geos.transform_inverse(GridPoint(0.15, 0.15));
+    if (!std::isnan(pt_off.lon) || !std::isnan(pt_off.lat)) {
+        ss << std::endl << "    Off-disk scan angle gave " << pt_off;
+    }
+
+    GridPoint pt_far = geos.transform(EarthPoint(104.8, 0.));
+    if (!std::isnan(pt_far.x) || !std::isnan(pt_far.y)) {
+        ss << std::endl << "    Far side point gave " << pt_far;
+    }
+
+    // The batch grid transform should match the point-by-point transform
+    const int nx = 5, ny = 4;
+    float xs[nx] = {-0.1, -0.05, 0., 0.05, 0.1};
+    float ys[ny] = {-0.12, 0., 0.12, 0.16};
+    float lons[nx * ny], lats[nx * ny];
+    geos.transform_inverse_grid(xs, nx, ys, ny, lons, lats);
+
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            EarthPoint pt = geos.transform_inverse(GridPoint(xs[i], ys[j]));
+            const int idx = i + nx * j;
+            const bool both_nan = std::isnan(pt.lon) && std::isnan(lons[idx]);
+
+            if (!both_nan && (pt.lon != lons[idx] || pt.lat != lats[idx])) {
+                ss << std::endl << "    Grid transform at (" << i << ", " << j << ") gave {lon=" << lons[idx] << ", lat=" << lats[idx] << "}, expected " << pt;
+            }
+        }
+    }
+
+    reportTest("Geostationary", ss.str());
+}
+
+void testRadarSweep() {
+    std::stringstream ss;
+
+    // Flinders Peak to Buninyong (the worked example from Vincenty 1975)
+    RadarSweep flinders(144 + 25 / 60. + 29.52440 / 3600., -(37 + 57 / 60. + 3.72030 / 3600.));
+    EarthPoint buninyong = flinders.transform_inverse(GridPoint(54972.271, 306 + 52 / 60. + 5.37 / 3600.));
+    EarthPoint buninyong_expected(143 + 55 / 60. + 35.38390 / 3600., -(37 + 39 / 60. + 10.15610 / 3600.));
+
+    if (fabs(buninyong.lon - buninyong_expected.lon) > 1e-5 || fabs(buninyong.lat - buninyong_expected.lat) > 1e-5) {
+        ss << std::endl << "    Direct transform gave " << buninyong << ", expected " << buninyong_expected;
+    }
+
+    // Round trip out to 460 km should be good to a couple meters (which is about the precision of the float32 lat/lons)
+    RadarSweep ktlx(-97.2778, 35.3331);
+    const int nr = 4, naz = 6;
+    float rns[nr] = {1000., 100000., 300000., 460000.};
+    float azs[naz] = {0., 45., 135.5, 180., 270., 359.5};
+    float lons[nr * naz], lats[nr * naz];
+    ktlx.transform_inverse_grid(rns, nr, azs, naz, lons, lats);
+
+    for (int i = 0; i < nr; i++) {
+        for (int j = 0; j < naz; j++) {
+            const int idx = i + nr * j;
+            GridPoint pt_rt = ktlx.transform(EarthPoint(lons[idx], lats[idx]));
+
+            const float cross_range_error = rns[i] * degToRad(fabs(pt_rt.y - azs[j]));
+
+            if (fabs(pt_rt.x - rns[i]) > 2 || cross_range_error > 2) {
+                ss << std::endl << "    Round trip of {rn=" << rns[i] << ", az=" << azs[j] << "} gave " << pt_rt;
+            }
+        }
     }
+
+    reportTest("Radar sweep", ss.str());
 }
 
 int main(int argc, char** argv) {
@@ -125,6 +1913,32 @@ int main(int argc, char** argv) {
         testContour(*it);
     }
 
+    testContourCurvilinear();
+    testLRUCache();
+    testFastMath();
+    testLambertFastMath();
+    testBBElements();
+    testDomainVertices();
+    testRefineDomain();
+    testMinZoom();
+    testPointIndex();
+    testFieldExpression();
+    testVectorKernels();
+    testSmoothContours();
+    testGridFilter();
+    testContourPyramid();
+    testContourScratch();
+    testContourStream();
+    testContourInBox();
+    testGrib2();
+    testContourCodec();
+    testVectorTile();
+    testTiledContours();
+    testContourIndex();
+    testEnsemble();
+    testGeostationary();
+    testRadarSweep();
+
     LambertConformalConic lcc(-97.5, 38.5, 38.5, 38.5);
     EarthPoint pt(-97.44, 35.18);
 
@@ -0,0 +1,117 @@
+#include <cmath>
+#include <algorithm>
+
+#include "thinning.hpp"
+#include "map.hpp"
+
+void makeStructuredMinZoom(const int ni, const int nj, const float thin_fac, uint8_t* min_zoom) {
+    const int log2_thin_fac = (int)round(log2(thin_fac));
+
+    // A point is visible at zoom 1 if both its indices are divisible by thin_fac, and each zoom level after that halves thin_fac, so the
+    //  min zoom comes from the number of trailing zero bits in the indices.
+    for (int j = 0; j < nj; j++) {
+        for (int i = 0; i < ni; i++) {
+            const unsigned int ij = (unsigned int)i | (unsigned int)j;
+            const int n_trailing_zeros = ij == 0 ? log2_thin_fac : __builtin_ctz(ij);
+
+            min_zoom[i + j * ni] = 1 + std::max(0, log2_thin_fac - n_trailing_zeros);
+        }
+    }
+}
+
+// Spread the bits of a 32-bit integer out to every other bit of a 64-bit integer
+static uint64_t spreadBits(uint64_t val) {
+    val = (val | (val << 16)) & 0x0000ffff0000ffffULL;
+    val = (val | (val << 8))  & 0x00ff00ff00ff00ffULL;
+    val = (val | (val << 4))  & 0x0f0f0f0f0f0f0f0fULL;
+    val = (val | (val << 2))  & 0x3333333333333333ULL;
+    val = (val | (val << 1))  & 0x5555555555555555ULL;
+    return val;
+}
+
+struct ThinningIndex {
+    std::vector<float> xs, ys;
+    std::vector<uint64_t> codes;
+    std::vector<int> order;
+    int n_levels;
+    int offset;
+    int max_depth;
+};
+
+static void thinCell(const ThinningIndex& index, int ibegin, int iend, int depth, double x_center, double y_center, double half_width, uint8_t* min_zoom) {
+    // Find the point nearest the center of the cell (using the same max-norm distance as the quadtree cells). Ties are common with the 
+    //  max norm, so break them by taking the first point, so the result doesn't depend on the sort order.
+    int ipt_nearest = -1;
+    double dist_nearest = INFINITY;
+
+    for (int iord = ibegin; iord < iend; iord++) {
+        const int ipt = index.order[iord];
+        const double dist = std::max(fabs(index.xs[ipt] - x_center), fabs(index.ys[ipt] - y_center));
+        if (dist < dist_nearest || (dist == dist_nearest && ipt < ipt_nearest)) {
+            ipt_nearest = ipt;
+            dist_nearest = dist;
+        }
+    }
+
+    if (min_zoom[ipt_nearest] == MAP_MAX_ZOOM) {
+        min_zoom[ipt_nearest] = std::max(depth - index.offset, 0);
+    }
+
+    // The level in the Morton codes for the children of this cell (the root cell is depth -1)
+    const int level = depth + 1;
+    if (iend - ibegin <= 1 || depth >= index.max_depth || level >= index.n_levels) return;
+
+    // The points in each child cell are contiguous in Morton order, so find the boundaries between them
+    const int shift = 2 * (index.n_levels - 1 - level);
+
+    int child_begin = ibegin;
+    for (int ichild = 0; ichild < 4; ichild++) {
+        const int child_end = std::partition_point(index.order.begin() + child_begin, index.order.begin() + iend, 
+                                                   [&](int ipt) { return (int)((index.codes[ipt] >> shift) & 3) <= ichild; }) - index.order.begin();
+
+        if (child_end > child_begin) {
+            const double child_x = x_center + ((ichild & 1) ? half_width : -half_width) / 2;
+            const double child_y = y_center + ((ichild & 2) ? half_width : -half_width) / 2;
+            thinCell(index, child_begin, child_end, depth + 1, child_x, child_y, half_width / 2, min_zoom);
+        }
+
+        child_begin = child_end;
+    }
+}
+
+void makeUnstructuredMinZoom(const float* lons, const float* lats, const int n_pts, const float thin_fac, uint8_t* min_zoom) {
+    WebMercator map_crs;
+    ThinningIndex index;
+
+    index.offset = (int)round(log2(thin_fac));
+    index.max_depth = MAP_MAX_ZOOM + index.offset;
+
+    // The root cell is centered on the map with twice the width of the map (at depth -1), so it covers longitudes past 180. Each level 
+    //  of the quadtree is one bit in each dimension of the Morton code.
+    index.n_levels = std::min(index.max_depth + 1, 31);
+    const double n_cells = (double)(1u << index.n_levels);
+
+    index.xs.resize(n_pts);
+    index.ys.resize(n_pts);
+    index.codes.resize(n_pts);
+    index.order.reserve(n_pts);
+
+    for (int ipt = 0; ipt < n_pts; ipt++) {
+        min_zoom[ipt] = MAP_MAX_ZOOM;
+
+        map_crs.transform(&lons[ipt], &lats[ipt], 1, &index.xs[ipt], &index.ys[ipt]);
+        if (std::isnan(index.xs[ipt]) || std::isnan(index.ys[ipt])) continue;
+
+        const uint64_t qx = (uint64_t)std::min(std::max(floor((index.xs[ipt] + 0.5) / 2 * n_cells), 0.), n_cells - 1);
+        const uint64_t qy = (uint64_t)std::min(std::max(floor((index.ys[ipt] + 0.5) / 2 * n_cells), 0.), n_cells - 1);
+
+        index.codes[ipt] = spreadBits(qx) | (spreadBits(qy) << 1);
+        index.order.push_back(ipt);
+    }
+
+    if (index.order.size() == 0) return;
+
+    std::sort(index.order.begin(), index.order.end(), [&](int a, int b) { return index.codes[a] < index.codes[b]; });
+
+    thinCell(index, 0, index.order.size(), -1, 0.5, 0.5, 1., min_zoom);
+}
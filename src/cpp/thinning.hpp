@@ -0,0 +1,18 @@
+
+#ifndef __AUTUMNPLOT_THINNING_H__
+#define __AUTUMNPLOT_THINNING_H__
+
+#include <vector>
+#include <cstdint>
+
+// Points that never get thinned in are left at the max map zoom
+const int MAP_MAX_ZOOM = 24;
+
+// Compute the minimum zoom at which each point on an ni x nj structured grid is visible when thinning by thin_fac (a power of 2) at zoom 1
+void makeStructuredMinZoom(const int ni, const int nj, const float thin_fac, uint8_t* min_zoom);
+
+// Compute the minimum zoom at which each of a set of scattered points is visible. The map is divided up as a quadtree, and in each quadtree 
+//  cell, the point closest to the center of the cell is made visible at the zoom for that cell.
+void makeUnstructuredMinZoom(const float* lons, const float* lats, const int n_pts, const float thin_fac, uint8_t* min_zoom);
+
+#endif
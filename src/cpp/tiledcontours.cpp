@@ -0,0 +1,115 @@
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+#include "float16_t.hpp"
+#include "map.hpp"
+#include "tiledcontours.hpp"
+
+using numeric::float16_t;
+
+template<typename T>
+TiledContourer<T>::TiledContourer(const T* grid, const float* lons, const float* lats, const int nx, const int ny, const std::vector<float>& values,
+                                  const bool quad_as_tri, const size_t cache_size) :
+    grid(grid, grid + nx * ny), map_xs(nx * ny), map_ys(nx * ny), nx(nx), ny(ny), values(values), quad_as_tri(quad_as_tri), tile_cache(cache_size) {
+
+    WebMercator map_crs;
+    map_crs.transform(lons, lats, nx * ny, this->map_xs.data(), this->map_ys.data());
+
+    // Block (bi, bj) has cells TILED_CONTOUR_BLOCK_SIZE * bi to TILED_CONTOUR_BLOCK_SIZE * (bi + 1) - 1 in i, so it spans one more grid point
+    //  than that to include the far corners of its last cells
+    const int n_cells_i = std::max(nx - 1, 0), n_cells_j = std::max(ny - 1, 0);
+    this->n_blocks_i = (n_cells_i + TILED_CONTOUR_BLOCK_SIZE - 1) / TILED_CONTOUR_BLOCK_SIZE;
+    this->n_blocks_j = (n_cells_j + TILED_CONTOUR_BLOCK_SIZE - 1) / TILED_CONTOUR_BLOCK_SIZE;
+    this->blocks.resize(this->n_blocks_i * this->n_blocks_j);
+
+    for (int bj = 0; bj < this->n_blocks_j; bj++) {
+        for (int bi = 0; bi < this->n_blocks_i; bi++) {
+            CellBlock& block = this->blocks[bi + this->n_blocks_i * bj];
+            block = {INFINITY, INFINITY, -INFINITY, -INFINITY};
+
+            const int i_end = std::min(TILED_CONTOUR_BLOCK_SIZE * (bi + 1), nx - 1);
+            const int j_end = std::min(TILED_CONTOUR_BLOCK_SIZE * (bj + 1), ny - 1);
+
+            for (int j = TILED_CONTOUR_BLOCK_SIZE * bj; j <= j_end; j++) {
+                for (int i = TILED_CONTOUR_BLOCK_SIZE * bi; i <= i_end; i++) {
+                    const float x = this->map_xs[i + nx * j], y = this->map_ys[i + nx * j];
+
+                    // Points off the map (e.g., off the disk for a geostationary satellite) are NaN
+                    if (std::isnan(x) || std::isnan(y)) continue;
+
+                    block.x_min = std::min(block.x_min, x); block.x_max = std::max(block.x_max, x);
+                    block.y_min = std::min(block.y_min, y); block.y_max = std::max(block.y_max, y);
+                }
+            }
+        }
+    }
+}
+
+template<typename T>
+bool TiledContourer<T>::getTileCellBox(const TileID& tile, const int world_offset, CellBox& box) const {
+    const double n_tiles = 1 << tile.z;
+    const float x_min = tile.x / n_tiles + world_offset, x_max = (tile.x + 1) / n_tiles + world_offset;
+    const float y_min = tile.y / n_tiles, y_max = (tile.y + 1) / n_tiles;
+
+    box = {this->nx, this->ny, -1, -1};
+
+    for (int bj = 0; bj < this->n_blocks_j; bj++) {
+        for (int bi = 0; bi < this->n_blocks_i; bi++) {
+            const CellBlock& block = this->blocks[bi + this->n_blocks_i * bj];
+            if (block.x_max < x_min || block.x_min > x_max || block.y_max < y_min || block.y_min > y_max) continue;
+
+            box.i_min = std::min(box.i_min, TILED_CONTOUR_BLOCK_SIZE * bi);
+            box.j_min = std::min(box.j_min, TILED_CONTOUR_BLOCK_SIZE * bj);
+            box.i_max = std::max(box.i_max, std::min(TILED_CONTOUR_BLOCK_SIZE * (bi + 1), this->nx - 1) - 1);
+            box.j_max = std::max(box.j_max, std::min(TILED_CONTOUR_BLOCK_SIZE * (bj + 1), this->ny - 1) - 1);
+        }
+    }
+
+    return box.i_min <= box.i_max && box.j_min <= box.j_max;
+}
+
+template<typename T>
+const EncodedContours& TiledContourer<T>::getTile(const TileID& tile) {
+    const uint64_t key = (static_cast<uint64_t>(tile.z) << 58) | (static_cast<uint64_t>(tile.x) << 29) | static_cast<uint64_t>(tile.y);
+
+    EncodedContours* cached = this->tile_cache.get(key);
+    if (cached != NULL) return *cached;
+
+    const double n_tiles = 1 << tile.z;
+    const float x_min = tile.x / n_tiles, x_max = (tile.x + 1) / n_tiles;
+    const float y_min = tile.y / n_tiles, y_max = (tile.y + 1) / n_tiles;
+
+    std::vector<Contour> tile_contours;
+    std::vector<uint8_t> cut_flags;
+
+    for (int world_offset = -1; world_offset <= 1; world_offset++) {
+        CellBox box;
+        if (!this->getTileCellBox(tile, world_offset, box)) continue;
+
+        std::vector<Contour> contours = makeContoursCurvilinearInBox(this->grid.data(), this->map_xs.data(), this->map_ys.data(), this->nx, this->ny,
+                                                                     this->values, this->quad_as_tri, box, cut_flags);
+
+        for (auto it = contours.begin(); it != contours.end(); ++it) {
+            if (world_offset != 0) {
+                for (auto plit = it->point_list.begin(); plit != it->point_list.end(); ++plit) {
+                    plit->x -= world_offset;
+                }
+            }
+
+            // The cell box covers at least the whole tile, so clipping to the tile is what decides where the lines stop
+            std::vector<std::vector<Point>> pieces = clipPolyline(it->point_list, x_min, y_min, x_max, y_max);
+            for (auto pcit = pieces.begin(); pcit != pieces.end(); ++pcit) {
+                // Lines that only touch the tile edge clip down to a single point
+                if (pcit->size() < 2 || (pcit->size() == 2 && pcit->front() == pcit->back())) continue;
+                tile_contours.emplace_back(*pcit, it->value);
+            }
+        }
+    }
+
+    return this->tile_cache.put(key, encodeContours(tile_contours, x_min, y_min, x_max, y_max));
+}
+
+template class TiledContourer<float>;
+template class TiledContourer<float16_t>;
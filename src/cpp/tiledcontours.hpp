@@ -0,0 +1,56 @@
+
+#ifndef __AUTUMNPLOT_TILEDCONTOURS_H__
+#define __AUTUMNPLOT_TILEDCONTOURS_H__
+
+#include <vector>
+#include <cstdint>
+
+#include "marchingsquares.hpp"
+#include "lrucache.hpp"
+#include "contourcodec.hpp"
+#include "vectortile.hpp"
+
+// Cells are grouped into blocks this many cells on a side for finding the cells under a tile
+const int TILED_CONTOUR_BLOCK_SIZE = 32;
+
+// Contours a grid one WebMercator tile at a time, so the work for a view is proportional to the number of tiles in it rather than the size
+//  of the grid. Only the cells under a tile are contoured, and the contours are clipped to the tile. A cell gives the same segments whichever
+//  tile it's contoured for, and neighboring tiles clip against the same edge and quantize the same way along it, so the lines join up
+//  exactly across tile borders. The most recently used tiles are kept, encoded with the tile as the bounding box (see contourcodec.hpp).
+template<typename T>
+class TiledContourer {
+    struct CellBlock {
+        float x_min, y_min, x_max, y_max;
+    };
+
+    std::vector<T> grid;
+    std::vector<float> map_xs, map_ys;
+    int nx, ny;
+    std::vector<float> values;
+    bool quad_as_tri;
+
+    // Bounding boxes of the blocks of cells in map coordinates
+    std::vector<CellBlock> blocks;
+    int n_blocks_i, n_blocks_j;
+
+    LRUCache<uint64_t, EncodedContours> tile_cache;
+
+    public:
+    // lons and lats are the earth coordinates of every grid point (nx x ny, as for makeContoursCurvilinear()). Longitudes aren't wrapped,
+    //  so a grid that runs from 0 to 360 is found both in the tiles east of the antimeridian and, one world over, west of it.
+    TiledContourer(const T* grid, const float* lons, const float* lats, const int nx, const int ny, const std::vector<float>& values,
+                   const bool quad_as_tri, const size_t cache_size=256);
+
+    // Find the cells under a tile, with the tile shifted world_offset worlds to the east. Returns false if the tile doesn't overlap the grid.
+    bool getTileCellBox(const TileID& tile, const int world_offset, CellBox& box) const;
+
+    // Contours in a tile, in WebMercator coordinates (0 to 1, with y increasing to the south). The reference is only good until the next
+    //  call to getTile().
+    const EncodedContours& getTile(const TileID& tile);
+
+    size_t getCacheSize() const {
+        return this->tile_cache.size();
+    }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#include <cmath>
+
+#include "vectorfield.hpp"
+#include "float16_t.hpp"
+
+using numeric::float16_t;
+
+template<typename T, typename U>
+void rotateVectorsToEarth(const T* u, const T* v, const float* rot, const int n, U* u_earth, U* v_earth) {
+    for (int i = 0; i < n; i++) {
+        const float u_grid = u[i], v_grid = v[i];
+        const float cos_rot = cosf(rot[i]), sin_rot = sinf(rot[i]);
+
+        u_earth[i] = U(u_grid * cos_rot + v_grid * sin_rot);
+        v_earth[i] = U(-u_grid * sin_rot + v_grid * cos_rot);
+    }
+}
+
+template<typename T, typename U>
+void vectorSpeedDirection(const T* u, const T* v, const float* rot, const int n, U* speed, U* direction) {
+    const float rad_to_deg = 180. / M_PI;
+
+    for (int i = 0; i < n; i++) {
+        const float u_val = u[i], v_val = v[i];
+        const float rot_val = rot == NULL ? 0.f : rot[i];
+
+        // Same as sampleField in RawVectorField
+        float brg = (M_PI / 2 - atan2f(-v_val, -u_val) + rot_val) * rad_to_deg;
+        if (brg >= 360) brg -= 360;
+        if (brg < 0) brg += 360;
+
+        speed[i] = U(sqrtf(u_val * u_val + v_val * v_val));
+        direction[i] = U(brg);
+    }
+}
+
+template void rotateVectorsToEarth(const float* u, const float* v, const float* rot, const int n, float* u_earth, float* v_earth);
+template void rotateVectorsToEarth(const float* u, const float* v, const float* rot, const int n, float16_t* u_earth, float16_t* v_earth);
+template void rotateVectorsToEarth(const float16_t* u, const float16_t* v, const float* rot, const int n, float* u_earth, float* v_earth);
+template void rotateVectorsToEarth(const float16_t* u, const float16_t* v, const float* rot, const int n, float16_t* u_earth, float16_t* v_earth);
+
+template void vectorSpeedDirection(const float* u, const float* v, const float* rot, const int n, float* speed, float* direction);
+template void vectorSpeedDirection(const float* u, const float* v, const float* rot, const int n, float16_t* speed, float16_t* direction);
+template void vectorSpeedDirection(const float16_t* u, const float16_t* v, const float* rot, const int n, float* speed, float* direction);
+template void vectorSpeedDirection(const float16_t* u, const float16_t* v, const float* rot, const int n, float16_t* speed, float16_t* direction);
@@ -0,0 +1,15 @@
+
+#ifndef __AUTUMNPLOT_VECTORFIELD_H__
+#define __AUTUMNPLOT_VECTORFIELD_H__
+
+// Rotate grid-relative vectors to earth-relative, where rot is the angle (in radians) of east in the grid coordinates (as from 
+//  StructuredGrid::computeVectorRotation). The outputs can be float or float16_t.
+template<typename T, typename U>
+void rotateVectorsToEarth(const T* u, const T* v, const float* rot, const int n, U* u_earth, U* v_earth);
+
+// Compute the speed and direction of a vector field. The direction is the meteorological direction (the bearing the vector points from,
+//  in degrees clockwise from north). If rot is NULL, the vectors are taken to be earth-relative already.
+template<typename T, typename U>
+void vectorSpeedDirection(const T* u, const T* v, const float* rot, const int n, U* speed, U* direction);
+
+#endif
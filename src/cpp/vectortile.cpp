@@ -0,0 +1,329 @@
+
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <stdexcept>
+#include <cstring>
+
+#include "vectortile.hpp"
+
+std::vector<Point> simplifyPolyline(const std::vector<Point>& points, const float tolerance) {
+    if (points.size() <= 2) return points;
+
+    std::vector<bool> keep(points.size(), false);
+    keep.front() = true;
+    keep.back() = true;
+
+    const float tolerance2 = tolerance * tolerance;
+    std::vector<std::pair<int, int>> stack = {{0, static_cast<int>(points.size()) - 1}};
+
+    while (!stack.empty()) {
+        auto [istart, iend] = stack.back();
+        stack.pop_back();
+
+        const Point& start = points[istart];
+        const float dx = points[iend].x - start.x, dy = points[iend].y - start.y;
+        const float len2 = dx * dx + dy * dy;
+
+        float max_dist2 = -1;
+        int imax = -1;
+
+        for (int ipt = istart + 1; ipt < iend; ipt++) {
+            float px = points[ipt].x - start.x, py = points[ipt].y - start.y;
+
+            // Distance to the segment, or to the start point if the segment is degenerate (as it is for a closed contour)
+            if (len2 > 0) {
+                const float t = std::clamp((px * dx + py * dy) / len2, 0.f, 1.f);
+                px -= t * dx;
+                py -= t * dy;
+            }
+
+            const float dist2 = px * px + py * py;
+            if (dist2 > max_dist2) {
+                max_dist2 = dist2;
+                imax = ipt;
+            }
+        }
+
+        if (imax >= 0 && max_dist2 > tolerance2) {
+            keep[imax] = true;
+            stack.emplace_back(istart, imax);
+            stack.emplace_back(imax, iend);
+        }
+    }
+
+    std::vector<Point> simplified;
+    for (int ipt = 0; ipt < points.size(); ipt++) {
+        if (keep[ipt]) simplified.push_back(points[ipt]);
+    }
+
+    return simplified;
+}
+
+std::vector<std::vector<Point>> clipPolyline(const std::vector<Point>& points, const float x_min, const float y_min, const float x_max,
+                                             const float y_max) {
+    std::vector<std::vector<Point>> pieces;
+    bool in_piece = false;
+
+    for (int ipt = 0; ipt + 1 < points.size(); ipt++) {
+        const Point& p0 = points[ipt];
+        const Point& p1 = points[ipt + 1];
+
+        // Liang-Barsky clipping of the segment from p0 to p1
+        const float dx = p1.x - p0.x, dy = p1.y - p0.y;
+        const float p[4] = {-dx, dx, -dy, dy};
+        const float q[4] = {p0.x - x_min, x_max - p0.x, p0.y - y_min, y_max - p0.y};
+        float t0 = 0, t1 = 1;
+        bool visible = true;
+
+        for (int iedge = 0; iedge < 4 && visible; iedge++) {
+            if (p[iedge] == 0) {
+                visible = q[iedge] >= 0;
+            }
+            else {
+                const float t = q[iedge] / p[iedge];
+                if (p[iedge] < 0) t0 = std::max(t0, t);
+                else t1 = std::min(t1, t);
+                visible = t0 <= t1;
+            }
+        }
+
+        if (!visible) {
+            in_piece = false;
+            continue;
+        }
+
+        if (!in_piece || t0 > 0) {
+            pieces.emplace_back();
+            pieces.back().emplace_back(p0.x + t0 * dx, p0.y + t0 * dy);
+        }
+
+        pieces.back().emplace_back(p0.x + t1 * dx, p0.y + t1 * dy);
+        in_piece = t1 >= 1;
+    }
+
+    return pieces;
+}
+
+static void writeVarint(std::vector<uint8_t>& buf, uint64_t val) {
+    while (val >= 0x80) {
+        buf.push_back((val & 0x7f) | 0x80);
+        val >>= 7;
+    }
+    buf.push_back(val);
+}
+
+static inline uint32_t zigzag(int32_t val) {
+    return (static_cast<uint32_t>(val) << 1) ^ static_cast<uint32_t>(val >> 31);
+}
+
+// Protobuf wire types
+const int PB_VARINT = 0, PB_FIXED64 = 1, PB_LENGTH_DELIMITED = 2;
+
+static void writeTag(std::vector<uint8_t>& buf, int field, int wire_type) {
+    writeVarint(buf, (field << 3) | wire_type);
+}
+
+static void writeMessage(std::vector<uint8_t>& buf, int field, const std::vector<uint8_t>& message) {
+    writeTag(buf, field, PB_LENGTH_DELIMITED);
+    writeVarint(buf, message.size());
+    buf.insert(buf.end(), message.begin(), message.end());
+}
+
+static void writeString(std::vector<uint8_t>& buf, int field, const std::string& str) {
+    writeTag(buf, field, PB_LENGTH_DELIMITED);
+    writeVarint(buf, str.size());
+    buf.insert(buf.end(), str.begin(), str.end());
+}
+
+static void writePacked(std::vector<uint8_t>& buf, int field, const std::vector<uint32_t>& vals) {
+    std::vector<uint8_t> packed;
+    for (auto it = vals.begin(); it != vals.end(); ++it) writeVarint(packed, *it);
+    writeMessage(buf, field, packed);
+}
+
+// MVT geometry commands
+const int MVT_MOVE_TO = 1, MVT_LINE_TO = 2;
+const int MVT_LINESTRING = 2;
+
+static inline uint32_t mvtCommand(int id, int count) {
+    return (id & 0x7) | (count << 3);
+}
+
+ContourTiler::ContourTiler(const std::vector<Contour>& contours, const int min_zoom, const int max_zoom, const int extent, const int buffer,
+                           const float simplify_tolerance, const std::string& layer_name) :
+    min_zoom(min_zoom), max_zoom(max_zoom), extent(extent), buffer(buffer), layer_name(layer_name) {
+
+    if (min_zoom < 0 || max_zoom < min_zoom || max_zoom > 24) {
+        throw std::invalid_argument("Zoom range must be within 0 to 24");
+    }
+
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        this->values.push_back(it->value);
+    }
+    std::sort(this->values.begin(), this->values.end());
+    this->values.erase(std::unique(this->values.begin(), this->values.end()), this->values.end());
+
+    for (int z = min_zoom; z <= max_zoom; z++) {
+        const float tolerance = simplify_tolerance / (static_cast<float>(extent) * (1 << z));
+        std::vector<SimplifiedContour> simplified;
+
+        for (auto it = contours.begin(); it != contours.end(); ++it) {
+            SimplifiedContour contour;
+            contour.points = simplifyPolyline(it->point_list, tolerance);
+            if (contour.points.size() < 2) continue;
+
+            contour.x_min = contour.y_min = INFINITY;
+            contour.x_max = contour.y_max = -INFINITY;
+            for (auto plit = contour.points.begin(); plit != contour.points.end(); ++plit) {
+                contour.x_min = std::min(contour.x_min, plit->x);
+                contour.y_min = std::min(contour.y_min, plit->y);
+                contour.x_max = std::max(contour.x_max, plit->x);
+                contour.y_max = std::max(contour.y_max, plit->y);
+            }
+
+            contour.value_index = std::lower_bound(this->values.begin(), this->values.end(), it->value) - this->values.begin();
+            simplified.push_back(std::move(contour));
+        }
+
+        this->zoom_contours.push_back(std::move(simplified));
+    }
+}
+
+std::vector<TileID> ContourTiler::getTiles(const int z) const {
+    if (z < this->min_zoom || z > this->max_zoom) return {};
+
+    const int n_tiles = 1 << z;
+    const float margin = static_cast<float>(this->buffer) / this->extent;
+    std::set<std::pair<int, int>> tiles;
+
+    // Mark the tiles around each segment. The segments are short compared to a tile except at very high zooms, so this doesn't mark many
+    //  tiles the contours don't actually go through.
+    const std::vector<SimplifiedContour>& contours = this->zoom_contours[z - this->min_zoom];
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        for (int ipt = 0; ipt + 1 < it->points.size(); ipt++) {
+            const Point& p0 = it->points[ipt];
+            const Point& p1 = it->points[ipt + 1];
+
+            const int tx_min = std::max(0, static_cast<int>(std::floor(std::min(p0.x, p1.x) * n_tiles - margin)));
+            const int tx_max = std::min(n_tiles - 1, static_cast<int>(std::floor(std::max(p0.x, p1.x) * n_tiles + margin)));
+            const int ty_min = std::max(0, static_cast<int>(std::floor(std::min(p0.y, p1.y) * n_tiles - margin)));
+            const int ty_max = std::min(n_tiles - 1, static_cast<int>(std::floor(std::max(p0.y, p1.y) * n_tiles + margin)));
+
+            for (int ty = ty_min; ty <= ty_max; ty++) {
+                for (int tx = tx_min; tx <= tx_max; tx++) {
+                    tiles.emplace(tx, ty);
+                }
+            }
+        }
+    }
+
+    std::vector<TileID> tile_ids;
+    for (auto it = tiles.begin(); it != tiles.end(); ++it) {
+        tile_ids.push_back({z, it->first, it->second});
+    }
+
+    return tile_ids;
+}
+
+std::vector<uint8_t> ContourTiler::encodeTile(const TileID& tile) const {
+    if (tile.z < this->min_zoom || tile.z > this->max_zoom) {
+        throw std::invalid_argument("Tile zoom is outside the tiler's zoom range");
+    }
+
+    const double n_tiles = 1 << tile.z;
+    const float margin = static_cast<float>(this->buffer) / this->extent;
+    const float x_min = (tile.x - margin) / n_tiles, x_max = (tile.x + 1 + margin) / n_tiles;
+    const float y_min = (tile.y - margin) / n_tiles, y_max = (tile.y + 1 + margin) / n_tiles;
+
+    // Geometry for each contour level, in tile coordinates
+    std::vector<std::vector<uint32_t>> geometries(this->values.size());
+    std::vector<std::pair<int32_t, int32_t>> cursors(this->values.size(), {0, 0});
+
+    const std::vector<SimplifiedContour>& contours = this->zoom_contours[tile.z - this->min_zoom];
+    for (auto it = contours.begin(); it != contours.end(); ++it) {
+        if (it->x_max < x_min || it->x_min > x_max || it->y_max < y_min || it->y_min > y_max) continue;
+
+        std::vector<std::vector<Point>> pieces = clipPolyline(it->points, x_min, y_min, x_max, y_max);
+
+        for (auto pcit = pieces.begin(); pcit != pieces.end(); ++pcit) {
+            // Quantize to the tile grid and drop repeated points
+            std::vector<std::pair<int32_t, int32_t>> tile_points;
+            for (auto plit = pcit->begin(); plit != pcit->end(); ++plit) {
+                const int32_t tx = static_cast<int32_t>(std::round((plit->x * n_tiles - tile.x) * this->extent));
+                const int32_t ty = static_cast<int32_t>(std::round((plit->y * n_tiles - tile.y) * this->extent));
+
+                if (tile_points.empty() || tile_points.back() != std::make_pair(tx, ty)) {
+                    tile_points.emplace_back(tx, ty);
+                }
+            }
+
+            if (tile_points.size() < 2) continue;
+
+            std::vector<uint32_t>& geometry = geometries[it->value_index];
+            auto& [cx, cy] = cursors[it->value_index];
+
+            geometry.push_back(mvtCommand(MVT_MOVE_TO, 1));
+            geometry.push_back(zigzag(tile_points[0].first - cx));
+            geometry.push_back(zigzag(tile_points[0].second - cy));
+            geometry.push_back(mvtCommand(MVT_LINE_TO, tile_points.size() - 1));
+
+            for (int ipt = 1; ipt < tile_points.size(); ipt++) {
+                geometry.push_back(zigzag(tile_points[ipt].first - tile_points[ipt - 1].first));
+                geometry.push_back(zigzag(tile_points[ipt].second - tile_points[ipt - 1].second));
+            }
+
+            cx = tile_points.back().first;
+            cy = tile_points.back().second;
+        }
+    }
+
+    // Tile { repeated Layer layers = 3; }, Layer { version = 15, name = 1, features = 2, keys = 3, values = 4, extent = 5 }
+    std::vector<uint8_t> layer;
+    writeTag(layer, 15, PB_VARINT);
+    writeVarint(layer, 2);
+    writeString(layer, 1, this->layer_name);
+
+    std::vector<float> layer_values;
+    for (int ival = 0; ival < this->values.size(); ival++) {
+        if (geometries[ival].empty()) continue;
+
+        // Feature { id = 1, tags = 2, type = 3, geometry = 4 }
+        std::vector<uint8_t> feature;
+        writeTag(feature, 1, PB_VARINT);
+        writeVarint(feature, ival + 1);
+        writePacked(feature, 2, {0, static_cast<uint32_t>(layer_values.size())});
+        writeTag(feature, 3, PB_VARINT);
+        writeVarint(feature, MVT_LINESTRING);
+        writePacked(feature, 4, geometries[ival]);
+
+        writeMessage(layer, 2, feature);
+        layer_values.push_back(this->values[ival]);
+    }
+
+    if (layer_values.empty()) return {};
+
+    writeString(layer, 3, "level");
+
+    for (auto it = layer_values.begin(); it != layer_values.end(); ++it) {
+        // Value { double_value = 3 }
+        std::vector<uint8_t> value;
+        writeTag(value, 3, PB_FIXED64);
+        const double val = *it;
+        uint64_t bits;
+        memcpy(&bits, &val, 8);
+        for (int ibyte = 0; ibyte < 8; ibyte++) value.push_back((bits >> (8 * ibyte)) & 0xff);
+
+        writeMessage(layer, 4, value);
+    }
+
+    writeTag(layer, 5, PB_VARINT);
+    writeVarint(layer, this->extent);
+
+    std::vector<uint8_t> tile_buf;
+    writeMessage(tile_buf, 3, layer);
+    return tile_buf;
+}
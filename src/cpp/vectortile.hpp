@@ -0,0 +1,61 @@
+
+#ifndef __AUTUMNPLOT_VECTORTILE_H__
+#define __AUTUMNPLOT_VECTORTILE_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "marchingsquares.hpp"
+
+struct TileID {
+    int z;
+    int x;
+    int y;
+
+    bool operator==(const TileID& other) const noexcept {
+        return this->z == other.z && this->x == other.x && this->y == other.y;
+    }
+};
+
+// Douglas-Peucker simplification of a polyline. Points within tolerance of the simplified line are dropped, and the end points are
+//  always kept.
+std::vector<Point> simplifyPolyline(const std::vector<Point>& points, const float tolerance);
+
+// Clip a polyline to a box, splitting it into pieces wherever it leaves the box.
+std::vector<std::vector<Point>> clipPolyline(const std::vector<Point>& points, const float x_min, const float y_min, const float x_max,
+                                             const float y_max);
+
+// Cuts contours into Mapbox Vector Tiles (https://github.com/mapbox/vector-tile-spec, version 2). The contours are given in WebMercator
+//  coordinates (0 to 1 in both directions, with y increasing to the south, as from WebMercator::transform()). Each tile has one
+//  multi-linestring feature per contour level, with the level in a "level" attribute. The contours are simplified once per zoom, so
+//  encodeTile() only has to clip and quantize, and it can be called from several threads at once.
+class ContourTiler {
+    struct SimplifiedContour {
+        std::vector<Point> points;
+        float x_min, y_min, x_max, y_max;
+        int value_index;
+    };
+
+    int min_zoom;
+    int max_zoom;
+    int extent;
+    int buffer;
+    std::string layer_name;
+    std::vector<float> values;
+    std::vector<std::vector<SimplifiedContour>> zoom_contours;
+
+    public:
+    // simplify_tolerance is in tile units (1 / extent of a tile), and buffer is the margin (also in tile units) kept around each tile so
+    //  lines don't end right at the tile edge.
+    ContourTiler(const std::vector<Contour>& contours, const int min_zoom, const int max_zoom, const int extent=4096, const int buffer=64,
+                 const float simplify_tolerance=1, const std::string& layer_name="contours");
+
+    // All tiles at zoom z that might have contours in them
+    std::vector<TileID> getTiles(const int z) const;
+
+    // Encode a tile as MVT protobuf. The result is empty if no contours fall in the tile.
+    std::vector<uint8_t> encodeTile(const TileID& tile) const;
+};
+
+#endif
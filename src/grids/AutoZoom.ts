@@ -2,13 +2,14 @@ import { WGLBuffer, WGLTexture, WGLTextureSpec } from "autumn-wgl";
 import { TypedArray, WebGLAnyRenderingContext } from "../AutumnTypes";
 import { Cache } from "../utils";
 import { AbstractConstructor, Grid } from "./Grid";
-import { getGLFormatTypeAlignment, layer_worker } from "../PlotComponent";
+import { getContourWorkerPool, getGLFormatTypeAlignment } from "../PlotComponent";
 import { Float16Array } from "@petamoriken/float16";
 
 async function makeWGLBillboardBuffers(gl: WebGLAnyRenderingContext, grid: AutoZoomGrid, thin_fac: number, map_max_zoom: number) {
     const {lats: field_lats, lons: field_lons} = grid.getEarthCoords();
-    const min_zoom = grid.getMinVisibleZoom(thin_fac);
-    const bb_elements = await layer_worker.makeBBElements(field_lats, field_lons, min_zoom, grid.ni, grid.nj, map_max_zoom);
+    const min_zoom = await grid.getMinVisibleZoom(thin_fac);
+    const pool = getContourWorkerPool(undefined, 1);
+    const bb_elements = await pool.makeBBElements(field_lats, field_lons, min_zoom, grid.ni, grid.nj, map_max_zoom);
 
     const vertices = new WGLBuffer(gl, bb_elements['pts'], 2, gl.POINTS, {per_instance: true});
     const texcoords = new WGLBuffer(gl, bb_elements['tex_coords'], 2, gl.POINTS, {per_instance: true});
@@ -53,7 +54,7 @@ interface AutoZoomGridIntf {
     getWGLBillboardBuffers(gl: WebGLAnyRenderingContext, thin_fac: number, max_zoom: number) : Promise<{'vertices': WGLBuffer, 'texcoords': WGLBuffer}>;
     getVectorRotationTexture(gl: WebGLAnyRenderingContext, data_are_earth_relative: boolean) : {'rotation': WGLTexture};
     getVectorRotationAtPoint(lon: number, lat: number) : number;
-    getMinVisibleZoom(thin_fac: number): Uint8Array;
+    getMinVisibleZoom(thin_fac: number): Promise<Uint8Array>;
 }
 
 function autoZoomGridMixin<G extends AbstractConstructor<Grid>>(base: G) : AbstractConstructor<AutoZoomGridIntf> & G {
@@ -87,7 +88,7 @@ function autoZoomGridMixin<G extends AbstractConstructor<Grid>>(base: G) : Abstr
             return Math.atan2(y_pertlon - y, x_pertlon - x);
         }
 
-        public abstract getMinVisibleZoom(thin_fac: number): Uint8Array;
+        public abstract getMinVisibleZoom(thin_fac: number): Promise<Uint8Array>;
     }
 
     return AutoZoomGrid;
@@ -52,12 +52,18 @@ class GeostationaryImage extends gridCoordinateMixin(StructuredGrid) {
         return this.vpp(x, y, {inverse: inverse});
     }
 
+    /** @internal */
+    public getNativeGridDef() {
+        return {type: 'geostationary' as const, ni: this.ni, nj: this.nj, ll_x: this.ll_x, ll_y: this.ll_y, ur_x: this.ur_x, ur_y: this.ur_y, 
+                satellite_lon: this.satellite_lon};
+    }
+
     public copy() {
         return new GeostationaryImage(this.ni, this.nj, this.ll_x, this.ll_y, this.ur_x, this.ur_y, this.satellite_lon);
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
         const {ni, nj, thin_x, thin_y, ll_x, ll_y, ur_x, ur_y} = 
             this.thinnedGridParameters(thin_fac, map_max_zoom, this.ll_x, this.ll_y, this.ur_x, this.ur_y);
 
@@ -1,4 +1,5 @@
 import { TypedArray } from "../AutumnTypes";
+import { NativeGridDef } from "../ContourCreator.worker";
 
 interface EarthCoords {
     lons: Float32Array;
@@ -34,10 +35,18 @@ abstract class Grid {
     public abstract transform(x: number, y: number, opts?: {inverse?: boolean}): [number, number];
     public abstract sampleNearestGridPoint(lon: number, lat: number, ary: TypedArray): {sample: number, sample_lon: number, sample_lat: number};
 
-    public abstract getThinnedGrid(thin_fac: number, map_max_zoom: number): this;
+    public abstract getThinnedGrid(thin_fac: number, map_max_zoom: number): Promise<this>;
     public abstract thinDataArray<ArrayType extends TypedArray>(original_grid: Grid, ary: ArrayType): ArrayType;
 
     public abstract copy(): Grid;
+
+    /** 
+     * @internal 
+     * The definition of this grid for setting it up natively in the contouring workers, or null if there's no native version of this grid
+     */
+    public getNativeGridDef(): NativeGridDef | null {
+        return null;
+    }
 }
 
 type AbstractConstructor<T> = abstract new(...args: any[]) => T;
@@ -26,6 +26,7 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
     public readonly ur_y: number;
     public readonly a: number;
     public readonly b: number;
+    public readonly fast_math: boolean;
 
     private readonly lcc: (a: number, b: number, opts?: {inverse: boolean}) => [number, number];
 
@@ -42,9 +43,12 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
      * @param ur_y    - The y coordinate in projection space of the upper-right corner of the grid
      * @param a       - The semimajor axis of the assumed shape of Earth in meters
      * @param b       - The semiminor axis of the assumed shape of Earth in meters
+     * @param fast_math - Use fast approximations of the math functions when computing the projection in the contouring workers (within 
+     *                    about 1 m of the exact projection over CONUS), which makes building the domain mesh faster. Only applies on the 
+     *                    WGS 84 ellipsoid.
      */
     constructor(ni: number, nj: number, lon_0: number, lat_0: number, lat_std: [number, number], 
-                ll_x: number, ll_y: number, ur_x: number, ur_y: number, a?: number, b?: number, thin_x?: number, thin_y?: number) {
+                ll_x: number, ll_y: number, ur_x: number, ur_y: number, a?: number, b?: number, thin_x?: number, thin_y?: number, fast_math?: boolean) {
         super('lcc', true, ni, nj, thin_x, thin_y);
 
         this.lon_0 = lon_0;
@@ -56,6 +60,7 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
         this.ur_y = ur_y;
         this.a = a === undefined ? WGS84_SEMIMAJOR : a;
         this.b = b === undefined ? WGS84_SEMIMINOR : b;
+        this.fast_math = fast_math === undefined ? false : fast_math;
         this.lcc = lambertConformalConic({lon_0: lon_0, lat_0: lat_0, lat_std: lat_std, a: this.a, b: this.b});
 
         this.setupCoordinateCaches(ll_x, ur_x, ll_y, ur_y);
@@ -74,10 +79,11 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
      * @param dy      - The grid dy in meters
      * @param a       - The semimajor axis of the assumed shape of Earth in meters
      * @param b       - The semiminor axis of the assumed shape of Earth in meters
+     * @param fast_math - Use fast approximations of the math functions in the contouring workers (see the constructor)
      * @returns 
      */
     public static fromLLCornerLonLat(ni: number, nj: number, lon_0: number, lat_0: number, lat_std: [number, number], 
-                                     ll_lon: number, ll_lat: number, dx: number, dy: number, a?: number, b?: number) {
+                                     ll_lon: number, ll_lat: number, dx: number, dy: number, a?: number, b?: number, fast_math?: boolean) {
 
         a = a === undefined ? WGS84_SEMIMAJOR : a;
         b = b === undefined ? WGS84_SEMIMINOR : b;
@@ -85,7 +91,7 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
         const lcc = lambertConformalConic({lon_0: lon_0, lat_0: lat_0, lat_std: lat_std, a: a, b: b});
         const [ll_x, ll_y] = lcc(ll_lon, ll_lat);
 
-        return new LambertGrid(ni, nj, lon_0, lat_0, lat_std, ll_x, ll_y, ll_x + ni * dx, ll_y + nj * dy, a, b);
+        return new LambertGrid(ni, nj, lon_0, lat_0, lat_std, ll_x, ll_y, ll_x + ni * dx, ll_y + nj * dy, a, b, undefined, undefined, fast_math);
     }
 
     /** @internal */
@@ -98,7 +104,16 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
         const ur_x = opts.ur_x !== undefined ? opts.ur_x : this.ur_x;
         const ur_y = opts.ur_y !== undefined ? opts.ur_y : this.ur_y;
 
-        return new LambertGrid(ni, nj, this.lon_0, this.lat_0, this.lat_std, ll_x, ll_y, ur_x, ur_y, this.a, this.b);
+        return new LambertGrid(ni, nj, this.lon_0, this.lat_0, this.lat_std, ll_x, ll_y, ur_x, ur_y, this.a, this.b, undefined, undefined, this.fast_math);
+    }
+
+    /** @internal */
+    public getNativeGridDef() {
+        // The native projection is only on the WGS 84 ellipsoid
+        if (this.a != WGS84_SEMIMAJOR || this.b != WGS84_SEMIMINOR) return null;
+
+        return {type: 'lcc' as const, ni: this.ni, nj: this.nj, lon_0: this.lon_0, lat_0: this.lat_0, lat_std_1: this.lat_std[0], 
+                lat_std_2: this.lat_std[1], ll_x: this.ll_x, ll_y: this.ll_y, ur_x: this.ur_x, ur_y: this.ur_y, fast_math: this.fast_math};
     }
 
     /** @internal */
@@ -110,11 +125,11 @@ class LambertGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGrid))
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
         const {ni, nj, thin_x, thin_y, ll_x, ll_y, ur_x, ur_y} = 
             this.thinnedGridParameters(thin_fac, map_max_zoom, this.ll_x, this.ll_y, this.ur_x, this.ur_y);
 
-        return new LambertGrid(ni, nj, this.lon_0, this.lat_0, this.lat_std, ll_x, ll_y, ur_x, ur_y, this.a, this.b, this.thin_x * thin_x, this.thin_y * thin_y) as this;
+        return new LambertGrid(ni, nj, this.lon_0, this.lat_0, this.lat_std, ll_x, ll_y, ur_x, ur_y, this.a, this.b, this.thin_x * thin_x, this.thin_y * thin_y, this.fast_math) as this;
     }
 }
 
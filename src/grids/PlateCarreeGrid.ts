@@ -53,13 +53,18 @@ class PlateCarreeGrid extends autoZoomGridMixin(gridCoordinateMixin(StructuredGr
         return new PlateCarreeGrid(ni, nj, ll_lon, ll_lat, ur_lon, ur_lat);
     }
 
+    /** @internal */
+    public getNativeGridDef() {
+        return {type: 'latlon' as const, ni: this.ni, nj: this.nj, ll_lon: this.ll_lon, ll_lat: this.ll_lat, ur_lon: this.ur_lon, ur_lat: this.ur_lat};
+    }
+
     /** @internal */
     public transform(x: number, y: number, opts?: {inverse?: boolean}) {
         return [x, y] as [number, number];
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
         const {ni, nj, thin_x, thin_y, ll_x: ll_lon, ll_y: ll_lat, ur_x: ur_lon, ur_y: ur_lat} = 
             this.thinnedGridParameters(thin_fac, map_max_zoom, this.ll_lon, this.ll_lat, this.ur_lon, this.ur_lat);
 
@@ -75,7 +75,7 @@ class PlateCarreeRotatedGrid extends autoZoomGridMixin(gridCoordinateMixin(Struc
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
         const {ni, nj, thin_x, thin_y, ll_x: ll_lon, ll_y: ll_lat, ur_x: ur_lon, ur_y: ur_lat} = 
             this.thinnedGridParameters(thin_fac, map_max_zoom, this.ll_lon, this.ll_lat, this.ur_lon, this.ur_lat);
 
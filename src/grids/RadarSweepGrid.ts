@@ -54,6 +54,12 @@ class RadarSweepGrid extends gridCoordinateMixin(StructuredGrid) {
         return new RadarSweepGrid(nr, nt, start_rn, end_rn, start_az, end_az, longitude, latitude);
     }
 
+    /** @internal */
+    public getNativeGridDef() {
+        return {type: 'radar' as const, ni: this.ni, nj: this.nj, start_rn: this.start_rn, end_rn: this.end_rn, start_az: this.start_az, 
+                end_az: this.end_az, longitude: this.longitude, latitude: this.latitude};
+    }
+
     protected async makeDomainBuffers(gl: WebGLAnyRenderingContext) {
         return await makeCartesianDomainBuffers(gl, this as StructuredGrid, 16, this.nj, {margin_r: false, margin_s: false});
     }
@@ -87,7 +93,7 @@ class RadarSweepGrid extends gridCoordinateMixin(StructuredGrid) {
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
         const {ni: nr, nj: nt, thin_x, thin_y, ll_x: start_az, ll_y: start_rn, ur_x: end_az, ur_y: end_rn} = 
             this.thinnedGridParameters(thin_fac, map_max_zoom, this.end_az, this.end_rn, this.start_az, this.start_rn);
 
@@ -1,16 +1,34 @@
 import { WGLBuffer } from "autumn-wgl";
 import { TypedArray, WebGLAnyRenderingContext } from "../AutumnTypes";
-import { argMin, getArrayConstructor, getMinZoom } from "../utils";
+import { Cache, argMin, getArrayConstructor } from "../utils";
 import { EarthCoords, Grid, GridType } from "./Grid";
-import { layer_worker } from "../PlotComponent";
+import { getContourWorkerPool, layer_worker } from "../PlotComponent";
 import { domainBufferMixin } from "./DomainBuffer";
 import { GridElement } from "./GridCoordinates";
 
+// Native domain meshes are refined until they're within this many pixels of the true projected positions at DOMAIN_MESH_ZOOM. The error 
+//  doubles with each zoom level past that, but refining for much higher zooms would keep nearly every row and column of most model grids.
+const DOMAIN_MESH_TOLERANCE_PX = 0.5;
+const DOMAIN_MESH_ZOOM = 10;
+
 async function makeCartesianDomainBuffers(gl: WebGLAnyRenderingContext, grid: StructuredGrid, simplify_ni: number, simplify_nj: number, opts?: {margin_r?: boolean, margin_s?: boolean}) {
     opts = opts === undefined ? {} : opts;
     const use_margin_r = opts.margin_r === undefined ? true : opts.margin_r;
     const use_margin_s = opts.margin_s === undefined ? true : opts.margin_s;
 
+    // Grids with a native version make the domain in the contouring worker, without computing the coordinates on the main thread first. The
+    //  mesh is refined where the projection curves instead of using the simplified grid size.
+    const grid_def = grid.getNativeGridDef();
+    if (grid_def !== null) {
+        const pool = getContourWorkerPool(undefined, 1);
+        const domain_coords = await pool.gridDomainBuffers(grid_def, use_margin_r, use_margin_s, DOMAIN_MESH_TOLERANCE_PX, DOMAIN_MESH_ZOOM);
+
+        const vertices = new WGLBuffer(gl, domain_coords['vertices'], 2, gl.TRIANGLE_STRIP);
+        const texcoords = new WGLBuffer(gl, domain_coords['tex_coords'], 2, gl.TRIANGLE_STRIP);
+
+        return {'vertices': vertices, 'texcoords': texcoords};
+    }
+
     const texcoord_margin_r = use_margin_r ? 1 / (2 * grid.ni) : 0;
     const texcoord_margin_s = use_margin_s ? 1 / (2 * grid.nj) : 0;
 
@@ -33,12 +51,18 @@ async function makeCartesianDomainBuffers(gl: WebGLAnyRenderingContext, grid: St
 abstract class StructuredGrid extends domainBufferMixin(Grid) {
     protected readonly thin_x: number;
     protected readonly thin_y: number;
+    private readonly min_zoom_cache: Cache<[number], Promise<Uint8Array>>;
 
     constructor(type: GridType, is_conformal: boolean, ni: number, nj: number, thin_x?: number, thin_y?: number) {
         super(type, is_conformal, ni, nj);
 
         this.thin_x = thin_x === undefined ? 1 : thin_x;
         this.thin_y = thin_y === undefined ? 1 : thin_y;
+
+        this.min_zoom_cache = new Cache(async (thin_fac: number) => {
+            const pool = getContourWorkerPool(undefined, 1);
+            return await pool.structuredMinZoom(this.ni, this.nj, thin_fac / Math.max(this.thin_x, this.thin_y));
+        });
     }
 
     public abstract getEarthCoords(ni?: number, nj?: number, which_i?: GridElement, which_j?: GridElement): EarthCoords;
@@ -70,17 +94,8 @@ abstract class StructuredGrid extends domainBufferMixin(Grid) {
     }
 
     /** @internal */
-    public getMinVisibleZoom(thin_fac: number) {
-        const min_zoom = new Uint8Array(this.ni * this.nj);
-        const zoom_thin_fac = thin_fac / Math.max(this.thin_x, this.thin_y);
-        for (let ilat = 0; ilat < this.nj * this.thin_y; ilat++) {
-            for (let ilon = 0; ilon < this.ni * this.thin_x; ilon++) {
-                const idx = ilat * this.ni + ilon;
-                min_zoom[idx] = getMinZoom(ilat, ilon, zoom_thin_fac);
-            }
-        }
-
-        return min_zoom;
+    public async getMinVisibleZoom(thin_fac: number) {
+        return await this.min_zoom_cache.getValue(thin_fac);
     }
 
     /** @internal */
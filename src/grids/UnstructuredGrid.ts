@@ -1,10 +1,12 @@
-import { kdTree } from "kd-tree-javascript";
 import { Cache, argMin, getArrayConstructor } from "../utils";
 import { autoZoomGridMixin } from "./AutoZoom";
 import { Grid, GridCoords } from "./Grid";
-import { LngLat } from "../Map";
+import { getContourWorkerPool } from "../PlotComponent";
 import { TypedArray } from "../AutumnTypes";
 
+// Unstructured grids get a number for identifying their points to the contouring workers
+let n_unstructured_grids = 0;
+
 /**
  * An unstructured grid defined by a list of latitudes and longitudes 
  *
@@ -19,8 +21,9 @@ import { TypedArray } from "../AutumnTypes";
  */
 class UnstructuredGrid extends autoZoomGridMixin(Grid) {
     public readonly coords: {lon: number, lat: number}[];
-    private readonly zoom_cache: Cache<[number], Uint8Array>
+    private readonly zoom_cache: Cache<[number], Promise<Uint8Array>>
     private readonly zoom_arg: Uint8Array | null;
+    private readonly index_key: string;
 
     /**
      * Create an unstructured grid
@@ -32,42 +35,12 @@ class UnstructuredGrid extends autoZoomGridMixin(Grid) {
         super('unstructured', true, Math.min(coords.length, MAX_DIM), Math.floor(coords.length / MAX_DIM) + 1);
         this.coords = coords;
         this.zoom_arg = zoom === undefined ? null : zoom;
+        this.index_key = `unstructured:${n_unstructured_grids++}`;
 
-        this.zoom_cache = new Cache((thin_fac: number) => {
-            interface kdNode {
-                x: number;
-                y: number;
-                min_zoom: number;
-            }
-    
-            const MAP_MAX_ZOOM = 24;
-            const offset = Math.log2(thin_fac);
-            const kd_nodes = this.coords.map(c => ({...new LngLat(c.lon, c.lat).toMercatorCoord(), min_zoom: MAP_MAX_ZOOM} as kdNode));
-            const tree = new kdTree([...kd_nodes], (a, b) => Math.max(Math.abs(a.x - b.x), Math.abs(a.y - b.y)), ['x', 'y']);
-    
-            const recursiveThin = (x: number, y: number, depth: number) => {
-                const size = Math.pow(0.5, depth + 1);
-                const nodes = tree.nearest({x: x, y: y, min_zoom: 0}, 2, size);
-
-                if (nodes.length > 0) {
-                    const [node, dist] = nodes.sort((a, b) => a[1] - b[1])[0];
-                    if (node.min_zoom == MAP_MAX_ZOOM) {
-                        node.min_zoom = Math.max(depth - offset, 0);
-                    }
-                }
-
-                if (nodes.length > 1 && depth < MAP_MAX_ZOOM + offset) {
-                    recursiveThin(x - size / 2, y - size / 2, depth + 1);
-                    recursiveThin(x + size / 2, y - size / 2, depth + 1);
-                    recursiveThin(x - size / 2, y + size / 2, depth + 1);
-                    recursiveThin(x + size / 2, y + size / 2, depth + 1);
-                }
-            }
-
-            // Start at -1 zoom depth, which should handle longitudes > 180 degrees.
-            recursiveThin(0.5, 0.5, -1);
-
-            return new Uint8Array(kd_nodes.map(n => n.min_zoom));
+        this.zoom_cache = new Cache(async (thin_fac: number) => {
+            const {lons, lats} = this.getEarthCoords();
+            const pool = getContourWorkerPool(undefined, 1);
+            return await pool.unstructuredMinZoom(lons, lats, thin_fac);
         });
     }
 
@@ -93,15 +66,15 @@ class UnstructuredGrid extends autoZoomGridMixin(Grid) {
     }
 
     /** @internal */
-    public getMinVisibleZoom(thin_fac: number) {
+    public async getMinVisibleZoom(thin_fac: number) {
         if (this.zoom_arg !== null) 
             return this.zoom_arg;
-        return this.zoom_cache.getValue(thin_fac);
+        return await this.zoom_cache.getValue(thin_fac);
     }
 
     /** @internal */
-    public getThinnedGrid(thin_fac: number, map_max_zoom: number) {
-        const min_zoom = this.getMinVisibleZoom(thin_fac);
+    public async getThinnedGrid(thin_fac: number, map_max_zoom: number) {
+        const min_zoom = await this.getMinVisibleZoom(thin_fac);
         return new UnstructuredGrid(this.coords.filter((ll, ill) => min_zoom[ill] <= map_max_zoom), min_zoom.filter(ll => ll <= map_max_zoom)) as this;
     }
 
@@ -123,8 +96,57 @@ class UnstructuredGrid extends autoZoomGridMixin(Grid) {
         return new_data;
     }
 
+    // Run a query on the spatial index over the grid points in a contouring worker, sending the points along if that worker hasn't indexed 
+    //  them yet
+    private async queryPointIndex<R>(run: (lons?: Float32Array, lats?: Float32Array) => Promise<R | null>) {
+        const result = await run();
+        if (result !== null) return result;
+
+        const {lons, lats} = this.getEarthCoords();
+        const result_indexed = await run(lons, lats);
+        if (result_indexed === null) throw `Point index wasn't set up in the contouring worker`;
+        return result_indexed;
+    }
+
+    /**
+     * Find the nearest grid point to each of a batch of points, using a spatial index over the grid points in the contouring worker
+     * @param lons     - Longitudes of the points
+     * @param lats     - Latitudes of the points
+     * @param max_dist - Only look this far from each point, in WebMercator units (fractions of the width of the world)
+     * @returns the index of the nearest grid point to each point, or -1 if there isn't one within max_dist
+     */
+    public async getNearestGridPoints(lons: Float32Array, lats: Float32Array, max_dist?: number) {
+        const pool = getContourWorkerPool(undefined, 1);
+        const {indices} = await this.queryPointIndex((grid_lons, grid_lats) => pool.nearestPoints(this.index_key, lons, lats, max_dist, grid_lons, grid_lats));
+        return indices;
+    }
+
+    /**
+     * Find the grid points within a distance of each of a batch of points (e.g., to pick the stations around a point)
+     * @param lons   - Longitudes of the points
+     * @param lats   - Latitudes of the points
+     * @param radius - The distance in WebMercator units (fractions of the width of the world)
+     * @returns the indices of the grid points near each point
+     */
+    public async getGridPointsWithin(lons: Float32Array, lats: Float32Array, radius: number) {
+        const pool = getContourWorkerPool(undefined, 1);
+        const {offsets, indices} = await this.queryPointIndex((grid_lons, grid_lats) => pool.pointsWithin(this.index_key, lons, lats, radius, grid_lons, grid_lats));
+        return [...Array(lons.length).keys()].map(iqry => indices.subarray(offsets[iqry], offsets[iqry + 1]));
+    }
+
+    /**
+     * Find the grid points in a longitude/latitude box (e.g., to pick the stations in a map view)
+     * @returns the indices of the grid points in the box
+     */
+    public async getGridPointsInBox(ll_lon: number, ll_lat: number, ur_lon: number, ur_lat: number) {
+        const pool = getContourWorkerPool(undefined, 1);
+        const {indices} = await this.queryPointIndex((grid_lons, grid_lats) => pool.pointsInBox(this.index_key, ll_lon, ll_lat, ur_lon, ur_lat, grid_lons, grid_lats));
+        return indices;
+    }
+
     public sampleNearestGridPoint(lon: number, lat: number, ary: TypedArray): {sample: number, sample_lon: number, sample_lat: number} {
-        // TAS: This is gonna be slow. Need to think about using the kdTree here.
+        // This has to answer right away, so it scans all the points. Sampling many points at once should go through getNearestGridPoints(), 
+        //  which uses the spatial index in the contouring worker.
         const idx = argMin(this.coords.map(c => (c.lon - lon) * (c.lon - lon) + (c.lat - lat) * (c.lat - lat)));
         return {sample: ary[idx], sample_lon: this.coords[idx].lon, sample_lat: this.coords[idx].lat};
     }
@@ -1,4 +1,4 @@
-import { PlotComponent, getContourWorkerPool } from "./PlotComponent";
+import { PlotComponent, getContourWorkerCount, getContourWorkerPool } from "./PlotComponent";
 import Contour, {ContourOptions, ContourLabels, ContourLabelOptions} from "./Contour";
 import {ContourFill, Raster, ContourFillOptions, RasterOptions} from "./Fill";
 import Barbs, {BarbsOptions} from "./Barbs";
@@ -7,7 +7,7 @@ import Hodographs, {HodographOptions} from './Hodographs';
 import StationPlot, {StationPlotOptions, SPPosition, SPNumberConfig, SPStringConfig, SPBarbConfig, SPSymbolConfig, SPConfig, SPDataConfig, SPSymbol} from "./StationPlot";
 
 import { PlotLayer, MultiPlotLayer } from './PlotLayer';
-import { WindProfile, StormRelativeWindProfile, GroundRelativeWindProfile, WebGLAnyRenderingContext, TypedArray, ContourData } from "./AutumnTypes";
+import { WindProfile, StormRelativeWindProfile, GroundRelativeWindProfile, WebGLAnyRenderingContext, TypedArray, ContourData, EncodedContourData } from "./AutumnTypes";
 import { MapLikeType } from "./Map";
 import { ColorMap, ColorMapOptions, bluered, redblue, pw_speed500mb, pw_speed850mb, pw_cape, pw_t2m, pw_td2m, nws_storm_clear_refl, wv_cimss } from './Colormap';
 import { Color } from "./Color";
@@ -24,7 +24,9 @@ import { RadarSweepGrid } from "./grids/RadarSweepGrid";
 import { GeostationaryImage } from "./grids/Geostationary";
 import { UnstructuredGrid } from "./grids/UnstructuredGrid";
 import { AutoZoomGrid } from "./grids/AutoZoom";
-import { FieldContourOpts } from './ContourCreator.worker';
+import { FieldContourOpts, GridFilterOpts, CellBox, TileID } from './ContourCreator.worker';
+import { ContourIndex, ContourID, ContourInfo, ContourNearest } from './ContourIndex';
+import { Ensemble } from './Ensemble';
 
 /** All built-in colormaps */
 const colormaps = {
@@ -59,6 +61,15 @@ function initAutumnPlot(opts?: InitAutumnPlotOpts) {
     getContourWorkerPool(opts.wasm_base_url, contour_workers);
 }
 
+/**
+ * Give back the memory that the contouring workers keep between calls to make contouring faster. This is useful after contouring an 
+ * unusually large grid; the memory is allocated again as it's needed.
+ */
+async function releaseContourMemory() {
+    const pool = getContourWorkerPool(undefined, 1);
+    await Promise.all([...Array(getContourWorkerCount()).keys()].map(iw => pool.onWorker(iw).releaseContourScratch()));
+}
+
 export {PlotComponent,
         Barbs, BarbsOptions,
         Contour, ContourOptions, ContourLabels, ContourLabelOptions,
@@ -69,8 +80,8 @@ export {PlotComponent,
         PlotLayer, MultiPlotLayer, 
         MapLikeType, LineStyle,
         ColorMap, ColorMapOptions, colormaps, makeColorBar, makePaintballKey, Color, ColorbarOrientation, ColorbarTickDirection, ColorBarOptions, PaintballKeyOptions,
-        RawScalarField, ComputedScalarField, ExpressionScalarField, RawVectorField, ComputedVectorField, ExpressionVectorField, RawProfileField, RawObsField, ObsRawData,
+        RawScalarField, ComputedScalarField, ExpressionScalarField, Ensemble, RawVectorField, ComputedVectorField, ExpressionVectorField, RawProfileField, RawObsField, ObsRawData,
         Grid, GridType, StructuredGrid, VectorRelativeTo, RawVectorFieldOptions, PlateCarreeGrid, PlateCarreeRotatedGrid, LambertGrid, UnstructuredGrid, RadarSweepGrid, GeostationaryImage,
         AutoZoomGrid,
-        WebGLAnyRenderingContext, TypedArray, ContourData,
-        initAutumnPlot, InitAutumnPlotOpts, FieldContourOpts};
+        WebGLAnyRenderingContext, TypedArray, ContourData, EncodedContourData, ContourIndex, ContourID, ContourInfo, ContourNearest,
+        initAutumnPlot, InitAutumnPlotOpts, releaseContourMemory, FieldContourOpts, GridFilterOpts, CellBox, TileID};
@@ -1,18 +1,5 @@
-import { TypedArray, TypedArrayStr } from "./AutumnTypes";
-
-function getMinZoom(jlat: number, ilon: number, thin_fac_base: number) {
-    const zoom_base = 1;
-
-    let zoom = zoom_base;
-    let thin_fac = thin_fac_base;
-
-    while (((jlat % thin_fac) != 0) || ((ilon % thin_fac) != 0)) {
-        zoom += 1;
-        thin_fac /= 2;
-    }
-
-    return zoom;
-}
+import { ContourData, EncodedContourData, TypedArray, TypedArrayStr } from "./AutumnTypes";
+import { latFromMercatorY, lngFromMercatorX } from "./Map";
 
 function* zip(...args: any[]) {
 	const iterators = args.map(x => x[Symbol.iterator]());
@@ -178,4 +165,143 @@ function argMin<T>(ary: T[] | TypedArray) {
     return minIndex;
 }
 
-export {zip, getMinZoom, getOS, Cache, normalizeOptions, getArrayConstructor, mergeShaderCode, applySamplerCodeScalar, applySamplerCodeVector, argMin};
+const CONTOUR_QUANT_MAX = 65535;
+
+/**
+ * Decode contours from the compact form the contouring worker sends. Optionally transform each vertex on the way out, so the contours 
+ * don't need another pass to get them into earth coordinates.
+ */
+function decodeContourData(encoded: EncodedContourData, transform?: (x: number, y: number) => [number, number]) {
+    const x_step = (encoded.x_max - encoded.x_min) / CONTOUR_QUANT_MAX;
+    const y_step = (encoded.y_max - encoded.y_min) / CONTOUR_QUANT_MAX;
+    const data = encoded.data;
+
+    const contour_data: ContourData = {};
+    let pos = 0;
+
+    const readVarint = () => {
+        let val = 0;
+        let shift = 0;
+        let byte;
+        do {
+            if (pos >= data.length) throw `Encoded contour data ended in the middle of a vertex`;
+
+            byte = data[pos++];
+            val += (byte & 0x7f) * 2 ** shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        // Undo the zigzag encoding
+        return val % 2 == 0 ? val / 2 : -(val + 1) / 2;
+    }
+
+    for (let ic = 0; ic < encoded.values.length; ic++) {
+        const value = encoded.values[ic];
+        if (!(value in contour_data)) contour_data[value] = [];
+
+        const contour: [number, number][] = new Array(encoded.n_points[ic]);
+        let qx = 0, qy = 0;
+
+        for (let ip = 0; ip < contour.length; ip++) {
+            qx += readVarint();
+            qy += readVarint();
+
+            const x = encoded.x_min + qx * x_step;
+            const y = encoded.y_min + qy * y_step;
+            contour[ip] = transform === undefined ? [x, y] : transform(x, y);
+        }
+
+        contour_data[value].push(contour);
+    }
+
+    return contour_data;
+}
+
+/** 
+ * What the contours in a contour file were contoured from and how (see ContourFileInfo in src/cpp/contourcodec.hpp). The grid extent is the 
+ * coordinates of the first and last grid points, and the interval is 0 if the levels were given.
+ */
+type ContourFileInfo = {
+    ni: number;
+    nj: number;
+    grid_x_min: number;
+    grid_y_min: number;
+    grid_x_max: number;
+    grid_y_max: number;
+    interval: number;
+    levels: Float32Array;
+    quad_as_tri: boolean;
+    smooth: number;
+}
+
+/**
+ * Parse a contour file written by the `contourbatch` tool (see src/cpp/contourcodec.hpp for the layout)
+ */
+function parseContourFile(buffer: ArrayBuffer) : {info: ContourFileInfo, contours: EncodedContourData} {
+    const view = new DataView(buffer);
+    const magic = String.fromCharCode(...new Uint8Array(buffer, 0, Math.min(4, buffer.byteLength)));
+    if (magic != 'APCT') throw `Not a contour file`;
+
+    const version = view.getUint32(4, true);
+    if (version != 2) throw `Unsupported contour file version ${version}`;
+
+    const n_levels = view.getUint32(36, true);
+    let offset = 40;
+
+    const levels = new Float32Array(n_levels);
+    for (let ilvl = 0; ilvl < n_levels; ilvl++, offset += 4) levels[ilvl] = view.getFloat32(offset, true);
+
+    const info = {ni: view.getUint32(8, true), nj: view.getUint32(12, true), grid_x_min: view.getFloat32(16, true), grid_y_min: view.getFloat32(20, true),
+                  grid_x_max: view.getFloat32(24, true), grid_y_max: view.getFloat32(28, true), interval: view.getFloat32(32, true), levels: levels,
+                  quad_as_tri: (view.getUint32(offset, true) & 1) != 0, smooth: view.getUint32(offset + 4, true)};
+    offset += 8;
+
+    const bounds_offset = offset;
+    const n_contours = view.getUint32(bounds_offset + 16, true);
+    offset += 20;
+
+    const values = new Float32Array(n_contours);
+    for (let ic = 0; ic < n_contours; ic++, offset += 4) values[ic] = view.getFloat32(offset, true);
+
+    const n_points = new Uint32Array(n_contours);
+    for (let ic = 0; ic < n_contours; ic++, offset += 4) n_points[ic] = view.getUint32(offset, true);
+
+    const n_bytes = view.getUint32(offset, true);
+    offset += 4;
+    if (offset + n_bytes > buffer.byteLength) throw `Contour file ended early`;
+
+    const contours = {x_min: view.getFloat32(bounds_offset, true), y_min: view.getFloat32(bounds_offset + 4, true), 
+                      x_max: view.getFloat32(bounds_offset + 8, true), y_max: view.getFloat32(bounds_offset + 12, true),
+                      values: values, n_points: n_points, data: new Uint8Array(buffer, offset, n_bytes)};
+
+    return {info: info, contours: contours};
+}
+
+/**
+ * Find the bounding box of a map viewport in some other coordinate system (e.g., grid coordinates). The transform can bend the edges of the 
+ * viewport, so this samples along each edge instead of just using the corners.
+ * @param viewport  - The viewport in WebMercator coordinates (0 to 1, with y increasing to the south)
+ * @param transform - Transform from longitude and latitude to the other coordinate system
+ */
+function getViewportBounds(viewport: {x_min: number, y_min: number, x_max: number, y_max: number}, transform: (lon: number, lat: number) => [number, number]) {
+    const n_samples = 16;
+    let x_min = Infinity, x_max = -Infinity, y_min = Infinity, y_max = -Infinity;
+
+    for (let isamp = 0; isamp <= n_samples; isamp++) {
+        const frac = isamp / n_samples;
+        const mx = viewport.x_min + frac * (viewport.x_max - viewport.x_min);
+        const my = viewport.y_min + frac * (viewport.y_max - viewport.y_min);
+
+        const edge_points = [[mx, viewport.y_min], [mx, viewport.y_max], [viewport.x_min, my], [viewport.x_max, my]];
+        edge_points.forEach(([px, py]) => {
+            const [x, y] = transform(lngFromMercatorX(px), latFromMercatorY(py));
+            x_min = Math.min(x_min, x); x_max = Math.max(x_max, x);
+            y_min = Math.min(y_min, y); y_max = Math.max(y_max, y);
+        });
+    }
+
+    return {x_min: x_min, y_min: y_min, x_max: x_max, y_max: y_max};
+}
+
+export {zip, getOS, Cache, normalizeOptions, getArrayConstructor, mergeShaderCode, applySamplerCodeScalar, applySamplerCodeVector, argMin, decodeContourData, parseContourFile, getViewportBounds};
+export type {ContourFileInfo};